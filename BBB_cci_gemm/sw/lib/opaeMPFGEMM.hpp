@@ -37,6 +37,7 @@
 #include <string>
 #include <time.h>
 #include "opae_svc_wrapper.h"
+#include <opae/mpf/wait.h>
 #include <math.h>
 #include "gemmHelper.hpp"
 #include "gemmLib.hpp"
@@ -152,6 +153,8 @@ class	opaeMPFGEMM {
  bool 					m_is_hw;
  bool					m_is_packed;
  uint32_t				packing;
+ // Reused by every runGEMM() so the spin budget follows the job length
+ mpf_wait_state			m_wait_state;
 					
 };
 
@@ -333,12 +336,9 @@ uint32_t opaeMPFGEMM<T1, T2>::runGEMM(
 	
 	fpga_gemm->mmioWrite64(CSR_CTL, 1);
 	
-	long f = 0;
-	//Wait for the GEMM Accelerator to Complete else time out!
-	while ((0 == ((*status_ptr) & 0x1) && (f <1000000))){
-		usleep(100);
-		if(m_is_hw) f++;
-	}
+	//Wait for the GEMM Accelerator to Complete else time out (100s on HW)!
+	mpfWaitUntilTimeout(&m_wait_state, status_ptr, 0x1, 0x1, true,
+	                    m_is_hw ? 100000000000ULL : 0, NULL);
 	// Stop GEMM Accelerator
 	
 	fpga_gemm->mmioWrite64(CSR_CTL, 7);
@@ -376,7 +376,7 @@ opaeMPFGEMM<T1, T2>::opaeMPFGEMM():
         dsm_status(NULL),
         dsm_size(0),
         fpga_gemm(NULL){
-		
+		mpfWaitInit(&m_wait_state);
 		
 }
 /*
@@ -452,7 +452,7 @@ module cci_mpf_svc_vtp
 
         if (! reset)
         begin
-            assert (! pt_walk_client.notPresent) else
+            assert (! pt_walk_client.notPresent || csrs.vtp_in_mode.fault_wait) else
                 $fatal("cci_mpf_svc_vtp: VA not present in page table");
         end
     end
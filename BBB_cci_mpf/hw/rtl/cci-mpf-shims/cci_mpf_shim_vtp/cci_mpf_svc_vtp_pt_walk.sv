@@ -195,6 +195,7 @@ module cci_mpf_svc_vtp_pt_walk
         STATE_PT_WALK_READ_RSP,
         STATE_PT_WALK_DONE,
         STATE_PT_WALK_ERROR,
+        STATE_PT_WALK_FAULT_WAIT,
         STATE_PT_WALK_HALT
     }
     t_state_pt_walk;
@@ -484,14 +485,41 @@ module cci_mpf_svc_vtp_pt_walk
 
           STATE_PT_WALK_ERROR:
             begin
-                // Terminal state
                 pt_walk.notPresent <= 1'b1;
-                state <= STATE_PT_WALK_HALT;
 
-                if (! reset)
+                if (csrs.vtp_in_mode.fault_wait)
                 begin
-                    $fatal("VTP PT WALK: No translation found for VA 0x%x",
-                           { translate_va, CCI_PT_4KB_PAGE_OFFSET_BITS'(0), 6'b0 });
+                    // Software pins pages on demand.  It will add the
+                    // translation to the page table and signal with an
+                    // invalidation.  The failed request is dropped and
+                    // retried by the translation pipeline.
+                    state <= STATE_PT_WALK_FAULT_WAIT;
+                end
+                else
+                begin
+                    // Terminal state
+                    state <= STATE_PT_WALK_HALT;
+
+                    if (! reset)
+                    begin
+                        $fatal("VTP PT WALK: No translation found for VA 0x%x",
+                               { translate_va, CCI_PT_4KB_PAGE_OFFSET_BITS'(0), 6'b0 });
+                    end
+                end
+            end
+
+          STATE_PT_WALK_FAULT_WAIT:
+            begin
+                pt_walk.notPresent <= 1'b0;
+
+                // translate_va holds the failed address, visible to
+                // software in the statLastTranslateVA CSR, until software
+                // writes an invalidation.
+                if (csrs.vtp_in_inval_page_valid ||
+                    csrs.vtp_in_mode.inval_translation_cache)
+                begin
+                    state <= STATE_PT_WALK_IDLE;
+                    state_is_walk_idle <= 1'b1;
                 end
             end
 
@@ -634,11 +662,22 @@ module cci_mpf_svc_vtp_pt_walk
     //
     assign tlb_fill_if.fillEn = state_is_walk_done && tlb_fill_if.fillRdy;
     assign tlb_fill_if.fillVA = translate_va;
-    assign tlb_fill_if.fillPA = pt_walk_cur_page;
 
-    // Use just bit 0 of translate_depth, which is either 2 for a 2MB page
-    // or 3 for a 4KB page.
-    assign tlb_fill_if.fillBigPage = ! (translate_depth[0]);
+    // translate_depth is 1 for a 1GB page, 2 for a 2MB page or 3 for a 4KB
+    // page.  There is no 1GB TLB.  A 1GB page is inserted in the 2MB TLB as
+    // the 2MB region containing the requested address.
+    always_comb
+    begin
+        tlb_fill_if.fillPA = pt_walk_cur_page;
+
+        if (translate_depth == t_cci_mpf_pt_walk_depth'(1))
+        begin
+            tlb_fill_if.fillPA[9 +: 9] = translate_va[9 +: 9];
+        end
+    end
+
+    assign tlb_fill_if.fillBigPage =
+        (translate_depth != t_cci_mpf_pt_walk_depth'(CCI_MPF_PT_MAX_DEPTH - 1));
 
 endmodule // cci_mpf_svc_vtp_pt_walk
 
@@ -57,6 +57,7 @@ package cci_mpf_csrs_pkg;
 
     // CCI_MPF_VTP_CSR_MODE -- see cci_mpf_csrs.h
     typedef struct packed {
+        logic fault_wait;
         logic inval_translation_cache;
         logic enabled;
     } t_cci_mpf_vtp_csr_mode;
@@ -0,0 +1,61 @@
+## Copyright(c) 2017, Intel Corporation
+##
+## Redistribution  and  use  in source  and  binary  forms,  with  or  without
+## modification, are permitted provided that the following conditions are met:
+##
+## * Redistributions of  source code  must retain the  above copyright notice,
+##   this list of conditions and the following disclaimer.
+## * Redistributions in binary form must reproduce the above copyright notice,
+##   this list of conditions and the following disclaimer in the documentation
+##   and/or other materials provided with the distribution.
+## * Neither the name  of Intel Corporation  nor the names of its contributors
+##   may be used to  endorse or promote  products derived  from this  software
+##   without specific prior written permission.
+##
+## THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+## AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+## IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+## ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+## LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+## CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+## SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+## INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+## CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+## ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+## POSSIBILITY OF SUCH DAMAGE.
+
+##
+## Software-only benchmarks of MPF internals.  The benchmarks connect to
+## MPF's FPGA emulator.  The libmpf sources are linked with a stub of the
+## OPAE driver functions so no FPGA software stack is needed.  They are
+## not installed.
+##
+
+add_library(mpf_bench_objs OBJECT ${LIBMPF} ${PROJECT_SOURCE_DIR}/bench/fpga_stub.c)
+target_include_directories(mpf_bench_objs PRIVATE ${PROJECT_SOURCE_DIR}/src/libmpf)
+
+add_executable(vtp_pt_walk
+    ${PROJECT_SOURCE_DIR}/bench/vtp_pt_walk.c
+    $<TARGET_OBJECTS:mpf_bench_objs>)
+target_include_directories(vtp_pt_walk PRIVATE ${PROJECT_SOURCE_DIR}/src/libmpf)
+
+add_executable(vtp_pt_ops
+    ${PROJECT_SOURCE_DIR}/bench/vtp_pt_ops.c
+    $<TARGET_OBJECTS:mpf_bench_objs>)
+target_include_directories(vtp_pt_ops PRIVATE ${PROJECT_SOURCE_DIR}/src/libmpf)
+
+add_executable(vtp_tlb_model
+    ${PROJECT_SOURCE_DIR}/bench/vtp_tlb_model.c
+    $<TARGET_OBJECTS:mpf_bench_objs>)
+target_include_directories(vtp_tlb_model PRIVATE ${PROJECT_SOURCE_DIR}/src/libmpf)
+
+add_executable(mpf_stats_export
+    ${PROJECT_SOURCE_DIR}/bench/mpf_stats_export.c
+    $<TARGET_OBJECTS:mpf_bench_objs>)
+
+if(CMAKE_THREAD_LIBS_INIT)
+    target_link_libraries(vtp_pt_walk "${CMAKE_THREAD_LIBS_INIT}")
+    target_link_libraries(vtp_pt_ops "${CMAKE_THREAD_LIBS_INIT}")
+    target_link_libraries(vtp_tlb_model "${CMAKE_THREAD_LIBS_INIT}")
+    target_link_libraries(mpf_stats_export "${CMAKE_THREAD_LIBS_INIT}")
+endif()
@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Link-time stand-in for the OPAE driver.  libmpf references the OPAE
+// device functions, but the benchmarks connect to MPF's emulator with
+// mpfConnectBackend() and never call them.
+//
+
+#include <opae/fpga.h>
+
+
+fpga_result fpgaPrepareBuffer(
+    fpga_handle handle,
+    uint64_t len,
+    void **buf_addr,
+    uint64_t *wsid,
+    int flags
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaReleaseBuffer(
+    fpga_handle handle,
+    uint64_t wsid
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaGetIOAddress(
+    fpga_handle handle,
+    uint64_t wsid,
+    uint64_t *ioaddr
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaReadMMIO64(
+    fpga_handle handle,
+    uint32_t mmio_num,
+    uint64_t offset,
+    uint64_t *value
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaWriteMMIO64(
+    fpga_handle handle,
+    uint32_t mmio_num,
+    uint64_t offset,
+    uint64_t value
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaMapMMIO(
+    fpga_handle handle,
+    uint32_t mmio_num,
+    uint64_t **mmio_ptr
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaGetPropertiesFromHandle(
+    fpga_handle handle,
+    fpga_properties *prop
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaDestroyProperties(
+    fpga_properties *prop
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaPropertiesGetBus(
+    const fpga_properties prop,
+    uint8_t *bus
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaPropertiesGetDevice(
+    const fpga_properties prop,
+    uint8_t *device
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaPropertiesGetDeviceID(
+    const fpga_properties prop,
+    uint16_t *device_id
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result fpgaPropertiesGetFunction(
+    const fpga_properties prop,
+    uint8_t *function
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
@@ -0,0 +1,196 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Export MPF statistics in OpenMetrics text format from an emulated AFU.
+// The program writes the emulated shims' statistics counters as though
+// the AFU were running a steady load, so consecutive scrapes show
+// counters advancing.
+//
+// Usage: mpf_stats_export [seconds] [port | file]
+//
+// With no port or file the text is printed once.  A numeric argument is
+// a TCP port on the loopback interface, served for the given number of
+// seconds.  Otherwise the argument is a file rewritten once per second,
+// as node_exporter's textfile collector expects.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <opae/mpf/mpf.h>
+
+#define AFU_LABEL "emulated"
+
+// Clock frequency of the emulated shims
+#define CLOCK_MHZ 400
+
+// Counter update period (us)
+#define UPDATE_US 100000
+
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+//
+// Statistics counters of the simulated load, each a fraction of the
+// elapsed cycles: (per_1024 / 1024) * cycles.
+//
+typedef struct
+{
+    t_cci_mpf_shim_idx shim;
+    uint64_t csr;
+    uint32_t per_1024;
+}
+t_load_counter;
+
+static const t_load_counter load[] =
+{
+    { CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_4KB_TLB_NUM_HITS, 96 },
+    { CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_4KB_TLB_NUM_MISSES, 4 },
+    { CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_2MB_TLB_NUM_HITS, 192 },
+    { CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_2MB_TLB_NUM_MISSES, 2 },
+    { CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_PT_WALK_BUSY_CYCLES, 120 },
+    { CCI_MPF_SHIM_WRO, CCI_MPF_WRO_CSR_STAT_RR_CONFLICT, 10 },
+    { CCI_MPF_SHIM_WRO, CCI_MPF_WRO_CSR_STAT_RW_CONFLICT, 20 },
+    { CCI_MPF_SHIM_WRO, CCI_MPF_WRO_CSR_STAT_WR_CONFLICT, 30 },
+    { CCI_MPF_SHIM_WRO, CCI_MPF_WRO_CSR_STAT_WW_CONFLICT, 5 },
+    { CCI_MPF_SHIM_PWRITE, CCI_MPF_PWRITE_CSR_STAT_NUM_PWRITES, 1 }
+};
+
+
+static void updateCounters(mpf_handle_t mpf, uint64_t start_ns)
+{
+    uint64_t cycles = (nowNs() - start_ns) * CLOCK_MHZ / 1000;
+
+    for (size_t i = 0; i < sizeof(load) / sizeof(load[0]); i++)
+    {
+        mpfWriteCsr(mpf, load[i].shim, load[i].csr,
+                    cycles / 1024 * load[i].per_1024);
+    }
+
+    // The VC mapper changes its mapping about once per millisecond
+    mpfWriteCsr(mpf, CCI_MPF_SHIM_VC_MAP,
+                CCI_MPF_VC_MAP_CSR_STAT_NUM_MAPPING_CHANGES,
+                cycles / (CLOCK_MHZ * 1000));
+}
+
+
+static bool isPort(const char* s)
+{
+    if (0 == *s) return false;
+
+    for (; *s; s++)
+    {
+        if (! isdigit(*s)) return false;
+    }
+
+    return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+    fpga_handle emu;
+    const mpf_backend* backend;
+    mpf_handle_t mpf;
+    fpga_result r;
+    uint32_t seconds = (argc > 1) ? atoi(argv[1]) : 0;
+    const char* sink = (argc > 2) ? argv[2] : NULL;
+
+    if ((FPGA_OK != mpfEmulatorOpen(0, &emu, &backend)) ||
+        (FPGA_OK != mpfConnectBackend(backend, emu, 0, 0, &mpf, 0)))
+    {
+        fprintf(stderr, "Failed to connect to the emulator\n");
+        return 1;
+    }
+
+    uint64_t start_ns = nowNs();
+    usleep(UPDATE_US);
+    updateCounters(mpf, start_ns);
+
+    if (NULL == sink)
+    {
+        size_t len;
+        mpfStatsFormatOpenMetrics(mpf, AFU_LABEL, NULL, 0, &len);
+
+        char* text = malloc(len + 1);
+        r = mpfStatsFormatOpenMetrics(mpf, AFU_LABEL, text, len + 1, &len);
+        if (FPGA_OK == r) fputs(text, stdout);
+        free(text);
+    }
+    else if (isPort(sink))
+    {
+        uint16_t port;
+        r = mpfStatsExporterStart(mpf, AFU_LABEL, atoi(sink), &port);
+        if (FPGA_OK == r)
+        {
+            printf("Serving http://127.0.0.1:%d/metrics for %d seconds\n",
+                   port, seconds);
+            fflush(stdout);
+
+            for (uint64_t i = 0; i < seconds * (1000000 / UPDATE_US); i++)
+            {
+                usleep(UPDATE_US);
+                updateCounters(mpf, start_ns);
+            }
+        }
+    }
+    else
+    {
+        printf("Writing %s once per second for %d seconds\n", sink, seconds);
+        do
+        {
+            r = mpfStatsWriteOpenMetrics(mpf, AFU_LABEL, sink);
+            if ((FPGA_OK != r) || (0 == seconds)) break;
+            sleep(1);
+            updateCounters(mpf, start_ns);
+        }
+        while (--seconds);
+    }
+
+    if (FPGA_OK != r)
+    {
+        fprintf(stderr, "Export failed: %d\n", r);
+    }
+
+    mpfDisconnect(mpf);
+    mpfEmulatorClose(emu);
+    return (FPGA_OK == r) ? 0 : 1;
+}
@@ -0,0 +1,349 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Measure building, walking and tearing down the VTP page table.  Each
+// thread owns a disjoint virtual buffer.  Threads insert every page of
+// their buffers one at a time, translate random addresses and then
+// remove the pages.  Inserts and removes contend for the page table
+// mutex.  Translations are lock-free.
+//
+// Buffer sizes, page mixes and thread counts are swept.  The "mix"
+// page mix fills each 2MB slot of a buffer with either a 2MB page or
+// 512 4KB pages, chosen at random.
+//
+// Usage: vtp_pt_ops [max threads] [translations per thread]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <opae/mpf/mpf.h>
+#include "mpf_internal.h"
+
+// Arbitrary 1GB aligned virtual and physical bases.  Each thread's buffer
+// starts at a multiple of THREAD_STRIDE from the base.  The translations
+// are never dereferenced.
+#define REGION_VA 0x200000000000ULL
+#define REGION_PA 0x4000000000ULL
+#define THREAD_STRIDE (64ULL << 30)
+
+#define MAX_THREADS 64
+
+// Page mixes
+typedef enum
+{
+    MIX_4KB,
+    MIX_2MB,
+    MIX_1GB,
+    MIX_MIXED
+}
+t_page_mix;
+
+static const char* mix_names[] = { "4KB", "2MB", "1GB", "mix" };
+
+
+typedef struct
+{
+    mpf_vtp_pt* pt;
+    pthread_barrier_t* barrier;
+
+    uint64_t va;
+    uint64_t pa;
+    uint64_t buf_bytes;
+    t_page_mix mix;
+    uint64_t n_translations;
+
+    // Results
+    uint64_t n_pages;
+    double insert_ns;
+    double translate_ns;
+    double remove_ns;
+    uint64_t errors;
+}
+t_thread_args;
+
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static uint64_t nextRand(uint64_t* seed)
+{
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *seed >> 16;
+}
+
+
+//
+// Page size at an offset in a buffer.  Offsets are visited in order, so
+// the page size of a "mix" buffer is picked at each 2MB boundary.
+//
+static mpf_vtp_page_size pageSizeAt(
+    t_page_mix mix,
+    uint64_t offset,
+    uint64_t* seed,
+    mpf_vtp_page_size* slot_size
+)
+{
+    const uint64_t mask_2mb = mpfPageSizeEnumToBytes(MPF_VTP_PAGE_2MB) - 1;
+
+    switch (mix)
+    {
+      case MIX_1GB:
+        return MPF_VTP_PAGE_1GB;
+      case MIX_2MB:
+        return MPF_VTP_PAGE_2MB;
+      case MIX_4KB:
+        return MPF_VTP_PAGE_4KB;
+      default:
+        if (0 == (offset & mask_2mb))
+        {
+            *slot_size = (nextRand(seed) & 1) ? MPF_VTP_PAGE_2MB :
+                                                MPF_VTP_PAGE_4KB;
+        }
+        return *slot_size;
+    }
+}
+
+
+static void* runThread(void* arg)
+{
+    t_thread_args* t = (t_thread_args*)arg;
+    uint64_t seed = t->va;
+    mpf_vtp_page_size slot_size = MPF_VTP_PAGE_4KB;
+    double start;
+
+    // Insert
+    pthread_barrier_wait(t->barrier);
+    start = now();
+    t->n_pages = 0;
+    for (uint64_t offset = 0; offset < t->buf_bytes; )
+    {
+        mpf_vtp_page_size size = pageSizeAt(t->mix, offset, &seed, &slot_size);
+        if (FPGA_OK != mpfVtpPtInsertPageMapping(t->pt,
+                                                 (mpf_vtp_pt_vaddr)(t->va + offset),
+                                                 t->pa + offset, 0, size, 0))
+        {
+            t->errors += 1;
+        }
+
+        offset += mpfPageSizeEnumToBytes(size);
+        t->n_pages += 1;
+    }
+    t->insert_ns = (now() - start) * 1e9 / t->n_pages;
+
+    // Translate random addresses
+    pthread_barrier_wait(t->barrier);
+    start = now();
+    for (uint64_t i = 0; i < t->n_translations; i++)
+    {
+        uint64_t offset = nextRand(&seed) % t->buf_bytes;
+        mpf_vtp_pt_paddr pa;
+        mpf_vtp_page_size size;
+
+        if ((FPGA_OK != mpfVtpPtTranslateVAtoPA(t->pt,
+                                                (mpf_vtp_pt_vaddr)(t->va + offset),
+                                                &pa, &size, NULL)) ||
+            (pa != t->pa + (offset & ~(mpfPageSizeEnumToBytes(size) - 1))))
+        {
+            t->errors += 1;
+        }
+    }
+    t->translate_ns = (now() - start) * 1e9 / t->n_translations;
+
+    // Remove.  The page table reports the size of each page.
+    pthread_barrier_wait(t->barrier);
+    start = now();
+    for (uint64_t offset = 0; offset < t->buf_bytes; )
+    {
+        mpf_vtp_page_size size = MPF_VTP_PAGE_4KB;
+        if (FPGA_OK != mpfVtpPtRemovePageMapping(t->pt,
+                                                 (mpf_vtp_pt_vaddr)(t->va + offset),
+                                                 NULL, NULL, NULL, &size, NULL))
+        {
+            t->errors += 1;
+        }
+
+        offset += mpfPageSizeEnumToBytes(size);
+    }
+    t->remove_ns = (now() - start) * 1e9 / t->n_pages;
+
+    pthread_barrier_wait(t->barrier);
+    return NULL;
+}
+
+
+//
+// Run one configuration.  Returns false on error.
+//
+static bool runConfig(
+    struct _mpf_handle_t* mpf,
+    uint64_t buf_bytes,
+    t_page_mix mix,
+    uint32_t n_threads,
+    uint64_t n_translations
+)
+{
+    mpf_vtp_pt* pt;
+    pthread_t tid[MAX_THREADS];
+    t_thread_args args[MAX_THREADS];
+    pthread_barrier_t barrier;
+
+    if (FPGA_OK != mpfVtpPtInit(mpf, &pt))
+    {
+        fprintf(stderr, "Failed to allocate page table\n");
+        return false;
+    }
+
+    // The main thread joins the barrier between phases to sample the
+    // number of nodes after all pages are inserted.
+    pthread_barrier_init(&barrier, NULL, n_threads + 1);
+
+    for (uint32_t i = 0; i < n_threads; i++)
+    {
+        memset(&args[i], 0, sizeof(args[i]));
+        args[i].pt = pt;
+        args[i].barrier = &barrier;
+        args[i].va = REGION_VA + i * THREAD_STRIDE;
+        args[i].pa = REGION_PA + i * THREAD_STRIDE;
+        args[i].buf_bytes = buf_bytes;
+        args[i].mix = mix;
+        args[i].n_translations = n_translations;
+
+        pthread_create(&tid[i], NULL, runThread, &args[i]);
+    }
+
+    uint64_t n_pinned, n_used;
+
+    pthread_barrier_wait(&barrier);     // Start insert
+    pthread_barrier_wait(&barrier);     // Start translate
+    mpfVtpPtGetNodeCounts(pt, &n_pinned, &n_used);
+    pthread_barrier_wait(&barrier);     // Start remove
+    pthread_barrier_wait(&barrier);     // Done
+
+    double insert_ns = 0, translate_ns = 0, remove_ns = 0;
+    uint64_t n_pages = 0, errors = 0;
+    for (uint32_t i = 0; i < n_threads; i++)
+    {
+        pthread_join(tid[i], NULL);
+
+        insert_ns += args[i].insert_ns;
+        translate_ns += args[i].translate_ns;
+        remove_ns += args[i].remove_ns;
+        n_pages += args[i].n_pages;
+        errors += args[i].errors;
+    }
+
+    pthread_barrier_destroy(&barrier);
+    mpfVtpPtTerm(pt);
+
+    // Times are per-thread averages
+    printf("  %8" PRIu64 " %-4s %7u %10" PRIu64 " %11.1f %11.1f %11.1f %11" PRIu64 " %13" PRIu64 "\n",
+           buf_bytes >> 20, mix_names[mix], n_threads, n_pages,
+           insert_ns / n_threads, translate_ns / n_threads, remove_ns / n_threads,
+           n_used, n_pinned);
+
+    if (errors)
+    {
+        fprintf(stderr, "%" PRIu64 " errors\n", errors);
+    }
+
+    return (0 == errors);
+}
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t max_threads = 4;
+    uint64_t n_translations = 1 << 20;
+
+    if (argc > 1) max_threads = strtoul(argv[1], NULL, 0);
+    if (argc > 2) n_translations = strtoull(argv[2], NULL, 0);
+    if ((0 == max_threads) || (max_threads > MAX_THREADS) || (0 == n_translations))
+    {
+        fprintf(stderr, "Usage: %s [max threads (1-%d)] [translations per thread]\n",
+                argv[0], MAX_THREADS);
+        return 1;
+    }
+
+    // Buffer sizes per thread
+    static const uint64_t buf_sizes[] = { 16ULL << 20, 256ULL << 20, 4ULL << 30 };
+    static const t_page_mix mixes[] = { MIX_4KB, MIX_2MB, MIX_1GB, MIX_MIXED };
+
+    // The page table needs only the device and debug flag.  Page table
+    // nodes are pinned in an emulated device.
+    struct _mpf_handle_t mpf;
+    memset(&mpf, 0, sizeof(mpf));
+    if (FPGA_OK != mpfEmulatorOpen(0, &mpf.handle, &mpf.backend))
+    {
+        fprintf(stderr, "Failed to open emulator\n");
+        return 1;
+    }
+
+    printf("%" PRIu64 " random translations per thread.  Times are ns/op, averaged over threads.\n\n",
+           n_translations);
+    printf("  Buf (MB) Page Threads      Pages      Insert   Translate      Remove  Nodes used  Nodes pinned\n");
+
+    int status = 0;
+    for (size_t b = 0; b < sizeof(buf_sizes) / sizeof(buf_sizes[0]); b++)
+    {
+        for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++)
+        {
+            // Buffers must hold at least one page
+            if ((MIX_1GB == mixes[m]) &&
+                (buf_sizes[b] < mpfPageSizeEnumToBytes(MPF_VTP_PAGE_1GB)))
+            {
+                continue;
+            }
+
+            for (uint32_t n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+            {
+                if (! runConfig(&mpf, buf_sizes[b], mixes[m], n_threads,
+                                n_translations))
+                {
+                    status = 1;
+                }
+            }
+        }
+    }
+
+    mpfEmulatorClose(mpf.handle);
+    return status;
+}
@@ -0,0 +1,247 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Measure software walks of the VTP page table.  The same virtual region
+// is mapped with 4KB, 2MB and 1GB pages and random addresses in it are
+// translated.  Larger pages terminate the walk closer to the root.
+//
+// Usage: vtp_pt_walk [region GB] [translations]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include <opae/mpf/mpf.h>
+#include "mpf_internal.h"
+
+// Arbitrary 1GB aligned virtual and physical bases.  The translations are
+// never dereferenced.
+#define REGION_VA 0x200000000000ULL
+#define REGION_PA 0x4000000000ULL
+
+// Mappings passed to mpfVtpPtInsertPageMappings() at a time
+#define BATCH_SIZE 256
+
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// Walk levels from the root to a translation of the given size
+static uint32_t walkLevels(mpf_vtp_page_size page_size)
+{
+    switch (page_size)
+    {
+      case MPF_VTP_PAGE_1GB:
+        return 2;
+      case MPF_VTP_PAGE_2MB:
+        return 3;
+      default:
+        return 4;
+    }
+}
+
+
+static fpga_result mapRegion(
+    mpf_vtp_pt* pt,
+    uint64_t region_bytes,
+    mpf_vtp_page_size page_size
+)
+{
+    fpga_result r;
+    mpf_vtp_pt_mapping batch[BATCH_SIZE];
+    uint32_t n = 0;
+    uint64_t page_bytes = mpfPageSizeEnumToBytes(page_size);
+
+    for (uint64_t offset = 0; offset < region_bytes; offset += page_bytes)
+    {
+        batch[n].va = (mpf_vtp_pt_vaddr)(REGION_VA + offset);
+        batch[n].pa = REGION_PA + offset;
+        batch[n].wsid = 0;
+        batch[n].size = page_size;
+        batch[n].flags = 0;
+
+        if ((++n == BATCH_SIZE) || (offset + page_bytes == region_bytes))
+        {
+            r = mpfVtpPtInsertPageMappings(pt, batch, n, NULL);
+            if (FPGA_OK != r) return r;
+            n = 0;
+        }
+    }
+
+    return FPGA_OK;
+}
+
+
+static void unmapRegion(
+    mpf_vtp_pt* pt,
+    uint64_t region_bytes,
+    mpf_vtp_page_size page_size
+)
+{
+    uint64_t page_bytes = mpfPageSizeEnumToBytes(page_size);
+
+    for (uint64_t offset = 0; offset < region_bytes; offset += page_bytes)
+    {
+        mpfVtpPtRemovePageMapping(pt, (mpf_vtp_pt_vaddr)(REGION_VA + offset),
+                                  NULL, NULL, NULL, NULL, NULL);
+    }
+}
+
+
+static bool runWalks(
+    mpf_vtp_pt* pt,
+    const uint64_t* offsets,
+    uint64_t n_offsets,
+    mpf_vtp_page_size page_size,
+    double* ns_per_op
+)
+{
+    uint64_t page_mask = mpfPageSizeEnumToBytes(page_size) - 1;
+    mpf_vtp_pt_paddr pa;
+    mpf_vtp_page_size size;
+    uint64_t errors = 0;
+
+    double start = now();
+    for (uint64_t i = 0; i < n_offsets; i++)
+    {
+        mpf_vtp_pt_vaddr va = (mpf_vtp_pt_vaddr)(REGION_VA + offsets[i]);
+        if ((FPGA_OK != mpfVtpPtTranslateVAtoPA(pt, va, &pa, &size, NULL)) ||
+            (pa != REGION_PA + (offsets[i] & ~page_mask)) ||
+            (size != page_size))
+        {
+            errors += 1;
+        }
+    }
+    *ns_per_op = (now() - start) * 1e9 / n_offsets;
+
+    if (errors)
+    {
+        fprintf(stderr, "%" PRIu64 " incorrect translations\n", errors);
+    }
+
+    return (0 == errors);
+}
+
+
+int main(int argc, char *argv[])
+{
+    uint64_t region_gb = 4;
+    uint64_t n_offsets = 1 << 22;
+
+    if (argc > 1) region_gb = strtoull(argv[1], NULL, 0);
+    if (argc > 2) n_offsets = strtoull(argv[2], NULL, 0);
+    if ((0 == region_gb) || (0 == n_offsets))
+    {
+        fprintf(stderr, "Usage: %s [region GB] [translations]\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t region_bytes = region_gb << 30;
+
+    // The same random addresses are translated for every page size
+    uint64_t* offsets = malloc(n_offsets * sizeof(uint64_t));
+    if (NULL == offsets) return 1;
+
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for (uint64_t i = 0; i < n_offsets; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        offsets[i] = (seed >> 16) % region_bytes;
+    }
+
+    // The page table needs only the device and debug flag.  Page table
+    // nodes are pinned in an emulated device.
+    struct _mpf_handle_t mpf;
+    memset(&mpf, 0, sizeof(mpf));
+    if (FPGA_OK != mpfEmulatorOpen(0, &mpf.handle, &mpf.backend))
+    {
+        fprintf(stderr, "Failed to open emulator\n");
+        return 1;
+    }
+
+    static const mpf_vtp_page_size sizes[] = { MPF_VTP_PAGE_4KB,
+                                               MPF_VTP_PAGE_2MB,
+                                               MPF_VTP_PAGE_1GB };
+
+    printf("Region %" PRIu64 " GB, %" PRIu64 " random translations\n\n",
+           region_gb, n_offsets);
+    printf("  Page   Levels   Map (ms)   Walk (ns/op)\n");
+
+    int status = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        mpf_vtp_page_size page_size = sizes[i];
+        mpf_vtp_pt* pt;
+
+        if (FPGA_OK != mpfVtpPtInit(&mpf, &pt))
+        {
+            fprintf(stderr, "Failed to allocate page table\n");
+            return 1;
+        }
+
+        double start = now();
+        if (FPGA_OK != mapRegion(pt, region_bytes, page_size))
+        {
+            fprintf(stderr, "Failed to map region\n");
+            return 1;
+        }
+        double map_ms = (now() - start) * 1e3;
+
+        // Warm the caches, then measure
+        double ns_per_op;
+        runWalks(pt, offsets, n_offsets, page_size, &ns_per_op);
+        if (! runWalks(pt, offsets, n_offsets, page_size, &ns_per_op))
+        {
+            status = 1;
+        }
+
+        printf("  %-6s %6u %10.2f %14.2f\n",
+               (page_size == MPF_VTP_PAGE_1GB ? "1GB" :
+                (page_size == MPF_VTP_PAGE_2MB ? "2MB" : "4KB")),
+               walkLevels(page_size), map_ms, ns_per_op);
+
+        unmapRegion(pt, region_bytes, page_size);
+        mpfVtpPtTerm(pt);
+    }
+
+    free(offsets);
+    mpfEmulatorClose(mpf.handle);
+    return status;
+}
@@ -0,0 +1,294 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Predict the FPGA's VTP translation behavior for a synthetic AFU
+// access pattern with the host-side model in shim_vtp_model.h.  Two
+// buffers are streamed in and one streamed out a line at a time while
+// a fourth, a lookup table, is read at random.  The layout is mapped
+// with each page size in turn and the model reports hit rates, page
+// table reads per walk and the buffers responsible for the walks.
+//
+// Usage: vtp_tlb_model [table MB] [accesses]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <opae/mpf/mpf.h>
+#include "mpf_internal.h"
+
+// Arbitrary 1GB aligned virtual and physical bases.  Buffers are placed
+// at 1GB intervals.  The translations are never dereferenced.
+#define LAYOUT_VA 0x200000000000ULL
+#define LAYOUT_PA 0x4000000000ULL
+
+// Size of the streamed buffers
+#define STREAM_BYTES (16ULL << 20)
+
+// Accesses replayed at a time
+#define TRACE_CHUNK 4096
+
+#define CL_BYTES 64
+
+
+typedef struct
+{
+    const char* name;
+    uint64_t bytes;
+}
+t_buffer;
+
+static t_buffer buffers[] =
+{
+    { "src0", STREAM_BYTES },
+    { "src1", STREAM_BYTES },
+    { "dst", STREAM_BYTES },
+    { "table", 0 }
+};
+
+#define N_BUFFERS (sizeof(buffers) / sizeof(buffers[0]))
+
+
+static char* bufferVA(uint32_t idx)
+{
+    return (char*)(LAYOUT_VA + ((uint64_t)idx << 30));
+}
+
+
+static uint64_t roundUp(uint64_t n, uint64_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+
+//
+// Map each buffer with a single page size, marking the allocation
+// boundaries as mpfVtpBufferAllocate() does.
+//
+static fpga_result mapLayout(
+    mpf_vtp_pt* pt,
+    mpf_vtp_page_size page_size,
+    bool do_map
+)
+{
+    uint64_t page_bytes = mpfPageSizeEnumToBytes(page_size);
+
+    for (uint32_t b = 0; b < N_BUFFERS; b++)
+    {
+        uint64_t bytes = roundUp(buffers[b].bytes, page_bytes);
+
+        for (uint64_t offset = 0; offset < bytes; offset += page_bytes)
+        {
+            char* va = bufferVA(b) + offset;
+
+            if (! do_map)
+            {
+                mpfVtpPtRemovePageMapping(pt, va, NULL, NULL, NULL, NULL, NULL);
+                continue;
+            }
+
+            uint32_t flags = MPF_VTP_PT_FLAG_PREALLOCATED;
+            if (0 == offset) flags |= MPF_VTP_PT_FLAG_ALLOC_START;
+            if (offset + page_bytes == bytes) flags |= MPF_VTP_PT_FLAG_ALLOC_END;
+
+            fpga_result r;
+            r = mpfVtpPtInsertPageMapping(pt, va,
+                                          LAYOUT_PA + (va - bufferVA(0)),
+                                          0, page_size, flags);
+            if (FPGA_OK != r) return r;
+        }
+    }
+
+    return FPGA_OK;
+}
+
+
+static fpga_result replayTrace(
+    mpf_vtp_model_t model,
+    uint64_t n_accesses
+)
+{
+    mpf_vtp_model_access trace[TRACE_CHUNK];
+    uint64_t table_bytes = buffers[N_BUFFERS - 1].bytes;
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    uint64_t line = 0;
+    uint64_t n = 0;
+
+    while (n < n_accesses)
+    {
+        uint32_t i;
+        for (i = 0; (i + 4 <= TRACE_CHUNK) && (n + i < n_accesses); i += 4)
+        {
+            uint64_t offset = (line * CL_BYTES) % STREAM_BYTES;
+            line += 1;
+
+            trace[i].va = bufferVA(0) + offset;
+            trace[i].is_write = false;
+            trace[i + 1].va = bufferVA(1) + offset;
+            trace[i + 1].is_write = false;
+            trace[i + 2].va = bufferVA(2) + offset;
+            trace[i + 2].is_write = true;
+
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            trace[i + 3].va = bufferVA(3) + ((seed >> 16) % table_bytes);
+            trace[i + 3].is_write = false;
+        }
+
+        fpga_result r = mpfVtpModelReplay(model, trace, i);
+        if (FPGA_OK != r) return r;
+        n += i;
+    }
+
+    return FPGA_OK;
+}
+
+
+static const char* pageSizeName(mpf_vtp_page_size page_size)
+{
+    return (page_size == MPF_VTP_PAGE_1GB ? "1GB" :
+            (page_size == MPF_VTP_PAGE_2MB ? "2MB" : "4KB"));
+}
+
+
+static const char* bufferName(const void* va)
+{
+    for (uint32_t b = 0; b < N_BUFFERS; b++)
+    {
+        if (va == bufferVA(b)) return buffers[b].name;
+    }
+
+    return "?";
+}
+
+
+int main(int argc, char *argv[])
+{
+    uint64_t table_mb = 256;
+    uint64_t n_accesses = 1 << 22;
+
+    if (argc > 1) table_mb = strtoull(argv[1], NULL, 0);
+    if (argc > 2) n_accesses = strtoull(argv[2], NULL, 0);
+    if ((0 == table_mb) || (table_mb > 1024) || (0 == n_accesses))
+    {
+        fprintf(stderr, "Usage: %s [table MB (1-1024)] [accesses]\n", argv[0]);
+        return 1;
+    }
+
+    buffers[N_BUFFERS - 1].bytes = table_mb << 20;
+
+    fpga_handle emu;
+    const mpf_backend* backend;
+    mpf_handle_t mpf;
+    if ((FPGA_OK != mpfEmulatorOpen(0, &emu, &backend)) ||
+        (FPGA_OK != mpfConnectBackend(backend, emu, 0, 0, &mpf, 0)))
+    {
+        fprintf(stderr, "Failed to connect to the emulator\n");
+        return 1;
+    }
+
+    mpf_vtp_pt* pt = ((_mpf_handle_p)mpf)->vtp.pt;
+
+    mpf_vtp_model_config config;
+    mpfVtpModelDefaultConfig(&config);
+
+    printf("Streams 3 x %" PRIu64 " MB, random table %" PRIu64 " MB, "
+           "%" PRIu64 " accesses\n", (uint64_t)(STREAM_BYTES >> 20), table_mb,
+           n_accesses);
+    printf("L1 %u/%u entries, TLB 4KB %ux%u, TLB 2MB %ux%u, "
+           "PT cache %u lines\n\n",
+           config.l1_4kb_entries, config.l1_2mb_entries,
+           config.tlb_4kb_sets, config.tlb_4kb_ways,
+           config.tlb_2mb_sets, config.tlb_2mb_ways,
+           config.pt_cache_entries);
+
+    static const mpf_vtp_page_size sizes[] = { MPF_VTP_PAGE_4KB,
+                                               MPF_VTP_PAGE_2MB,
+                                               MPF_VTP_PAGE_1GB };
+
+    int status = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        mpf_vtp_page_size page_size = sizes[i];
+        mpf_vtp_model_t model;
+        mpf_vtp_model_stats stats;
+        mpf_vtp_model_buffer_stats top[N_BUFFERS];
+        uint32_t n_top;
+
+        if ((FPGA_OK != mapLayout(pt, page_size, true)) ||
+            (FPGA_OK != mpfVtpModelCreate(mpf, &config, &model)))
+        {
+            fprintf(stderr, "Failed to map buffers\n");
+            status = 1;
+            break;
+        }
+
+        // Warm the caches, then measure
+        replayTrace(model, n_accesses);
+        mpfVtpModelClearStats(model);
+        replayTrace(model, n_accesses);
+
+        mpfVtpModelGetStats(model, &stats);
+        mpfVtpModelGetTopBuffers(model, top, N_BUFFERS, &n_top);
+
+        printf("%s pages:\n", pageSizeName(page_size));
+        printf("  L1 hit rate   %6.2f%%\n", 100 * stats.l1_hit_rate);
+        printf("  TLB hit rate  %6.2f%% (of L1 misses)\n",
+               100 * stats.tlb_hit_rate);
+        printf("  Walks         %" PRIu64 " (%.2f%% of accesses), "
+               "%.2f PT reads/walk\n",
+               stats.walks_4kb + stats.walks_2mb,
+               100 * (1 - stats.hit_rate), stats.reads_per_walk);
+        if (stats.failed_walks)
+        {
+            printf("  Failed walks  %" PRIu64 "\n", stats.failed_walks);
+            status = 1;
+        }
+
+        printf("  Buffer      Accesses      Walks   PT reads\n");
+        for (uint32_t b = 0; b < n_top; b++)
+        {
+            printf("  %-8s %11" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+                   bufferName(top[b].va), top[b].accesses, top[b].walks,
+                   top[b].walk_reads);
+        }
+        printf("\n");
+
+        mpfVtpModelDestroy(model);
+        mapLayout(pt, page_size, false);
+    }
+
+    mpfDisconnect(mpf);
+    mpfEmulatorClose(emu);
+    return status;
+}
@@ -0,0 +1,145 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file backend.h
+ * \brief Device access backends, including an FPGA emulator
+ *
+ * MPF reaches the FPGA through a small set of driver functions: MMIO
+ * reads and writes and pinned buffer management.  By default these are
+ * the OPAE functions.  mpfConnectBackend() substitutes another
+ * implementation, such as the in-process emulator, so that host-side
+ * code can be run and measured without an FPGA.
+ */
+
+#ifndef __FPGA_MPF_BACKEND_H__
+#define __FPGA_MPF_BACKEND_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Device access functions.  Each has the signature and semantics of the
+ * OPAE function with the same name.  The fpga_handle passed to
+ * mpfConnectBackend() is passed to every function and may point to
+ * backend-specific state.
+ */
+typedef struct
+{
+    fpga_result (*fpgaReadMMIO64)(fpga_handle handle, uint32_t mmio_num,
+                                  uint64_t offset, uint64_t *value);
+    fpga_result (*fpgaWriteMMIO64)(fpga_handle handle, uint32_t mmio_num,
+                                   uint64_t offset, uint64_t value);
+    fpga_result (*fpgaMapMMIO)(fpga_handle handle, uint32_t mmio_num,
+                               uint64_t **mmio_ptr);
+
+    fpga_result (*fpgaPrepareBuffer)(fpga_handle handle, uint64_t len,
+                                     void **buf_addr, uint64_t *wsid,
+                                     int flags);
+    fpga_result (*fpgaReleaseBuffer)(fpga_handle handle, uint64_t wsid);
+    fpga_result (*fpgaGetIOAddress)(fpga_handle handle, uint64_t wsid,
+                                    uint64_t *ioaddr);
+}
+mpf_backend;
+
+
+/**
+ * Establish a connection to MPF through a backend
+ *
+ * Identical to mpfConnect() except that the device is reached through
+ * the functions in backend.
+ *
+ * @param[in]  backend      Device access functions.  NULL selects OPAE.
+ *                          The backend must remain valid until
+ *                          mpfDisconnect().
+ * @param[in]  handle       Device handle passed to the backend functions.
+ * @param[in]  mmio_num     Number of MMIO space to access.
+ * @param[in]  mmio_offset  Byte offset in MMIO space at which scanning for
+ *                          MPF features should begin.
+ * @param[out] mpf_handle   Handle describing the instantiated MPF shims.
+ * @param[in]  mpf_flags    Bitwise OR of flags to control MPF behavior.
+ * @returns                 FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfConnectBackend(
+    const mpf_backend* backend,
+    fpga_handle handle,
+    uint32_t mmio_num,
+    uint64_t mmio_offset,
+    mpf_handle_t *mpf_handle,
+    uint32_t mpf_flags
+);
+
+
+/**
+ * Create an emulated device.
+ *
+ * The emulator models an AFU containing MPF shims:
+ *
+ *   - MMIO space holds a device feature list with an AFU header followed
+ *     by one feature per emulated shim, as walked by mpfConnect().
+ *   - Shim CSRs are read/write storage.  Statistics counters stay at
+ *     zero unless written with mpfWriteCsr(), which tests can use to
+ *     inject values.
+ *   - Pinned buffers get I/O addresses with the same offset within a
+ *     1GB region as their virtual addresses, so huge pages map to
+ *     aligned I/O pages as they would on hardware.
+ *
+ * @param[in]  shim_mask    Bit mask of shims to instantiate, with bit i
+ *                          set for t_cci_mpf_shim_idx i.  0 instantiates
+ *                          all shims.
+ * @param[out] handle       Device handle to pass to mpfConnectBackend().
+ * @param[out] backend      Emulator backend to pass to mpfConnectBackend().
+ * @returns                 FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfEmulatorOpen(
+    uint32_t shim_mask,
+    fpga_handle* handle,
+    const mpf_backend** backend
+);
+
+
+/**
+ * Destroy an emulated device.  Buffers still pinned are released.
+ *
+ * @param[in]  handle       Handle from mpfEmulatorOpen().
+ * @returns                 FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfEmulatorClose(
+    fpga_handle handle
+);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FPGA_MPF_BACKEND_H__
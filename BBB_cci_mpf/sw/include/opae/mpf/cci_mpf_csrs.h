@@ -76,6 +76,10 @@ typedef enum
     //   Bit 1:
     //      0 - Normal
     //      1 - Invalidate current FPGA-side translation cache.
+    //   Bit 2:
+    //      0 - A failed translation halts the page table walker
+    //      1 - A failed translation is retried after the next
+    //          invalidation.  Used when software pins pages on demand.
     CCI_MPF_VTP_CSR_MODE = 24,
 
     // Page table physical address (line address) (write)
@@ -99,6 +99,23 @@ bool __MPF_API__ mpfShimPresent(
 );
 
 
+/**
+ * NUMA node to which the FPGA is attached
+ *
+ * The node is found from the accelerator's PCIe location when MPF
+ * connects.  Buffers used by the FPGA are best allocated on this node.
+ * VTP does so by default.  See mpfVtpSetNumaNode().
+ *
+ * @param[in]  mpf_handle   Handle to MPF instance.
+ * @returns                 NUMA node or -1 if unknown, either because the
+ *                          platform doesn't report it or the device was
+ *                          connected with a backend other than OPAE.
+ */
+int __MPF_API__ mpfGetNumaNode(
+    mpf_handle_t mpf_handle
+);
+
+
 #ifdef __cplusplus
 }
 #endif
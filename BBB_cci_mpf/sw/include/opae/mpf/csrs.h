@@ -84,6 +84,35 @@ uint64_t __MPF_API__ mpfReadCsr(
     fpga_result* result
 );
 
+
+/**
+ * Read a block of consecutive CSRs in an MPF shim
+ *
+ * Sampling a group of statistics with one call is faster than reading
+ * CSRs individually.  When the MMIO space could be mapped into the process
+ * the CSRs are read directly, without the overhead of a driver call per
+ * CSR.  The values are not read atomically.  Each is an independent
+ * 64 bit MMIO read.
+ *
+ * @param[in]  mpf_handle       MPF handle initialized by mpfConnect().
+ * @param[in]  mpf_shim_idx     MPF shim to read.
+ * @param[in]  shim_csr_offset  Offset of the first CSR within the shim's
+ *                              CSR space.
+ * @param[in]  num_csrs         Number of consecutive 64 bit CSRs to read.
+ * @param[out] values           Array of num_csrs entries, filled with the
+ *                              CSR values.  Set to -1 when the shim is
+ *                              not present.
+ * @returns                     FPGA_OK on success and FPGA_NOT_FOUND when
+ *                              the requested shim is not present.
+ */
+fpga_result __MPF_API__ mpfReadCsrs(
+    mpf_handle_t mpf_handle,
+    t_cci_mpf_shim_idx mpf_shim_idx,
+    uint64_t shim_csr_offset,
+    uint32_t num_csrs,
+    uint64_t* values
+);
+
 #ifdef __cplusplus
 }
 #endif
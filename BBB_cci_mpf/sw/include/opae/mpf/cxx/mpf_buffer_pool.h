@@ -0,0 +1,292 @@
+// Copyright(c) 2018, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <opae/mpf/cxx/mpf_shared_buffer.h>
+
+namespace opae {
+namespace fpga {
+namespace bbb {
+namespace mpf {
+namespace types {
+
+/** Typed view of part of a shared buffer
+ *
+ * A view is a pointer and an element count, in the style of std::span.
+ * It does not own memory and is only valid while the lease it came from
+ * holds the buffer.
+ */
+template <typename T>
+class mpf_buffer_view {
+ public:
+  typedef T element_type;
+  typedef std::size_t size_t;
+  typedef T *iterator;
+
+  mpf_buffer_view() : data_(nullptr), size_(0), mpf_handle_(nullptr) {}
+
+  mpf_buffer_view(mpf_handle_t mpf_handle, T *data, size_t size)
+      : data_(data), size_(size), mpf_handle_(mpf_handle) {}
+
+  T *data() const { return data_; }
+  size_t size() const { return size_; }
+  size_t size_bytes() const { return size_ * sizeof(T); }
+  bool empty() const { return size_ == 0; }
+
+  T &operator[](size_t idx) const { return data_[idx]; }
+
+  iterator begin() const { return data_; }
+  iterator end() const { return data_ + size_; }
+
+  /** A view of count elements starting at element offset.
+   */
+  mpf_buffer_view subview(size_t offset, size_t count) const {
+    return mpf_buffer_view(mpf_handle_, data_ + offset, count);
+  }
+
+  /** I/O address of the first element, including its offset within
+   * the page.  0 if the view isn't in a buffer managed by VTP.
+   *
+   * I/O addresses are contiguous only within a physical page.  AFUs that
+   * address memory through VTP use the virtual address, data(), instead.
+   */
+  uint64_t iova() const {
+    void *va = const_cast<void *>(static_cast<const void *>(data_));
+    uint64_t io_addr = 0;
+    mpfVtpGetIOAddresses(mpf_handle_, 1, &va, &io_addr);
+    return io_addr;
+  }
+
+ private:
+  T *data_;
+  size_t size_;
+  mpf_handle_t mpf_handle_;
+};
+
+class mpf_buffer_pool;
+
+/** Exclusive use of a pooled shared buffer
+ *
+ * Leases are move-only.  Destroying a lease returns its buffer to the
+ * pool, still pinned and mapped by VTP.  The pool must outlive its
+ * leases.
+ */
+class mpf_buffer_lease {
+ public:
+  typedef std::size_t size_t;
+
+  mpf_buffer_lease() : pool_(nullptr), len_(0) {}
+  ~mpf_buffer_lease() { release(); }
+
+  mpf_buffer_lease(const mpf_buffer_lease &) = delete;
+  mpf_buffer_lease &operator=(const mpf_buffer_lease &) = delete;
+
+  mpf_buffer_lease(mpf_buffer_lease &&other) noexcept
+      : pool_(other.pool_), buffer_(std::move(other.buffer_)),
+        len_(other.len_) {
+    other.pool_ = nullptr;
+    other.len_ = 0;
+  }
+
+  mpf_buffer_lease &operator=(mpf_buffer_lease &&other) noexcept {
+    if (this != &other) {
+      release();
+      pool_ = other.pool_;
+      buffer_ = std::move(other.buffer_);
+      len_ = other.len_;
+      other.pool_ = nullptr;
+      other.len_ = 0;
+    }
+    return *this;
+  }
+
+  /** True when the lease holds a buffer.
+   */
+  explicit operator bool() const { return bool(buffer_); }
+
+  /** Return the buffer to the pool before the lease is destroyed.
+   */
+  void release();
+
+  /** Length requested when the buffer was leased.  The underlying
+   * buffer may be larger.
+   */
+  size_t size() const { return len_; }
+
+  /** Virtual address of the buffer.
+   */
+  uint8_t *data() const { return buffer_ ? buffer_->c_type() : nullptr; }
+
+  /** I/O address of the start of the buffer.
+   */
+  uint64_t iova() const { return buffer_ ? buffer_->iova() : 0; }
+
+  /** The underlying shared buffer.
+   */
+  const mpf_shared_buffer &buffer() const { return *buffer_; }
+
+  /** A view of the whole lease as an array of T.
+   */
+  template <typename T>
+  mpf_buffer_view<T> as() const {
+    return view<T>(0, len_ / sizeof(T));
+  }
+
+  /** A view of count elements of type T starting at byte_offset.
+   *
+   * Throws if the view extends beyond the lease.
+   */
+  template <typename T>
+  mpf_buffer_view<T> view(size_t byte_offset, size_t count) const {
+    if (!buffer_ || (byte_offset > len_) ||
+        (count > (len_ - byte_offset) / sizeof(T))) {
+      throw opae::fpga::types::except(OPAECXX_HERE);
+    }
+    return mpf_buffer_view<T>(handle(),
+                              reinterpret_cast<T *>(data() + byte_offset),
+                              count);
+  }
+
+ private:
+  friend class mpf_buffer_pool;
+
+  mpf_buffer_lease(mpf_buffer_pool *pool, mpf_shared_buffer::ptr_t &&buffer,
+                   size_t len)
+      : pool_(pool), buffer_(std::move(buffer)), len_(len) {}
+
+  mpf_handle_t handle() const;
+
+  mpf_buffer_pool *pool_;
+  mpf_shared_buffer::ptr_t buffer_;
+  size_t len_;
+};
+
+/** Pool of pinned shared buffers
+ *
+ * Buffers are kept in power of 2 size classes from 4KB to 1GB and are
+ * handed out as move-only leases.  A released lease returns its buffer
+ * to the pool without unpinning it, so steady-state acquire and release
+ * make no driver calls and no VTP page table updates.  Requests larger
+ * than 1GB are allocated on demand and released with their lease.
+ *
+ * A pool may be shared by multiple threads.
+ */
+class mpf_buffer_pool {
+ public:
+  typedef std::size_t size_t;
+  typedef std::shared_ptr<mpf_buffer_pool> ptr_t;
+
+  mpf_buffer_pool(const mpf_buffer_pool &) = delete;
+  mpf_buffer_pool &operator=(const mpf_buffer_pool &) = delete;
+
+  /** Idle buffers are released.
+   */
+  ~mpf_buffer_pool();
+
+  /** mpf_buffer_pool factory method.
+   * @param[in] handle         The handle used to allocate buffers.
+   * @param[in] max_idle_bytes Maximum bytes held in idle buffers.  Buffers
+   * returned to a full pool are released.
+   * @return A valid mpf_buffer_pool smart pointer.
+   */
+  static mpf_buffer_pool::ptr_t create(
+      mpf_handle::ptr_t mpf_handle,
+      size_t max_idle_bytes = std::numeric_limits<size_t>::max());
+
+  /** Lease a buffer of at least len bytes.
+   *
+   * An idle buffer of len's size class is reused when available.
+   * Otherwise a new buffer is allocated with mpf_shared_buffer::allocate(),
+   * which throws on failure.
+   *
+   * @param[in] len The length in bytes of the requested buffer.
+   * @return A lease holding the buffer.
+   */
+  mpf_buffer_lease acquire(size_t len);
+
+  /** Allocate idle buffers ahead of time.
+   *
+   * @param[in] len   The length in bytes of each buffer.
+   * @param[in] count Number of buffers to add to the pool.
+   */
+  void reserve(size_t len, size_t count);
+
+  /** Release all idle buffers.
+   */
+  void trim();
+
+  /** Bytes held in idle buffers.
+   */
+  size_t idle_bytes() const;
+
+  /** The MPF connection used to allocate buffers.
+   */
+  mpf_handle_t c_type() const { return *mpf_handle_; }
+
+ private:
+  friend class mpf_buffer_lease;
+
+  mpf_buffer_pool(mpf_handle::ptr_t mpf_handle, size_t max_idle_bytes);
+
+  // Size classes are powers of 2 from 4KB (2^12) to 1GB (2^30)
+  static const int min_class_log2 = 12;
+  static const int num_classes = 19;
+
+  static int size_class(size_t len);
+
+  void put(mpf_shared_buffer::ptr_t &&buffer);
+
+  mpf_handle::ptr_t mpf_handle_;
+  size_t max_idle_bytes_;
+
+  mutable std::mutex mutex_;
+  size_t idle_bytes_;
+  std::vector<mpf_shared_buffer::ptr_t> idle_[num_classes];
+};
+
+inline void mpf_buffer_lease::release() {
+  if (buffer_) {
+    pool_->put(std::move(buffer_));
+    buffer_.reset();
+  }
+  pool_ = nullptr;
+  len_ = 0;
+}
+
+inline mpf_handle_t mpf_buffer_lease::handle() const {
+  return pool_->c_type();
+}
+
+}  // end of namespace types
+}  // end of namespace mpf
+}  // end of namespace bbb
+}  // end of namespace fpga
+}  // end of namespace opae
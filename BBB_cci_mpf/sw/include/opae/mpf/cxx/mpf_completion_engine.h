@@ -0,0 +1,170 @@
+// Copyright(c) 2018, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opae/mpf/wait.h>
+
+namespace opae {
+namespace fpga {
+namespace bbb {
+namespace mpf {
+namespace types {
+
+/** Completion engine for AFU jobs signalled through shared memory
+ *
+ * AFUs typically report that a job is done by writing a word in a
+ * shared buffer (the DSM).  Instead of each caller spinning on its own
+ * word, jobs are registered with an engine and a single poller thread
+ * watches all outstanding words, completing a std::future or invoking a
+ * callback when a word matches.
+ *
+ * The poller waits with mpfWaitForTimeout(), so it spins for a budget
+ * tuned to the observed intervals between completions and then backs
+ * off to sleeps.  Registering a job ends the current wait.  Words are
+ * polled without holding the lock that registration takes.
+ *
+ * Watched words must remain valid until their jobs complete or the
+ * engine is destroyed.
+ */
+class mpf_completion_engine {
+ public:
+  typedef std::shared_ptr<mpf_completion_engine> ptr_t;
+
+  /** Invoked on the poller thread with the value that matched.
+   */
+  typedef std::function<void(uint64_t value)> callback_t;
+
+  /** How a watched word is compared to the expected value.
+   */
+  enum match_t {
+    // Complete when (word & mask) == value
+    match_equal,
+    // Complete when (word & mask) != value, e.g. wait for non-zero
+    match_not_equal
+  };
+
+  /** Poller wait.  Starts with the mpfWaitInit() defaults.  Its
+   * configuration fields, such as max_spin_ns, may be changed.
+   */
+  struct config {
+    mpf_wait_state wait;
+
+    config() { mpfWaitInit(&wait); }
+  };
+
+  mpf_completion_engine(const mpf_completion_engine &) = delete;
+  mpf_completion_engine &operator=(const mpf_completion_engine &) = delete;
+
+  /** Stop the poller.  Futures of jobs that are still outstanding
+   * become ready with a broken_promise error and their callbacks are
+   * not invoked.
+   */
+  ~mpf_completion_engine();
+
+  /** mpf_completion_engine factory method.  Starts the poller thread.
+   * @param[in] cfg Poller wait.
+   * @return A valid mpf_completion_engine smart pointer.
+   */
+  static mpf_completion_engine::ptr_t create(const config &cfg = config());
+
+  /** Register a job and return a future for its completion.
+   *
+   * @param[in] addr  Word written by the AFU.
+   * @param[in] value Expected value.
+   * @param[in] match Comparison of the masked word with value.
+   * @param[in] mask  Bits of the word to compare.
+   * @return Future holding the word's value when it matched.
+   */
+  std::future<uint64_t> submit(const volatile uint64_t *addr, uint64_t value,
+                               match_t match = match_equal,
+                               uint64_t mask = ~uint64_t(0));
+
+  /** Register a job completed by a callback.
+   *
+   * @param[in] addr  Word written by the AFU.
+   * @param[in] value Expected value.
+   * @param[in] cb    Invoked on the poller thread with the word's value
+   * when it matched.  Callbacks must not block.
+   * @param[in] match Comparison of the masked word with value.
+   * @param[in] mask  Bits of the word to compare.
+   */
+  void submit(const volatile uint64_t *addr, uint64_t value, callback_t cb,
+              match_t match = match_equal, uint64_t mask = ~uint64_t(0));
+
+  /** Number of jobs registered and not yet complete.
+   */
+  size_t outstanding() const;
+
+ private:
+  struct job {
+    const volatile uint64_t *addr;
+    uint64_t value;
+    uint64_t mask;
+    match_t match;
+    std::unique_ptr<std::promise<uint64_t>> promise;
+    callback_t cb;
+  };
+
+  mpf_completion_engine(const config &cfg);
+
+  void add_job(job &&j);
+  void poll_loop();
+  static bool poll_active(void *ctx);
+
+  // Used only by the poller thread
+  mpf_wait_state wait_;
+  std::vector<job> active_;
+  std::vector<job> done_;
+  std::vector<uint64_t> done_values_;
+
+  // Jobs registered since the poller last took them, protected by mutex_
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<job> pending_;
+
+  // Set with pending_ so the poller can check without the lock
+  std::atomic<bool> has_pending_;
+  std::atomic<bool> stop_;
+  std::atomic<size_t> outstanding_;
+
+  std::thread poller_;
+};
+
+}  // end of namespace types
+}  // end of namespace mpf
+}  // end of namespace bbb
+}  // end of namespace fpga
+}  // end of namespace opae
@@ -0,0 +1,200 @@
+// Copyright(c) 2018, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <opae/cxx/core/handle.h>
+#include <opae/cxx/core/token.h>
+#include <opae/mpf/cxx/mpf_handle.h>
+
+namespace opae {
+namespace fpga {
+namespace bbb {
+namespace mpf {
+namespace types {
+
+class mpf_device_manager;
+
+/** One accelerator opened by mpf_device_manager
+ */
+struct mpf_device {
+  /** Position in the manager's device list.
+   */
+  std::size_t index;
+
+  opae::fpga::types::token::ptr_t token;
+  opae::fpga::types::handle::ptr_t accel;
+  // Declared after accel so that MPF disconnects before the
+  // accelerator closes
+  mpf_handle::ptr_t mpf;
+
+  /** NUMA node of the device's PCIe link or -1 if unknown.  VTP
+   * allocates the device's buffers on this node.
+   */
+  int numa_node;
+};
+
+/** A job assigned to a device
+ *
+ * Move-only.  The device counts the job as outstanding until the job is
+ * released or destroyed.  A job must not outlive the manager that
+ * assigned it.
+ */
+class mpf_device_job {
+ public:
+  mpf_device_job() : manager_(nullptr), device_(nullptr) {}
+  ~mpf_device_job() { release(); }
+
+  mpf_device_job(const mpf_device_job &) = delete;
+  mpf_device_job &operator=(const mpf_device_job &) = delete;
+
+  mpf_device_job(mpf_device_job &&other) noexcept
+      : manager_(other.manager_), device_(other.device_) {
+    other.manager_ = nullptr;
+    other.device_ = nullptr;
+  }
+
+  mpf_device_job &operator=(mpf_device_job &&other) noexcept {
+    if (this != &other) {
+      release();
+      manager_ = other.manager_;
+      device_ = other.device_;
+      other.manager_ = nullptr;
+      other.device_ = nullptr;
+    }
+    return *this;
+  }
+
+  /** True when the job is assigned to a device.
+   */
+  explicit operator bool() const { return device_ != nullptr; }
+
+  /** Mark the job complete before it is destroyed.
+   */
+  void release();
+
+  /** The device running the job.
+   */
+  const mpf_device &device() const { return *device_; }
+
+ private:
+  friend class mpf_device_manager;
+
+  mpf_device_job(mpf_device_manager *manager, const mpf_device *device)
+      : manager_(manager), device_(device) {}
+
+  mpf_device_manager *manager_;
+  const mpf_device *device_;
+};
+
+/** Every accelerator in the system with a given AFU ID
+ *
+ * A single-device program opens the first accelerator that isn't busy.
+ * The manager instead opens all of them, connects MPF to each and
+ * records the NUMA node of each device's PCIe link.  MPF allocates
+ * VTP buffers on that node, so DMA does not cross the socket
+ * interconnect.
+ *
+ * Work is spread across the devices with acquire(), which picks the
+ * device with the fewest outstanding jobs.  Ties go to a device local to
+ * the caller and then rotate.  Host threads that feed a device are best
+ * run on the device's node too.
+ */
+class mpf_device_manager {
+ public:
+  typedef std::shared_ptr<mpf_device_manager> ptr_t;
+  typedef std::size_t size_t;
+
+  /** Pass to acquire() to prefer devices local to the calling thread.
+   */
+  static const int caller_node = -1;
+
+  mpf_device_manager(const mpf_device_manager &) = delete;
+  mpf_device_manager &operator=(const mpf_device_manager &) = delete;
+
+  ~mpf_device_manager();
+
+  /** Open every available accelerator with an AFU ID
+   *
+   * Accelerators that are busy, because another process holds them, are
+   * skipped.  Throws opae::fpga::types::not_found when none could be
+   * opened.
+   *
+   * @param[in] accel_uuid  AFU ID of the accelerators.
+   * @param[in] mpf_flags   Flags passed to mpf_handle::open().
+   * @param[in] max_devices Stop after opening this many devices.
+   * 0 opens all of them.
+   */
+  static mpf_device_manager::ptr_t open(const char *accel_uuid,
+                                        uint32_t mpf_flags = 0,
+                                        size_t max_devices = 0);
+
+  /** Number of open devices.
+   */
+  size_t size() const { return devices_.size(); }
+
+  /** A device by index, in enumeration order.
+   */
+  const mpf_device &operator[](size_t idx) const { return devices_[idx]; }
+
+  /** Assign a job to the least loaded device.
+   *
+   * @param[in] numa_node Break ties in favor of devices on this node.
+   * caller_node uses the node of the CPU running the caller.
+   * @return The job, which holds its device until released.
+   */
+  mpf_device_job acquire(int numa_node = caller_node);
+
+  /** Outstanding jobs on a device.
+   */
+  size_t outstanding(size_t idx) const;
+
+  /** NUMA node of the CPU running the calling thread, -1 if unknown.
+   */
+  static int current_numa_node();
+
+ private:
+  friend class mpf_device_job;
+
+  mpf_device_manager();
+
+  void complete(const mpf_device *device);
+
+  std::vector<mpf_device> devices_;
+
+  mutable std::mutex mutex_;
+  std::vector<size_t> outstanding_;
+  size_t next_;
+};
+
+}  // end of namespace types
+}  // end of namespace mpf
+}  // end of namespace bbb
+}  // end of namespace fpga
+}  // end of namespace opae
@@ -40,15 +40,30 @@
  *
  * - Initialize MPF and connect to an AFU with mpfConnect()
  * - Test whether a shim is instantiated in a connected AFU with mpfShimPresent()
- * - Allocate virtually referenced buffers with mpfVtpBufferAllocate()
+ * - Run without an FPGA by connecting to an emulated AFU with
+ *   mpfEmulatorOpen() and mpfConnectBackend()
+ * - Allocate virtually referenced buffers with mpfVtpBufferAllocate().
+ *   Buffers are placed on the FPGA's NUMA node, mpfGetNumaNode(), unless
+ *   changed with mpfVtpSetNumaNode().
  * - Control channel mapping on AFUs with VC Map enabled using functions
  *   in shim_vc_map.h
+ * - Adjust the VC Map's fixed VL0 ratio at run time to follow shifts
+ *   in the traffic mix with mpfVcMapControllerStart()
  *
  * - Many shims have functions that read statistics:
  *   - VC Map (virtual channel mapper): mpfVcMapGetStats()
  *   - VTP (virtual to physical): mpfVtpGetStats()
  *   - WRO (write/read order): mpfWroGetStats()
  *   - PWrite (partial write): mpfPwriteGetStats()
+ *
+ * - Sample the statistics of all shims together with mpfGetAllStats()
+ *   or periodically, with rates, using mpfStatsSamplerStart()
+ * - Export statistics for Prometheus with mpfStatsExporterStart() or
+ *   mpfStatsWriteOpenMetrics()
+ * - Predict VTP TLB hit rates and page table walk costs for an address
+ *   trace with mpfVtpModelReplay()
+ * - Wait for an AFU to update a shared memory word with the adaptive
+ *   spin-then-sleep mpfWaitUntil() in wait.h (included separately)
  */
 
 #ifndef __FPGA_MPF_MPF_H__
@@ -60,11 +75,15 @@
 #include <opae/fpga.h>
 #include <opae/mpf/types.h>
 #include <opae/mpf/connect.h>
+#include <opae/mpf/backend.h>
 #include <opae/mpf/csrs.h>
 #include <opae/mpf/shim_latency_qos.h>
 #include <opae/mpf/shim_pwrite.h>
 #include <opae/mpf/shim_vc_map.h>
 #include <opae/mpf/shim_vtp.h>
+#include <opae/mpf/shim_vtp_model.h>
 #include <opae/mpf/shim_wro.h>
+#include <opae/mpf/stats.h>
+#include <opae/mpf/stats_export.h>
 
 #endif // __FPGA_MPF_MPF_H__
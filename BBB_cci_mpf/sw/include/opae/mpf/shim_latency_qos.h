@@ -57,6 +57,220 @@ fpga_result __MPF_API__ mpfLatencyQosSetConfig(
 );
 
 
+/**
+ * Largest values of the latency QoS fields.
+ */
+#define MPF_LATENCY_QOS_MAX_ACTIVE_LINES 0x7fff
+#define MPF_LATENCY_QOS_MAX_EPOCH_CYCLES 0x7fff
+
+
+/**
+ * Latency QoS parameters of one channel.
+ */
+typedef struct
+{
+    bool enable;
+    // Limit on lines in flight.  Requests beyond the limit are held in
+    // the AFU until the next epoch.
+    uint32_t max_active_lines;
+    // Length of an epoch (cycles)
+    uint32_t epoch_cycles;
+}
+mpf_latency_qos_channel;
+
+/**
+ * Latency QoS parameters, the decoded form of the configuration
+ * register.  Channel 0 is reads (c0) and channel 1 is writes (c1).
+ */
+typedef struct
+{
+    mpf_latency_qos_channel chan[2];
+}
+mpf_latency_qos_params;
+
+
+/**
+ * Pack parameters into the configuration register format.
+ *
+ * @param[in]  params           Parameters.
+ * @returns                     Value for mpfLatencyQosSetConfig().
+ */
+uint64_t __MPF_API__ mpfLatencyQosEncodeConfig(
+    const mpf_latency_qos_params* params
+);
+
+
+/**
+ * Unpack a configuration register value.
+ *
+ * @param[in]  config           Configuration bits.
+ * @param[out] params           Parameters.
+ */
+void __MPF_API__ mpfLatencyQosDecodeConfig(
+    uint64_t config,
+    mpf_latency_qos_params* params
+);
+
+
+/**
+ * Set the Latency QoS configuration from decoded parameters.
+ *
+ * @param[in]  mpf_handle       MPF handle initialized by mpfConnect().
+ * @param[in]  params           Parameters.
+ * @returns                     FPGA_OK on success.  FPGA_INVALID_PARAM
+ *                              if a field is out of range.
+ */
+fpga_result __MPF_API__ mpfLatencyQosSetParams(
+    mpf_handle_t mpf_handle,
+    const mpf_latency_qos_params* params
+);
+
+
+/**
+ * Get the most recent configuration set through this handle.
+ *
+ * @param[in]  mpf_handle       MPF handle initialized by mpfConnect().
+ * @param[out] params           Parameters.
+ * @returns                     FPGA_OK on success.  FPGA_NOT_FOUND if
+ *                              no configuration has been set.
+ */
+fpga_result __MPF_API__ mpfLatencyQosGetParams(
+    mpf_handle_t mpf_handle,
+    mpf_latency_qos_params* params
+);
+
+
+/**
+ * Measure a workload on the current latency QoS configuration.
+ *
+ * Called by mpfLatencyQosTune() after each candidate configuration is
+ * set.  The function should run traffic on the channel being tuned and
+ * return its bandwidth and latency.  Units are up to the caller but
+ * must be consistent across calls.
+ *
+ * @param[in]  ctx              measure_ctx passed to mpfLatencyQosTune().
+ * @param[in]  channel          Channel being tuned (0 reads, 1 writes).
+ * @param[out] bandwidth        Achieved bandwidth.  Larger is better.
+ * @param[out] latency          Mean or tail latency.  Smaller is better.
+ * @returns                     FPGA_OK on success.  Other values abort
+ *                              tuning and are returned to the caller.
+ */
+typedef fpga_result (*mpf_latency_qos_measure_fn)(
+    void* ctx,
+    uint32_t channel,
+    double* bandwidth,
+    double* latency
+);
+
+
+/**
+ * Autotuner search bounds.
+ */
+typedef struct
+{
+    // Range of max_active_lines searched
+    uint32_t min_active_lines;
+    uint32_t max_active_lines;
+    // Range of epoch_cycles searched.  Setting both to the same value
+    // disables the epoch search.
+    uint32_t min_epoch_cycles;
+    uint32_t max_epoch_cycles;
+    // Fraction of peak bandwidth that may be given up for lower latency
+    double bw_tolerance;
+    // Searches stop when the interval is no wider than these
+    uint32_t active_lines_resolution;
+    uint32_t epoch_cycles_resolution;
+}
+mpf_latency_qos_tune_opts;
+
+
+/**
+ * Fill in the default autotuner search bounds.
+ *
+ * @param[out] opts             Options.
+ */
+void __MPF_API__ mpfLatencyQosTuneDefaults(
+    mpf_latency_qos_tune_opts* opts
+);
+
+
+/**
+ * Tune the latency QoS parameters of one channel.
+ *
+ * Peak bandwidth is measured with the maximum active line limit.  A
+ * bisection then finds the smallest limit that keeps bandwidth within
+ * bw_tolerance of the peak, since latency grows with the number of
+ * lines in flight.  Finally, a golden-section search picks the epoch
+ * length with the lowest latency that still meets the bandwidth target.
+ *
+ * The chosen parameters are set in the hardware on return.
+ *
+ * @param[in]  mpf_handle       MPF handle initialized by mpfConnect().
+ * @param[in]  channel          0 for reads, 1 for writes.
+ * @param[in]  measure          Workload measurement function.
+ * @param[in]  measure_ctx      Passed to measure.
+ * @param[in]  opts             Search bounds.  NULL for the defaults.
+ * @param[inout] params         Starting parameters.  The other channel's
+ *                              settings are used unchanged.  On return,
+ *                              the tuned channel is filled in.
+ * @returns                     FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfLatencyQosTune(
+    mpf_handle_t mpf_handle,
+    uint32_t channel,
+    mpf_latency_qos_measure_fn measure,
+    void* measure_ctx,
+    const mpf_latency_qos_tune_opts* opts,
+    mpf_latency_qos_params* params
+);
+
+
+/**
+ * Environment variable naming a profile that mpfConnect() loads and
+ * applies when the latency QoS shim is present.
+ */
+#define MPF_LATENCY_QOS_PROFILE_ENV "MPF_LATENCY_QOS_PROFILE"
+
+
+/**
+ * Save parameters to a profile file.
+ *
+ * The profile is a text file of key=value lines.  It records the PCIe
+ * device ID of the FPGA, when known, so that a profile tuned for one
+ * platform isn't applied to another.
+ *
+ * @param[in]  mpf_handle       MPF handle initialized by mpfConnect().
+ * @param[in]  path             File name.
+ * @param[in]  params           Parameters.
+ * @returns                     FPGA_OK on success.  FPGA_EXCEPTION if
+ *                              the file can't be written.
+ */
+fpga_result __MPF_API__ mpfLatencyQosSaveProfile(
+    mpf_handle_t mpf_handle,
+    const char* path,
+    const mpf_latency_qos_params* params
+);
+
+
+/**
+ * Load parameters from a profile file.  The parameters are not set in
+ * the hardware.
+ *
+ * @param[in]  mpf_handle       MPF handle initialized by mpfConnect().
+ * @param[in]  path             File name.
+ * @param[out] params           Parameters.
+ * @returns                     FPGA_OK on success.  FPGA_NOT_FOUND if
+ *                              the file can't be read.  FPGA_INVALID_PARAM
+ *                              if it is malformed or was tuned for a
+ *                              different device.
+ */
+fpga_result __MPF_API__ mpfLatencyQosLoadProfile(
+    mpf_handle_t mpf_handle,
+    const char* path,
+    mpf_latency_qos_params* params
+);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -193,6 +193,193 @@ uint64_t __MPF_API__ mpfVcMapGetMappingHistory(
 );
 
 
+/**
+ * Read the AFU's per-channel line counters.  Invoked on the controller's
+ * thread.
+ *
+ * The counters are maintained by the AFU, not by MPF, so the application
+ * must supply them.  Each must be monotonic.
+ *
+ * @param[in]  ctx         read_lines_ctx from the controller configuration.
+ * @param[out] vl0_lines   Lines read or written on VL0.
+ * @param[out] vh_lines    Lines read or written on VH0 and VH1.
+ */
+typedef void (*mpf_vc_map_read_lines_fn)(
+    void* ctx,
+    uint64_t* vl0_lines,
+    uint64_t* vh_lines
+);
+
+
+/**
+ * VC Map controller configuration.
+ */
+typedef struct
+{
+    // Decision period in microseconds.  0 picks a 100ms default.
+    uint64_t period_us;
+
+    // Range of fixed VL0 ratios (64ths) the controller may choose.
+    // A max_ratio of 0 picks 64.
+    uint32_t min_ratio;
+    uint32_t max_ratio;
+
+    // Starting ratio.  -1 starts from the ratio currently in the hardware,
+    // taken from mpfVcMapGetMappingHistory().
+    int32_t initial_ratio;
+
+    // Change in the ratio of each probe.  0 picks 4.
+    uint32_t step;
+
+    // Relative bandwidth change treated as significant.  A probe is
+    // kept only if it improves bandwidth by more than this fraction,
+    // and a change this large at a held ratio is taken as a shift in
+    // the traffic mix.  0 picks 0.03.
+    double hysteresis;
+
+    // Periods at a held ratio before its neighbors are probed again.
+    // 0 picks 50.
+    uint32_t probe_interval;
+
+    // Periods with fewer lines than this are treated as idle and make
+    // no decision.  0 picks 4096.
+    uint64_t min_lines;
+
+    // Channel line counters (required)
+    mpf_vc_map_read_lines_fn read_lines;
+    void* read_lines_ctx;
+
+    // Log each decision
+    bool log_decisions;
+}
+mpf_vc_map_controller_config;
+
+
+/**
+ * VC Map controller decisions.
+ */
+typedef enum
+{
+    // No period has completed
+    MPF_VC_MAP_CTRL_NONE = 0,
+    // Too little traffic to judge
+    MPF_VC_MAP_CTRL_IDLE,
+    // Waiting for a new ratio to reach the hardware
+    MPF_VC_MAP_CTRL_SETTLE,
+    // Keep the held ratio
+    MPF_VC_MAP_CTRL_HOLD,
+    // Try a neighboring ratio
+    MPF_VC_MAP_CTRL_PROBE,
+    // The probed ratio improved bandwidth and is now held
+    MPF_VC_MAP_CTRL_ACCEPT,
+    // The probed ratio didn't help.  Return to the held ratio.
+    MPF_VC_MAP_CTRL_REVERT
+}
+mpf_vc_map_controller_decision;
+
+
+/**
+ * VC Map controller state.
+ */
+typedef struct
+{
+    // Ratio (64ths to VL0) currently set in the hardware
+    uint32_t ratio;
+    // Best known ratio.  Differs from ratio while probing.
+    uint32_t held_ratio;
+    // Most recent decision
+    mpf_vc_map_controller_decision last_decision;
+
+    // Delivered bandwidth (lines per second) in the most recent period
+    double bw_lines_per_sec;
+    // Smoothed bandwidth at the held ratio
+    double held_bw_lines_per_sec;
+    // Fraction of lines on VL0 in the most recent period
+    double vl0_fraction;
+    // Mapping history read in the most recent period
+    uint64_t mapping_history;
+
+    // Decision periods completed, and those that were idle
+    uint64_t num_periods;
+    uint64_t num_idle_periods;
+    // Ratios probed, probes accepted and probes reverted
+    uint64_t num_probes;
+    uint64_t num_accepts;
+    uint64_t num_reverts;
+    // Large bandwidth changes at a held ratio
+    uint64_t num_traffic_shifts;
+}
+mpf_vc_map_controller_state;
+
+
+/**
+ * Start a background thread that adjusts the fixed VL0 ratio to
+ * maximize delivered bandwidth.
+ *
+ * Each period the controller reads the channel line counters and
+ * compares the delivered bandwidth with the bandwidth at the held ratio.
+ * Periodically, or when the bandwidth at the held ratio shifts by more
+ * than the hysteresis, neighboring ratios are probed.  A probe is kept
+ * only when it improves bandwidth by more than the hysteresis, so the
+ * ratio doesn't dither on noise.  Every ratio change costs a write
+ * fence in the hardware.
+ *
+ * Mapping must already be enabled with mpfVcMapSetMode().  The
+ * controller disables the hardware's dynamic mapping by setting fixed
+ * ratios.  Only one controller may run per MPF handle.  The controller
+ * is stopped by mpfDisconnect() if it is still running.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  config      Controller configuration.
+ * @returns                FPGA_OK on success.  FPGA_BUSY if a controller
+ *                         is already running.  FPGA_NOT_SUPPORTED if the
+ *                         VC Map shim is not present.
+ */
+fpga_result __MPF_API__ mpfVcMapControllerStart(
+    mpf_handle_t mpf_handle,
+    const mpf_vc_map_controller_config* config
+);
+
+
+/**
+ * Stop the VC Map controller.  The ratio it last set remains in the
+ * hardware.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @returns                FPGA_OK on success.  FPGA_NOT_FOUND if no
+ *                         controller is running.
+ */
+fpga_result __MPF_API__ mpfVcMapControllerStop(
+    mpf_handle_t mpf_handle
+);
+
+
+/**
+ * Return the VC Map controller state.  The state is also sampled by
+ * mpfGetAllStats().
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[out] state       Controller state.
+ * @returns                FPGA_OK on success.  FPGA_NOT_FOUND if no
+ *                         controller is running.
+ */
+fpga_result __MPF_API__ mpfVcMapControllerGetState(
+    mpf_handle_t mpf_handle,
+    mpf_vc_map_controller_state* state
+);
+
+
+/**
+ * Name of a controller decision, for logs.
+ *
+ * @param[in]  decision    Decision.
+ * @returns                Name.
+ */
+__MPF_API__ const char* mpfVcMapControllerDecisionStr(
+    mpf_vc_map_controller_decision decision
+);
+
+
 #ifdef __cplusplus
 }
 #endif
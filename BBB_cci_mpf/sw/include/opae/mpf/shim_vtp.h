@@ -43,13 +43,15 @@ extern "C" {
 #endif
 
 /**
- * The page table supports two physical page sizes.
+ * The page table supports three physical page sizes.  1GB pages are
+ * disabled by default.  See mpfVtpSetMaxPhysPageSize().
  */
 typedef enum
 {
     // Enumeration values are log2 of the size
     MPF_VTP_PAGE_4KB = 12,
-    MPF_VTP_PAGE_2MB = 21
+    MPF_VTP_PAGE_2MB = 21,
+    MPF_VTP_PAGE_1GB = 30
 }
 mpf_vtp_page_size;
 
@@ -57,6 +59,14 @@ mpf_vtp_page_size;
 #define mpfPageSizeEnumToBytes(page_size) ((size_t)1 << page_size)
 
 
+/**
+ * mpfVtpPrepareBuffer() flag: reserve the buffer's virtual address range
+ * but pin and map pages only when they are first used.  See
+ * mpfVtpPrepareBuffer().
+ */
+#define MPF_VTP_BUF_LAZY (1 << 16)
+
+
 
 /**
  * Test whether the VTP service is available on the FPGA.
@@ -87,12 +97,24 @@ bool __MPF_API__ mpfVtpIsAvailable(
  * OPAE to share the buffer with the FPGA and will also add the
  * buffer to VTP's address translation table.
  *
+ * When MPF_VTP_BUF_LAZY is set, only virtual address space is reserved.
+ * The buffer is divided into 2MB regions that are pinned and added to
+ * the translation table the first time they are touched, either by
+ * the FPGA or by mpfVtpGetIOAddress().  A host-side service thread
+ * watches for failed FPGA translations.  The FPGA's page table walker
+ * stalls until the region is pinned, so the first access to each region
+ * is slow.  Memory is never unpinned before the buffer is released.
+ * Lazy buffers require an FPGA built with a version of MPF that can
+ * retry failed translations.  Older FPGAs halt on the first failure.
+ * MPF_VTP_BUF_LAZY may not be combined with FPGA_BUF_PREALLOCATED.
+ *
  * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
  * @param[in]  len         Length of the buffer to allocate in bytes.
  * @param[out] buf_addr    Virtual base address of the allocated buffer.
  * @param[in]  flags       Flags. FPGA_BUF_PREALLOCATED indicates that memory
  *                         pointed at in '*buf_addr' is already allocated an
- *                         mapped into virtual memory.
+ *                         mapped into virtual memory.  MPF_VTP_BUF_LAZY
+ *                         defers pinning until pages are used.
  * @returns                FPGA_OK on success.
  */
 fpga_result __MPF_API__ mpfVtpPrepareBuffer(
@@ -168,6 +190,77 @@ uint64_t __MPF_API__ mpfVtpGetIOAddress(
 );
 
 
+/**
+ * Return the IOVAs associated with an array of virtual addresses.
+ *
+ * Equivalent to calling mpfVtpGetIOAddress() on each address, except that
+ * the returned IOVAs include the offset of each address within its page.
+ * Consecutive addresses in the same page share a single translation.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  n           Number of addresses.
+ * @param[in]  buf_addrs   Virtual addresses to translate.
+ * @param[out] io_addrs    Corresponding IOVAs.  An entry is 0 if the
+ *                         address is not managed by VTP.
+ * @returns                FPGA_OK if all addresses were translated.
+ *                         FPGA_NOT_FOUND if any address is not managed
+ *                         by VTP.
+ */
+fpga_result __MPF_API__ mpfVtpGetIOAddresses(
+    mpf_handle_t mpf_handle,
+    size_t n,
+    void* const* buf_addrs,
+    uint64_t* io_addrs
+);
+
+
+/**
+ * A virtually and physically contiguous span of a buffer, as returned by
+ * mpfVtpGetIOExtents().
+ */
+typedef struct
+{
+    void* va;
+    uint64_t iova;
+    uint64_t len;
+}
+mpf_vtp_io_extent;
+
+
+/**
+ * Describe a virtual address range as a list of IOVA extents.
+ *
+ * Adjacent pages that are also contiguous in IOVA space are merged into
+ * a single extent, so a region pinned with one driver call is usually
+ * returned as one extent.  The page table is walked once per page table
+ * node instead of once per page.  The result is suitable for building
+ * scatter-gather DMA descriptor lists.
+ *
+ * When the range needs more than max_extents extents, the first
+ * max_extents are returned along with FPGA_NO_MEMORY.  The caller may
+ * continue from the end of the last extent.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  buf_addr    Start of the range.
+ * @param[in]  len         Length of the range in bytes.
+ * @param[out] extents     Extents, in address order.
+ * @param[in]  max_extents Size of extents.
+ * @param[out] n_extents   Number of extents returned.
+ * @returns                FPGA_OK if the whole range is described.
+ *                         FPGA_NOT_FOUND if part of the range is not
+ *                         managed by VTP.  n_extents then covers the
+ *                         range up to the missing address.
+ */
+fpga_result __MPF_API__ mpfVtpGetIOExtents(
+    mpf_handle_t mpf_handle,
+    void* buf_addr,
+    uint64_t len,
+    mpf_vtp_io_extent* extents,
+    size_t max_extents,
+    size_t* n_extents
+);
+
+
 /**
  * Invalidate the FPGA-side translation cache.
  *
@@ -201,6 +294,29 @@ fpga_result __MPF_API__ mpfVtpInvalVAMapping(
 );
 
 
+/**
+ * Invalidate a range of virtual addresses in the FPGA-side translation cache.
+ *
+ * This method does not affect allocated storage or the contents of the
+ * VTP-managed translation table.  One invalidation is sent for each 4KB
+ * page in the range and one for each 2MB region of larger pages.  When a
+ * range would need many invalidations, the entire FPGA-side translation
+ * cache is flushed instead, as in mpfVtpInvalHWTLB().
+ *
+ * mpfVtpReleaseBuffer() applies the same policy when freeing a buffer.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  va          Start of the range to invalidate.
+ * @param[in]  len         Length of the range in bytes.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpInvalVARange(
+    mpf_handle_t mpf_handle,
+    void* va,
+    size_t len
+);
+
+
 /**
  * Set the maximum allocated physical page size.
  *
@@ -208,6 +324,12 @@ fpga_result __MPF_API__ mpfVtpInvalVAMapping(
  * debugging the allocator than in production.  In most cases an application
  * is better off with large pages, which is the default.
  *
+ * The default maximum is MPF_VTP_PAGE_2MB.  Raising it to MPF_VTP_PAGE_1GB
+ * permits 1GB pages for allocations of at least 1GB.  The FPGA must be built
+ * with an MPF page table walker that accepts 1GB translations and the
+ * system must have 1GB huge pages reserved.  Without reserved pages VTP
+ * falls back to smaller pages.
+ *
  * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
  * @param[in]  max_psize   Maximum physical page size.
  * @returns                FPGA_OK on success.
@@ -218,6 +340,74 @@ fpga_result __MPF_API__ mpfVtpSetMaxPhysPageSize(
 );
 
 
+/**
+ * Set the preferred NUMA node of buffers allocated by VTP.
+ *
+ * The default is the node of the FPGA's PCIe link, as returned by
+ * mpfGetNumaNode(), so that FPGA DMA does not cross the socket
+ * interconnect.  Pages are taken from other nodes when the preferred
+ * node is out of memory.  The setting affects buffers mapped after the
+ * call.  Buffers recycled from the pool keep their original placement.
+ * Buffers allocated with FPGA_BUF_PREALLOCATED are not moved.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  numa_node   Preferred node or -1 for the process's default
+ *                         memory policy.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpSetNumaNode(
+    mpf_handle_t mpf_handle,
+    int numa_node
+);
+
+
+/**
+ * Set the number of threads used to populate and pin large buffers.
+ *
+ * With more than one thread, buffers larger than 64MB are split into
+ * chunks that are faulted in by parallel worker threads, using the NUMA
+ * placement set by mpfVtpSetNumaNode().  When the driver can't pin a
+ * whole buffer with one call, the workers also pin their chunks in
+ * parallel and the translations are merged into the page table at the
+ * end.  The default is 1, which populates and pins on the calling
+ * thread.  Up to 64 threads are used.  Preallocated buffers are always
+ * pinned by the calling thread.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  n_threads   Number of threads, including the caller.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpSetPopulateThreads(
+    mpf_handle_t mpf_handle,
+    uint32_t n_threads
+);
+
+
+/**
+ * Recycle released buffers.
+ *
+ * When pooling is enabled, buffers released by mpfVtpReleaseBuffer()
+ * stay pinned and mapped in the VTP page table.  Later allocations in
+ * the same size class reuse them without calling the driver.  Size
+ * classes are powers of 2 from 4KB to 1GB, so pooled allocations are
+ * rounded up to a power of 2.  Preallocated buffers are never pooled.
+ * Recycled buffers are not cleared.
+ *
+ * Pooling is disabled by default.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  max_idle_bytes  Maximum total size of idle buffers held in
+ *                         the pool.  When exceeded, idle buffers are
+ *                         released, largest first.  0 disables pooling
+ *                         and releases all idle buffers.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpSetBufferPoolSize(
+    mpf_handle_t mpf_handle,
+    uint64_t max_idle_bytes
+);
+
+
 /**
  * VTP statistics
  */
@@ -247,6 +437,15 @@ typedef struct
     // Last virtual address translated. If numFailedTranslations is non-zero
     // this is the failing virtual address.
     void* ptWalkLastVAddr;
+
+    // Hits and misses in the host-side software TLB used by
+    // mpfVtpGetIOAddress().  Each thread has a private TLB.  The
+    // counts are the sum over all threads.
+    uint64_t numSwTLBHits;
+    uint64_t numSwTLBMisses;
+
+    // Regions of MPF_VTP_BUF_LAZY buffers pinned on demand
+    uint64_t numLazyRegionsPinned;
 }
 mpf_vtp_stats;
 
@@ -0,0 +1,291 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file shim_vtp_model.h
+ * \brief Host-side model of the FPGA VTP translation caches
+ *
+ * The model replays a trace of virtual addresses against the VTP page
+ * table of a connection and predicts the behavior of the hardware:
+ *
+ *   - Per-channel direct-mapped L1 caches of 4KB and 2MB translations
+ *     (cci_mpf_shim_vtp.sv).
+ *   - The shared set-associative 4KB and 2MB TLBs, with random
+ *     replacement (cci_mpf_svc_vtp_tlb.sv).
+ *   - The page table walker and its cache of recently read page table
+ *     lines (cci_mpf_svc_vtp_pt_walk.sv).  Each walk reads one line per
+ *     level of the table below the deepest cached level.
+ *
+ * The default geometry matches cci_mpf_config.vh.  Timing and request
+ * concurrency are not modelled, so the results predict how often the
+ * hardware walks the table and what each walk costs, not throughput.
+ * The model is useful for comparing buffer layouts and page sizes
+ * before building an FPGA image.
+ */
+
+#ifndef __FPGA_MPF_SHIM_VTP_MODEL_H__
+#define __FPGA_MPF_SHIM_VTP_MODEL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Opaque VTP model handle.
+ */
+typedef void* mpf_vtp_model_t;
+
+
+/**
+ * Model geometry.  Entry, set and way counts must be powers of 2.
+ */
+typedef struct
+{
+    // Entries in each channel's direct-mapped L1 caches
+    // (VTP_N_C0_L1_*_CACHE_ENTRIES and VTP_N_C1_L1_*_CACHE_ENTRIES).
+    // 0 disables the L1 caches.
+    uint32_t l1_4kb_entries;
+    uint32_t l1_2mb_entries;
+
+    // Shared TLBs (VTP_N_TLB_*_SETS and VTP_N_TLB_*_WAYS)
+    uint32_t tlb_4kb_sets;
+    uint32_t tlb_4kb_ways;
+    uint32_t tlb_2mb_sets;
+    uint32_t tlb_2mb_ways;
+
+    // Lines in the page table walker's cache.  The cache is split evenly
+    // among the 4 levels of the table, so there must be at least 4 lines.
+    // 0 disables the cache.
+    uint32_t pt_cache_entries;
+
+    // Seed of the random TLB replacement policy
+    uint32_t seed;
+}
+mpf_vtp_model_config;
+
+
+/**
+ * One access in a trace.
+ */
+typedef struct
+{
+    const void* va;
+    // Writes are translated by channel 1's L1 caches, reads by channel 0's.
+    bool is_write;
+}
+mpf_vtp_model_access;
+
+
+/**
+ * Predicted translation statistics.
+ */
+typedef struct
+{
+    // Translated accesses, including failed translations
+    uint64_t accesses;
+
+    // Accesses satisfied by the L1 caches
+    uint64_t l1_hits;
+    // L1 misses satisfied by the TLBs
+    uint64_t tlb_4kb_hits;
+    uint64_t tlb_2mb_hits;
+
+    // Page table walks.  Walks that found 1GB pages are counted as 2MB,
+    // matching the hardware, which fills the 2MB TLB with the 2MB region
+    // of a 1GB page holding the requested address.
+    uint64_t walks_4kb;
+    uint64_t walks_2mb;
+
+    // Walks that found no translation.  The hardware would either halt
+    // or raise a fault for software to resolve.
+    uint64_t failed_walks;
+
+    // Page table lines read from host memory by successful walks
+    uint64_t walk_reads;
+    // Page table levels resolved by the walker's cache instead of
+    // reading host memory
+    uint64_t walk_cache_hits;
+
+    // Derived from the counters above
+    double l1_hit_rate;
+    // TLB hits as a fraction of L1 misses
+    double tlb_hit_rate;
+    // Accesses that needed no walk
+    double hit_rate;
+    double reads_per_walk;
+}
+mpf_vtp_model_stats;
+
+
+/**
+ * Predicted translation statistics of one buffer.
+ */
+typedef struct
+{
+    // Extent of the buffer in the page table
+    const void* va;
+    uint64_t len;
+
+    uint64_t accesses;
+    uint64_t walks;
+    uint64_t walk_reads;
+}
+mpf_vtp_model_buffer_stats;
+
+
+/**
+ * Fill in the default model geometry, matching cci_mpf_config.vh.
+ *
+ * @param[out] config      Configuration.
+ */
+void __MPF_API__ mpfVtpModelDefaultConfig(
+    mpf_vtp_model_config* config
+);
+
+
+/**
+ * Create a model of the VTP translation caches.
+ *
+ * The model translates addresses using the page table of the
+ * connection, so buffers must be allocated with mpfVtpBufferAllocate()
+ * or mpfVtpPrepareBuffer().  Connecting to the emulator with
+ * mpfConnectBackend() makes it possible to model an AFU without an FPGA.
+ *
+ * A model may be used by only one thread at a time.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  config      Model geometry.  NULL selects the defaults.
+ * @param[out] model       Model handle.
+ * @returns                FPGA_OK on success.  FPGA_NOT_SUPPORTED if
+ *                         VTP is not initialized.  FPGA_INVALID_PARAM
+ *                         if the geometry is not a power of 2.
+ */
+fpga_result __MPF_API__ mpfVtpModelCreate(
+    mpf_handle_t mpf_handle,
+    const mpf_vtp_model_config* config,
+    mpf_vtp_model_t* model
+);
+
+
+/**
+ * Destroy a model.
+ *
+ * @param[in]  model       Model handle.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpModelDestroy(
+    mpf_vtp_model_t model
+);
+
+
+/**
+ * Replay a trace through the model.
+ *
+ * Traces may be replayed in pieces.  The cache state carries over from
+ * one call to the next.
+ *
+ * @param[in]  model       Model handle.
+ * @param[in]  trace       Accesses, in the order they reach VTP.
+ * @param[in]  n           Number of accesses in trace.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpModelReplay(
+    mpf_vtp_model_t model,
+    const mpf_vtp_model_access* trace,
+    size_t n
+);
+
+
+/**
+ * Invalidate the modelled caches, as mpfVtpInvalHWTLB() does in the
+ * FPGA.  Statistics are preserved.  Call after changing the page table
+ * between replays.
+ *
+ * @param[in]  model       Model handle.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpModelInvalidate(
+    mpf_vtp_model_t model
+);
+
+
+/**
+ * Clear the statistics, including the per-buffer statistics.  The
+ * cache state is preserved, so a trace can be replayed once to warm
+ * the caches and again to measure.
+ *
+ * @param[in]  model       Model handle.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpModelClearStats(
+    mpf_vtp_model_t model
+);
+
+
+/**
+ * Return the predicted statistics.
+ *
+ * @param[in]  model       Model handle.
+ * @param[out] stats       Statistics.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpModelGetStats(
+    mpf_vtp_model_t model,
+    mpf_vtp_model_stats* stats
+);
+
+
+/**
+ * Return the buffers that caused the most page table walks.
+ *
+ * Buffers are identified by the allocation boundaries recorded in the
+ * page table when the model first sees an access to them.  Accesses to
+ * addresses with no translation are not attributed to a buffer.
+ *
+ * @param[in]  model       Model handle.
+ * @param[out] buffers     Buffers, sorted by decreasing walks.
+ * @param[in]  max_buffers Size of buffers.
+ * @param[out] n_buffers   Number of buffers returned.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfVtpModelGetTopBuffers(
+    mpf_vtp_model_t model,
+    mpf_vtp_model_buffer_stats* buffers,
+    uint32_t max_buffers,
+    uint32_t* n_buffers
+);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FPGA_MPF_SHIM_VTP_MODEL_H__
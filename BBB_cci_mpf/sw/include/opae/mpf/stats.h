@@ -0,0 +1,248 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file stats.h
+ * \brief Sample the statistics of all MPF shims
+ */
+
+#ifndef __FPGA_MPF_STATS_H__
+#define __FPGA_MPF_STATS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Statistics of all shims, sampled together.
+ *
+ * The statistics of a shim that isn't present are set to -1, as they
+ * are by the shim-specific functions.
+ */
+typedef struct
+{
+    // Time of the sample, in nanoseconds on a monotonic clock.  The time
+    // is the midpoint of the CSR reads.
+    uint64_t timestamp_ns;
+    // Time spent reading the CSRs, in nanoseconds
+    uint64_t sample_ns;
+
+    // Shims present in the AFU
+    bool has_vtp;
+    bool has_vc_map;
+    bool has_wro;
+    bool has_pwrite;
+
+    mpf_vtp_stats vtp;
+    mpf_vc_map_stats vc_map;
+    mpf_wro_stats wro;
+    mpf_pwrite_stats pwrite;
+
+    // VC Map controller state, when mpfVcMapControllerStart() is running
+    bool has_vc_map_controller;
+    mpf_vc_map_controller_state vc_map_controller;
+}
+mpf_all_stats;
+
+
+/**
+ * Sample the statistics of all shims.
+ *
+ * The counters are read in one pass with mpfReadCsrs(), making the
+ * sample both cheaper and more coherent than calling each shim's
+ * GetStats function.  Counters are still read individually by the
+ * hardware, so the sample is not atomic.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[out] stats       Statistics.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result __MPF_API__ mpfGetAllStats(
+    mpf_handle_t mpf_handle,
+    mpf_all_stats* stats
+);
+
+
+/**
+ * Maximum number of application counters sampled along with the MPF
+ * counters.
+ */
+#define MPF_STATS_MAX_EXTRA 16
+
+
+/**
+ * Read application counters.  Invoked on the sampler's thread.
+ *
+ * @param[in]  ctx         read_extra_ctx from the sampler configuration.
+ * @param[out] values      Array of num_extra counters to fill in.
+ */
+typedef void (*mpf_stats_read_extra_fn)(void* ctx, uint64_t* values);
+
+
+/**
+ * Statistics sampler configuration.
+ */
+typedef struct
+{
+    // Sampling period in microseconds.  0 picks a 100ms default.
+    uint64_t period_us;
+
+    // Number of samples kept in the history.  0 picks a default of 64.
+    uint32_t history_len;
+
+    // Clock frequency of the MPF shims (MHz).  Cycle counters are
+    // converted to a percentage of the interval's cycles using this
+    // frequency.  The percentages are -1 when the frequency is 0.
+    double afu_clock_mhz;
+
+    // Optional application counters, such as AFU-specific CSRs, read
+    // each period with the MPF counters.  Counters must be monotonic.
+    uint32_t num_extra;
+    mpf_stats_read_extra_fn read_extra;
+    void* read_extra_ctx;
+}
+mpf_stats_sampler_config;
+
+
+/**
+ * One sample.  Rates are computed over the interval since the previous
+ * sample.  Rates and percentages that depend on a shim missing from the
+ * AFU are set to -1.
+ */
+typedef struct
+{
+    // Sequence number, counting from 0 when the sampler starts
+    uint64_t seq;
+    // Length of the interval covered by the rates (ns)
+    uint64_t interval_ns;
+
+    // Raw counter values at the end of the interval.  The sample's
+    // timestamp is stats.timestamp_ns.
+    mpf_all_stats stats;
+    uint64_t extra[MPF_STATS_MAX_EXTRA];
+
+    // VTP: FPGA-side TLB hits and misses (4KB and 2MB pages combined),
+    // failed translations per second and page table walker occupancy
+    double vtp_tlb_hits_per_sec;
+    double vtp_tlb_misses_per_sec;
+    double vtp_failed_translations_per_sec;
+    double vtp_pt_walk_busy_pct;
+
+    // VC Map: mapping changes per second
+    double vc_map_changes_per_sec;
+
+    // WRO: percentage of cycles with each conflict type
+    double wro_conflict_rr_pct;
+    double wro_conflict_rw_pct;
+    double wro_conflict_wr_pct;
+    double wro_conflict_ww_pct;
+
+    // PWRITE: partial writes per second
+    double pwrite_per_sec;
+
+    // Application counters per second
+    double extra_per_sec[MPF_STATS_MAX_EXTRA];
+}
+mpf_stats_sample;
+
+
+/**
+ * Start a background thread that samples all shim statistics
+ * periodically.
+ *
+ * Samples are stored in a ring buffer.  Readers get them with
+ * mpfStatsSamplerGetLatest() and mpfStatsSamplerGetHistory() without
+ * locks and without reading CSRs.  Only one sampler may run per MPF
+ * handle.  The sampler is stopped by mpfDisconnect() if it is still
+ * running.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  config      Sampler configuration.  NULL for defaults.
+ * @returns                FPGA_OK on success.  FPGA_BUSY if a sampler
+ *                         is already running.
+ */
+fpga_result __MPF_API__ mpfStatsSamplerStart(
+    mpf_handle_t mpf_handle,
+    const mpf_stats_sampler_config* config
+);
+
+
+/**
+ * Stop the sampler thread and release its history.
+ *
+ * No other thread may be reading samples during the call.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @returns                FPGA_OK on success.  FPGA_NOT_FOUND if no
+ *                         sampler is running.
+ */
+fpga_result __MPF_API__ mpfStatsSamplerStop(
+    mpf_handle_t mpf_handle
+);
+
+
+/**
+ * Return the most recent sample.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[out] sample      Latest sample.
+ * @returns                FPGA_OK on success.  FPGA_NOT_FOUND if no
+ *                         sampler is running or no interval has
+ *                         completed yet.
+ */
+fpga_result __MPF_API__ mpfStatsSamplerGetLatest(
+    mpf_handle_t mpf_handle,
+    mpf_stats_sample* sample
+);
+
+
+/**
+ * Return recent samples, oldest first.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[out] samples     Array of max_samples entries.
+ * @param[in]  max_samples Maximum number of samples to return.  The most
+ *                         recent samples are returned when the history
+ *                         holds more.
+ * @returns                Number of samples stored in the array.
+ */
+uint32_t __MPF_API__ mpfStatsSamplerGetHistory(
+    mpf_handle_t mpf_handle,
+    mpf_stats_sample* samples,
+    uint32_t max_samples
+);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FPGA_MPF_STATS_H__
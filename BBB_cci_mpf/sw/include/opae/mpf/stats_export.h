@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file stats_export.h
+ * \brief Export MPF statistics in OpenMetrics (Prometheus) text format
+ */
+
+#ifndef __FPGA_MPF_STATS_EXPORT_H__
+#define __FPGA_MPF_STATS_EXPORT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Format the statistics of all shims as OpenMetrics text.
+ *
+ * Every sample is labelled with the AFU and the shim.  Counters of shims
+ * missing from the AFU are omitted.  The presence of each shim is
+ * reported by the mpf_shim_present gauge.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  afu_label   Value of the "afu" label.  Distinguishes AFUs
+ *                         scraped together.
+ * @param[out] buf         Buffer for the text, terminated with a NUL.
+ * @param[in]  buf_size    Size of buf.
+ * @param[out] len         Length of the text, not counting the NUL.  Set
+ *                         even when buf is too small, so the caller can
+ *                         retry with a buffer of len + 1 bytes.
+ * @returns                FPGA_OK on success.  FPGA_NO_MEMORY if buf
+ *                         is too small.  FPGA_EXCEPTION if memory needed
+ *                         while formatting couldn't be allocated.
+ */
+fpga_result __MPF_API__ mpfStatsFormatOpenMetrics(
+    mpf_handle_t mpf_handle,
+    const char* afu_label,
+    char* buf,
+    size_t buf_size,
+    size_t* len
+);
+
+
+/**
+ * Write the statistics of all shims as OpenMetrics text to a file.
+ *
+ * The text is written to a temporary file that is then renamed to
+ * path, so a reader such as node_exporter's textfile collector never
+ * sees a partial file.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  afu_label   Value of the "afu" label.
+ * @param[in]  path        File to write, typically <name>.prom.
+ * @returns                FPGA_OK on success.  FPGA_EXCEPTION if the
+ *                         file can't be written.
+ */
+fpga_result __MPF_API__ mpfStatsWriteOpenMetrics(
+    mpf_handle_t mpf_handle,
+    const char* afu_label,
+    const char* path
+);
+
+
+/**
+ * Serve the statistics of all shims over HTTP.
+ *
+ * A background thread listens on the loopback interface and answers
+ * GET requests for /metrics with current OpenMetrics text.  Each
+ * request reads the CSRs.  Only one exporter may run per MPF handle.
+ * The exporter is stopped by mpfDisconnect() if it is still running.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @param[in]  afu_label   Value of the "afu" label.
+ * @param[in]  port        TCP port.  0 picks any free port.
+ * @param[out] bound_port  Port the exporter is listening on.  May be NULL.
+ * @returns                FPGA_OK on success.  FPGA_BUSY if an exporter
+ *                         is already running.  FPGA_NOT_SUPPORTED on
+ *                         platforms without a socket implementation.
+ */
+fpga_result __MPF_API__ mpfStatsExporterStart(
+    mpf_handle_t mpf_handle,
+    const char* afu_label,
+    uint16_t port,
+    uint16_t* bound_port
+);
+
+
+/**
+ * Stop the HTTP exporter.
+ *
+ * @param[in]  mpf_handle  MPF handle initialized by mpfConnect().
+ * @returns                FPGA_OK on success.  FPGA_NOT_FOUND if no
+ *                         exporter is running.
+ */
+fpga_result __MPF_API__ mpfStatsExporterStop(
+    mpf_handle_t mpf_handle
+);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FPGA_MPF_STATS_EXPORT_H__
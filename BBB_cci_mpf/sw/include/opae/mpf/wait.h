@@ -0,0 +1,433 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file wait.h
+ * \brief Adaptive wait for completion words written by an AFU
+ *
+ * AFUs signal completion by writing a word in shared memory.  Spinning
+ * on the word burns a core and sleeping between checks adds latency.
+ * The functions here spin, with a pause hint, for a budget and then
+ * back off exponentially to sleeps.  Each wait's latency is recorded in
+ * a histogram and the spin budget is retuned periodically to cover a
+ * percentile of the observed latencies.  Short jobs are then caught
+ * while spinning and long jobs cost little CPU.
+ *
+ * The functions are inline and need no library.  A wait state is not
+ * thread safe.  Keep one per thread or per kind of job.
+ *
+ * Example:
+ *
+ *   mpf_wait_state ws;
+ *   mpfWaitInit(&ws);
+ *   ...
+ *   mpfWaitUntilNonZero(&ws, &dsm->completion);
+ *
+ * A state that lives for the whole program can be initialized statically,
+ * so it keeps tuning across calls:
+ *
+ *   static mpf_wait_state ws = MPF_WAIT_STATE_INIT;
+ */
+
+#ifndef __FPGA_MPF_WAIT_H__
+#define __FPGA_MPF_WAIT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Buckets in the latency histogram.  Bucket i counts waits that took
+ * from 2^i to 2^(i+1) - 1 nanoseconds.  The last bucket also counts
+ * all longer waits.
+ */
+#define MPF_WAIT_HIST_BUCKETS 40
+
+// Polls between clock reads while spinning
+#define MPF_WAIT_POLLS_PER_CLOCK 16
+
+
+/**
+ * State of an adaptive wait.  Initialize with mpfWaitInit().  The
+ * configuration fields may be changed afterwards.
+ */
+typedef struct
+{
+    // Configuration.  Spin budgets are capped at max_spin_ns.  When the
+    // target percentile of latencies is longer than the cap, spinning
+    // would rarely help and the budget drops to 0.
+    uint64_t max_spin_ns;
+    // Sleeps double from min_sleep_ns to max_sleep_ns
+    uint64_t min_sleep_ns;
+    uint64_t max_sleep_ns;
+    // Percentile of latencies the spin budget should cover
+    uint32_t spin_percentile;
+    // Waits between retuning the spin budget
+    uint32_t tune_interval;
+
+    // Current spin budget
+    uint64_t spin_ns;
+
+    // Completion latencies.  Counts are halved at each retuning so the
+    // histogram follows changes in job length.
+    uint64_t hist[MPF_WAIT_HIST_BUCKETS];
+
+    // Totals since mpfWaitInit()
+    uint64_t n_waits;
+    // Waits that completed before the spin budget ran out
+    uint64_t n_spin_completions;
+    uint64_t n_sleeps;
+
+    uint32_t n_until_tune;
+}
+mpf_wait_state;
+
+
+/**
+ * Static initializer for a wait state with default configuration: spin
+ * for up to 100us, sleep from 2us to 1ms and cover the 90th percentile.
+ * Spins fully until there is a history.
+ */
+#define MPF_WAIT_STATE_INIT                                             \
+    {                                                                   \
+        100000,         /* max_spin_ns */                               \
+        2000,           /* min_sleep_ns */                              \
+        1000000,        /* max_sleep_ns */                              \
+        90,             /* spin_percentile */                           \
+        32,             /* tune_interval */                             \
+        100000,         /* spin_ns */                                   \
+        { 0 },          /* hist */                                      \
+        0, 0, 0,        /* n_waits, n_spin_completions, n_sleeps */     \
+        32              /* n_until_tune */                              \
+    }
+
+
+/**
+ * Initialize a wait state with the configuration of MPF_WAIT_STATE_INIT.
+ *
+ * @param[out] ws          Wait state.
+ */
+static inline void mpfWaitInit(mpf_wait_state* ws)
+{
+    static const mpf_wait_state init = MPF_WAIT_STATE_INIT;
+    *ws = init;
+}
+
+
+static inline uint64_t mpfWaitNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static inline void mpfWaitCpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+
+/**
+ * Latency, in nanoseconds, below which a percentage of the recorded
+ * waits completed.  The result is the upper bound of a histogram
+ * bucket, so it is accurate to within a factor of 2.
+ *
+ * @param[in]  ws          Wait state.
+ * @param[in]  percentile  Percentage of waits (0 - 100).
+ * @returns                Latency in nanoseconds.  0 if no waits are
+ *                         recorded.
+ */
+static inline uint64_t mpfWaitLatencyPercentile(
+    const mpf_wait_state* ws,
+    uint32_t percentile
+)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < MPF_WAIT_HIST_BUCKETS; i++)
+    {
+        total += ws->hist[i];
+    }
+    if (0 == total) return 0;
+
+    uint64_t target = (total * percentile + 99) / 100;
+    uint64_t n = 0;
+    for (int i = 0; i < MPF_WAIT_HIST_BUCKETS; i++)
+    {
+        n += ws->hist[i];
+        if (n >= target) return ((uint64_t)2 << i) - 1;
+    }
+
+    return ~(uint64_t)0;
+}
+
+
+static inline void mpfWaitRecord(mpf_wait_state* ws, uint64_t latency_ns)
+{
+    int b = 0;
+    while ((b < MPF_WAIT_HIST_BUCKETS - 1) && (latency_ns >> (b + 1)))
+    {
+        b += 1;
+    }
+
+    ws->hist[b] += 1;
+    ws->n_waits += 1;
+
+    if (ws->n_until_tune && --ws->n_until_tune) return;
+    ws->n_until_tune = ws->tune_interval;
+
+    uint64_t p = mpfWaitLatencyPercentile(ws, ws->spin_percentile);
+    ws->spin_ns = (p <= ws->max_spin_ns) ? p : 0;
+
+    // Age the history
+    for (int i = 0; i < MPF_WAIT_HIST_BUCKETS; i++)
+    {
+        ws->hist[i] >>= 1;
+    }
+}
+
+
+/**
+ * Condition checked by mpfWaitForTimeout().
+ *
+ * @param[in]  ctx         Context passed to mpfWaitForTimeout().
+ * @returns                True when the wait should end.
+ */
+typedef bool (*mpf_wait_poll_fn)(void* ctx);
+
+
+/**
+ * Wait until a condition holds or a timeout expires.  The condition is
+ * polled like a completion word: spinning for the tuned budget and then
+ * between sleeps.  Use it to watch several words at once.
+ *
+ * A wait that times out is recorded in the histogram with the timeout
+ * as its latency, a lower bound of the job's true latency.
+ *
+ * @param[in]  ws          Wait state.
+ * @param[in]  poll        Condition.
+ * @param[in]  ctx         Passed to poll.
+ * @param[in]  timeout_ns  Maximum wait.  0 waits forever.
+ * @returns                True if the condition held.
+ */
+static inline bool mpfWaitForTimeout(
+    mpf_wait_state* ws,
+    mpf_wait_poll_fn poll,
+    void* ctx,
+    uint64_t timeout_ns
+)
+{
+    if (0 == timeout_ns) timeout_ns = ~(uint64_t)0;
+
+    uint64_t start = mpfWaitNowNs();
+    uint64_t now = start;
+    bool matched = false;
+
+    uint64_t spin_ns = ws->spin_ns;
+    if (spin_ns > timeout_ns) spin_ns = timeout_ns;
+
+    // Spin
+    do
+    {
+        for (int i = 0; i < MPF_WAIT_POLLS_PER_CLOCK; i++)
+        {
+            if (poll(ctx))
+            {
+                matched = true;
+                break;
+            }
+
+            mpfWaitCpuRelax();
+        }
+
+        now = mpfWaitNowNs();
+    }
+    while (! matched && (now - start < spin_ns));
+
+    uint64_t latency_ns = now - start;
+
+    if (matched)
+    {
+        ws->n_spin_completions += 1;
+    }
+    else
+    {
+        // Back off.  The condition became true at some point during the
+        // final sleep.  The latency recorded is the start of that sleep,
+        // a lower bound, so that the budget can grow back once it has
+        // dropped and waits are no longer timed by spinning.
+        uint64_t sleep_ns = ws->min_sleep_ns;
+        while (latency_ns < timeout_ns)
+        {
+            if (sleep_ns > timeout_ns - latency_ns)
+            {
+                sleep_ns = timeout_ns - latency_ns;
+            }
+
+            struct timespec ts;
+            ts.tv_sec = sleep_ns / 1000000000;
+            ts.tv_nsec = sleep_ns % 1000000000;
+            nanosleep(&ts, NULL);
+            ws->n_sleeps += 1;
+
+            if (poll(ctx))
+            {
+                matched = true;
+                break;
+            }
+
+            latency_ns = mpfWaitNowNs() - start;
+
+            sleep_ns *= 2;
+            if (sleep_ns > ws->max_sleep_ns) sleep_ns = ws->max_sleep_ns;
+        }
+    }
+
+#if defined(__GNUC__)
+    // Reads of data written by the AFU before the completion word must
+    // not be hoisted above the wait.
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+
+    mpfWaitRecord(ws, latency_ns);
+
+    return matched;
+}
+
+
+// Condition of mpfWaitUntilTimeout()
+typedef struct
+{
+    const volatile uint64_t* addr;
+    uint64_t mask;
+    uint64_t value;
+    bool until_equal;
+    uint64_t v;
+}
+mpf_wait_word;
+
+static inline bool mpfWaitPollWord(void* ctx)
+{
+    mpf_wait_word* w = (mpf_wait_word*)ctx;
+    w->v = *w->addr;
+    return ((w->v & w->mask) == w->value) == w->until_equal;
+}
+
+
+/**
+ * Wait until a masked word matches a value or a timeout expires.
+ *
+ * @param[in]  ws          Wait state.
+ * @param[in]  addr        Word written by the AFU.
+ * @param[in]  mask        Bits of the word to compare.
+ * @param[in]  value       Expected value of the masked bits.
+ * @param[in]  until_equal Wait until (*addr & mask) == value when true
+ *                         or until it differs from value when false.
+ * @param[in]  timeout_ns  Maximum wait.  0 waits forever.
+ * @param[out] result      Value of the word when the wait ended.
+ *                         (Ignored if NULL.)
+ * @returns                True if the word matched.
+ */
+static inline bool mpfWaitUntilTimeout(
+    mpf_wait_state* ws,
+    const volatile uint64_t* addr,
+    uint64_t mask,
+    uint64_t value,
+    bool until_equal,
+    uint64_t timeout_ns,
+    uint64_t* result
+)
+{
+    mpf_wait_word w = { addr, mask, value, until_equal, 0 };
+    bool matched = mpfWaitForTimeout(ws, mpfWaitPollWord, &w, timeout_ns);
+
+    if (result) *result = w.v;
+    return matched;
+}
+
+
+/**
+ * Wait until a masked word matches a value.
+ *
+ * @param[in]  ws          Wait state.
+ * @param[in]  addr        Word written by the AFU.
+ * @param[in]  mask        Bits of the word to compare.
+ * @param[in]  value       Expected value of the masked bits.
+ * @param[in]  until_equal Wait until (*addr & mask) == value when true
+ *                         or until it differs from value when false.
+ * @returns                Value of the word when it matched.
+ */
+static inline uint64_t mpfWaitUntil(
+    mpf_wait_state* ws,
+    const volatile uint64_t* addr,
+    uint64_t mask,
+    uint64_t value,
+    bool until_equal
+)
+{
+    uint64_t v;
+    mpfWaitUntilTimeout(ws, addr, mask, value, until_equal, 0, &v);
+    return v;
+}
+
+
+/**
+ * Wait until a word is non-zero.
+ *
+ * @param[in]  ws          Wait state.
+ * @param[in]  addr        Word written by the AFU.
+ * @returns                Value of the word.
+ */
+static inline uint64_t mpfWaitUntilNonZero(
+    mpf_wait_state* ws,
+    const volatile uint64_t* addr
+)
+{
+    return mpfWaitUntil(ws, addr, ~(uint64_t)0, 0, false);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FPGA_MPF_WAIT_H__
@@ -0,0 +1,154 @@
+// Copyright(c) 2018, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include <opae/mpf/cxx/mpf_buffer_pool.h>
+
+namespace opae {
+namespace fpga {
+namespace bbb {
+namespace mpf {
+namespace types {
+
+using namespace opae::fpga::types;
+
+mpf_buffer_pool::mpf_buffer_pool(mpf_handle::ptr_t mpf_handle,
+                                 size_t max_idle_bytes)
+    : mpf_handle_(mpf_handle),
+      max_idle_bytes_(max_idle_bytes),
+      idle_bytes_(0) {}
+
+mpf_buffer_pool::~mpf_buffer_pool() {
+  // Idle buffers are unpinned by their destructors
+  trim();
+}
+
+mpf_buffer_pool::ptr_t mpf_buffer_pool::create(mpf_handle::ptr_t mpf_handle,
+                                               size_t max_idle_bytes) {
+  ptr_t p;
+
+  if (!mpfVtpIsAvailable(*mpf_handle)) {
+    throw except(OPAECXX_HERE);
+  }
+
+  p.reset(new mpf_buffer_pool(mpf_handle, max_idle_bytes));
+
+  return p;
+}
+
+int mpf_buffer_pool::size_class(size_t len) {
+  int c = 0;
+  while ((c < num_classes) && (len > (size_t(1) << (min_class_log2 + c)))) {
+    c += 1;
+  }
+
+  // num_classes for buffers too large to pool
+  return c;
+}
+
+mpf_buffer_lease mpf_buffer_pool::acquire(size_t len) {
+  if (!len) {
+    throw except(OPAECXX_HERE);
+  }
+
+  int c = size_class(len);
+
+  if (c < num_classes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!idle_[c].empty()) {
+      mpf_shared_buffer::ptr_t buffer = std::move(idle_[c].back());
+      idle_[c].pop_back();
+      idle_bytes_ -= buffer->size();
+
+      return mpf_buffer_lease(this, std::move(buffer), len);
+    }
+  }
+
+  // Pool is empty.  Allocate a buffer that fills the size class so it
+  // can be reused by any request in the class.
+  size_t alloc_len = (c < num_classes) ?
+                     (size_t(1) << (min_class_log2 + c)) : len;
+
+  return mpf_buffer_lease(this, mpf_shared_buffer::allocate(mpf_handle_,
+                                                            alloc_len),
+                          len);
+}
+
+void mpf_buffer_pool::reserve(size_t len, size_t count) {
+  int c = size_class(len);
+  if (!len || (c == num_classes)) {
+    throw except(OPAECXX_HERE);
+  }
+
+  for (size_t i = 0; i < count; i += 1) {
+    put(mpf_shared_buffer::allocate(mpf_handle_,
+                                    size_t(1) << (min_class_log2 + c)));
+  }
+}
+
+void mpf_buffer_pool::trim() {
+  std::vector<mpf_shared_buffer::ptr_t> released[num_classes];
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (int c = 0; c < num_classes; c += 1) {
+      released[c].swap(idle_[c]);
+    }
+    idle_bytes_ = 0;
+  }
+
+  // Buffers are unpinned as released goes out of scope, outside the lock
+}
+
+size_t mpf_buffer_pool::idle_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return idle_bytes_;
+}
+
+void mpf_buffer_pool::put(mpf_shared_buffer::ptr_t &&buffer) {
+  int c = size_class(buffer->size());
+
+  // Only buffers allocated for a size class are pooled.  Others, and
+  // buffers that would overflow the pool, are released.
+  if ((c < num_classes) &&
+      (buffer->size() == (size_t(1) << (min_class_log2 + c)))) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (buffer->size() <= max_idle_bytes_ - idle_bytes_) {
+      idle_bytes_ += buffer->size();
+      idle_[c].push_back(std::move(buffer));
+      return;
+    }
+  }
+
+  buffer.reset();
+}
+
+}  // end of namespace types
+}  // end of namespace mpf
+}  // end of namespace bbb
+}  // end of namespace fpga
+}  // end of namespace opae
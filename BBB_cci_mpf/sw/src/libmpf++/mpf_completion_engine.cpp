@@ -0,0 +1,191 @@
+// Copyright(c) 2018, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include <iostream>
+
+#include <opae/mpf/cxx/mpf_completion_engine.h>
+
+namespace opae {
+namespace fpga {
+namespace bbb {
+namespace mpf {
+namespace types {
+
+mpf_completion_engine::mpf_completion_engine(const config &cfg)
+    : wait_(cfg.wait), has_pending_(false), stop_(false), outstanding_(0) {}
+
+mpf_completion_engine::~mpf_completion_engine() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+
+  if (poller_.joinable()) {
+    poller_.join();
+  }
+
+  // Outstanding promises are destroyed with active_ and pending_,
+  // breaking their futures
+}
+
+mpf_completion_engine::ptr_t mpf_completion_engine::create(const config &cfg) {
+  ptr_t p(new mpf_completion_engine(cfg));
+
+  p->poller_ = std::thread(&mpf_completion_engine::poll_loop, p.get());
+
+  return p;
+}
+
+std::future<uint64_t> mpf_completion_engine::submit(
+    const volatile uint64_t *addr, uint64_t value, match_t match,
+    uint64_t mask) {
+  job j;
+  j.addr = addr;
+  j.value = value;
+  j.mask = mask;
+  j.match = match;
+  j.promise.reset(new std::promise<uint64_t>());
+
+  std::future<uint64_t> f = j.promise->get_future();
+  add_job(std::move(j));
+
+  return f;
+}
+
+void mpf_completion_engine::submit(const volatile uint64_t *addr,
+                                   uint64_t value, callback_t cb,
+                                   match_t match, uint64_t mask) {
+  job j;
+  j.addr = addr;
+  j.value = value;
+  j.mask = mask;
+  j.match = match;
+  j.cb = std::move(cb);
+
+  add_job(std::move(j));
+}
+
+size_t mpf_completion_engine::outstanding() const {
+  return outstanding_;
+}
+
+void mpf_completion_engine::add_job(job &&j) {
+  outstanding_ += 1;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(std::move(j));
+    has_pending_ = true;
+  }
+
+  // Wake the poller if it is idle.  A poller in mpfWaitForTimeout()
+  // sees has_pending_ instead.
+  wake_.notify_one();
+}
+
+// Condition polled by mpfWaitForTimeout().  Moves completed jobs from
+// active_ to done_ and also ends the wait when new jobs or a stop request
+// arrive.
+bool mpf_completion_engine::poll_active(void *ctx) {
+  mpf_completion_engine *e = static_cast<mpf_completion_engine *>(ctx);
+
+  size_t i = 0;
+  while (i < e->active_.size()) {
+    job &j = e->active_[i];
+    uint64_t v = *j.addr;
+    bool equal = ((v & j.mask) == j.value);
+
+    if (equal == (j.match == match_equal)) {
+      e->done_.push_back(std::move(j));
+      e->done_values_.push_back(v);
+
+      if (i != e->active_.size() - 1) {
+        j = std::move(e->active_.back());
+      }
+      e->active_.pop_back();
+    } else {
+      i += 1;
+    }
+  }
+
+  return !e->done_.empty() ||
+         e->has_pending_.load(std::memory_order_relaxed) ||
+         e->stop_.load(std::memory_order_relaxed);
+}
+
+void mpf_completion_engine::poll_loop() {
+  while (true) {
+    // Take new jobs, sleeping while there is nothing to watch
+    if (active_.empty() || has_pending_) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] {
+        return stop_ || !active_.empty() || !pending_.empty();
+      });
+      if (stop_) {
+        break;
+      }
+
+      for (auto &j : pending_) {
+        active_.push_back(std::move(j));
+      }
+      pending_.clear();
+      has_pending_ = false;
+    }
+
+    // Poll the words without the lock.  mpfWaitForTimeout() ends with
+    // an acquire fence, so data written by the AFU before a completion
+    // word is visible to the job's owner.
+    mpfWaitForTimeout(&wait_, poll_active, this, 0);
+
+    for (size_t d = 0; d < done_.size(); d += 1) {
+      if (done_[d].promise) {
+        done_[d].promise->set_value(done_values_[d]);
+      } else if (done_[d].cb) {
+        try {
+          done_[d].cb(done_values_[d]);
+        } catch (...) {
+          std::cerr << "mpf_completion_engine: exception in completion callback"
+                    << std::endl;
+        }
+      }
+
+      outstanding_ -= 1;
+    }
+
+    done_.clear();
+    done_values_.clear();
+
+    if (stop_) {
+      break;
+    }
+  }
+}
+
+}  // end of namespace types
+}  // end of namespace mpf
+}  // end of namespace bbb
+}  // end of namespace fpga
+}  // end of namespace opae
@@ -0,0 +1,142 @@
+// Copyright(c) 2018, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <opae/cxx/core/except.h>
+#include <opae/cxx/core/properties.h>
+#include <opae/mpf/cxx/mpf_device_manager.h>
+
+namespace opae {
+namespace fpga {
+namespace bbb {
+namespace mpf {
+namespace types {
+
+using namespace opae::fpga::types;
+
+void mpf_device_job::release() {
+  if (device_ != nullptr) {
+    manager_->complete(device_);
+    manager_ = nullptr;
+    device_ = nullptr;
+  }
+}
+
+mpf_device_manager::mpf_device_manager() : next_(0) {}
+
+mpf_device_manager::~mpf_device_manager() {}
+
+mpf_device_manager::ptr_t mpf_device_manager::open(const char *accel_uuid,
+                                                   uint32_t mpf_flags,
+                                                   size_t max_devices) {
+  ptr_t p(new mpf_device_manager());
+
+  auto filter = properties::get();
+  filter->guid.parse(accel_uuid);
+  filter->type = FPGA_ACCELERATOR;
+
+  for (auto &tok : token::enumerate({filter})) {
+    if (max_devices && (p->devices_.size() == max_devices)) break;
+
+    mpf_device d;
+    try {
+      d.accel = handle::open(tok, 0);
+    }
+    catch (const busy &) {
+      // Held by another process
+      continue;
+    }
+
+    d.index = p->devices_.size();
+    d.token = tok;
+    d.mpf = mpf_handle::open(d.accel, 0, 0, mpf_flags);
+    d.numa_node = mpfGetNumaNode(*d.mpf);
+    p->devices_.push_back(d);
+  }
+
+  if (p->devices_.empty()) {
+    throw not_found(OPAECXX_HERE);
+  }
+
+  p->outstanding_.assign(p->devices_.size(), 0);
+
+  return p;
+}
+
+mpf_device_job mpf_device_manager::acquire(int numa_node) {
+  if (numa_node == caller_node) {
+    numa_node = current_numa_node();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Least loaded, then local, then the first after the last pick
+  size_t n = devices_.size();
+  size_t best = next_ % n;
+  for (size_t i = 1; i < n; ++i) {
+    size_t idx = (next_ + i) % n;
+
+    if (outstanding_[idx] != outstanding_[best]) {
+      if (outstanding_[idx] < outstanding_[best]) best = idx;
+    } else if ((numa_node >= 0) &&
+               (devices_[idx].numa_node == numa_node) &&
+               (devices_[best].numa_node != numa_node)) {
+      best = idx;
+    }
+  }
+
+  outstanding_[best] += 1;
+  next_ = best + 1;
+
+  return mpf_device_job(this, &devices_[best]);
+}
+
+size_t mpf_device_manager::outstanding(size_t idx) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return outstanding_[idx];
+}
+
+int mpf_device_manager::current_numa_node() {
+#ifdef SYS_getcpu
+  unsigned int cpu, node;
+  if (0 == syscall(SYS_getcpu, &cpu, &node, nullptr)) {
+    return int(node);
+  }
+#endif
+  return -1;
+}
+
+void mpf_device_manager::complete(const mpf_device *device) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  outstanding_[device->index] -= 1;
+}
+
+}  // end of namespace types
+}  // end of namespace mpf
+}  // end of namespace bbb
+}  // end of namespace fpga
+}  // end of namespace opae
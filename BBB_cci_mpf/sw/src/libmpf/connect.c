@@ -38,6 +38,21 @@
 
 
 static void _mpf_find_features(_mpf_handle_p _mpf_handle);
+static void _mpf_map_mmio(_mpf_handle_p _mpf_handle);
+static void _mpf_find_pcie_info(_mpf_handle_p _mpf_handle);
+static void _mpf_load_latency_qos_profile(_mpf_handle_p _mpf_handle);
+
+
+// Device access through OPAE
+static const mpf_backend mpf_opae_backend =
+{
+    .fpgaReadMMIO64 = fpgaReadMMIO64,
+    .fpgaWriteMMIO64 = fpgaWriteMMIO64,
+    .fpgaMapMMIO = fpgaMapMMIO,
+    .fpgaPrepareBuffer = fpgaPrepareBuffer,
+    .fpgaReleaseBuffer = fpgaReleaseBuffer,
+    .fpgaGetIOAddress = fpgaGetIOAddress
+};
 
 
 fpga_result __MPF_API__ mpfConnect(
@@ -47,6 +62,20 @@ fpga_result __MPF_API__ mpfConnect(
     mpf_handle_t *mpf_handle,
     uint32_t mpf_flags
 )
+{
+    return mpfConnectBackend(NULL, handle, mmio_num, mmio_offset,
+                             mpf_handle, mpf_flags);
+}
+
+
+fpga_result __MPF_API__ mpfConnectBackend(
+    const mpf_backend* backend,
+    fpga_handle handle,
+    uint32_t mmio_num,
+    uint64_t mmio_offset,
+    mpf_handle_t *mpf_handle,
+    uint32_t mpf_flags
+)
 {
     fpga_result r;
     _mpf_handle_p _mpf_handle;
@@ -59,6 +88,14 @@ fpga_result __MPF_API__ mpfConnect(
 
     memset(_mpf_handle, 0, sizeof(*_mpf_handle));
 
+    r = mpfOsPrepareMutex(&_mpf_handle->vc_map_controller_mutex);
+    if (FPGA_OK != r)
+    {
+        free(_mpf_handle);
+        return r;
+    }
+
+    _mpf_handle->backend = backend ? backend : &mpf_opae_backend;
     _mpf_handle->handle = handle;
     _mpf_handle->mmio_num = mmio_num;
     _mpf_handle->mmio_offset = mmio_offset;
@@ -75,6 +112,8 @@ fpga_result __MPF_API__ mpfConnect(
     *mpf_handle = (void *)_mpf_handle;
 
     _mpf_find_features(_mpf_handle);
+    _mpf_map_mmio(_mpf_handle);
+    _mpf_find_pcie_info(_mpf_handle);
 
     //
     // Initialize features that require it.
@@ -85,6 +124,11 @@ fpga_result __MPF_API__ mpfConnect(
         if (FPGA_OK != r) return r;
     }
 
+    if (mpfShimPresent(_mpf_handle, CCI_MPF_SHIM_LATENCY_QOS))
+    {
+        _mpf_load_latency_qos_profile(_mpf_handle);
+    }
+
     return FPGA_OK;
 }
 
@@ -96,6 +140,21 @@ fpga_result __MPF_API__ mpfDisconnect(
     fpga_result r;
     _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
 
+    if (NULL != _mpf_handle->stats_sampler)
+    {
+        mpfStatsSamplerStop(_mpf_handle);
+    }
+
+    if (NULL != _mpf_handle->stats_exporter)
+    {
+        mpfStatsExporterStop(_mpf_handle);
+    }
+
+    if (NULL != _mpf_handle->vc_map_controller)
+    {
+        mpfVcMapControllerStop(_mpf_handle);
+    }
+
     //
     // Terminate features that require it.
     //
@@ -105,6 +164,7 @@ fpga_result __MPF_API__ mpfDisconnect(
         if (FPGA_OK != r) return r;
     }
 
+    mpfOsReleaseMutex(_mpf_handle->vc_map_controller_mutex);
     free(_mpf_handle);
 
     return FPGA_OK;
@@ -121,35 +181,21 @@ bool __MPF_API__ mpfShimPresent(
 }
 
 
+int __MPF_API__ mpfGetNumaNode(
+    mpf_handle_t mpf_handle
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    return _mpf_handle->numa_node;
+}
+
+
 // ========================================================================
 //
 //   Internal code.
 //
 // ========================================================================
 
-//
-// UUIDs of shims, broken down into 64 bit halves
-//
-
-#define MPF_SHIM_VTP_UUID_L           0xa70545727f501901
-#define MPF_SHIM_VTP_UUID_H           0xc8a2982fff9642bf
-
-#define MPF_SHIM_RSP_ORDER_UUID_L     0xb383c70ace57bfe4
-#define MPF_SHIM_RSP_ORDER_UUID_H     0x4c9c96f465ba4dd8
-
-#define MPF_SHIM_VC_MAP_UUID_L        0xb8f93b76e3dd4e74
-#define MPF_SHIM_VC_MAP_UUID_H        0x5046c86fba484856
-
-#define MPF_SHIM_LATENCY_QOS_UUID_L   0x9412a4cf1a999c49
-#define MPF_SHIM_LATENCY_QOS_UUID_H   0xb35138f6ea394603
-
-#define MPF_SHIM_WRO_UUID_L           0xa47e0681b4207a6d
-#define MPF_SHIM_WRO_UUID_H           0x56b06b489dd74004
-
-#define MPF_SHIM_PWRITE_UUID_L        0xa63675b19a0b4f5c
-#define MPF_SHIM_PWRITE_UUID_H        0x9bdbbcaf2c5a4d17
-
-
 // Shim to UUID mapping
 typedef struct
 {
@@ -210,14 +256,12 @@ static void _mpf_find_features(
     do
     {
         // Read the next feature header
-        fpgaReadMMIO64(_mpf_handle->handle, _mpf_handle->mmio_num, offset, &dfh);
+        mpfDevReadMMIO64(_mpf_handle, offset, &dfh);
 
         // Read the current feature's UUID
         uint64_t feature_uuid[2];
-        fpgaReadMMIO64(_mpf_handle->handle, _mpf_handle->mmio_num, offset + 8,
-                       &feature_uuid[0]);
-        fpgaReadMMIO64(_mpf_handle->handle, _mpf_handle->mmio_num, offset + 16,
-                       &feature_uuid[1]);
+        mpfDevReadMMIO64(_mpf_handle, offset + 8, &feature_uuid[0]);
+        mpfDevReadMMIO64(_mpf_handle, offset + 16, &feature_uuid[1]);
 
         if (_mpf_feature_is_bbb(dfh))
         {
@@ -247,3 +291,125 @@ static void _mpf_find_features(
     }
     while (! eol);
 }
+
+
+//
+// Map the MMIO space for direct CSR reads.  Some implementations of
+// fpgaMapMMIO(), such as simulation, return a mapping that isn't backed
+// by the device.  The mapping is used only if a shim's UUID reads the
+// same way through it as through fpgaReadMMIO64().  The mapping is left
+// in place on disconnect since it may be shared with the application.
+// It is released by fpgaClose().
+//
+static void _mpf_map_mmio(
+    _mpf_handle_p _mpf_handle
+)
+{
+    uint64_t* mmio_ptr;
+
+    _mpf_handle->mmio_ptr = NULL;
+
+    if (FPGA_OK != mpfDevMapMMIO(_mpf_handle, &mmio_ptr))
+    {
+        return;
+    }
+
+    for (int i = 0; i < CCI_MPF_SHIM_LAST_IDX; i++)
+    {
+        uint64_t offset = _mpf_handle->shim_mmio_base[i];
+        if (0 == offset) continue;
+
+        // Compare the UUID of the first shim found
+        volatile uint64_t* p = mmio_ptr;
+        if ((p[(offset + 8) / 8] == mpf_shim_info[i].uuid[0]) &&
+            (p[(offset + 16) / 8] == mpf_shim_info[i].uuid[1]))
+        {
+            _mpf_handle->mmio_ptr = mmio_ptr;
+        }
+
+        break;
+    }
+
+    if (_mpf_handle->dbg_mode)
+    {
+        MPF_FPGA_MSG("CSRs read %s", (_mpf_handle->mmio_ptr ?
+                                          "directly from mapped MMIO" :
+                                          "with the backend's MMIO reads"));
+    }
+}
+
+
+//
+// Find the NUMA node of the FPGA's PCIe link from the accelerator's
+// bus/device/function, along with the PCIe device ID.  Other backends,
+// such as the emulator, have no PCIe location.
+//
+static void _mpf_find_pcie_info(
+    _mpf_handle_p _mpf_handle
+)
+{
+    fpga_properties props = NULL;
+    uint8_t bus, device, function;
+    uint16_t device_id;
+
+    _mpf_handle->numa_node = -1;
+    _mpf_handle->pci_device_id = 0;
+
+    if (_mpf_handle->backend != &mpf_opae_backend) return;
+    if (FPGA_OK != fpgaGetPropertiesFromHandle(_mpf_handle->handle, &props))
+    {
+        return;
+    }
+
+    if (FPGA_OK == fpgaPropertiesGetDeviceID(props, &device_id))
+    {
+        _mpf_handle->pci_device_id = device_id;
+    }
+
+    if ((FPGA_OK == fpgaPropertiesGetBus(props, &bus)) &&
+        (FPGA_OK == fpgaPropertiesGetDevice(props, &device)) &&
+        (FPGA_OK == fpgaPropertiesGetFunction(props, &function)))
+    {
+        _mpf_handle->numa_node = mpfOsGetPciNumaNode(bus, device, function);
+
+        if (_mpf_handle->dbg_mode)
+        {
+            MPF_FPGA_MSG("PCIe %02x:%02x.%x is on NUMA node %d",
+                         bus, device, function, _mpf_handle->numa_node);
+        }
+    }
+
+    fpgaDestroyProperties(&props);
+}
+
+
+//
+// Apply the latency QoS profile named by MPF_LATENCY_QOS_PROFILE, if any.
+// A profile that can't be applied is reported but isn't fatal, since the
+// hardware defaults still work.
+//
+static void _mpf_load_latency_qos_profile(
+    _mpf_handle_p _mpf_handle
+)
+{
+    fpga_result r;
+    mpf_latency_qos_params params;
+
+    const char* path = getenv(MPF_LATENCY_QOS_PROFILE_ENV);
+    if ((NULL == path) || ('\0' == *path)) return;
+
+    r = mpfLatencyQosLoadProfile(_mpf_handle, path, &params);
+    if (FPGA_OK == r)
+    {
+        r = mpfLatencyQosSetParams(_mpf_handle, &params);
+    }
+
+    if (FPGA_OK != r)
+    {
+        MPF_FPGA_MSG("Latency QoS profile %s not applied (error %d)", path, r);
+    }
+    else if (_mpf_handle->dbg_mode)
+    {
+        MPF_FPGA_MSG("Latency QoS profile %s applied", path);
+    }
+}
@@ -28,6 +28,8 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <string.h>
+
 #include <opae/mpf/mpf.h>
 #include "mpf_internal.h"
 
@@ -46,9 +48,9 @@ fpga_result __MPF_API__ mpfWriteCsr(
         return FPGA_NOT_FOUND;
     }
 
-    return fpgaWriteMMIO64(_mpf_handle->handle, _mpf_handle->mmio_num,
-                           shim_csr_offset + _mpf_handle->shim_mmio_base[mpf_shim_idx],
-                           value);
+    return mpfDevWriteMMIO64(_mpf_handle,
+                             shim_csr_offset + _mpf_handle->shim_mmio_base[mpf_shim_idx],
+                             value);
 }
 
 
@@ -69,9 +71,9 @@ uint64_t __MPF_API__ mpfReadCsr(
     }
     else
     {
-        r = fpgaReadMMIO64(_mpf_handle->handle, _mpf_handle->mmio_num,
-                           shim_csr_offset + _mpf_handle->shim_mmio_base[mpf_shim_idx],
-                           &value);
+        r = mpfDevReadMMIO64(_mpf_handle,
+                             shim_csr_offset + _mpf_handle->shim_mmio_base[mpf_shim_idx],
+                             &value);
     }
 
     if (NULL != result)
@@ -81,3 +83,51 @@ uint64_t __MPF_API__ mpfReadCsr(
 
     return value;
 }
+
+
+fpga_result __MPF_API__ mpfReadCsrs(
+    mpf_handle_t mpf_handle,
+    t_cci_mpf_shim_idx mpf_shim_idx,
+    uint64_t shim_csr_offset,
+    uint32_t num_csrs,
+    uint64_t* values
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    fpga_result r;
+
+    if (NULL == values) return FPGA_INVALID_PARAM;
+
+    if (! mpfShimPresent(mpf_handle, mpf_shim_idx))
+    {
+        memset(values, -1, num_csrs * sizeof(uint64_t));
+        return FPGA_NOT_FOUND;
+    }
+
+    uint64_t offset = shim_csr_offset + _mpf_handle->shim_mmio_base[mpf_shim_idx];
+
+    // Read directly from the mapped MMIO space when available
+    if (NULL != _mpf_handle->mmio_ptr)
+    {
+        volatile uint64_t* p = _mpf_handle->mmio_ptr + offset / sizeof(uint64_t);
+        for (uint32_t i = 0; i < num_csrs; i++)
+        {
+            values[i] = p[i];
+        }
+
+        return FPGA_OK;
+    }
+
+    for (uint32_t i = 0; i < num_csrs; i++)
+    {
+        r = mpfDevReadMMIO64(_mpf_handle, offset + i * sizeof(uint64_t),
+                             &values[i]);
+        if (FPGA_OK != r)
+        {
+            memset(&values[i], -1, (num_csrs - i) * sizeof(uint64_t));
+            return r;
+        }
+    }
+
+    return FPGA_OK;
+}
@@ -0,0 +1,392 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file emulator.c
+ * \brief In-process emulation of an AFU with MPF shims
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opae/mpf/mpf.h>
+#include "mpf_internal.h"
+
+
+// Size of the emulated MMIO space
+#define EMU_MMIO_BYTES 0x1000
+
+// Stride between emulated features in MMIO space.  Larger than any
+// shim's CSR space.
+#define EMU_FEATURE_STRIDE 0x100
+
+// I/O addresses are assigned starting here, leaving 0 invalid
+#define EMU_IOVA_BASE 0x100000000ULL
+
+// I/O address regions are aligned to the largest page size
+#define EMU_IOVA_ALIGN (1ULL << 30)
+
+// UUIDs of the shims, indexed by t_cci_mpf_shim_idx
+static const uint64_t emu_shim_uuid[CCI_MPF_SHIM_LAST_IDX][2] =
+{
+    { MPF_SHIM_VTP_UUID_L, MPF_SHIM_VTP_UUID_H },
+    { MPF_SHIM_RSP_ORDER_UUID_L, MPF_SHIM_RSP_ORDER_UUID_H },
+    { MPF_SHIM_VC_MAP_UUID_L, MPF_SHIM_VC_MAP_UUID_H },
+    { MPF_SHIM_LATENCY_QOS_UUID_L, MPF_SHIM_LATENCY_QOS_UUID_H },
+    { MPF_SHIM_WRO_UUID_L, MPF_SHIM_WRO_UUID_H },
+    { MPF_SHIM_PWRITE_UUID_L, MPF_SHIM_PWRITE_UUID_H }
+};
+
+
+// Pinned buffer.  The wsid of buffers[i] is i + 1.
+typedef struct
+{
+    void* va;
+    uint64_t len;
+    uint64_t iova;
+    bool in_use;
+    // Buffer was mapped by the emulator, not by the caller
+    bool emu_mapped;
+}
+emu_buffer;
+
+typedef struct
+{
+    // MMIO space
+    uint64_t csrs[EMU_MMIO_BYTES / 8];
+
+    // Protects the buffer table and I/O address allocation
+    mpf_os_mutex_handle mutex;
+
+    emu_buffer* buffers;
+    uint64_t n_buffers;
+    uint64_t max_buffers;
+
+    uint64_t next_iova;
+}
+mpf_emulator;
+
+typedef mpf_emulator* mpf_emulator_p;
+
+
+// Look up a buffer.  Caller holds the mutex.
+static emu_buffer* emuFindBuffer(
+    mpf_emulator_p emu,
+    uint64_t wsid
+)
+{
+    if ((0 == wsid) || (wsid > emu->n_buffers)) return NULL;
+
+    emu_buffer* buf = &emu->buffers[wsid - 1];
+    return buf->in_use ? buf : NULL;
+}
+
+
+static fpga_result emuReadMMIO64(
+    fpga_handle handle,
+    uint32_t mmio_num,
+    uint64_t offset,
+    uint64_t *value
+)
+{
+    mpf_emulator_p emu = (mpf_emulator_p)handle;
+
+    if ((0 != mmio_num) || (offset >= EMU_MMIO_BYTES) || (offset & 7))
+    {
+        return FPGA_INVALID_PARAM;
+    }
+
+    *value = mpfOsAtomicLoad64(&emu->csrs[offset / 8]);
+    return FPGA_OK;
+}
+
+
+static fpga_result emuWriteMMIO64(
+    fpga_handle handle,
+    uint32_t mmio_num,
+    uint64_t offset,
+    uint64_t value
+)
+{
+    mpf_emulator_p emu = (mpf_emulator_p)handle;
+
+    if ((0 != mmio_num) || (offset >= EMU_MMIO_BYTES) || (offset & 7))
+    {
+        return FPGA_INVALID_PARAM;
+    }
+
+    mpfOsAtomicStore64(&emu->csrs[offset / 8], value);
+    return FPGA_OK;
+}
+
+
+static fpga_result emuMapMMIO(
+    fpga_handle handle,
+    uint32_t mmio_num,
+    uint64_t **mmio_ptr
+)
+{
+    mpf_emulator_p emu = (mpf_emulator_p)handle;
+
+    if (0 != mmio_num) return FPGA_INVALID_PARAM;
+
+    *mmio_ptr = emu->csrs;
+    return FPGA_OK;
+}
+
+
+static fpga_result emuPrepareBuffer(
+    fpga_handle handle,
+    uint64_t len,
+    void **buf_addr,
+    uint64_t *wsid,
+    int flags
+)
+{
+    mpf_emulator_p emu = (mpf_emulator_p)handle;
+    bool preallocated = (0 != (flags & FPGA_BUF_PREALLOCATED));
+    fpga_result r;
+    void* va;
+
+    // A zero length request probes for FPGA_BUF_PREALLOCATED support
+    if (0 == len)
+    {
+        return preallocated ? FPGA_OK : FPGA_INVALID_PARAM;
+    }
+
+    if ((NULL == buf_addr) || (NULL == wsid)) return FPGA_INVALID_PARAM;
+
+    if (preallocated)
+    {
+        va = *buf_addr;
+        if (((uint64_t)va | len) & (mpfPageSizeEnumToBytes(MPF_VTP_PAGE_4KB) - 1))
+        {
+            return FPGA_INVALID_PARAM;
+        }
+    }
+    else
+    {
+        mpf_vtp_page_size page_size = MPF_VTP_PAGE_4KB;
+        r = mpfOsMapMemory(len, &page_size, -1, &va);
+        if (FPGA_OK != r) return r;
+    }
+
+    mpfOsLockMutex(emu->mutex);
+
+    if (emu->n_buffers == emu->max_buffers)
+    {
+        uint64_t max_buffers = emu->max_buffers ? 2 * emu->max_buffers : 256;
+        emu_buffer* buffers = realloc(emu->buffers,
+                                      max_buffers * sizeof(emu_buffer));
+        if (NULL == buffers)
+        {
+            mpfOsUnlockMutex(emu->mutex);
+            if (! preallocated) mpfOsUnmapMemory(va, len);
+            return FPGA_NO_MEMORY;
+        }
+
+        emu->buffers = buffers;
+        emu->max_buffers = max_buffers;
+    }
+
+    // Keep the offset of the buffer within a 1GB region so that huge
+    // pages in the buffer are also aligned in I/O space.  Each buffer
+    // starts a new region.
+    uint64_t region_offset = (uint64_t)va & (EMU_IOVA_ALIGN - 1);
+
+    emu_buffer* buf = &emu->buffers[emu->n_buffers++];
+    buf->va = va;
+    buf->len = len;
+    buf->iova = emu->next_iova + region_offset;
+    buf->in_use = true;
+    buf->emu_mapped = ! preallocated;
+
+    emu->next_iova += (region_offset + len + EMU_IOVA_ALIGN - 1) &
+                      ~(EMU_IOVA_ALIGN - 1);
+
+    *wsid = emu->n_buffers;
+
+    mpfOsUnlockMutex(emu->mutex);
+
+    *buf_addr = va;
+    return FPGA_OK;
+}
+
+
+static fpga_result emuReleaseBuffer(
+    fpga_handle handle,
+    uint64_t wsid
+)
+{
+    mpf_emulator_p emu = (mpf_emulator_p)handle;
+
+    mpfOsLockMutex(emu->mutex);
+
+    emu_buffer* buf = emuFindBuffer(emu, wsid);
+    if (NULL == buf)
+    {
+        mpfOsUnlockMutex(emu->mutex);
+        return FPGA_INVALID_PARAM;
+    }
+
+    buf->in_use = false;
+    void* va = buf->va;
+    uint64_t len = buf->len;
+    bool emu_mapped = buf->emu_mapped;
+
+    mpfOsUnlockMutex(emu->mutex);
+
+    if (emu_mapped) mpfOsUnmapMemory(va, len);
+
+    return FPGA_OK;
+}
+
+
+static fpga_result emuGetIOAddress(
+    fpga_handle handle,
+    uint64_t wsid,
+    uint64_t *ioaddr
+)
+{
+    mpf_emulator_p emu = (mpf_emulator_p)handle;
+    fpga_result r = FPGA_INVALID_PARAM;
+
+    mpfOsLockMutex(emu->mutex);
+
+    emu_buffer* buf = emuFindBuffer(emu, wsid);
+    if (NULL != buf)
+    {
+        *ioaddr = buf->iova;
+        r = FPGA_OK;
+    }
+
+    mpfOsUnlockMutex(emu->mutex);
+
+    return r;
+}
+
+
+static const mpf_backend mpf_emulator_backend =
+{
+    .fpgaReadMMIO64 = emuReadMMIO64,
+    .fpgaWriteMMIO64 = emuWriteMMIO64,
+    .fpgaMapMMIO = emuMapMMIO,
+    .fpgaPrepareBuffer = emuPrepareBuffer,
+    .fpgaReleaseBuffer = emuReleaseBuffer,
+    .fpgaGetIOAddress = emuGetIOAddress
+};
+
+
+fpga_result __MPF_API__ mpfEmulatorOpen(
+    uint32_t shim_mask,
+    fpga_handle* handle,
+    const mpf_backend** backend
+)
+{
+    mpf_emulator_p emu;
+    fpga_result r;
+
+    if ((NULL == handle) || (NULL == backend)) return FPGA_INVALID_PARAM;
+
+    emu = malloc(sizeof(mpf_emulator));
+    if (NULL == emu) return FPGA_NO_MEMORY;
+    memset(emu, 0, sizeof(mpf_emulator));
+
+    r = mpfOsPrepareMutex(&emu->mutex);
+    if (FPGA_OK != r)
+    {
+        free(emu);
+        return r;
+    }
+
+    emu->next_iova = EMU_IOVA_BASE;
+
+    if (0 == shim_mask)
+    {
+        shim_mask = (1 << CCI_MPF_SHIM_LAST_IDX) - 1;
+    }
+
+    //
+    // Build the device feature list.  The AFU header is at 0, followed
+    // by one BBB (type 2) feature per shim.  The last feature has the
+    // end of list bit set.
+    //
+    uint64_t* dfh = &emu->csrs[0];
+    uint64_t offset = 0;
+
+    // AFU (type 1)
+    *dfh = (1ULL << 60);
+
+    for (int i = 0; i < CCI_MPF_SHIM_LAST_IDX; i++)
+    {
+        if (0 == (shim_mask & (1 << i))) continue;
+
+        // Link the previous feature to this one
+        *dfh |= ((uint64_t)EMU_FEATURE_STRIDE << 16);
+        offset += EMU_FEATURE_STRIDE;
+
+        dfh = &emu->csrs[offset / 8];
+        *dfh = (2ULL << 60);
+        emu->csrs[offset / 8 + 1] = emu_shim_uuid[i][0];
+        emu->csrs[offset / 8 + 2] = emu_shim_uuid[i][1];
+    }
+
+    // End of list
+    *dfh |= (1ULL << 40);
+
+    *handle = (fpga_handle)emu;
+    *backend = &mpf_emulator_backend;
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfEmulatorClose(
+    fpga_handle handle
+)
+{
+    mpf_emulator_p emu = (mpf_emulator_p)handle;
+
+    if (NULL == emu) return FPGA_INVALID_PARAM;
+
+    for (uint64_t i = 0; i < emu->n_buffers; i++)
+    {
+        emu_buffer* buf = &emu->buffers[i];
+        if (buf->in_use && buf->emu_mapped)
+        {
+            mpfOsUnmapMemory(buf->va, buf->len);
+        }
+    }
+
+    free(emu->buffers);
+    mpfOsReleaseMutex(emu->mutex);
+    free(emu);
+
+    return FPGA_OK;
+}
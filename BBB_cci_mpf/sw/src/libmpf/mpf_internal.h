@@ -65,6 +65,29 @@
         fflush(stdout); \
     } while(0);
 
+//
+// UUIDs of shims, broken down into 64 bit halves
+//
+
+#define MPF_SHIM_VTP_UUID_L           0xa70545727f501901
+#define MPF_SHIM_VTP_UUID_H           0xc8a2982fff9642bf
+
+#define MPF_SHIM_RSP_ORDER_UUID_L     0xb383c70ace57bfe4
+#define MPF_SHIM_RSP_ORDER_UUID_H     0x4c9c96f465ba4dd8
+
+#define MPF_SHIM_VC_MAP_UUID_L        0xb8f93b76e3dd4e74
+#define MPF_SHIM_VC_MAP_UUID_H        0x5046c86fba484856
+
+#define MPF_SHIM_LATENCY_QOS_UUID_L   0x9412a4cf1a999c49
+#define MPF_SHIM_LATENCY_QOS_UUID_H   0xb35138f6ea394603
+
+#define MPF_SHIM_WRO_UUID_L           0xa47e0681b4207a6d
+#define MPF_SHIM_WRO_UUID_H           0x56b06b489dd74004
+
+#define MPF_SHIM_PWRITE_UUID_L        0xa63675b19a0b4f5c
+#define MPF_SHIM_PWRITE_UUID_H        0x9bdbbcaf2c5a4d17
+
+
 // Forward declaration to avoid circular dependence.
 typedef struct _mpf_handle_t* _mpf_handle_p;
 
@@ -82,15 +105,110 @@ struct _mpf_handle_t
     uint32_t mmio_num;
     uint64_t mmio_offset;
 
+    // Device access functions.  OPAE unless set by mpfConnectBackend().
+    const mpf_backend* backend;
+
     // Base MMIO offset of each shim.  0 if shim not present.
     uint64_t shim_mmio_base[CCI_MPF_SHIM_LAST_IDX];
 
+    // MMIO space mapped into the process by fpgaMapMMIO().  CSRs are
+    // read directly through the mapping when it is available, avoiding
+    // the per-call overhead of fpgaReadMMIO64().  NULL when not mapped.
+    volatile uint64_t* mmio_ptr;
+
+    // NUMA node of the FPGA's PCIe link, -1 if unknown
+    int numa_node;
+    // PCIe device ID of the FPGA, 0 if unknown
+    uint16_t pci_device_id;
+
+    // Most recent latency QoS configuration, valid once set
+    uint64_t latency_qos_config;
+    bool latency_qos_config_valid;
+
     // VTP state
     mpf_vtp_state vtp;
 
+    // Statistics sampler, NULL when not running
+    struct _mpf_stats_sampler* stats_sampler;
+
+    // OpenMetrics HTTP exporter, NULL when not running
+    struct _mpf_stats_exporter* stats_exporter;
+
+    // VC Map controller, NULL when not running.  The pointer is protected
+    // by vc_map_controller_mutex since statistics threads read it.
+    struct _mpf_vc_map_controller* vc_map_controller;
+    mpf_os_mutex_handle vc_map_controller_mutex;
+
     // Debug mode requested in mpf_flags?
     bool dbg_mode;
 };
 
 
+/*
+ * Device access through the connection's backend.  MMIO functions use
+ * the connection's MMIO space.
+ */
+static inline fpga_result mpfDevReadMMIO64(
+    _mpf_handle_p _mpf_handle,
+    uint64_t offset,
+    uint64_t* value
+)
+{
+    return _mpf_handle->backend->fpgaReadMMIO64(_mpf_handle->handle,
+                                                _mpf_handle->mmio_num,
+                                                offset, value);
+}
+
+static inline fpga_result mpfDevWriteMMIO64(
+    _mpf_handle_p _mpf_handle,
+    uint64_t offset,
+    uint64_t value
+)
+{
+    return _mpf_handle->backend->fpgaWriteMMIO64(_mpf_handle->handle,
+                                                 _mpf_handle->mmio_num,
+                                                 offset, value);
+}
+
+static inline fpga_result mpfDevMapMMIO(
+    _mpf_handle_p _mpf_handle,
+    uint64_t** mmio_ptr
+)
+{
+    return _mpf_handle->backend->fpgaMapMMIO(_mpf_handle->handle,
+                                             _mpf_handle->mmio_num,
+                                             mmio_ptr);
+}
+
+static inline fpga_result mpfDevPrepareBuffer(
+    _mpf_handle_p _mpf_handle,
+    uint64_t len,
+    void** buf_addr,
+    uint64_t* wsid,
+    int flags
+)
+{
+    return _mpf_handle->backend->fpgaPrepareBuffer(_mpf_handle->handle,
+                                                   len, buf_addr, wsid, flags);
+}
+
+static inline fpga_result mpfDevReleaseBuffer(
+    _mpf_handle_p _mpf_handle,
+    uint64_t wsid
+)
+{
+    return _mpf_handle->backend->fpgaReleaseBuffer(_mpf_handle->handle, wsid);
+}
+
+static inline fpga_result mpfDevGetIOAddress(
+    _mpf_handle_p _mpf_handle,
+    uint64_t wsid,
+    uint64_t* ioaddr
+)
+{
+    return _mpf_handle->backend->fpgaGetIOAddress(_mpf_handle->handle,
+                                                  wsid, ioaddr);
+}
+
+
 #endif // __FPGA_MPF_INTERNAL_H__
@@ -31,7 +31,12 @@
 #ifndef _WIN32
 #define _GNU_SOURCE
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <stdio.h>
 #else
 #include <Windows.h>
 #endif
@@ -50,6 +55,15 @@
 #define MAP_HUGE_SHIFT 26
 #endif
 
+// From numaif.h, which is part of libnuma and not always installed.  The
+// mbind() system call is invoked directly.
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+// Largest NUMA node for which a placement policy can be set
+#define MPF_OS_MAX_NUMA_NODES 1024
+
 void mpfOsMemoryBarrier(void)
 {
 #ifndef _WIN32
@@ -138,6 +152,169 @@ fpga_result mpfOsUnlockMutex(
 
 
 
+//
+// Threads run a function with a single argument.  The OS-specific entry
+// point unpacks it.
+//
+typedef struct
+{
+    void (*start_fn)(void* arg);
+    void* arg;
+#ifndef _WIN32
+    pthread_t tid;
+#else
+    HANDLE tid;
+#endif
+}
+mpf_os_thread;
+
+#ifndef _WIN32
+static void* threadEntry(void* t)
+{
+    ((mpf_os_thread*)t)->start_fn(((mpf_os_thread*)t)->arg);
+    return NULL;
+}
+#else
+static DWORD WINAPI threadEntry(LPVOID t)
+{
+    ((mpf_os_thread*)t)->start_fn(((mpf_os_thread*)t)->arg);
+    return 0;
+}
+#endif
+
+
+fpga_result mpfOsCreateThread(
+    void (*start_fn)(void* arg),
+    void* arg,
+    mpf_os_thread_handle* thread
+)
+{
+    mpf_os_thread* t = malloc(sizeof(mpf_os_thread));
+    if (NULL == t) return FPGA_NO_MEMORY;
+
+    t->start_fn = start_fn;
+    t->arg = arg;
+
+#ifndef _WIN32
+    if (0 != pthread_create(&t->tid, NULL, threadEntry, t))
+#else
+    t->tid = CreateThread(NULL, 0, threadEntry, t, 0, NULL);
+    if (NULL == t->tid)
+#endif
+    {
+        free(t);
+        return FPGA_EXCEPTION;
+    }
+
+    *thread = (mpf_os_thread_handle)t;
+    return FPGA_OK;
+}
+
+
+fpga_result mpfOsJoinThread(
+    mpf_os_thread_handle thread
+)
+{
+    mpf_os_thread* t = (mpf_os_thread*)thread;
+    fpga_result r;
+
+#ifndef _WIN32
+    r = (0 == pthread_join(t->tid, NULL)) ? FPGA_OK : FPGA_EXCEPTION;
+#else
+    r = (WAIT_OBJECT_0 == WaitForSingleObject(t->tid, INFINITE)) ?
+            FPGA_OK : FPGA_EXCEPTION;
+    CloseHandle(t->tid);
+#endif
+
+    free(t);
+    return r;
+}
+
+
+void mpfOsSleepUs(
+    uint64_t usec
+)
+{
+#ifndef _WIN32
+    struct timespec ts;
+    ts.tv_sec = usec / 1000000;
+    ts.tv_nsec = (usec % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+#else
+    Sleep((DWORD)((usec + 999) / 1000));
+#endif
+}
+
+
+uint64_t mpfOsGetTimeNs(void)
+{
+#ifndef _WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (0 == freq.QuadPart)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&count);
+
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#endif
+}
+
+
+
+int mpfOsGetPciNumaNode(
+    uint8_t bus,
+    uint8_t device,
+    uint8_t function
+)
+{
+    int numa_node = -1;
+
+#ifndef _WIN32
+    // Find the device in sysfs.  The PCIe segment isn't known, so the
+    // bus/device/function must be unique.
+    DIR* dir = opendir("/sys/bus/pci/devices");
+    if (NULL == dir) return -1;
+
+    char path[320];
+    int n_found = 0;
+    struct dirent* e;
+    while (NULL != (e = readdir(dir)))
+    {
+        unsigned int s, b, d, f;
+        if ((4 == sscanf(e->d_name, "%x:%x:%x.%x", &s, &b, &d, &f)) &&
+            (b == bus) && (d == device) && (f == function))
+        {
+            snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/numa_node",
+                     e->d_name);
+            n_found += 1;
+        }
+    }
+    closedir(dir);
+
+    if (1 != n_found) return -1;
+
+    // The kernel reports -1 when the platform doesn't describe the
+    // device's node.
+    FILE* fp = fopen(path, "r");
+    if (NULL == fp) return -1;
+    if (1 != fscanf(fp, "%d", &numa_node))
+    {
+        numa_node = -1;
+    }
+    fclose(fp);
+#endif
+
+    return numa_node;
+}
+
+
 // Round a length up to a multiple of the page size
 static size_t roundUpToPages(
     size_t num_bytes,
@@ -149,12 +326,78 @@ static size_t roundUpToPages(
 }
 
 
+#ifndef _WIN32
+//
+// Ask the kernel to allocate a buffer's physical pages on numa_node.  The
+// policy is applied as pages fault in, so it must be set before the buffer
+// is touched or pinned.  It is only a preference: when the node is out of
+// memory pages come from other nodes instead of failing the allocation.
+//
+static void bindToNumaNode(
+    void* buffer,
+    size_t num_bytes,
+    int numa_node
+)
+{
+#ifdef SYS_mbind
+    if ((numa_node < 0) || (numa_node >= MPF_OS_MAX_NUMA_NODES)) return;
+
+    const size_t bits_per_word = 8 * sizeof(unsigned long);
+    unsigned long mask[MPF_OS_MAX_NUMA_NODES / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    mask[numa_node / bits_per_word] = 1UL << (numa_node % bits_per_word);
+
+    // Failure leaves the default policy, which is still correct
+    syscall(SYS_mbind, buffer, num_bytes, MPOL_PREFERRED, mask,
+            MPF_OS_MAX_NUMA_NODES + 1, 0);
+#endif
+}
+
+
+//
+// mmap() only guarantees alignment to the base page size.  Pad the request
+// so that the buffer can be aligned to page_bytes here.
+//
+static void* mapAligned(
+    size_t num_bytes,
+    size_t page_bytes,
+    int flags
+)
+{
+    size_t alloc_bytes = num_bytes + page_bytes;
+    void* base_buffer = mmap(NULL, alloc_bytes, (PROT_READ | PROT_WRITE), flags, 0, 0);
+    if (base_buffer == MAP_FAILED) return MAP_FAILED;
+
+    // Align the buffer start to a page
+    void* buffer = (void*)(((size_t)base_buffer + page_bytes - 1) & ~(page_bytes - 1));
+
+    // Release the unused portion at the start used for alignment
+    if (buffer != base_buffer)
+    {
+        size_t drop_bytes = (size_t)(buffer - base_buffer);
+        munmap(base_buffer, drop_bytes);
+        alloc_bytes -= drop_bytes;
+    }
+
+    // Release any extra portion at the end of the buffer
+    if (alloc_bytes > num_bytes)
+    {
+        munmap(buffer + num_bytes, alloc_bytes - num_bytes);
+    }
+
+    return buffer;
+}
+#endif
+
+
 fpga_result mpfOsMapMemory(
     size_t num_bytes,
     mpf_vtp_page_size* page_size,
+    int numa_node,
     void** buffer
 )
 {
+    size_t req_bytes = num_bytes;
     num_bytes = roundUpToPages(num_bytes, *page_size);
     size_t page_bytes = mpfPageSizeEnumToBytes(*page_size);
 
@@ -168,58 +411,93 @@ fpga_result mpfOsMapMemory(
 
     // Compute the mmap flags
     const int base_flags = (MAP_PRIVATE | MAP_ANONYMOUS);
-    int flags = base_flags;
-    if (*page_size > MPF_VTP_PAGE_4KB)
+    *buffer = MAP_FAILED;
+
+    // Try huge pages, stepping down from 1GB to 2MB when the system has
+    // no free pages of the requested size.
+    while (*page_size > MPF_VTP_PAGE_4KB)
     {
-        flags |= MAP_HUGETLB;
+        int flags = base_flags | MAP_HUGETLB;
 
         // Indicate the desired size.  The page size enumeration already uses
         // log2 encoding, which mmap expects.
         flags |= (*page_size << MAP_HUGE_SHIFT);
-    }
 
-    *buffer = mmap(NULL, num_bytes, (PROT_READ | PROT_WRITE), flags, 0, 0);
+        *buffer = mmap(NULL, num_bytes, (PROT_READ | PROT_WRITE), flags, 0, 0);
+        if ((*buffer != MAP_FAILED) || (*page_size != MPF_VTP_PAGE_1GB)) break;
+
+        *page_size = MPF_VTP_PAGE_2MB;
+        num_bytes = roundUpToPages(req_bytes, *page_size);
+        page_bytes = mpfPageSizeEnumToBytes(*page_size);
+    }
 
-    if ((*buffer == MAP_FAILED) && (*page_size > MPF_VTP_PAGE_4KB))
+    if (*page_size == MPF_VTP_PAGE_4KB)
     {
-        // Failed to allocate at the requested page size.  Retry, but
-        // don't demand huge pages.
-        assert(MPF_VTP_PAGE_2MB == *page_size);
+        *buffer = mmap(NULL, num_bytes, (PROT_READ | PROT_WRITE), base_flags, 0, 0);
+    }
+    else if (*buffer == MAP_FAILED)
+    {
+        // Failed to allocate huge pages.  Retry, but don't demand huge
+        // pages.
 
-        // Indicate that the preallocated 2MB region wasn't used.  The
+        // Indicate that the preallocated huge region wasn't used.  The
         // response doesn't mean that the underlying pages are necessarily
         // only 4KB, but they may be.
         *page_size = MPF_VTP_PAGE_4KB;
 
         // Without requesting 2MB pages, mmap won't guarantee alignment.
-        // Pad the request so that we will handle alignment here.
-        size_t alloc_bytes = num_bytes + page_bytes;
-        void* base_buffer = mmap(NULL, alloc_bytes, (PROT_READ | PROT_WRITE), base_flags, 0, 0);
-        if (base_buffer != MAP_FAILED)
-        {
-            // Align the buffer start to a page
-            *buffer = (void*)(((size_t)base_buffer + page_bytes - 1) & ~(page_bytes - 1));
-
-            // Release the unused portion at the start used for alignment
-            if (*buffer != base_buffer)
-            {
-                size_t drop_bytes = (size_t)(*buffer - base_buffer);
-                munmap(base_buffer, drop_bytes);
-                alloc_bytes -= drop_bytes;
-            }
-
-            // Release any extra portion at the end of the buffer
-            if (alloc_bytes > num_bytes)
-            {
-                munmap(*buffer + num_bytes, alloc_bytes - num_bytes);
-            }
-        }
+        *buffer = mapAligned(num_bytes, page_bytes, base_flags);
+    }
+
+    if (*buffer == MAP_FAILED)
+    {
+        *buffer = NULL;
+    }
+    else
+    {
+        bindToNumaNode(*buffer, num_bytes, numa_node);
+    }
+#else
+    // Windows
+
+    // Implement me
+    *buffer = NULL;
+#endif
+
+    if (*buffer == NULL) return FPGA_NO_MEMORY;
+
+    return FPGA_OK;
+}
+
+
+fpga_result mpfOsReserveMemory(
+    size_t num_bytes,
+    mpf_vtp_page_size align,
+    int numa_node,
+    void** buffer
+)
+{
+    num_bytes = roundUpToPages(num_bytes, align);
+
+    if ((NULL == buffer) || (0 == num_bytes))
+    {
+        return FPGA_INVALID_PARAM;
     }
 
+#ifndef _WIN32
+    // POSIX
+
+    // Normal pages, committed only when touched
+    *buffer = mapAligned(num_bytes, mpfPageSizeEnumToBytes(align),
+                         (MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE));
     if (*buffer == MAP_FAILED)
     {
         *buffer = NULL;
     }
+    else
+    {
+        bindToNumaNode(*buffer, num_bytes, numa_node);
+    }
 #else
     // Windows
 
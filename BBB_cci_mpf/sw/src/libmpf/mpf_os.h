@@ -40,6 +40,50 @@
 void mpfOsMemoryBarrier(void);
 
 
+/**
+ * Atomic 64 bit load with acquire semantics.
+ *
+ * Paired with mpfOsAtomicStore64() to publish data to readers that
+ * don't hold a lock.
+ */
+#ifndef _WIN32
+#define mpfOsAtomicLoad64(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#else
+// Volatile accesses have acquire/release semantics with MSVC on x86.
+#define mpfOsAtomicLoad64(ptr) (*(volatile int64_t*)(ptr))
+#endif
+
+
+/**
+ * Atomic 64 bit store with release semantics.
+ */
+#ifndef _WIN32
+#define mpfOsAtomicStore64(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#else
+#define mpfOsAtomicStore64(ptr, val) (*(volatile int64_t*)(ptr) = (val))
+#endif
+
+
+/**
+ * Atomic 64 bit add, returning the previous value.  A full barrier.
+ */
+#ifndef _WIN32
+#define mpfOsAtomicAdd64(ptr, val) __atomic_fetch_add(ptr, val, __ATOMIC_SEQ_CST)
+#else
+#define mpfOsAtomicAdd64(ptr, val) InterlockedExchangeAdd64((volatile LONG64*)(ptr), val)
+#endif
+
+
+/**
+ * Storage class for thread-local variables.
+ */
+#ifndef _WIN32
+#define MPF_OS_THREAD_LOCAL __thread
+#else
+#define MPF_OS_THREAD_LOCAL __declspec(thread)
+#endif
+
+
 /**
  * Anonymous mutex type.
  */
@@ -90,6 +134,71 @@ fpga_result mpfOsUnlockMutex(
 );
 
 
+/**
+ * Anonymous thread type.
+ */
+typedef void* mpf_os_thread_handle;
+
+
+/**
+ * Start a thread.
+ *
+ * @param[in]  start_fn    Function run by the new thread.
+ * @param[in]  arg         Argument passed to start_fn.
+ * @param[out] thread      Thread object.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result mpfOsCreateThread(
+    void (*start_fn)(void* arg),
+    void* arg,
+    mpf_os_thread_handle* thread
+);
+
+
+/**
+ * Wait for a thread to exit and release the thread object.
+ *
+ * @param[in]  thread      Thread object.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result mpfOsJoinThread(
+    mpf_os_thread_handle thread
+);
+
+
+/**
+ * Sleep for at least the requested time.
+ *
+ * @param[in]  usec        Microseconds to sleep.
+ */
+void mpfOsSleepUs(
+    uint64_t usec
+);
+
+
+/**
+ * Monotonic time.
+ *
+ * @returns                Nanoseconds since an arbitrary fixed point.
+ */
+uint64_t mpfOsGetTimeNs(void);
+
+
+/**
+ * NUMA node to which a PCIe device is attached.
+ *
+ * @param[in]  bus         PCIe bus.
+ * @param[in]  device      PCIe device.
+ * @param[in]  function    PCIe function.
+ * @returns                NUMA node or -1 if unknown.
+ */
+int mpfOsGetPciNumaNode(
+    uint8_t bus,
+    uint8_t device,
+    uint8_t function
+);
+
+
 /**
  * Map a memory buffer.
  *
@@ -97,12 +206,36 @@ fpga_result mpfOsUnlockMutex(
  * @param[inout] page_size Physical page size requested.  On return the page_size
  *                         is set to the actual size used.  If big pages are
  *                         unavailable, smaller physical pages may be permitted.
+ * @param[in]  numa_node   Preferred NUMA node of the physical pages, which
+ *                         are allocated when first touched or pinned.
+ *                         -1 for the default policy.
  * @param[out] buffer      Address of the allocated buffer
  * @returns                FPGA_OK on success.
  */
 fpga_result mpfOsMapMemory(
     size_t num_bytes,
     mpf_vtp_page_size* page_size,
+    int numa_node,
+    void** buffer
+);
+
+
+/**
+ * Reserve virtual address space for a buffer.  Physical memory is committed
+ * as pages are touched or pinned.
+ *
+ * @param[in]  num_bytes   Number of bytes to reserve.  Rounded up to a
+ *                         multiple of align.
+ * @param[in]  align       The buffer is aligned to a page of this size.
+ * @param[in]  numa_node   Preferred NUMA node of the physical pages.
+ *                         -1 for the default policy.
+ * @param[out] buffer      Address of the reserved buffer
+ * @returns                FPGA_OK on success.
+ */
+fpga_result mpfOsReserveMemory(
+    size_t num_bytes,
+    mpf_vtp_page_size align,
+    int numa_node,
     void** buffer
 );
 
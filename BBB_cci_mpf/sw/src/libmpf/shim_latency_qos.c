@@ -33,7 +33,10 @@
  * \brief MPF Latency QoS shim
  */
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <float.h>
 
 #include <opae/mpf/mpf.h>
 #include "mpf_internal.h"
@@ -52,5 +55,475 @@ fpga_result __MPF_API__ mpfLatencyQosSetConfig(
                     CCI_MPF_SHIM_LATENCY_QOS, CCI_MPF_LATENCY_QOS_CSR_CTRL_REG,
                     config);
 
+    if (FPGA_OK == r)
+    {
+        _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+        _mpf_handle->latency_qos_config = config;
+        _mpf_handle->latency_qos_config_valid = true;
+    }
+
+    return r;
+}
+
+
+// ========================================================================
+//
+//  Configuration encoding.  See cci_mpf_shim_latency_qos.sv.
+//
+// ========================================================================
+
+uint64_t __MPF_API__ mpfLatencyQosEncodeConfig(
+    const mpf_latency_qos_params* params
+)
+{
+    const mpf_latency_qos_channel* c0 = &params->chan[0];
+    const mpf_latency_qos_channel* c1 = &params->chan[1];
+
+    return ((uint64_t)c0->enable |
+            ((uint64_t)c1->enable << 1) |
+            ((uint64_t)(c0->max_active_lines & MPF_LATENCY_QOS_MAX_ACTIVE_LINES) << 2) |
+            ((uint64_t)(c1->max_active_lines & MPF_LATENCY_QOS_MAX_ACTIVE_LINES) << 17) |
+            ((uint64_t)(c0->epoch_cycles & MPF_LATENCY_QOS_MAX_EPOCH_CYCLES) << 32) |
+            ((uint64_t)(c1->epoch_cycles & MPF_LATENCY_QOS_MAX_EPOCH_CYCLES) << 48));
+}
+
+
+void __MPF_API__ mpfLatencyQosDecodeConfig(
+    uint64_t config,
+    mpf_latency_qos_params* params
+)
+{
+    params->chan[0].enable = config & 1;
+    params->chan[1].enable = (config >> 1) & 1;
+    params->chan[0].max_active_lines = (config >> 2) & MPF_LATENCY_QOS_MAX_ACTIVE_LINES;
+    params->chan[1].max_active_lines = (config >> 17) & MPF_LATENCY_QOS_MAX_ACTIVE_LINES;
+    params->chan[0].epoch_cycles = (config >> 32) & MPF_LATENCY_QOS_MAX_EPOCH_CYCLES;
+    params->chan[1].epoch_cycles = (config >> 48) & MPF_LATENCY_QOS_MAX_EPOCH_CYCLES;
+}
+
+
+fpga_result __MPF_API__ mpfLatencyQosSetParams(
+    mpf_handle_t mpf_handle,
+    const mpf_latency_qos_params* params
+)
+{
+    for (int c = 0; c < 2; c += 1)
+    {
+        if ((params->chan[c].max_active_lines > MPF_LATENCY_QOS_MAX_ACTIVE_LINES) ||
+            (params->chan[c].epoch_cycles > MPF_LATENCY_QOS_MAX_EPOCH_CYCLES))
+        {
+            return FPGA_INVALID_PARAM;
+        }
+    }
+
+    return mpfLatencyQosSetConfig(mpf_handle, mpfLatencyQosEncodeConfig(params));
+}
+
+
+fpga_result __MPF_API__ mpfLatencyQosGetParams(
+    mpf_handle_t mpf_handle,
+    mpf_latency_qos_params* params
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+
+    if (! _mpf_handle->latency_qos_config_valid) return FPGA_NOT_FOUND;
+
+    mpfLatencyQosDecodeConfig(_mpf_handle->latency_qos_config, params);
+    return FPGA_OK;
+}
+
+
+// ========================================================================
+//
+//  Autotuner.
+//
+// ========================================================================
+
+void __MPF_API__ mpfLatencyQosTuneDefaults(
+    mpf_latency_qos_tune_opts* opts
+)
+{
+    // Very low limits starve the pipeline and aren't worth measuring
+    opts->min_active_lines = 32;
+    opts->max_active_lines = 1023;
+    opts->min_epoch_cycles = 16;
+    opts->max_epoch_cycles = 1023;
+    opts->bw_tolerance = 0.02;
+    opts->active_lines_resolution = 4;
+    opts->epoch_cycles_resolution = 4;
+}
+
+
+//
+// Search state for one channel
+//
+typedef struct
+{
+    mpf_handle_t mpf_handle;
+    uint32_t channel;
+    mpf_latency_qos_measure_fn measure;
+    void* measure_ctx;
+    mpf_latency_qos_params params;
+
+    // Highest bandwidth seen.  Candidates must reach (1 - tolerance) of it.
+    double peak_bw;
+    double bw_tolerance;
+
+    // Best candidate meeting the bandwidth target
+    bool have_best;
+    uint32_t best_active_lines;
+    uint32_t best_epoch_cycles;
+    double best_latency;
+}
+tune_state;
+
+
+//
+// Set and measure one candidate.
+//
+static fpga_result tuneMeasure(
+    tune_state* t,
+    uint32_t active_lines,
+    uint32_t epoch_cycles,
+    double* bw,
+    double* latency
+)
+{
+    fpga_result r;
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)t->mpf_handle;
+    mpf_latency_qos_channel* chan = &t->params.chan[t->channel];
+
+    chan->enable = true;
+    chan->max_active_lines = active_lines;
+    chan->epoch_cycles = epoch_cycles;
+
+    r = mpfLatencyQosSetParams(t->mpf_handle, &t->params);
+    if (FPGA_OK != r) return r;
+
+    r = t->measure(t->measure_ctx, t->channel, bw, latency);
+    if (FPGA_OK != r) return r;
+
+    if (_mpf_handle->dbg_mode)
+    {
+        MPF_FPGA_MSG("c%d lines %d epoch %d: bw %f, latency %f",
+                     t->channel, active_lines, epoch_cycles, *bw, *latency);
+    }
+
+    if (*bw > t->peak_bw) t->peak_bw = *bw;
+    return FPGA_OK;
+}
+
+
+static bool tuneMeetsBw(
+    const tune_state* t,
+    double bw
+)
+{
+    return bw >= (1.0 - t->bw_tolerance) * t->peak_bw;
+}
+
+
+//
+// Measure a candidate and remember it if it is the best so far.  The
+// returned cost is the latency, or DBL_MAX if bandwidth is too low.
+//
+static fpga_result tuneCost(
+    tune_state* t,
+    uint32_t active_lines,
+    uint32_t epoch_cycles,
+    double* cost
+)
+{
+    fpga_result r;
+    double bw, latency;
+
+    r = tuneMeasure(t, active_lines, epoch_cycles, &bw, &latency);
+    if (FPGA_OK != r) return r;
+
+    *cost = DBL_MAX;
+    if (tuneMeetsBw(t, bw))
+    {
+        *cost = latency;
+
+        if (! t->have_best || (latency < t->best_latency))
+        {
+            t->have_best = true;
+            t->best_active_lines = active_lines;
+            t->best_epoch_cycles = epoch_cycles;
+            t->best_latency = latency;
+        }
+    }
+
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfLatencyQosTune(
+    mpf_handle_t mpf_handle,
+    uint32_t channel,
+    mpf_latency_qos_measure_fn measure,
+    void* measure_ctx,
+    const mpf_latency_qos_tune_opts* opts,
+    mpf_latency_qos_params* params
+)
+{
+    fpga_result r;
+    mpf_latency_qos_tune_opts default_opts;
+    tune_state t;
+    double bw, latency, cost;
+
+    if (! mpfShimPresent(mpf_handle, CCI_MPF_SHIM_LATENCY_QOS)) return FPGA_NOT_SUPPORTED;
+
+    if (NULL == opts)
+    {
+        mpfLatencyQosTuneDefaults(&default_opts);
+        opts = &default_opts;
+    }
+
+    if ((channel > 1) || (NULL == measure) ||
+        (opts->min_active_lines == 0) ||
+        (opts->min_active_lines > opts->max_active_lines) ||
+        (opts->max_active_lines > MPF_LATENCY_QOS_MAX_ACTIVE_LINES) ||
+        (opts->min_epoch_cycles == 0) ||
+        (opts->min_epoch_cycles > opts->max_epoch_cycles) ||
+        (opts->max_epoch_cycles > MPF_LATENCY_QOS_MAX_EPOCH_CYCLES) ||
+        (opts->bw_tolerance < 0) || (opts->bw_tolerance >= 1))
+    {
+        return FPGA_INVALID_PARAM;
+    }
+
+    memset(&t, 0, sizeof(t));
+    t.mpf_handle = mpf_handle;
+    t.channel = channel;
+    t.measure = measure;
+    t.measure_ctx = measure_ctx;
+    t.params = *params;
+    t.bw_tolerance = opts->bw_tolerance;
+
+    uint32_t line_res = (opts->active_lines_resolution ? opts->active_lines_resolution : 1);
+    uint32_t epoch_res = (opts->epoch_cycles_resolution ? opts->epoch_cycles_resolution : 1);
+
+    // Start from the caller's epoch, if it is in range
+    uint32_t epoch = params->chan[channel].epoch_cycles;
+    if ((epoch < opts->min_epoch_cycles) || (epoch > opts->max_epoch_cycles))
+    {
+        epoch = (opts->min_epoch_cycles + opts->max_epoch_cycles) / 2;
+    }
+
+    //
+    // Peak bandwidth, with the fewest restrictions on lines in flight
+    //
+    r = tuneMeasure(&t, opts->max_active_lines, epoch, &bw, &latency);
+    if (FPGA_OK != r) return r;
+
+    //
+    // Bandwidth is non-decreasing with the active line limit.  Bisect for
+    // the smallest limit that meets the bandwidth target.  hi always meets
+    // the target.
+    //
+    uint32_t lo = opts->min_active_lines;
+    uint32_t hi = opts->max_active_lines;
+
+    r = tuneMeasure(&t, lo, epoch, &bw, &latency);
+    if (FPGA_OK != r) return r;
+    if (tuneMeetsBw(&t, bw))
+    {
+        hi = lo;
+    }
+
+    while (hi - lo > line_res)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        r = tuneMeasure(&t, mid, epoch, &bw, &latency);
+        if (FPGA_OK != r) return r;
+
+        if (tuneMeetsBw(&t, bw))
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid;
+        }
+    }
+
+    uint32_t lines = hi;
+    r = tuneCost(&t, lines, epoch, &cost);
+    if (FPGA_OK != r) return r;
+
+    //
+    // Golden-section search for the epoch length with the lowest latency.
+    // Candidates that miss the bandwidth target cost DBL_MAX.
+    //
+    // 1 / golden ratio
+    const double inv_phi = 0.6180339887498949;
+
+    double a = opts->min_epoch_cycles;
+    double b = opts->max_epoch_cycles;
+    uint32_t x1 = (uint32_t)(b - inv_phi * (b - a) + 0.5);
+    uint32_t x2 = (uint32_t)(a + inv_phi * (b - a) + 0.5);
+    double f1, f2;
+
+    if (b - a > epoch_res)
+    {
+        r = tuneCost(&t, lines, x1, &f1);
+        if (FPGA_OK != r) return r;
+        r = tuneCost(&t, lines, x2, &f2);
+        if (FPGA_OK != r) return r;
+    }
+
+    while (b - a > epoch_res)
+    {
+        if (f1 <= f2)
+        {
+            b = x2;
+            x2 = x1;
+            f2 = f1;
+            x1 = (uint32_t)(b - inv_phi * (b - a) + 0.5);
+            if (x1 == x2) break;
+
+            r = tuneCost(&t, lines, x1, &f1);
+        }
+        else
+        {
+            a = x1;
+            x1 = x2;
+            f1 = f2;
+            x2 = (uint32_t)(a + inv_phi * (b - a) + 0.5);
+            if (x1 == x2) break;
+
+            r = tuneCost(&t, lines, x2, &f2);
+        }
+
+        if (FPGA_OK != r) return r;
+    }
+
+    //
+    // Apply the best candidate.  The bisection's result always met the
+    // target when it was measured, but noise may have raised the peak
+    // since then.  Fall back to it anyway rather than fail.
+    //
+    mpf_latency_qos_channel* chan = &t.params.chan[channel];
+    chan->enable = true;
+    chan->max_active_lines = (t.have_best ? t.best_active_lines : lines);
+    chan->epoch_cycles = (t.have_best ? t.best_epoch_cycles : epoch);
+
+    r = mpfLatencyQosSetParams(mpf_handle, &t.params);
+    if (FPGA_OK != r) return r;
+
+    *params = t.params;
+    return FPGA_OK;
+}
+
+
+// ========================================================================
+//
+//  Profiles.
+//
+// ========================================================================
+
+fpga_result __MPF_API__ mpfLatencyQosSaveProfile(
+    mpf_handle_t mpf_handle,
+    const char* path,
+    const mpf_latency_qos_params* params
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+
+    FILE* f = fopen(path, "w");
+    if (NULL == f) return FPGA_EXCEPTION;
+
+    fprintf(f, "# MPF latency QoS profile\n");
+    if (_mpf_handle->pci_device_id)
+    {
+        fprintf(f, "pci_device_id=0x%04x\n", _mpf_handle->pci_device_id);
+    }
+
+    for (int c = 0; c < 2; c += 1)
+    {
+        fprintf(f, "c%d_enable=%d\n", c, params->chan[c].enable);
+        fprintf(f, "c%d_max_active_lines=%u\n", c, params->chan[c].max_active_lines);
+        fprintf(f, "c%d_epoch_cycles=%u\n", c, params->chan[c].epoch_cycles);
+    }
+
+    if (0 != fclose(f)) return FPGA_EXCEPTION;
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfLatencyQosLoadProfile(
+    mpf_handle_t mpf_handle,
+    const char* path,
+    mpf_latency_qos_params* params
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    fpga_result r = FPGA_OK;
+    char line[256];
+    // Each channel field must be present once
+    uint32_t found = 0;
+
+    FILE* f = fopen(path, "r");
+    if (NULL == f) return FPGA_NOT_FOUND;
+
+    memset(params, 0, sizeof(*params));
+
+    while ((FPGA_OK == r) && fgets(line, sizeof(line), f))
+    {
+        char key[64];
+        long value;
+        int c;
+
+        if (('#' == line[0]) || ('\n' == line[0])) continue;
+
+        if (2 != sscanf(line, " %63[^= ] = %li", key, &value))
+        {
+            r = FPGA_INVALID_PARAM;
+        }
+        else if (0 == strcmp(key, "pci_device_id"))
+        {
+            // Refuse profiles from other devices.  Unknown devices (such
+            // as the emulator) accept any profile.
+            if (_mpf_handle->pci_device_id && (value != _mpf_handle->pci_device_id))
+            {
+                r = FPGA_INVALID_PARAM;
+            }
+        }
+        else if ((1 == sscanf(key, "c%d_", &c)) && (c >= 0) && (c <= 1))
+        {
+            const char* field = key + 3;
+            if (0 == strcmp(field, "enable"))
+            {
+                params->chan[c].enable = (value != 0);
+                found |= 1 << (c * 3);
+            }
+            else if (0 == strcmp(field, "max_active_lines") &&
+                     (value >= 0) && (value <= MPF_LATENCY_QOS_MAX_ACTIVE_LINES))
+            {
+                params->chan[c].max_active_lines = value;
+                found |= 2 << (c * 3);
+            }
+            else if (0 == strcmp(field, "epoch_cycles") &&
+                     (value >= 0) && (value <= MPF_LATENCY_QOS_MAX_EPOCH_CYCLES))
+            {
+                params->chan[c].epoch_cycles = value;
+                found |= 4 << (c * 3);
+            }
+            else
+            {
+                r = FPGA_INVALID_PARAM;
+            }
+        }
+        else
+        {
+            r = FPGA_INVALID_PARAM;
+        }
+    }
+
+    fclose(f);
+
+    if ((FPGA_OK == r) && (found != 077)) r = FPGA_INVALID_PARAM;
     return r;
 }
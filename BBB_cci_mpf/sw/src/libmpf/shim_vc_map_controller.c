@@ -0,0 +1,519 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file shim_vc_map_controller.c
+ * \brief Closed-loop control of the VC Map fixed VL0 ratio
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opae/mpf/mpf.h>
+#include "mpf_internal.h"
+
+
+#define VC_MAP_CTRL_DEFAULT_PERIOD_US 100000
+#define VC_MAP_CTRL_DEFAULT_STEP 4
+#define VC_MAP_CTRL_DEFAULT_HYSTERESIS 0.03
+#define VC_MAP_CTRL_DEFAULT_PROBE_INTERVAL 50
+#define VC_MAP_CTRL_DEFAULT_MIN_LINES 4096
+
+// Longest sleep between checks for a stop request
+#define VC_MAP_CTRL_MAX_SLEEP_US 10000
+
+// Periods to wait for a new ratio to appear in the mapping history
+// before measuring anyway
+#define VC_MAP_CTRL_MAX_SETTLE_PERIODS 4
+
+// Weight of each new period in the smoothed held bandwidth
+#define VC_MAP_CTRL_HELD_BW_WEIGHT 0.25
+
+
+struct _mpf_vc_map_controller
+{
+    _mpf_handle_p _mpf_handle;
+    mpf_vc_map_controller_config config;
+
+    mpf_os_thread_handle thread;
+    int64_t stop;
+
+    // Published state, protected by mutex
+    mpf_os_mutex_handle mutex;
+    mpf_vc_map_controller_state pub;
+
+    // Working state.  Used only by the controller thread.
+    mpf_vc_map_controller_state s;
+    bool log;
+    bool probing;
+    bool have_held_bw;
+    // +1 or -1
+    int32_t direction;
+    // Probes that failed since the held ratio last changed
+    uint32_t failed_probes;
+    uint32_t hold_periods;
+    // Has a period completed with the current ratio in the hardware?
+    bool settled;
+    uint32_t settle_periods;
+
+    // Counters at the start of the current period
+    uint64_t prev_vl0_lines;
+    uint64_t prev_vh_lines;
+    uint64_t prev_ns;
+};
+
+typedef struct _mpf_vc_map_controller* _mpf_vc_map_controller_p;
+
+
+__MPF_API__ const char* mpfVcMapControllerDecisionStr(
+    mpf_vc_map_controller_decision decision
+)
+{
+    switch (decision)
+    {
+      case MPF_VC_MAP_CTRL_NONE:   return "none";
+      case MPF_VC_MAP_CTRL_IDLE:   return "idle";
+      case MPF_VC_MAP_CTRL_SETTLE: return "settle";
+      case MPF_VC_MAP_CTRL_HOLD:   return "hold";
+      case MPF_VC_MAP_CTRL_PROBE:  return "probe";
+      case MPF_VC_MAP_CTRL_ACCEPT: return "accept";
+      case MPF_VC_MAP_CTRL_REVERT: return "revert";
+      default:                     return "unknown";
+    }
+}
+
+
+//
+// Ratio currently in the hardware, from the low byte of the mapping
+// history.  Bit 6 is set for 64/64ths.
+//
+static uint32_t historyRatio(
+    uint64_t history
+)
+{
+    return (history & 0x40) ? 64 : (history & 0x3f);
+}
+
+
+static void ctrlSetRatio(
+    _mpf_vc_map_controller_p ctrl,
+    uint32_t ratio
+)
+{
+    mpfVcMapSetFixedMapping(ctrl->_mpf_handle, true, ratio);
+    ctrl->s.ratio = ratio;
+    ctrl->settled = false;
+    ctrl->settle_periods = 0;
+}
+
+
+//
+// Pick the next ratio to probe from the held ratio.  Returns false if
+// the range allows no move in either direction.
+//
+static bool ctrlProbeTarget(
+    _mpf_vc_map_controller_p ctrl,
+    uint32_t* target
+)
+{
+    const mpf_vc_map_controller_config* c = &ctrl->config;
+    uint32_t held = ctrl->s.held_ratio;
+
+    for (int tries = 0; tries < 2; tries++)
+    {
+        if ((ctrl->direction > 0) && (held < c->max_ratio))
+        {
+            *target = (held + c->step < c->max_ratio) ? held + c->step : c->max_ratio;
+            return true;
+        }
+
+        if ((ctrl->direction < 0) && (held > c->min_ratio))
+        {
+            *target = (held > c->min_ratio + c->step) ? held - c->step : c->min_ratio;
+            return true;
+        }
+
+        ctrl->direction = -ctrl->direction;
+    }
+
+    return false;
+}
+
+
+// Returns true if a probe started
+static bool ctrlStartProbe(
+    _mpf_vc_map_controller_p ctrl
+)
+{
+    uint32_t target;
+
+    ctrl->hold_periods = 0;
+    if (! ctrlProbeTarget(ctrl, &target)) return false;
+
+    ctrl->probing = true;
+    ctrl->s.num_probes += 1;
+    ctrlSetRatio(ctrl, target);
+
+    return true;
+}
+
+
+//
+// One decision period.  bw is the delivered bandwidth at the ratio now
+// in the hardware.
+//
+static mpf_vc_map_controller_decision ctrlDecide(
+    _mpf_vc_map_controller_p ctrl,
+    double bw
+)
+{
+    mpf_vc_map_controller_state* s = &ctrl->s;
+    double hyst = ctrl->config.hysteresis;
+
+    if (! ctrl->have_held_bw)
+    {
+        // First measurement of the starting ratio
+        ctrl->have_held_bw = true;
+        s->held_bw_lines_per_sec = bw;
+        return ctrlStartProbe(ctrl) ? MPF_VC_MAP_CTRL_PROBE : MPF_VC_MAP_CTRL_HOLD;
+    }
+
+    if (ctrl->probing)
+    {
+        ctrl->probing = false;
+
+        if (bw > s->held_bw_lines_per_sec * (1.0 + hyst))
+        {
+            // Better.  Hold the new ratio and keep moving the same way.
+            // The other way leads back to the old ratio, which is known
+            // to be worse, so a failure in this direction ends the search.
+            s->held_ratio = s->ratio;
+            s->held_bw_lines_per_sec = bw;
+            s->num_accepts += 1;
+            ctrl->failed_probes = 1;
+
+            ctrlStartProbe(ctrl);
+            return MPF_VC_MAP_CTRL_ACCEPT;
+        }
+
+        s->num_reverts += 1;
+        ctrl->failed_probes += 1;
+        ctrl->direction = -ctrl->direction;
+        ctrlSetRatio(ctrl, s->held_ratio);
+        ctrl->hold_periods = 0;
+
+        // Try the other side once before settling on the held ratio
+        if (ctrl->failed_probes == 1)
+        {
+            ctrlStartProbe(ctrl);
+        }
+
+        return MPF_VC_MAP_CTRL_REVERT;
+    }
+
+    double held_bw = s->held_bw_lines_per_sec;
+
+    if ((bw > held_bw * (1.0 + hyst)) || (bw < held_bw * (1.0 - hyst)))
+    {
+        // The traffic mix changed.  The held ratio may no longer be best.
+        s->num_traffic_shifts += 1;
+        s->held_bw_lines_per_sec = bw;
+        ctrl->failed_probes = 0;
+        return ctrlStartProbe(ctrl) ? MPF_VC_MAP_CTRL_PROBE : MPF_VC_MAP_CTRL_HOLD;
+    }
+
+    s->held_bw_lines_per_sec = held_bw +
+        VC_MAP_CTRL_HELD_BW_WEIGHT * (bw - held_bw);
+
+    ctrl->hold_periods += 1;
+    if (ctrl->hold_periods >= ctrl->config.probe_interval)
+    {
+        ctrl->failed_probes = 0;
+        if (ctrlStartProbe(ctrl)) return MPF_VC_MAP_CTRL_PROBE;
+    }
+
+    return MPF_VC_MAP_CTRL_HOLD;
+}
+
+
+static void ctrlPeriod(
+    _mpf_vc_map_controller_p ctrl
+)
+{
+    mpf_vc_map_controller_state* s = &ctrl->s;
+    uint64_t vl0_lines, vh_lines;
+
+    ctrl->config.read_lines(ctrl->config.read_lines_ctx, &vl0_lines, &vh_lines);
+    uint64_t now = mpfOsGetTimeNs();
+    s->mapping_history = mpfVcMapGetMappingHistory(ctrl->_mpf_handle);
+
+    uint64_t d_vl0 = vl0_lines - ctrl->prev_vl0_lines;
+    uint64_t d_vh = vh_lines - ctrl->prev_vh_lines;
+    uint64_t dt = now - ctrl->prev_ns;
+
+    ctrl->prev_vl0_lines = vl0_lines;
+    ctrl->prev_vh_lines = vh_lines;
+    ctrl->prev_ns = now;
+
+    s->num_periods += 1;
+    s->bw_lines_per_sec = dt ? (double)(d_vl0 + d_vh) * 1e9 / (double)dt : 0;
+    s->vl0_fraction = (d_vl0 + d_vh) ? (double)d_vl0 / (double)(d_vl0 + d_vh) : 0;
+
+    uint32_t prev_ratio = s->ratio;
+    mpf_vc_map_controller_decision decision;
+
+    if (! ctrl->settled)
+    {
+        // The period in which the ratio changed mixes old and new
+        // mappings.  Skip periods until one starts after the hardware
+        // reports the new ratio.
+        ctrl->settle_periods += 1;
+        ctrl->settled = (historyRatio(s->mapping_history) == s->ratio) ||
+                        (ctrl->settle_periods >= VC_MAP_CTRL_MAX_SETTLE_PERIODS);
+        decision = MPF_VC_MAP_CTRL_SETTLE;
+    }
+    else if ((d_vl0 + d_vh) < ctrl->config.min_lines)
+    {
+        s->num_idle_periods += 1;
+        decision = MPF_VC_MAP_CTRL_IDLE;
+    }
+    else
+    {
+        decision = ctrlDecide(ctrl, s->bw_lines_per_sec);
+    }
+
+    // Log changes, not every period spent holding or idle
+    if (ctrl->log && (decision != MPF_VC_MAP_CTRL_SETTLE) &&
+        ((decision != s->last_decision) || (s->ratio != prev_ratio)))
+    {
+        MPF_FPGA_MSG("VC Map controller: %s, ratio %d -> %d, held %d, "
+                     "bw %.0f lines/s (held %.0f), VL0 %.1f%%",
+                     mpfVcMapControllerDecisionStr(decision),
+                     prev_ratio, s->ratio, s->held_ratio,
+                     s->bw_lines_per_sec, s->held_bw_lines_per_sec,
+                     100.0 * s->vl0_fraction);
+    }
+
+    s->last_decision = decision;
+
+    mpfOsLockMutex(ctrl->mutex);
+    ctrl->pub = *s;
+    mpfOsUnlockMutex(ctrl->mutex);
+}
+
+
+static void ctrlThread(void* arg)
+{
+    _mpf_vc_map_controller_p ctrl = (_mpf_vc_map_controller_p)arg;
+    uint64_t period_ns = ctrl->config.period_us * 1000;
+    uint64_t deadline = ctrl->prev_ns + period_ns;
+
+    while (! mpfOsAtomicLoad64(&ctrl->stop))
+    {
+        uint64_t now = mpfOsGetTimeNs();
+        if (now < deadline)
+        {
+            uint64_t sleep_us = (deadline - now + 999) / 1000;
+            if (sleep_us > VC_MAP_CTRL_MAX_SLEEP_US)
+            {
+                sleep_us = VC_MAP_CTRL_MAX_SLEEP_US;
+            }
+
+            mpfOsSleepUs(sleep_us);
+            continue;
+        }
+
+        ctrlPeriod(ctrl);
+
+        deadline += period_ns;
+        if (deadline < now)
+        {
+            deadline = now + period_ns;
+        }
+    }
+}
+
+
+//
+// Start a controller.  Called with vc_map_controller_mutex held.
+//
+static fpga_result ctrlStart(
+    mpf_handle_t mpf_handle,
+    const mpf_vc_map_controller_config* config
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    _mpf_vc_map_controller_p ctrl;
+    fpga_result r;
+
+    if (! mpfShimPresent(mpf_handle, CCI_MPF_SHIM_VC_MAP)) return FPGA_NOT_SUPPORTED;
+    if (NULL != _mpf_handle->vc_map_controller) return FPGA_BUSY;
+    if ((NULL == config) || (NULL == config->read_lines)) return FPGA_INVALID_PARAM;
+
+    ctrl = malloc(sizeof(struct _mpf_vc_map_controller));
+    if (NULL == ctrl) return FPGA_NO_MEMORY;
+    memset(ctrl, 0, sizeof(*ctrl));
+
+    ctrl->_mpf_handle = _mpf_handle;
+    ctrl->config = *config;
+
+    mpf_vc_map_controller_config* c = &ctrl->config;
+    if (0 == c->period_us) c->period_us = VC_MAP_CTRL_DEFAULT_PERIOD_US;
+    if (0 == c->max_ratio) c->max_ratio = 64;
+    if (0 == c->step) c->step = VC_MAP_CTRL_DEFAULT_STEP;
+    if (0 == c->hysteresis) c->hysteresis = VC_MAP_CTRL_DEFAULT_HYSTERESIS;
+    if (0 == c->probe_interval) c->probe_interval = VC_MAP_CTRL_DEFAULT_PROBE_INTERVAL;
+    if (0 == c->min_lines) c->min_lines = VC_MAP_CTRL_DEFAULT_MIN_LINES;
+
+    if ((c->max_ratio > 64) || (c->min_ratio > c->max_ratio) ||
+        (c->initial_ratio > 64) || (c->initial_ratio < -1) ||
+        (c->hysteresis < 0) || (c->hysteresis >= 1))
+    {
+        free(ctrl);
+        return FPGA_INVALID_PARAM;
+    }
+
+    ctrl->log = c->log_decisions || _mpf_handle->dbg_mode;
+    ctrl->direction = 1;
+
+    uint32_t ratio = (c->initial_ratio >= 0) ?
+                         (uint32_t)c->initial_ratio :
+                         historyRatio(mpfVcMapGetMappingHistory(mpf_handle));
+    if (ratio < c->min_ratio) ratio = c->min_ratio;
+    if (ratio > c->max_ratio) ratio = c->max_ratio;
+
+    r = mpfOsPrepareMutex(&ctrl->mutex);
+    if (FPGA_OK != r)
+    {
+        free(ctrl);
+        return r;
+    }
+
+    // The first period starts now, at the initial ratio
+    ctrl->s.held_ratio = ratio;
+    ctrlSetRatio(ctrl, ratio);
+    ctrl->pub = ctrl->s;
+
+    c->read_lines(c->read_lines_ctx, &ctrl->prev_vl0_lines, &ctrl->prev_vh_lines);
+    ctrl->prev_ns = mpfOsGetTimeNs();
+
+    if (ctrl->log)
+    {
+        MPF_FPGA_MSG("VC Map controller: start, ratio %d, range %d-%d",
+                     ratio, c->min_ratio, c->max_ratio);
+    }
+
+    r = mpfOsCreateThread(ctrlThread, ctrl, &ctrl->thread);
+    if (FPGA_OK != r)
+    {
+        mpfOsReleaseMutex(ctrl->mutex);
+        free(ctrl);
+        return r;
+    }
+
+    _mpf_handle->vc_map_controller = ctrl;
+
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfVcMapControllerStart(
+    mpf_handle_t mpf_handle,
+    const mpf_vc_map_controller_config* config
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    fpga_result r;
+
+    mpfOsLockMutex(_mpf_handle->vc_map_controller_mutex);
+    r = ctrlStart(mpf_handle, config);
+    mpfOsUnlockMutex(_mpf_handle->vc_map_controller_mutex);
+
+    return r;
+}
+
+
+fpga_result __MPF_API__ mpfVcMapControllerStop(
+    mpf_handle_t mpf_handle
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    _mpf_vc_map_controller_p ctrl;
+
+    // Detach the controller first.  Once the handle's mutex is released
+    // no mpfVcMapControllerGetState() can reach it, so it may be freed.
+    mpfOsLockMutex(_mpf_handle->vc_map_controller_mutex);
+    ctrl = _mpf_handle->vc_map_controller;
+    _mpf_handle->vc_map_controller = NULL;
+    mpfOsUnlockMutex(_mpf_handle->vc_map_controller_mutex);
+
+    if (NULL == ctrl) return FPGA_NOT_FOUND;
+
+    mpfOsAtomicStore64(&ctrl->stop, 1);
+    mpfOsJoinThread(ctrl->thread);
+
+    if (ctrl->log)
+    {
+        MPF_FPGA_MSG("VC Map controller: stop, ratio %d", ctrl->s.ratio);
+    }
+
+    mpfOsReleaseMutex(ctrl->mutex);
+    free(ctrl);
+
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfVcMapControllerGetState(
+    mpf_handle_t mpf_handle,
+    mpf_vc_map_controller_state* state
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    _mpf_vc_map_controller_p ctrl;
+    fpga_result r = FPGA_NOT_FOUND;
+
+    // Holding the handle's mutex keeps mpfVcMapControllerStop() from
+    // freeing the controller during the copy.
+    mpfOsLockMutex(_mpf_handle->vc_map_controller_mutex);
+
+    ctrl = _mpf_handle->vc_map_controller;
+    if (NULL != ctrl)
+    {
+        mpfOsLockMutex(ctrl->mutex);
+        *state = ctrl->pub;
+        mpfOsUnlockMutex(ctrl->mutex);
+        r = FPGA_OK;
+    }
+
+    mpfOsUnlockMutex(_mpf_handle->vc_map_controller_mutex);
+
+    return r;
+}
@@ -42,6 +42,7 @@
 #include "mpf_internal.h"
 
 static const size_t CCI_MPF_VTP_LARGE_PAGE_THRESHOLD = (128*1024);
+static const size_t CCI_MPF_VTP_HUGE_PAGE_THRESHOLD = (1024*1024*1024);
 
 
 // ========================================================================
@@ -50,6 +51,25 @@ static const size_t CCI_MPF_VTP_LARGE_PAGE_THRESHOLD = (128*1024);
 //
 // ========================================================================
 
+//
+// Printable page size for debugging messages.
+//
+static const char* pageSizeName(
+    mpf_vtp_page_size page_size
+)
+{
+    switch (page_size)
+    {
+      case MPF_VTP_PAGE_1GB:
+        return "1GB";
+      case MPF_VTP_PAGE_2MB:
+        return "2MB";
+      default:
+        return "4KB";
+    }
+}
+
+
 //
 // Turn the FPGA side on.
 //
@@ -63,22 +83,27 @@ static fpga_result vtpEnable(
                     CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_PAGE_TABLE_PADDR,
                     mpfVtpPtGetPageTableRootPA(_mpf_handle->vtp.pt) / CL(1));
 
-    // Enable VTP
-    r = mpfWriteCsr(_mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_MODE, 1);
+    // Enable VTP.  When lazy buffers exist, failed translations wait
+    // for the service thread instead of halting the FPGA.
+    uint64_t mode = 1;
+    if (_mpf_handle->vtp.lazy_enabled) mode |= 4;
+
+    r = mpfWriteCsr(_mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_MODE, mode);
     return r;
 }
 
 
 //
-// Allocate page of size page_size to virtual address va and add entry to VTP
-// page table
+// Pin a page of size page_size at virtual address va, sharing it with
+// the FPGA.  The translation is returned in mapping but is not yet added
+// to the page table.
 //
-static fpga_result allocateAndInsertPage(
+static fpga_result pinPage(
     _mpf_handle_p _mpf_handle,
     mpf_vtp_pt_vaddr va,
     mpf_vtp_page_size page_size,
-    uint32_t flags,
-    bool speculative
+    bool speculative,
+    mpf_vtp_pt_mapping* mapping
 )
 {
     fpga_result r;
@@ -110,13 +135,13 @@ static fpga_result allocateAndInsertPage(
         fpga_flags |= FPGA_BUF_QUIET;
     }
 
-    r = fpgaPrepareBuffer(_mpf_handle->handle, page_bytes, &va, &wsid, fpga_flags);
+    r = mpfDevPrepareBuffer(_mpf_handle, page_bytes, &va, &wsid, fpga_flags);
     if (FPGA_OK != r)
     {
         if (_mpf_handle->dbg_mode)
         {
             MPF_FPGA_MSG("FAILED allocating %s page VA %p, status %d",
-                         (page_size == MPF_VTP_PAGE_2MB ? "2MB" : "4KB"),
+                         pageSizeName(page_size),
                          alloc_va, r);
         }
 
@@ -129,7 +154,7 @@ static fpga_result allocateAndInsertPage(
         if (_mpf_handle->dbg_mode)
         {
             MPF_FPGA_MSG("FAILED allocating %s page VA %p -- at %p instead of requested address",
-                         (page_size == MPF_VTP_PAGE_2MB ? "2MB" : "4KB"),
+                         pageSizeName(page_size),
                          alloc_va, va);
         }
 
@@ -138,19 +163,165 @@ static fpga_result allocateAndInsertPage(
 
     // Get the physical address of the buffer
     mpf_vtp_pt_paddr alloc_pa;
-    r = fpgaGetIOAddress(_mpf_handle->handle, wsid, &alloc_pa);
-    if (FPGA_OK != r) return r;
+    r = mpfDevGetIOAddress(_mpf_handle, wsid, &alloc_pa);
+    if (FPGA_OK != r)
+    {
+        mpfDevReleaseBuffer(_mpf_handle, wsid);
+        return r;
+    }
 
     if (_mpf_handle->dbg_mode)
     {
         MPF_FPGA_MSG("allocate %s page VA %p, PA 0x%" PRIx64 ", wsid 0x%" PRIx64,
-                     (page_size == MPF_VTP_PAGE_2MB ? "2MB" : "4KB"),
+                     pageSizeName(page_size),
                      alloc_va, alloc_pa, wsid);
     }
 
-    // Insert VTP page table entry
-    r = mpfVtpPtInsertPageMapping(_mpf_handle->vtp.pt,
-                                  alloc_va, alloc_pa, wsid, page_size, flags);
+    mapping->va = alloc_va;
+    mapping->pa = alloc_pa;
+    mapping->wsid = wsid;
+    mapping->size = page_size;
+    mapping->flags = 0;
+
+    return FPGA_OK;
+}
+
+
+//
+// Pin an entire region with a single driver call.  The driver returns
+// a single IOVA for the region, so the region is contiguous in the FPGA's
+// address space no matter how the underlying physical pages are laid out.
+// Old drivers or drivers without an IOMMU may refuse large regions.
+// The request is quiet since the caller falls back to pinning pages
+// one at a time.
+//
+static fpga_result pinRegion(
+    _mpf_handle_p _mpf_handle,
+    mpf_vtp_pt_vaddr va,
+    size_t len,
+    mpf_vtp_pt_paddr* pa,
+    uint64_t* wsid
+)
+{
+    fpga_result r;
+    mpf_vtp_pt_vaddr alloc_va = va;
+
+    // Only the FPGA_BUF_PREALLOCATED protocol can pin memory that is
+    // already mapped.
+    if (! _mpf_handle->vtp.use_fpga_buf_preallocated) return FPGA_NOT_SUPPORTED;
+
+    r = mpfDevPrepareBuffer(_mpf_handle, len, &alloc_va, wsid,
+                            FPGA_BUF_PREALLOCATED | FPGA_BUF_QUIET);
+    if (FPGA_OK != r) return r;
+
+    r = mpfDevGetIOAddress(_mpf_handle, *wsid, pa);
+    if ((FPGA_OK != r) || (alloc_va != va))
+    {
+        mpfDevReleaseBuffer(_mpf_handle, *wsid);
+        return FPGA_NO_MEMORY;
+    }
+
+    if (_mpf_handle->dbg_mode)
+    {
+        MPF_FPGA_MSG("pinned region VA %p, 0x%zx bytes, PA 0x%" PRIx64 ", wsid 0x%" PRIx64,
+                     va, len, *pa, *wsid);
+    }
+
+    return FPGA_OK;
+}
+
+
+//
+// Page translations are collected in batches and added to the page table
+// as a group.
+//
+#define VTP_MAPPING_BATCH_SIZE 512
+
+typedef struct
+{
+    uint32_t n;
+    mpf_vtp_pt_mapping m[VTP_MAPPING_BATCH_SIZE];
+
+    // Address following the last page added to the page table
+    mpf_vtp_pt_vaddr inserted_end;
+
+    // When defer is set, flushing moves translations to the deferred list
+    // instead of the page table.  Parallel population workers collect
+    // translations this way and they are merged into the table later.
+    bool defer;
+    mpf_vtp_pt_mapping* deferred;
+    size_t n_deferred;
+    size_t max_deferred;
+}
+vtp_mapping_batch;
+
+
+static void initMappingBatch(
+    vtp_mapping_batch* batch,
+    mpf_vtp_pt_vaddr start,
+    bool defer
+)
+{
+    batch->n = 0;
+    batch->inserted_end = start;
+    batch->defer = defer;
+    batch->deferred = NULL;
+    batch->n_deferred = 0;
+    batch->max_deferred = 0;
+}
+
+
+//
+// Move all pending translations in a batch to its deferred list.  On
+// failure the translations are left in the batch.
+//
+static fpga_result deferMappingBatch(
+    vtp_mapping_batch* batch
+)
+{
+    if (batch->n_deferred + batch->n > batch->max_deferred)
+    {
+        size_t max_deferred = 2 * batch->max_deferred + VTP_MAPPING_BATCH_SIZE;
+        mpf_vtp_pt_mapping* deferred =
+            realloc(batch->deferred, max_deferred * sizeof(mpf_vtp_pt_mapping));
+        if (NULL == deferred) return FPGA_NO_MEMORY;
+
+        batch->deferred = deferred;
+        batch->max_deferred = max_deferred;
+    }
+
+    memcpy(&batch->deferred[batch->n_deferred], batch->m,
+           batch->n * sizeof(mpf_vtp_pt_mapping));
+    batch->n_deferred += batch->n;
+    batch->n = 0;
+
+    return FPGA_OK;
+}
+
+
+//
+// Add all pending translations in a batch to the page table.
+//
+static fpga_result flushMappingBatch(
+    _mpf_handle_p _mpf_handle,
+    vtp_mapping_batch* batch
+)
+{
+    fpga_result r;
+    uint32_t n_inserted;
+
+    if (0 == batch->n) return FPGA_OK;
+    if (batch->defer) return deferMappingBatch(batch);
+
+    r = mpfVtpPtInsertPageMappings(_mpf_handle->vtp.pt, batch->m, batch->n,
+                                   &n_inserted);
+
+    if (n_inserted)
+    {
+        const mpf_vtp_pt_mapping* last = &batch->m[n_inserted - 1];
+        batch->inserted_end = (char*)last->va + mpfPageSizeEnumToBytes(last->size);
+    }
+
     if (FPGA_OK != r)
     {
         if (_mpf_handle->dbg_mode)
@@ -158,12 +329,1143 @@ static fpga_result allocateAndInsertPage(
             MPF_FPGA_MSG("FAILED inserting page mapping, status %d", r);
         }
 
-        fpgaReleaseBuffer(_mpf_handle->handle, wsid);
+        // Pages that didn't make it into the table are released here.
+        // Pages in the table are released by the caller.
+        for (uint32_t i = n_inserted; i < batch->n; i++)
+        {
+            if (0 == (batch->m[i].flags & MPF_VTP_PT_FLAG_WSID_SHARED))
+            {
+                mpfDevReleaseBuffer(_mpf_handle, batch->m[i].wsid);
+            }
+        }
+    }
+
+    batch->n = 0;
+    return r;
+}
+
+
+static fpga_result addMappingToBatch(
+    _mpf_handle_p _mpf_handle,
+    vtp_mapping_batch* batch,
+    const mpf_vtp_pt_mapping* mapping
+)
+{
+    batch->m[batch->n++] = *mapping;
+
+    if (VTP_MAPPING_BATCH_SIZE == batch->n)
+    {
+        return flushMappingBatch(_mpf_handle, batch);
+    }
+
+    return FPGA_OK;
+}
+
+
+//
+// Try to pin a region with a single driver call and add all its pages
+// to the page table.  Returns FPGA_NOT_SUPPORTED without side effects
+// when the region must be pinned page by page.  pt_flags are set on the
+// first page and pt_end_flags on the last.
+//
+static fpga_result addRegionBulk(
+    _mpf_handle_p _mpf_handle,
+    vtp_mapping_batch* batch,
+    uint8_t* buf,
+    size_t len,
+    uint32_t pt_flags,
+    uint32_t pt_end_flags
+)
+{
+    fpga_result r;
+    mpf_vtp_pt_paddr region_pa;
+    uint64_t wsid;
+
+    const size_t page_bytes_4kb = mpfPageSizeEnumToBytes(MPF_VTP_PAGE_4KB);
+    const size_t page_bytes_2mb = mpfPageSizeEnumToBytes(MPF_VTP_PAGE_2MB);
+    const size_t page_mask_2mb = page_bytes_2mb - 1;
+    const size_t page_mask_1gb = mpfPageSizeEnumToBytes(MPF_VTP_PAGE_1GB) - 1;
+    const bool allow_2mb =
+        (MPF_VTP_PAGE_2MB <= _mpf_handle->vtp.max_physical_page_size);
+    const bool allow_1gb =
+        (MPF_VTP_PAGE_1GB <= _mpf_handle->vtp.max_physical_page_size);
+
+    // Nothing to gain for a single page
+    if (len <= page_bytes_4kb) return FPGA_NOT_SUPPORTED;
+
+    r = pinRegion(_mpf_handle, buf, len, &region_pa, &wsid);
+    if (FPGA_OK != r) return FPGA_NOT_SUPPORTED;
+
+    // Is there a 2MB aligned span in the region?  If so, the IOVA must be
+    // aligned the same way as the VA or the FPGA would be limited to 4KB
+    // translations.  Pinning page by page is better in that case.
+    size_t first_2mb = ((size_t)buf + page_mask_2mb) & ~page_mask_2mb;
+    bool has_2mb_span = allow_2mb &&
+                        (first_2mb + page_bytes_2mb <= (size_t)buf + len);
+    if (has_2mb_span && (((size_t)buf ^ region_pa) & page_mask_2mb))
+    {
+        if (_mpf_handle->dbg_mode)
+        {
+            MPF_FPGA_MSG("region PA 0x%" PRIx64 " alignment doesn't match VA %p, pinning pages individually",
+                         region_pa, buf);
+        }
+
+        mpfDevReleaseBuffer(_mpf_handle, wsid);
+        return FPGA_NOT_SUPPORTED;
+    }
+
+    // 1GB pages are used only where the IOVA shares the VA's 1GB alignment.
+    bool use_1gb = allow_1gb && (0 == (((size_t)buf ^ region_pa) & page_mask_1gb));
+
+    // Carve the region into the largest pages permitted by alignment.
+    // All pages share the region's wsid.
+    size_t offset = 0;
+    while (offset < len)
+    {
+        mpf_vtp_pt_mapping m;
+        m.va = buf + offset;
+        m.pa = region_pa + offset;
+        m.wsid = wsid;
+        m.size = MPF_VTP_PAGE_4KB;
+        m.flags = pt_flags;
+
+        if (use_1gb && (0 == ((size_t)m.va & page_mask_1gb)) &&
+            (len - offset > page_mask_1gb))
+        {
+            m.size = MPF_VTP_PAGE_1GB;
+        }
+        else if (allow_2mb && (0 == ((size_t)m.va & page_mask_2mb)) &&
+                 (len - offset >= page_bytes_2mb))
+        {
+            m.size = MPF_VTP_PAGE_2MB;
+        }
+
+        offset += mpfPageSizeEnumToBytes(m.size);
+        if (offset == len)
+        {
+            m.flags |= pt_end_flags;
+        }
+
+        r = addMappingToBatch(_mpf_handle, batch, &m);
+        if (FPGA_OK != r) return r;
+
+        pt_flags = MPF_VTP_PT_FLAG_WSID_SHARED;
+    }
+
+    return FPGA_OK;
+}
+
+
+//
+// Pin a region one page at a time and add the pages to the page table.
+// pt_flags are set on the first page and pt_end_flags on the last.
+//
+static fpga_result addRegionByPage(
+    _mpf_handle_p _mpf_handle,
+    vtp_mapping_batch* batch,
+    uint8_t* page,
+    size_t len,
+    mpf_vtp_page_size page_size,
+    uint32_t pt_flags,
+    uint32_t pt_end_flags
+)
+{
+    fpga_result r;
+
+    // Big page sizes to try, largest first
+    static const mpf_vtp_page_size big_pages[] = { MPF_VTP_PAGE_1GB,
+                                                   MPF_VTP_PAGE_2MB };
+
+    while (len)
+    {
+        mpf_vtp_pt_mapping m;
+        r = FPGA_NO_MEMORY;
+
+        // Speculatively request a big page even if in a smaller page
+        // allocation when the virtual page is aligned to the big page and
+        // is large enough.  We do this even when the page is preallocated,
+        // thus discovering when a huge preallocated page is passed in.
+        for (int i = 0; (FPGA_OK != r) && (i < 2); i++)
+        {
+            mpf_vtp_page_size big_size = big_pages[i];
+            size_t big_mask = mpfPageSizeEnumToBytes(big_size) - 1;
+
+            if ((0 == ((size_t)page & big_mask)) && (len > big_mask) &&
+                (big_size <= _mpf_handle->vtp.max_physical_page_size))
+            {
+                // Try for a big page
+                bool speculative = (page_size != big_size);
+                r = pinPage(_mpf_handle, page, big_size, speculative, &m);
+
+                if ((FPGA_OK != r) && ! speculative) return r;
+            }
+        }
+
+        if (FPGA_OK != r)
+        {
+            // The page isn't aligned to a big page or the big page failed.
+            // Use small pages.
+            r = pinPage(_mpf_handle, page, page_size, false, &m);
+            if (FPGA_OK != r) return r;
+        }
+
+        size_t this_page_bytes = mpfPageSizeEnumToBytes(m.size);
+
+        // Tag the first and last pages in the group
+        m.flags = pt_flags;
+        if (len == this_page_bytes)
+        {
+            m.flags |= pt_end_flags;
+        }
+
+        r = addMappingToBatch(_mpf_handle, batch, &m);
+        if (FPGA_OK != r) return r;
+
+        pt_flags = 0;
+        page += this_page_bytes;
+        len -= this_page_bytes;
+    }
+
+    return FPGA_OK;
+}
+
+
+//
+// Invalidations of FPGA-side translations are collected in batches so that
+// a range can be invalidated with as few MMIO writes as possible.  Each
+// write to CCI_MPF_VTP_CSR_INVAL_PAGE_VADDR clears the sets holding the
+// address in both the 4KB and 2MB TLBs, so 2MB and 1GB pages need only one
+// write per 2MB region.  When a batch would need more writes than
+// VTP_INVAL_BATCH_SIZE, the whole FPGA-side TLB is flushed instead.  With
+// the default TLB geometry, that many 4KB page writes would clear every
+// set of the 4KB TLB anyway.
+//
+#define VTP_INVAL_BATCH_SIZE 512
+
+typedef struct
+{
+    bool flush_all;
+    uint32_t n;
+    mpf_vtp_pt_vaddr va[VTP_INVAL_BATCH_SIZE];
+}
+vtp_inval_batch;
+
+
+//
+// Add the FPGA TLB entries covering [va, va + len) of pages of the given
+// size to an invalidation batch.
+//
+static void invalBatchAdd(
+    vtp_inval_batch* batch,
+    mpf_vtp_pt_vaddr va,
+    size_t len,
+    mpf_vtp_page_size size
+)
+{
+    // The FPGA has no 1GB TLB.  1GB pages are held in 2MB entries.
+    if (size > MPF_VTP_PAGE_2MB) size = MPF_VTP_PAGE_2MB;
+    size_t entry_mask = mpfPageSizeEnumToBytes(size) - 1;
+
+    char* entry = (char*)((size_t)va & ~entry_mask);
+    char* end = (char*)va + len;
+
+    while (! batch->flush_all && (entry < end))
+    {
+        if (batch->n == VTP_INVAL_BATCH_SIZE)
+        {
+            batch->flush_all = true;
+            break;
+        }
+
+        batch->va[batch->n++] = entry;
+        entry += entry_mask + 1;
+    }
+}
+
+
+//
+// Invalidate all translations in a batch and empty it.
+//
+static fpga_result invalBatchCommit(
+    _mpf_handle_p _mpf_handle,
+    vtp_inval_batch* batch
+)
+{
+    fpga_result r = FPGA_OK;
+
+    if (batch->flush_all)
+    {
+        if (_mpf_handle->dbg_mode)
+        {
+            MPF_FPGA_MSG("invalidate all FPGA translations");
+        }
+
+        r = mpfVtpInvalHWTLB(_mpf_handle);
+    }
+    else if (batch->n)
+    {
+        mpfVtpSwTlbInvalidate();
+
+        for (uint32_t i = 0; i < batch->n; i++)
+        {
+            r = mpfWriteCsr(_mpf_handle,
+                            CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_INVAL_PAGE_VADDR,
+                            // Convert VA to a line index
+                            (uint64_t)batch->va[i] / CL(1));
+            if (FPGA_OK != r) break;
+        }
+    }
+
+    batch->flush_all = false;
+    batch->n = 0;
+    return r;
+}
+
+
+//
+// Unpin a driver buffer and, when unmap is set, release its memory.
+// Regions of lazy buffers that were never pinned are only unmapped.
+//
+static void releasePinnedGroup(
+    _mpf_handle_p _mpf_handle,
+    uint64_t wsid,
+    mpf_vtp_pt_vaddr va,
+    size_t len,
+    bool pinned,
+    bool unmap
+)
+{
+    fpga_result r;
+
+    if (pinned)
+    {
+        // If the kernel deallocation fails just give up.  Something bad
+        // is bound to happen.
+        r = mpfDevReleaseBuffer(_mpf_handle, wsid);
+        assert(FPGA_OK == r);
+    }
+
+    if (unmap)
+    {
+        if (_mpf_handle->dbg_mode)
+        {
+            MPF_FPGA_MSG("unmapping VA %p, size 0x%zx", va, len);
+        }
+        mpfOsUnmapMemory(va, len);
+    }
+}
+
+
+//
+// Driver buffers whose pages have left the page table are released in
+// groups, after the FPGA-side TLB has been invalidated for all of them.
+//
+#define VTP_RELEASE_BATCH_SIZE 256
+
+typedef struct
+{
+    uint64_t wsid;
+    mpf_vtp_pt_vaddr va;
+    size_t len;
+    // False for lazy buffer placeholders, which have no driver buffer
+    bool pinned;
+}
+vtp_pinned_group;
+
+typedef struct
+{
+    vtp_inval_batch inval;
+
+    uint32_t n;
+    vtp_pinned_group group[VTP_RELEASE_BATCH_SIZE];
+}
+vtp_release_batch;
+
+
+static fpga_result releaseBatchCommit(
+    _mpf_handle_p _mpf_handle,
+    vtp_release_batch* batch,
+    bool unmap
+)
+{
+    fpga_result r = invalBatchCommit(_mpf_handle, &batch->inval);
+
+    for (uint32_t i = 0; i < batch->n; i++)
+    {
+        releasePinnedGroup(_mpf_handle, batch->group[i].wsid,
+                           batch->group[i].va, batch->group[i].len,
+                           batch->group[i].pinned, unmap);
+    }
+
+    batch->n = 0;
+    return r;
+}
+
+
+//
+// Remove pages from the page table, starting at va, and release them.
+// The walk ends after the page tagged MPF_VTP_PT_FLAG_ALLOC_END or, when
+// va_end is not NULL, at va_end.  Pages pinned together with a single
+// driver call are released once all of them have left the table and
+// the FPGA-side TLB no longer holds their translations.
+//
+static fpga_result releaseMappedPages(
+    _mpf_handle_p _mpf_handle,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_vaddr va_end,
+    bool unmap
+)
+{
+    fpga_result r = FPGA_OK;
+    mpf_vtp_pt_paddr pa;
+    mpf_vtp_page_size size;
+    uint32_t flags;
+    uint64_t wsid;
+
+    vtp_release_batch batch;
+    batch.inval.flush_all = false;
+    batch.inval.n = 0;
+    batch.n = 0;
+
+    // Driver buffer that will be released once all its pages are gone
+    bool group_valid = false;
+    vtp_pinned_group group = { 0, NULL, 0, false };
+
+    // Loop through the mapped virtual pages until the end of the region
+    // is reached or there is an error.
+    while ((NULL == va_end) || ((char*)va < (char*)va_end))
+    {
+        if (_mpf_handle->dbg_mode)
+        {
+            MPF_FPGA_MSG("lookup VA %p", va);
+        }
+
+        if (FPGA_OK != mpfVtpPtRemovePageMapping(_mpf_handle->vtp.pt, va,
+                                                 &pa, NULL, &wsid, &size, &flags))
+        {
+            if (_mpf_handle->dbg_mode)
+            {
+                MPF_FPGA_MSG("error unmapping VA %p", va);
+            }
+
+            r = FPGA_NO_MEMORY;
+            break;
+        }
+
+        if (_mpf_handle->dbg_mode)
+        {
+            MPF_FPGA_MSG("release %s page VA %p, PA 0x%" PRIx64 ", wsid 0x%" PRIx64,
+                         pageSizeName(size),
+                         va, pa, wsid);
+        }
+
+        // The FPGA never caches placeholders for unpinned lazy regions
+        size_t page_bytes = mpfPageSizeEnumToBytes(size);
+        bool pinned = (0 == (flags & MPF_VTP_PT_FLAG_INVALID));
+        if (pinned)
+        {
+            invalBatchAdd(&batch.inval, va, page_bytes, size);
+        }
+
+        if (0 == (flags & MPF_VTP_PT_FLAG_WSID_SHARED))
+        {
+            // First page of a new driver buffer.  The previous one can be
+            // released once the FPGA TLB is invalidated.
+            if (group_valid)
+            {
+                batch.group[batch.n++] = group;
+                if (batch.n == VTP_RELEASE_BATCH_SIZE)
+                {
+                    fpga_result r_inval = releaseBatchCommit(_mpf_handle, &batch, unmap);
+                    if (FPGA_OK == r) r = r_inval;
+                }
+            }
+
+            group_valid = true;
+            group.wsid = wsid;
+            group.va = va;
+            group.len = 0;
+            group.pinned = pinned;
+        }
+
+        group.len += page_bytes;
+
+        // Next page address
+        va = (char *) va + page_bytes;
+
+        // Done?
+        if (flags & MPF_VTP_PT_FLAG_ALLOC_END) break;
+    }
+
+    if (group_valid)
+    {
+        batch.group[batch.n++] = group;
+    }
+
+    fpga_result r_inval = releaseBatchCommit(_mpf_handle, &batch, unmap);
+    if (FPGA_OK == r) r = r_inval;
+
+    return r;
+}
+
+
+//
+// Undo a failed region insertion.  Pages pinned but not yet passed to the
+// page table, including deferred pages, hold their own wsids.
+// (flushMappingBatch() has already released any pages it failed to
+// insert.)  Pages from start to batch->inserted_end are in the page table
+// and are removed.
+//
+static void releaseMappingBatch(
+    _mpf_handle_p _mpf_handle,
+    vtp_mapping_batch* batch,
+    mpf_vtp_pt_vaddr start
+)
+{
+    for (uint32_t i = 0; i < batch->n; i++)
+    {
+        if (0 == (batch->m[i].flags & MPF_VTP_PT_FLAG_WSID_SHARED))
+        {
+            mpfDevReleaseBuffer(_mpf_handle, batch->m[i].wsid);
+        }
+    }
+    batch->n = 0;
+
+    for (size_t i = 0; i < batch->n_deferred; i++)
+    {
+        if (0 == (batch->deferred[i].flags & MPF_VTP_PT_FLAG_WSID_SHARED))
+        {
+            mpfDevReleaseBuffer(_mpf_handle, batch->deferred[i].wsid);
+        }
+    }
+    batch->n_deferred = 0;
+
+    // Drop pages already added to the page table
+    if (batch->inserted_end != start)
+    {
+        releaseMappedPages(_mpf_handle, start, batch->inserted_end, false);
+    }
+}
+
+
+//
+// Parallel population of large buffers.  The buffer is split into chunks,
+// one per worker thread, with boundaries aligned to the largest page VTP
+// may use.  Workers first fault in their chunks by writing to each page.
+// That is where the kernel spends most of the time for a large buffer,
+// zeroing pages and placing them according to the NUMA policy.  If the
+// driver can't then pin the whole buffer with a single call, workers pin
+// their chunks page by page into deferred batches.  The batches are merged
+// into the page table in address order once every worker has succeeded,
+// so a failed worker leaves nothing in the table to undo.
+//
+#define VTP_POPULATE_MAX_THREADS 64
+
+// Smallest chunk worth a thread
+#define VTP_POPULATE_MIN_CHUNK (64 * 1024 * 1024)
+
+typedef struct
+{
+    _mpf_handle_p _mpf_handle;
+    uint8_t* buf;
+    size_t len;
+    mpf_vtp_page_size page_size;
+    uint32_t pt_flags;
+    uint32_t pt_end_flags;
+
+    // Pin the chunk (true) or just fault it in (false)?
+    bool pin;
+    fpga_result r;
+    vtp_mapping_batch* batch;
+}
+vtp_populate_chunk;
+
+
+static void populateChunk(
+    void* arg
+)
+{
+    vtp_populate_chunk* c = (vtp_populate_chunk*)arg;
+
+    if (! c->pin)
+    {
+        const size_t page_bytes = mpfPageSizeEnumToBytes(c->page_size);
+        for (size_t offset = 0; offset < c->len; offset += page_bytes)
+        {
+            ((volatile uint8_t*)c->buf)[offset] = 0;
+        }
+
+        c->r = FPGA_OK;
+        return;
+    }
+
+    c->r = addRegionByPage(c->_mpf_handle, c->batch, c->buf, c->len,
+                           c->page_size, c->pt_flags, c->pt_end_flags);
+    if (FPGA_OK == c->r)
+    {
+        c->r = flushMappingBatch(c->_mpf_handle, c->batch);
+    }
+}
+
+
+//
+// Run one phase on every chunk.  The calling thread takes the last chunk,
+// along with any chunk whose thread couldn't be started.
+//
+static void populateRunPhase(
+    vtp_populate_chunk* chunks,
+    uint32_t n_chunks,
+    bool pin
+)
+{
+    mpf_os_thread_handle threads[VTP_POPULATE_MAX_THREADS];
+    bool started[VTP_POPULATE_MAX_THREADS];
+
+    for (uint32_t i = 0; i < n_chunks; i++)
+    {
+        chunks[i].pin = pin;
+    }
+
+    for (uint32_t i = 0; i < n_chunks - 1; i++)
+    {
+        started[i] = (FPGA_OK == mpfOsCreateThread(populateChunk, &chunks[i],
+                                                   &threads[i]));
+        if (! started[i]) populateChunk(&chunks[i]);
+    }
+
+    populateChunk(&chunks[n_chunks - 1]);
+
+    for (uint32_t i = 0; i < n_chunks - 1; i++)
+    {
+        if (started[i]) mpfOsJoinThread(threads[i]);
+    }
+}
+
+
+//
+// Populate and pin a region using the handle's populate threads and add
+// its pages to batch.  Returns FPGA_NOT_SUPPORTED without side effects
+// when the region is too small to split.  pt_flags are set on the first
+// page and pt_end_flags on the last.
+//
+static fpga_result addRegionParallel(
+    _mpf_handle_p _mpf_handle,
+    vtp_mapping_batch* batch,
+    uint8_t* buf,
+    size_t len,
+    mpf_vtp_page_size page_size,
+    uint32_t pt_flags,
+    uint32_t pt_end_flags
+)
+{
+    fpga_result r;
+    vtp_populate_chunk chunks[VTP_POPULATE_MAX_THREADS];
+    uint32_t n_chunks = 0;
+
+    uint32_t n_threads = _mpf_handle->vtp.populate_threads;
+    if (n_threads > VTP_POPULATE_MAX_THREADS)
+    {
+        n_threads = VTP_POPULATE_MAX_THREADS;
+    }
+
+    // No page may straddle two chunks
+    const size_t align_mask =
+        mpfPageSizeEnumToBytes(_mpf_handle->vtp.max_physical_page_size) - 1;
+
+    size_t chunk_bytes = len / n_threads;
+    if (chunk_bytes < VTP_POPULATE_MIN_CHUNK)
+    {
+        chunk_bytes = VTP_POPULATE_MIN_CHUNK;
+    }
+
+    uint8_t* start = buf;
+    uint8_t* end = buf + len;
+    while (start < end)
+    {
+        uint8_t* chunk_end = end;
+        if (n_chunks + 1 < n_threads)
+        {
+            chunk_end = (uint8_t*)(((size_t)start + chunk_bytes + align_mask) &
+                                   ~align_mask);
+            if (chunk_end > end) chunk_end = end;
+        }
+
+        vtp_populate_chunk* c = &chunks[n_chunks++];
+        c->_mpf_handle = _mpf_handle;
+        c->buf = start;
+        c->len = chunk_end - start;
+        c->page_size = page_size;
+        c->pt_flags = 0;
+        c->pt_end_flags = 0;
+        c->batch = NULL;
+
+        start = chunk_end;
+    }
+
+    if (n_chunks < 2) return FPGA_NOT_SUPPORTED;
+
+    chunks[0].pt_flags = pt_flags;
+    chunks[n_chunks - 1].pt_end_flags = pt_end_flags;
+
+    if (_mpf_handle->dbg_mode)
+    {
+        MPF_FPGA_MSG("populating VA %p, 0x%zx bytes, with %d threads",
+                     buf, len, n_chunks);
+    }
+
+    populateRunPhase(chunks, n_chunks, false);
+
+    // With the pages present, pinning the whole region with one call is
+    // quick when the driver permits it.
+    r = addRegionBulk(_mpf_handle, batch, buf, len, pt_flags, pt_end_flags);
+    if (FPGA_NOT_SUPPORTED != r) return r;
+
+    r = FPGA_OK;
+    for (uint32_t i = 0; i < n_chunks; i++)
+    {
+        chunks[i].batch = malloc(sizeof(vtp_mapping_batch));
+        if (NULL == chunks[i].batch)
+        {
+            r = FPGA_NO_MEMORY;
+            goto done;
+        }
+        initMappingBatch(chunks[i].batch, chunks[i].buf, true);
+    }
+
+    populateRunPhase(chunks, n_chunks, true);
+
+    for (uint32_t i = 0; (FPGA_OK == r) && (i < n_chunks); i++)
+    {
+        r = chunks[i].r;
+    }
+
+    // Merge the chunks into the page table.  Mappings handed to batch
+    // are dropped from their chunk so they are released only once on
+    // failure.
+    for (uint32_t i = 0; (FPGA_OK == r) && (i < n_chunks); i++)
+    {
+        vtp_mapping_batch* chunk_batch = chunks[i].batch;
+        size_t j = 0;
+
+        while ((FPGA_OK == r) && (j < chunk_batch->n_deferred))
+        {
+            r = addMappingToBatch(_mpf_handle, batch, &chunk_batch->deferred[j++]);
+        }
+
+        memmove(chunk_batch->deferred, &chunk_batch->deferred[j],
+                (chunk_batch->n_deferred - j) * sizeof(mpf_vtp_pt_mapping));
+        chunk_batch->n_deferred -= j;
+    }
+
+  done:
+    for (uint32_t i = 0; i < n_chunks; i++)
+    {
+        if (NULL == chunks[i].batch) continue;
+
+        releaseMappingBatch(_mpf_handle, chunks[i].batch, chunks[i].buf);
+        free(chunks[i].batch->deferred);
+        free(chunks[i].batch);
+    }
+
+    // FPGA_NOT_SUPPORTED would tell the caller to pin the region again
+    if (FPGA_NOT_SUPPORTED == r) r = FPGA_NO_MEMORY;
+
+    return r;
+}
+
+
+//
+// Buffer pool.  Released buffers stay pinned and mapped and are kept in
+// free lists, one per power of 2 size class.
+//
+
+// Size class of a buffer or -1 if it is too large to pool.
+static int poolSizeClass(
+    uint64_t len
+)
+{
+    uint64_t class_bytes = mpfPageSizeEnumToBytes(MPF_VTP_PAGE_4KB);
+    int c = 0;
+
+    while (class_bytes < len)
+    {
+        class_bytes <<= 1;
+        c += 1;
+    }
+
+    return (c < MPF_VTP_POOL_NUM_CLASSES) ? c : -1;
+}
+
+
+static uint64_t poolClassBytes(
+    int c
+)
+{
+    return mpfPageSizeEnumToBytes(MPF_VTP_PAGE_4KB) << c;
+}
+
+
+// Pop a buffer from a free list.  Returns NULL if the list is empty.
+static void* poolGet(
+    _mpf_handle_p _mpf_handle,
+    int c
+)
+{
+    mpf_vtp_pool* pool = &_mpf_handle->vtp.pool;
+    void* buf;
+
+    mpfOsLockMutex(pool->mutex);
+
+    buf = pool->free_list[c];
+    if (NULL != buf)
+    {
+        pool->free_list[c] = *(void**)buf;
+        pool->idle_bytes -= poolClassBytes(c);
+    }
+
+    mpfOsUnlockMutex(pool->mutex);
+
+    return buf;
+}
+
+
+//
+// Unlink idle buffers, largest first, until the pool is within its limit.
+// Must be called with the pool mutex held.  The unlinked buffers are
+// returned as a list for poolRelease(), which should be called after the
+// mutex is dropped.
+//
+static void* poolTrim(
+    mpf_vtp_pool* pool
+)
+{
+    void* victims = NULL;
+
+    for (int c = MPF_VTP_POOL_NUM_CLASSES - 1;
+         (c >= 0) && (pool->idle_bytes > pool->max_idle_bytes);
+         c--)
+    {
+        while ((NULL != pool->free_list[c]) &&
+               (pool->idle_bytes > pool->max_idle_bytes))
+        {
+            void* buf = pool->free_list[c];
+            pool->free_list[c] = *(void**)buf;
+            pool->idle_bytes -= poolClassBytes(c);
+
+            *(void**)buf = victims;
+            victims = buf;
+        }
+    }
+
+    return victims;
+}
+
+
+// Unpin and unmap a list of buffers returned by poolTrim().
+static void poolRelease(
+    _mpf_handle_p _mpf_handle,
+    void* victims
+)
+{
+    while (NULL != victims)
+    {
+        void* next = *(void**)victims;
+        releaseMappedPages(_mpf_handle, victims, NULL, true);
+        victims = next;
+    }
+}
+
+
+// Push a released buffer on a free list.  Returns false if pooling is
+// disabled, in which case the caller must release the buffer.
+static bool poolPut(
+    _mpf_handle_p _mpf_handle,
+    void* buf,
+    int c
+)
+{
+    mpf_vtp_pool* pool = &_mpf_handle->vtp.pool;
+    void* victims;
+
+    mpfOsLockMutex(pool->mutex);
+
+    if (0 == pool->max_idle_bytes)
+    {
+        mpfOsUnlockMutex(pool->mutex);
+        return false;
+    }
+
+    *(void**)buf = pool->free_list[c];
+    pool->free_list[c] = buf;
+    pool->idle_bytes += poolClassBytes(c);
+
+    victims = poolTrim(pool);
+
+    mpfOsUnlockMutex(pool->mutex);
+
+    poolRelease(_mpf_handle, victims);
+    return true;
+}
+
+
+//
+// Lazy buffers.  A MPF_VTP_BUF_LAZY buffer is reserved in the page table
+// with a placeholder for each 2MB region, flagged MPF_VTP_PT_FLAG_INVALID.
+// The FPGA's page table walker treats placeholders as missing translations.
+// A region is pinned the first time it is used, either after a failed
+// FPGA translation or by mpfVtpGetIOAddress().
+//
+#define VTP_LAZY_REGION_SIZE MPF_VTP_PAGE_2MB
+
+// Service thread polling interval (microseconds)
+#define VTP_LAZY_POLL_US 20
+
+
+//
+// Add placeholders for a lazy buffer to the page table.
+//
+static fpga_result lazyAddPlaceholders(
+    _mpf_handle_p _mpf_handle,
+    uint8_t* buf,
+    size_t len
+)
+{
+    fpga_result r = FPGA_OK;
+    const size_t region_bytes = mpfPageSizeEnumToBytes(VTP_LAZY_REGION_SIZE);
+    uint8_t* inserted_end = buf;
+
+    mpf_vtp_pt_mapping* m =
+        malloc(VTP_MAPPING_BATCH_SIZE * sizeof(mpf_vtp_pt_mapping));
+    if (NULL == m) return FPGA_NO_MEMORY;
+
+    size_t offset = 0;
+    uint32_t pt_flags = MPF_VTP_PT_FLAG_ALLOC_START;
+    while ((FPGA_OK == r) && (offset < len))
+    {
+        uint32_t n = 0;
+        uint32_t n_inserted;
+
+        while ((n < VTP_MAPPING_BATCH_SIZE) && (offset < len))
+        {
+            m[n].va = buf + offset;
+            m[n].pa = 0;
+            m[n].wsid = 0;
+            m[n].size = VTP_LAZY_REGION_SIZE;
+            m[n].flags = pt_flags | MPF_VTP_PT_FLAG_INVALID;
+
+            offset += region_bytes;
+            if (offset == len)
+            {
+                m[n].flags |= MPF_VTP_PT_FLAG_ALLOC_END;
+            }
+
+            pt_flags = 0;
+            n += 1;
+        }
+
+        r = mpfVtpPtInsertPageMappings(_mpf_handle->vtp.pt, m, n, &n_inserted);
+        inserted_end += n_inserted * region_bytes;
+    }
+
+    free(m);
+
+    if ((FPGA_OK != r) && (inserted_end != buf))
+    {
+        releaseMappedPages(_mpf_handle, buf, inserted_end, false);
+    }
+
+    return r;
+}
+
+
+//
+// Pin the lazy buffer region holding va, replacing its placeholder.
+// Returns FPGA_OK if the region is pinned, whether by this call or an
+// earlier one.  Fails if va isn't in the page table.
+//
+static fpga_result lazyPinRegion(
+    _mpf_handle_p _mpf_handle,
+    mpf_vtp_pt_vaddr va
+)
+{
+    fpga_result r;
+    mpf_vtp_pt* pt = _mpf_handle->vtp.pt;
+    mpf_vtp_pt_paddr pa;
+    uint32_t flags;
+    vtp_mapping_batch* batch;
+
+    const size_t region_bytes = mpfPageSizeEnumToBytes(VTP_LAZY_REGION_SIZE);
+    uint8_t* region = (uint8_t*)((size_t)va & ~(region_bytes - 1));
+
+    mpfOsLockMutex(_mpf_handle->vtp.lazy_mutex);
+
+    r = mpfVtpPtTranslateVAtoPA(pt, va, &pa, NULL, &flags);
+    if ((FPGA_OK != r) || (0 == (flags & MPF_VTP_PT_FLAG_INVALID))) goto done;
+
+    batch = malloc(sizeof(vtp_mapping_batch));
+    if (NULL == batch)
+    {
+        r = FPGA_NO_MEMORY;
+        goto done;
+    }
+    initMappingBatch(batch, region, false);
+
+    // Replace the placeholder.  Its first and last page tags move to the
+    // pinned pages.
+    r = mpfVtpPtRemovePageMapping(pt, region, NULL, NULL, NULL, NULL, &flags);
+    if (FPGA_OK != r) goto done_free;
+
+    uint32_t pt_flags = flags & MPF_VTP_PT_FLAG_ALLOC_START;
+    uint32_t pt_end_flags = flags & MPF_VTP_PT_FLAG_ALLOC_END;
+
+    r = addRegionBulk(_mpf_handle, batch, region, region_bytes,
+                      pt_flags, pt_end_flags);
+    if (FPGA_NOT_SUPPORTED == r)
+    {
+        r = addRegionByPage(_mpf_handle, batch, region, region_bytes,
+                            MPF_VTP_PAGE_4KB, pt_flags, pt_end_flags);
+    }
+    if (FPGA_OK == r)
+    {
+        r = flushMappingBatch(_mpf_handle, batch);
+    }
+
+    if (FPGA_OK != r)
+    {
+        if (_mpf_handle->dbg_mode)
+        {
+            MPF_FPGA_MSG("FAILED pinning lazy region VA %p, status %d", region, r);
+        }
+
+        // Put the placeholder back so the region can be released
+        releaseMappingBatch(_mpf_handle, batch, region);
+        mpfVtpPtInsertPageMapping(pt, region, 0, 0, VTP_LAZY_REGION_SIZE, flags);
+        goto done_free;
+    }
+
+    if (_mpf_handle->dbg_mode)
+    {
+        MPF_FPGA_MSG("pinned lazy region VA %p", region);
+    }
+
+    mpfOsAtomicAdd64(&_mpf_handle->vtp.lazy_regions_pinned, 1);
+
+  done_free:
+    free(batch);
+  done:
+    mpfOsUnlockMutex(_mpf_handle->vtp.lazy_mutex);
+    return r;
+}
+
+
+//
+// The service thread watches the FPGA's failed translation counter.  In
+// lazy mode the page table walker stops after a failure, holding the
+// failed address, until an invalidation is written.
+//
+static void lazyServiceThread(
+    void* arg
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)arg;
+    uint64_t n_failed = _mpf_handle->vtp.lazy_n_failed;
+
+    while (! mpfOsAtomicLoad64(&_mpf_handle->vtp.lazy_thread_stop))
+    {
+        uint64_t n = mpfReadCsr(_mpf_handle, CCI_MPF_SHIM_VTP,
+                                CCI_MPF_VTP_CSR_STAT_FAILED_TRANSLATIONS, NULL);
+        if (n == n_failed)
+        {
+            mpfOsSleepUs(VTP_LAZY_POLL_US);
+            continue;
+        }
+
+        n_failed = n;
+        mpf_vtp_pt_vaddr va =
+            (void*)(CL(1) * mpfReadCsr(_mpf_handle, CCI_MPF_SHIM_VTP,
+                                       CCI_MPF_VTP_CSR_STAT_PT_WALK_LAST_VADDR, NULL));
+
+        if (FPGA_OK == lazyPinRegion(_mpf_handle, va))
+        {
+            // Release the walker.  The FPGA retries the translation.
+            // The region may have been pinned already by a host thread,
+            // so the invalidation is needed even when nothing changed.
+            mpfVtpInvalVAMapping(_mpf_handle, va);
+        }
+        else
+        {
+            // Not a lazy buffer.  The FPGA remains stalled.
+            MPF_FPGA_MSG("FPGA translation failed for VA %p, which is not in a VTP buffer", va);
+        }
+    }
+}
+
+
+//
+// Switch the FPGA to lazy mode and start the service thread.  Called
+// when the first lazy buffer is allocated.
+//
+static fpga_result lazyEnable(
+    _mpf_handle_p _mpf_handle
+)
+{
+    fpga_result r = FPGA_OK;
+
+    mpfOsLockMutex(_mpf_handle->vtp.lazy_mutex);
+
+    if (! _mpf_handle->vtp.lazy_enabled)
+    {
+        // Failures before lazy mode is enabled are not the service
+        // thread's concern.
+        _mpf_handle->vtp.lazy_n_failed =
+            mpfReadCsr(_mpf_handle, CCI_MPF_SHIM_VTP,
+                       CCI_MPF_VTP_CSR_STAT_FAILED_TRANSLATIONS, NULL);
+
+        _mpf_handle->vtp.lazy_thread_stop = 0;
+        r = mpfOsCreateThread(lazyServiceThread, _mpf_handle,
+                              &_mpf_handle->vtp.lazy_thread);
+
+        if (FPGA_OK == r)
+        {
+            _mpf_handle->vtp.lazy_enabled = true;
+            r = vtpEnable(_mpf_handle);
+        }
+    }
+
+    mpfOsUnlockMutex(_mpf_handle->vtp.lazy_mutex);
+    return r;
+}
+
+
+//
+// Translate a VA using the page table, pinning lazy buffer regions on
+// demand.  pa is the base of the page.
+//
+static fpga_result translateVA(
+    _mpf_handle_p _mpf_handle,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr* pa,
+    mpf_vtp_page_size* size
+)
+{
+    fpga_result r;
+    mpf_vtp_pt* pt = _mpf_handle->vtp.pt;
+    uint32_t flags;
+
+    r = mpfVtpPtTranslateVAtoPA(pt, va, pa, size, &flags);
+
+    // The translation may also be missing briefly while another thread
+    // replaces a lazy region's placeholder.
+    if (_mpf_handle->vtp.lazy_enabled &&
+        ((FPGA_OK != r) || (flags & MPF_VTP_PT_FLAG_INVALID)))
+    {
+        r = lazyPinRegion(_mpf_handle, va);
+        if (FPGA_OK != r) return r;
 
-        return r;
+        r = mpfVtpPtTranslateVAtoPA(pt, va, pa, size, &flags);
     }
 
-    return FPGA_OK;
+    return r;
 }
 
 
@@ -187,25 +1489,29 @@ fpga_result mpfVtpInit(
     // Already initialized?
     if (NULL != _mpf_handle->vtp.pt) return FPGA_EXCEPTION;
 
-    // Allocate a mutex that protects the page table manager
-    r = mpfOsPrepareMutex(&(_mpf_handle->vtp.alloc_mutex));
-    if (FPGA_OK != r) return r;
-
     // Initialize the page table
     r = mpfVtpPtInit(_mpf_handle, &(_mpf_handle->vtp.pt));
-    if (FPGA_OK != r) goto fail;
+    if (FPGA_OK != r) return r;
+
+    // Buffer pooling is disabled until mpfVtpSetBufferPoolSize()
+    r = mpfOsPrepareMutex(&(_mpf_handle->vtp.pool.mutex));
+    if (FPGA_OK != r) return r;
+
+    // Lazy buffers are enabled by the first mpfVtpPrepareBuffer() request
+    r = mpfOsPrepareMutex(&(_mpf_handle->vtp.lazy_mutex));
+    if (FPGA_OK != r) return r;
 
     // Reset the HW TLB
     r = mpfVtpInvalHWTLB(_mpf_handle);
-    if (FPGA_OK != r) goto fail;
+    if (FPGA_OK != r) return r;
 
     // Test whether FPGA_BUF_PREALLOCATED is supported.  libfpga on old systems
     // might not.  fpgaPrepareBuffer() has a special mode for probing by
     // setting the buffer size to 0.
     uint64_t dummy_wsid;
     _mpf_handle->vtp.use_fpga_buf_preallocated =
-        (FPGA_OK == fpgaPrepareBuffer(_mpf_handle->handle, 0, NULL, &dummy_wsid,
-                                      FPGA_BUF_PREALLOCATED));
+        (FPGA_OK == mpfDevPrepareBuffer(_mpf_handle, 0, NULL, &dummy_wsid,
+                                        FPGA_BUF_PREALLOCATED));
     if (_mpf_handle->dbg_mode)
     {
         MPF_FPGA_MSG("FPGA_BUF_PREALLOCATED %s",
@@ -216,11 +1522,12 @@ fpga_result mpfVtpInit(
 
     _mpf_handle->vtp.max_physical_page_size = MPF_VTP_PAGE_2MB;
 
-    return FPGA_OK;
+    // Allocate near the FPGA by default
+    _mpf_handle->vtp.numa_node = _mpf_handle->numa_node;
 
-  fail:
-    mpfOsReleaseMutex(_mpf_handle->vtp.alloc_mutex);
-    return r;
+    _mpf_handle->vtp.populate_threads = 1;
+
+    return FPGA_OK;
 }
 
 
@@ -237,12 +1544,27 @@ fpga_result mpfVtpTerm(
 
     if (_mpf_handle->dbg_mode) MPF_FPGA_MSG("VTP terminating...");
 
+    if (_mpf_handle->vtp.lazy_enabled)
+    {
+        mpfOsAtomicStore64(&_mpf_handle->vtp.lazy_thread_stop, 1);
+        mpfOsJoinThread(_mpf_handle->vtp.lazy_thread);
+        _mpf_handle->vtp.lazy_thread = NULL;
+        _mpf_handle->vtp.lazy_enabled = false;
+    }
+    mpfOsReleaseMutex(_mpf_handle->vtp.lazy_mutex);
+    _mpf_handle->vtp.lazy_mutex = NULL;
+
+    // Drain the buffer pool
+    mpfVtpSetBufferPoolSize(_mpf_handle, 0);
+    mpfOsReleaseMutex(_mpf_handle->vtp.pool.mutex);
+    _mpf_handle->vtp.pool.mutex = NULL;
+
     r = mpfVtpPtTerm(_mpf_handle->vtp.pt);
     _mpf_handle->vtp.pt = NULL;
 
-    // Drop the allocated mutex
-    mpfOsReleaseMutex(_mpf_handle->vtp.alloc_mutex);
-    _mpf_handle->vtp.alloc_mutex = NULL;
+    // A new page table may be allocated at the same address.  Make sure
+    // no thread keeps translations from this one.
+    mpfVtpSwTlbInvalidate();
 
     return r;
 }
@@ -275,10 +1597,43 @@ fpga_result __MPF_API__ mpfVtpPrepareBuffer(
     fpga_result r;
     _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
     bool preallocated = (flags & FPGA_BUF_PREALLOCATED);
+    bool lazy = (flags & MPF_VTP_BUF_LAZY);
+    vtp_mapping_batch* batch;
 
     if (! _mpf_handle->vtp.is_available) return FPGA_NOT_SUPPORTED;
     if ((NULL == buf_addr) || (0 == len)) return FPGA_INVALID_PARAM;
 
+    if (lazy)
+    {
+        if (preallocated) return FPGA_INVALID_PARAM;
+
+        // Reserve the address space and add placeholders.  Nothing is
+        // pinned until the buffer is used.
+        len = (len + mpfPageSizeEnumToBytes(VTP_LAZY_REGION_SIZE) - 1) &
+              ~(mpfPageSizeEnumToBytes(VTP_LAZY_REGION_SIZE) - 1);
+
+        r = lazyEnable(_mpf_handle);
+        if (FPGA_OK != r) return r;
+
+        r = mpfOsReserveMemory(len, VTP_LAZY_REGION_SIZE,
+                               _mpf_handle->vtp.numa_node, buf_addr);
+        if (FPGA_OK != r) return r;
+
+        r = lazyAddPlaceholders(_mpf_handle, *buf_addr, len);
+        if (FPGA_OK != r)
+        {
+            mpfOsUnmapMemory(*buf_addr, len);
+            return r;
+        }
+
+        if (_mpf_handle->dbg_mode)
+        {
+            MPF_FPGA_MSG("reserved lazy 0x%" PRIx64 " byte buffer at VA %p", len, *buf_addr);
+        }
+
+        return FPGA_OK;
+    }
+
     if (preallocated)
     {
         const size_t p_mask = mpfPageSizeEnumToBytes(MPF_VTP_PAGE_4KB) - 1;
@@ -314,16 +1669,38 @@ fpga_result __MPF_API__ mpfVtpPrepareBuffer(
         }
     }
 
-    // Page table updates aren't thread safe
-    mpfOsLockMutex(_mpf_handle->vtp.alloc_mutex);
+    // No lock is held here.  Allocations cover disjoint virtual ranges,
+    // so pinning runs in parallel and only the page table updates are
+    // serialized, inside the page table manager.
 
     if (_mpf_handle->dbg_mode) MPF_FPGA_MSG("requested 0x%" PRIx64 " byte buffer", len);
 
+    // Recycle a pooled buffer?  If none is available, allocate a new one
+    // the full size of the class so it can be pooled when released.
+    int pool_class = -1;
+    if (! preallocated && (0 != _mpf_handle->vtp.pool.max_idle_bytes))
+    {
+        pool_class = poolSizeClass(len);
+        if (pool_class >= 0)
+        {
+            *buf_addr = poolGet(_mpf_handle, pool_class);
+            if (NULL != *buf_addr) return FPGA_OK;
+
+            len = poolClassBytes(pool_class);
+        }
+    }
+
     // Pick a requested page size
     mpf_vtp_page_size page_size = MPF_VTP_PAGE_4KB;
-    if ((len > CCI_MPF_VTP_LARGE_PAGE_THRESHOLD) &&
-        (MPF_VTP_PAGE_2MB <= _mpf_handle->vtp.max_physical_page_size) &&
+    if ((len >= CCI_MPF_VTP_HUGE_PAGE_THRESHOLD) &&
+        (MPF_VTP_PAGE_1GB <= _mpf_handle->vtp.max_physical_page_size) &&
         ! preallocated)
+    {
+        page_size = MPF_VTP_PAGE_1GB;
+    }
+    else if ((len > CCI_MPF_VTP_LARGE_PAGE_THRESHOLD) &&
+             (MPF_VTP_PAGE_2MB <= _mpf_handle->vtp.max_physical_page_size) &&
+             ! preallocated)
     {
         page_size = MPF_VTP_PAGE_2MB;
     }
@@ -331,85 +1708,74 @@ fpga_result __MPF_API__ mpfVtpPrepareBuffer(
     // Map the memory
     if (! preallocated)
     {
-        r = mpfOsMapMemory(len, &page_size, buf_addr);
+        r = mpfOsMapMemory(len, &page_size, _mpf_handle->vtp.numa_node,
+                           buf_addr);
         if (FPGA_OK != r) goto fail;
     }
 
-    // Share each page with the FPGA and insert them into the VTP page table.
+    // Share the pages with the FPGA and insert them into the VTP page table.
+    // When the driver permits it the whole region is pinned with a single
+    // call.  Otherwise pages are pinned one at a time.  Either way, the
+    // translations are added to the page table in batches.
     size_t page_bytes = mpfPageSizeEnumToBytes(page_size);
-    uint8_t* page = *buf_addr;
     uint32_t pt_flags = MPF_VTP_PT_FLAG_ALLOC_START;
     if (preallocated)
     {
         pt_flags |= MPF_VTP_PT_FLAG_PREALLOCATED;
     }
-
-    const size_t page_bytes_2mb = mpfPageSizeEnumToBytes(MPF_VTP_PAGE_2MB);
-    const size_t page_mask_2mb = page_bytes_2mb - 1;
+    if (pool_class >= 0)
+    {
+        pt_flags |= MPF_VTP_PT_FLAG_POOLED |
+                    (pool_class << MPF_VTP_PT_POOL_CLASS_SHIFT);
+    }
 
     // Round len up to a multiple of the page size
     len = (len + page_bytes - 1) & ~(page_bytes - 1);
 
-    while (len)
-    {
-        size_t this_page_bytes = page_bytes;
+    batch = malloc(sizeof(vtp_mapping_batch));
+    if (NULL == batch) goto fail_unmap;
+    initMappingBatch(batch, *buf_addr, false);
 
-        // Tag the last page in the group
-        if (len == page_bytes)
-        {
-            pt_flags |= MPF_VTP_PT_FLAG_ALLOC_END;
-        }
+    r = FPGA_NOT_SUPPORTED;
+    if ((_mpf_handle->vtp.populate_threads > 1) &&
+        _mpf_handle->vtp.use_fpga_buf_preallocated && ! preallocated)
+    {
+        r = addRegionParallel(_mpf_handle, batch, *buf_addr, len, page_size,
+                              pt_flags, MPF_VTP_PT_FLAG_ALLOC_END);
+    }
+    if (FPGA_NOT_SUPPORTED == r)
+    {
+        r = addRegionBulk(_mpf_handle, batch, *buf_addr, len, pt_flags,
+                          MPF_VTP_PT_FLAG_ALLOC_END);
+    }
+    if (FPGA_NOT_SUPPORTED == r)
+    {
+        r = addRegionByPage(_mpf_handle, batch, *buf_addr, len, page_size,
+                            pt_flags, MPF_VTP_PT_FLAG_ALLOC_END);
+    }
+    if (FPGA_OK == r)
+    {
+        r = flushMappingBatch(_mpf_handle, batch);
+    }
+    if (FPGA_OK != r) goto fail_release;
 
-        // Speculatively request a 2MB page even if in a 4KB allocation when
-        // the virtual page is aligned to 2MB and is large enough.  We do this
-        // even when the page is preallocated, thus discovering when a huge
-        // preallocated page is passed in.
-        if ((0 == ((size_t)page & page_mask_2mb)) && (len >= page_bytes_2mb) &&
-            (MPF_VTP_PAGE_2MB <= _mpf_handle->vtp.max_physical_page_size))
-        {
-            // Try for a big page
-            uint32_t pt_flags_2mb = pt_flags;
-            if (len == page_bytes_2mb)
-            {
-                pt_flags_2mb |= MPF_VTP_PT_FLAG_ALLOC_END;
-            }
+    free(batch);
 
-            bool speculative = (page_size != MPF_VTP_PAGE_2MB);
-            r = allocateAndInsertPage(_mpf_handle, page, MPF_VTP_PAGE_2MB, pt_flags_2mb,
-                                      speculative);
+    if (_mpf_handle->dbg_mode) mpfVtpPtDumpPageTable(_mpf_handle->vtp.pt);
 
-            // Did it work?
-            if (FPGA_OK == r)
-            {
-                // Yes!
-                this_page_bytes = page_bytes_2mb;
-            }
-            else if (speculative)
-            {
-                // No.  Use small pages.
-                r = allocateAndInsertPage(_mpf_handle, page, page_size, pt_flags, false);
-            }
-        }
-        else
-        {
-            // The page isn't aligned to 2MB.
-            r = allocateAndInsertPage(_mpf_handle, page, page_size, pt_flags, false);
-        }
+    return FPGA_OK;
 
-        if (FPGA_OK != r) goto fail;
+  fail_release:
+    releaseMappingBatch(_mpf_handle, batch, *buf_addr);
+    free(batch);
 
-        pt_flags = 0;
-        page += this_page_bytes;
-        len -= this_page_bytes;
+  fail_unmap:
+    if (! preallocated)
+    {
+        mpfOsUnmapMemory(*buf_addr, len);
     }
 
-    if (_mpf_handle->dbg_mode) mpfVtpPtDumpPageTable(_mpf_handle->vtp.pt);
-
-    mpfOsUnlockMutex(_mpf_handle->vtp.alloc_mutex);
-    return FPGA_OK;
-
   fail:
-    mpfOsUnlockMutex(_mpf_handle->vtp.alloc_mutex);
     return FPGA_NO_MEMORY;
 }
 
@@ -433,9 +1799,7 @@ fpga_result __MPF_API__ mpfVtpReleaseBuffer(
 
     mpf_vtp_pt_vaddr va = buf_addr;
     mpf_vtp_pt_paddr pa;
-    mpf_vtp_page_size size;
     uint32_t flags;
-    uint64_t wsid;
     fpga_result r;
 
     if (! _mpf_handle->vtp.is_available) return FPGA_NOT_SUPPORTED;
@@ -446,7 +1810,7 @@ fpga_result __MPF_API__ mpfVtpReleaseBuffer(
     }
 
     // Is the address the beginning of an allocation region?
-    r = mpfVtpPtTranslateVAtoPA(_mpf_handle->vtp.pt, va, &pa, &flags);
+    r = mpfVtpPtTranslateVAtoPA(_mpf_handle->vtp.pt, va, &pa, NULL, &flags);
     if (FPGA_OK != r) return r;
     if (0 == (flags & MPF_VTP_PT_FLAG_ALLOC_START))
     {
@@ -457,69 +1821,17 @@ fpga_result __MPF_API__ mpfVtpReleaseBuffer(
     // remove it from the translation table and unpin it, but leave it intact.
     bool preallocated = (flags & MPF_VTP_PT_FLAG_PREALLOCATED);
 
-    mpfOsLockMutex(_mpf_handle->vtp.alloc_mutex);
-
-    // Loop through the mapped virtual pages until the end of the region
-    // is reached or there is an error.
-    while (true)
+    // Keep pooled buffers pinned for reuse
+    if (flags & MPF_VTP_PT_FLAG_POOLED)
     {
-        if (_mpf_handle->dbg_mode)
-        {
-            MPF_FPGA_MSG("lookup VA %p", va);
-        }
-
-        if (FPGA_OK != mpfVtpPtRemovePageMapping(_mpf_handle->vtp.pt, va,
-                                                 &pa, NULL, &wsid, &size, &flags))
-        {
-            if (_mpf_handle->dbg_mode)
-            {
-                MPF_FPGA_MSG("error unmapping VA %p", va);
-            }
-            break;
-        }
-
-        if (_mpf_handle->dbg_mode)
-        {
-            MPF_FPGA_MSG("release %s page VA %p, PA 0x%" PRIx64 ", wsid 0x%" PRIx64,
-                         (size == MPF_VTP_PAGE_2MB ? "2MB" : "4KB"),
-                         va, pa, wsid);
-        }
-
-        size_t page_bytes = mpfPageSizeEnumToBytes(size);
-
-        r = mpfVtpInvalVAMapping(_mpf_handle, va);
-        if (FPGA_OK != r) goto fail;
-
-        // If the kernel deallocation fails just give up.  Something bad
-        // is bound to happen.
-        assert(FPGA_OK == fpgaReleaseBuffer(_mpf_handle->handle, wsid));
-        if (! preallocated)
-        {
-            if (_mpf_handle->dbg_mode)
-            {
-                MPF_FPGA_MSG("unmapping VA %p, size 0x%" PRIx64, va, page_bytes);
-            }
-            mpfOsUnmapMemory(va, page_bytes);
-        }
-
-        // Done?
-        if (flags & MPF_VTP_PT_FLAG_ALLOC_END)
-        {
-            if (_mpf_handle->dbg_mode) mpfVtpPtDumpPageTable(_mpf_handle->vtp.pt);
-
-            mpfOsUnlockMutex(_mpf_handle->vtp.alloc_mutex);
-            return FPGA_OK;
-        }
-
-        // Next page address
-        va = (char *) va + page_bytes;
+        int c = (flags & MPF_VTP_PT_POOL_CLASS_MASK) >> MPF_VTP_PT_POOL_CLASS_SHIFT;
+        if (poolPut(_mpf_handle, va, c)) return FPGA_OK;
     }
 
-    // Failure in the deallocation loop.  Continue to fail path.
-    r = FPGA_NO_MEMORY;
+    r = releaseMappedPages(_mpf_handle, va, NULL, ! preallocated);
+
+    if (_mpf_handle->dbg_mode) mpfVtpPtDumpPageTable(_mpf_handle->vtp.pt);
 
-  fail:
-    mpfOsUnlockMutex(_mpf_handle->vtp.alloc_mutex);
     return r;
 }
 
@@ -541,14 +1853,149 @@ uint64_t __MPF_API__ mpfVtpGetIOAddress(
     fpga_result r;
     _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
 
-    uint64_t pa;
-    r = mpfVtpPtTranslateVAtoPA(_mpf_handle->vtp.pt, buf_addr, &pa, NULL);
+    mpf_vtp_pt* pt = _mpf_handle->vtp.pt;
+    mpf_vtp_pt_paddr pa;
+    mpf_vtp_page_size size;
+
+    if (mpfVtpSwTlbLookup(pt, &_mpf_handle->vtp.sw_tlb_stats, buf_addr, &pa))
+    {
+        return pa;
+    }
+
+    r = translateVA(_mpf_handle, buf_addr, &pa, &size);
     if (FPGA_OK != r) return 0;
 
+    mpfVtpSwTlbInsert(pt, buf_addr, pa, size);
+
     return pa;
 }
 
 
+fpga_result __MPF_API__ mpfVtpGetIOAddresses(
+    mpf_handle_t mpf_handle,
+    size_t n,
+    void* const* buf_addrs,
+    uint64_t* io_addrs
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    fpga_result r = FPGA_OK;
+
+    if (! _mpf_handle->vtp.is_available) return FPGA_NOT_SUPPORTED;
+    if ((NULL == buf_addrs) || (NULL == io_addrs)) return FPGA_INVALID_PARAM;
+
+    // Most recent translation
+    uint64_t page_va = 0;
+    uint64_t page_mask = 0;
+    mpf_vtp_pt_paddr page_pa = 0;
+    bool page_valid = false;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t va = (uint64_t)buf_addrs[i];
+
+        if (! page_valid || ((va & ~page_mask) != page_va))
+        {
+            mpf_vtp_page_size size;
+            page_valid = (FPGA_OK == translateVA(_mpf_handle, buf_addrs[i],
+                                                 &page_pa, &size));
+            if (! page_valid)
+            {
+                io_addrs[i] = 0;
+                r = FPGA_NOT_FOUND;
+                continue;
+            }
+
+            page_mask = mpfPageSizeEnumToBytes(size) - 1;
+            page_va = va & ~page_mask;
+        }
+
+        io_addrs[i] = page_pa + (va & page_mask);
+    }
+
+    return r;
+}
+
+
+//
+// Pages are translated by mpfVtpGetIOExtents() in groups of this size.
+//
+#define VTP_EXTENT_BATCH_SIZE 64
+
+fpga_result __MPF_API__ mpfVtpGetIOExtents(
+    mpf_handle_t mpf_handle,
+    void* buf_addr,
+    uint64_t len,
+    mpf_vtp_io_extent* extents,
+    size_t max_extents,
+    size_t* n_extents
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    mpf_vtp_pt_mapping m[VTP_EXTENT_BATCH_SIZE];
+    uint32_t n_m;
+    size_t n = 0;
+
+    if (! _mpf_handle->vtp.is_available) return FPGA_NOT_SUPPORTED;
+    if ((NULL == extents) || (NULL == n_extents)) return FPGA_INVALID_PARAM;
+
+    *n_extents = 0;
+
+    char* va = buf_addr;
+    char* end = (char*)buf_addr + len;
+    while (va < end)
+    {
+        mpfVtpPtTranslateVARange(_mpf_handle->vtp.pt, va, end - va,
+                                 m, VTP_EXTENT_BATCH_SIZE, &n_m);
+
+        // Pin lazy regions and try again.  A missing page ends the walk.
+        if ((0 == n_m) || (m[0].flags & MPF_VTP_PT_FLAG_INVALID))
+        {
+            mpf_vtp_pt_paddr pa;
+            if (FPGA_OK != translateVA(_mpf_handle, va, &pa, NULL))
+            {
+                return FPGA_NOT_FOUND;
+            }
+            continue;
+        }
+
+        for (uint32_t i = 0; i < n_m; i++)
+        {
+            // Stop at a lazy placeholder.  It is pinned in the next pass.
+            if (m[i].flags & MPF_VTP_PT_FLAG_INVALID) break;
+
+            char* page_end = (char*)m[i].va + mpfPageSizeEnumToBytes(m[i].size);
+            if (page_end > end) page_end = end;
+
+            uint64_t iova = m[i].pa + (va - (char*)m[i].va);
+            uint64_t bytes = page_end - va;
+
+            if (n && (extents[n - 1].iova + extents[n - 1].len == iova))
+            {
+                extents[n - 1].len += bytes;
+            }
+            else if (n == max_extents)
+            {
+                *n_extents = n;
+                return FPGA_NO_MEMORY;
+            }
+            else
+            {
+                extents[n].va = va;
+                extents[n].iova = iova;
+                extents[n].len = bytes;
+                n += 1;
+            }
+
+            va = page_end;
+            *n_extents = n;
+        }
+    }
+
+    return FPGA_OK;
+}
+
+
 fpga_result __MPF_API__ mpfVtpInvalHWTLB(
     mpf_handle_t mpf_handle
 )
@@ -558,6 +2005,8 @@ fpga_result __MPF_API__ mpfVtpInvalHWTLB(
 
     if (! _mpf_handle->vtp.is_available) return FPGA_NOT_SUPPORTED;
 
+    mpfVtpSwTlbInvalidate();
+
     // Mode 2 blocks traffic and invalidates the FPGA-side TLB cache
     r = mpfWriteCsr(mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_MODE, 2);
     if (FPGA_OK != r) return r;
@@ -575,6 +2024,8 @@ fpga_result __MPF_API__ mpfVtpInvalVAMapping(
 
     if (! _mpf_handle->vtp.is_available) return FPGA_NOT_SUPPORTED;
 
+    mpfVtpSwTlbInvalidate();
+
     return mpfWriteCsr(mpf_handle,
                        CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_INVAL_PAGE_VADDR,
                        // Convert VA to a line index
@@ -582,6 +2033,46 @@ fpga_result __MPF_API__ mpfVtpInvalVAMapping(
 }
 
 
+fpga_result __MPF_API__ mpfVtpInvalVARange(
+    mpf_handle_t mpf_handle,
+    void* va,
+    size_t len
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+
+    if (! _mpf_handle->vtp.is_available) return FPGA_NOT_SUPPORTED;
+
+    vtp_inval_batch batch;
+    batch.flush_all = false;
+    batch.n = 0;
+
+    // Find the page size of each page in the range.  Addresses that
+    // aren't in the page table are treated as 4KB pages.
+    char* page = va;
+    char* end = (char*)va + len;
+    while (! batch.flush_all && (page < end))
+    {
+        mpf_vtp_pt_paddr pa;
+        mpf_vtp_page_size size;
+        if (FPGA_OK != mpfVtpPtTranslateVAtoPA(_mpf_handle->vtp.pt, page,
+                                               &pa, &size, NULL))
+        {
+            size = MPF_VTP_PAGE_4KB;
+        }
+
+        size_t page_mask = mpfPageSizeEnumToBytes(size) - 1;
+        char* page_end = (char*)(((size_t)page | page_mask) + 1);
+        if (page_end > end) page_end = end;
+
+        invalBatchAdd(&batch, page, page_end - page, size);
+        page = page_end;
+    }
+
+    return invalBatchCommit(_mpf_handle, &batch);
+}
+
+
 fpga_result __MPF_API__ mpfVtpSetMaxPhysPageSize(
     mpf_handle_t mpf_handle,
     mpf_vtp_page_size max_psize
@@ -589,18 +2080,75 @@ fpga_result __MPF_API__ mpfVtpSetMaxPhysPageSize(
 {
     _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
 
-    if (max_psize > MPF_VTP_PAGE_2MB) return FPGA_INVALID_PARAM;
+    if ((max_psize != MPF_VTP_PAGE_4KB) &&
+        (max_psize != MPF_VTP_PAGE_2MB) &&
+        (max_psize != MPF_VTP_PAGE_1GB))
+    {
+        return FPGA_INVALID_PARAM;
+    }
 
     _mpf_handle->vtp.max_physical_page_size = max_psize;
     return FPGA_OK;
 }
 
 
+fpga_result __MPF_API__ mpfVtpSetNumaNode(
+    mpf_handle_t mpf_handle,
+    int numa_node
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+
+    if (numa_node < -1) return FPGA_INVALID_PARAM;
+
+    _mpf_handle->vtp.numa_node = numa_node;
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfVtpSetPopulateThreads(
+    mpf_handle_t mpf_handle,
+    uint32_t n_threads
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+
+    if (0 == n_threads) return FPGA_INVALID_PARAM;
+
+    _mpf_handle->vtp.populate_threads = n_threads;
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfVtpSetBufferPoolSize(
+    mpf_handle_t mpf_handle,
+    uint64_t max_idle_bytes
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    mpf_vtp_pool* pool = &_mpf_handle->vtp.pool;
+    void* victims;
+
+    if (! _mpf_handle->vtp.is_available) return FPGA_NOT_SUPPORTED;
+
+    mpfOsLockMutex(pool->mutex);
+    pool->max_idle_bytes = max_idle_bytes;
+    victims = poolTrim(pool);
+    mpfOsUnlockMutex(pool->mutex);
+
+    poolRelease(_mpf_handle, victims);
+
+    return FPGA_OK;
+}
+
+
 fpga_result __MPF_API__ mpfVtpGetStats(
     mpf_handle_t mpf_handle,
     mpf_vtp_stats* stats
 )
 {
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+
     // Is the VTP feature present?
     if (! mpfShimPresent(mpf_handle, CCI_MPF_SHIM_VTP))
     {
@@ -608,14 +2156,23 @@ fpga_result __MPF_API__ mpfVtpGetStats(
         return FPGA_NOT_SUPPORTED;
     }
 
-    stats->numTLBHits4KB = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_4KB_TLB_NUM_HITS, NULL);
-    stats->numTLBMisses4KB = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_4KB_TLB_NUM_MISSES, NULL);
-    stats->numTLBHits2MB = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_2MB_TLB_NUM_HITS, NULL);
-    stats->numTLBMisses2MB = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_2MB_TLB_NUM_MISSES, NULL);
-    stats->numPTWalkBusyCycles = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_PT_WALK_BUSY_CYCLES, NULL);
-    stats->numFailedTranslations = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_FAILED_TRANSLATIONS, NULL);
+    // The statistics are consecutive CSRs, from 4KB TLB hits through
+    // the last page walk address.
+    uint64_t csrs[7];
+    mpfReadCsrs(mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_4KB_TLB_NUM_HITS, 7, csrs);
+
+    stats->numTLBHits4KB = csrs[0];
+    stats->numTLBMisses4KB = csrs[1];
+    stats->numTLBHits2MB = csrs[2];
+    stats->numTLBMisses2MB = csrs[3];
+    stats->numPTWalkBusyCycles = csrs[4];
+    stats->numFailedTranslations = csrs[5];
+
+    stats->ptWalkLastVAddr = (void*)(CL(1) * csrs[6]);
 
-    stats->ptWalkLastVAddr = (void*)(CL(1) * mpfReadCsr(mpf_handle, CCI_MPF_SHIM_VTP, CCI_MPF_VTP_CSR_STAT_PT_WALK_LAST_VADDR, NULL));
+    mpfVtpSwTlbGetStats(&_mpf_handle->vtp.sw_tlb_stats,
+                        &stats->numSwTLBHits, &stats->numSwTLBMisses);
+    stats->numLazyRegionsPinned = mpfOsAtomicLoad64(&_mpf_handle->vtp.lazy_regions_pinned);
 
     return FPGA_OK;
 }
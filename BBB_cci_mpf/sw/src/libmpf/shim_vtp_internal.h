@@ -34,6 +34,7 @@
 #define __FPGA_MPF_SHIM_VTP_INTERNAL_H__
 
 #include "shim_vtp_pt.h"
+#include "shim_vtp_sw_tlb.h"
 
 
 /**
@@ -64,6 +65,30 @@ fpga_result mpfVtpTerm(
 );
 
 
+/**
+ * Number of VTP buffer pool size classes.  Classes are powers of 2,
+ * starting at 4KB.  The largest pooled buffer is 1GB.
+ */
+#define MPF_VTP_POOL_NUM_CLASSES 19
+
+
+/**
+ * Pool of released buffers that are still pinned and mapped in the
+ * page table.  Idle buffers are linked through their first word.
+ */
+typedef struct
+{
+    mpf_os_mutex_handle mutex;
+
+    // Maximum bytes held in idle buffers.  Pooling is disabled when 0.
+    uint64_t max_idle_bytes;
+    uint64_t idle_bytes;
+
+    void* free_list[MPF_VTP_POOL_NUM_CLASSES];
+}
+mpf_vtp_pool;
+
+
 /**
  * VTP persistent state.  An instance of this struct is stored in the
  * MPF handle.
@@ -73,18 +98,44 @@ typedef struct
     // VTP page table state
     mpf_vtp_pt* pt;
 
-    // VTP mutex (one allocation at a time)
-    mpf_os_mutex_handle alloc_mutex;
+    // Recycled buffers
+    mpf_vtp_pool pool;
 
     // Maximum requested page size
     mpf_vtp_page_size max_physical_page_size;
 
+    // Preferred NUMA node of new buffers, -1 for the default policy
+    int numa_node;
+
+    // Threads used to populate and pin large buffers
+    uint32_t populate_threads;
+
     // Does libfpga support FPGA_PREALLOCATED?  The old AAL compatibility
     // version does not.
     bool use_fpga_buf_preallocated;
 
     // Is VTP available in the FPGA?
     bool is_available;
+
+    // Software TLB statistics (mpfVtpGetIOAddress() lookups)
+    mpf_vtp_sw_tlb_stats sw_tlb_stats;
+
+    // Set once a MPF_VTP_BUF_LAZY buffer has been allocated.  The FPGA
+    // then waits for software to resolve failed translations.
+    bool lazy_enabled;
+
+    // Serializes on-demand pinning of lazy buffer regions
+    mpf_os_mutex_handle lazy_mutex;
+
+    // Service thread that pins regions of lazy buffers after failed
+    // FPGA translations.  Started with the first lazy buffer.
+    mpf_os_thread_handle lazy_thread;
+    int64_t lazy_thread_stop;
+
+    // FPGA failed translation count when the service thread started
+    uint64_t lazy_n_failed;
+
+    uint64_t lazy_regions_pinned;
 }
 mpf_vtp_state;
 
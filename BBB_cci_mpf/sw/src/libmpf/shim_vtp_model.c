@@ -0,0 +1,772 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file shim_vtp_model.c
+ * \brief Host-side model of the FPGA VTP translation caches
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opae/mpf/mpf.h>
+#include "mpf_internal.h"
+
+
+// Defaults from hw/rtl/cci_mpf_config.vh
+#define VTP_MODEL_L1_4KB_ENTRIES 512
+#define VTP_MODEL_L1_2MB_ENTRIES 512
+#define VTP_MODEL_TLB_4KB_SETS 512
+#define VTP_MODEL_TLB_4KB_WAYS 4
+#define VTP_MODEL_TLB_2MB_SETS 512
+#define VTP_MODEL_TLB_2MB_WAYS 4
+
+// PT_CACHE_ENTRIES in cci_mpf_svc_vtp_pt_walk.sv
+#define VTP_MODEL_PT_CACHE_ENTRIES 128
+
+// Levels in the page table and page table entries in a cache line
+#define VTP_MODEL_PT_DEPTH 4
+#define VTP_MODEL_PT_ENTRIES_PER_LINE 8
+
+#define VTP_MODEL_PAGE_4KB_SHIFT 12
+#define VTP_MODEL_PAGE_2MB_SHIFT 21
+
+
+//
+// Cache entries hold the page (or page table line) index plus one so
+// that zeroed storage is invalid.
+//
+typedef uint64_t vtp_model_tag;
+
+
+typedef struct
+{
+    const char* start;
+    const char* end;
+
+    uint64_t accesses;
+    uint64_t walks;
+    uint64_t walk_reads;
+}
+vtp_model_buffer;
+
+
+typedef struct
+{
+    _mpf_handle_p _mpf_handle;
+    mpf_vtp_model_config config;
+
+    // Direct-mapped L1 caches, indexed by channel
+    vtp_model_tag* l1_4kb[2];
+    vtp_model_tag* l1_2mb[2];
+
+    // Set-associative TLBs.  Set i is ways [i * n_ways, (i + 1) * n_ways).
+    vtp_model_tag* tlb_4kb;
+    vtp_model_tag* tlb_2mb;
+
+    // Page table walker's line cache
+    vtp_model_tag* pt_cache;
+
+    // State of the random replacement policy (xorshift32)
+    uint32_t rand_state;
+
+    mpf_vtp_model_stats stats;
+
+    // Buffers seen in the trace, sorted by address
+    vtp_model_buffer* buffers;
+    uint32_t n_buffers;
+    uint32_t max_buffers;
+
+    // Most recently accessed buffer
+    uint32_t last_buffer;
+}
+vtp_model;
+
+
+static bool isPow2(uint32_t n)
+{
+    return (n != 0) && ((n & (n - 1)) == 0);
+}
+
+
+static uint32_t modelRand(vtp_model* model)
+{
+    uint32_t x = model->rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    model->rand_state = x;
+    return x;
+}
+
+
+//
+// hash32() from cci_mpf_prim_hash.vh: CRC-32 (IEEE 802.3) of a 32 bit
+// word with a zero initial value.
+//
+static uint32_t hash32(uint32_t d)
+{
+    uint32_t h = 0;
+    for (int i = 31; i >= 0; i--)
+    {
+        uint32_t b = ((h >> 31) ^ (d >> i)) & 1;
+        h <<= 1;
+        if (b) h ^= 0x04c11db7;
+    }
+
+    return h;
+}
+
+
+// ========================================================================
+//
+//   Translation caches.
+//
+// ========================================================================
+
+static bool l1Lookup(
+    vtp_model* model,
+    uint32_t chan,
+    uint64_t va
+)
+{
+    uint64_t p4kb = va >> VTP_MODEL_PAGE_4KB_SHIFT;
+    uint64_t p2mb = va >> VTP_MODEL_PAGE_2MB_SHIFT;
+
+    // The 4KB and 2MB caches are probed in parallel
+    if (model->config.l1_4kb_entries &&
+        (model->l1_4kb[chan][p4kb & (model->config.l1_4kb_entries - 1)] == p4kb + 1))
+    {
+        return true;
+    }
+
+    if (model->config.l1_2mb_entries &&
+        (model->l1_2mb[chan][p2mb & (model->config.l1_2mb_entries - 1)] == p2mb + 1))
+    {
+        return true;
+    }
+
+    return false;
+}
+
+
+static void l1Insert(
+    vtp_model* model,
+    uint32_t chan,
+    uint64_t va,
+    bool is_2mb
+)
+{
+    if (is_2mb)
+    {
+        if (0 == model->config.l1_2mb_entries) return;
+
+        uint64_t p = va >> VTP_MODEL_PAGE_2MB_SHIFT;
+        model->l1_2mb[chan][p & (model->config.l1_2mb_entries - 1)] = p + 1;
+    }
+    else
+    {
+        if (0 == model->config.l1_4kb_entries) return;
+
+        uint64_t p = va >> VTP_MODEL_PAGE_4KB_SHIFT;
+        model->l1_4kb[chan][p & (model->config.l1_4kb_entries - 1)] = p + 1;
+    }
+}
+
+
+static bool tlbLookup(
+    vtp_model_tag* tlb,
+    uint32_t n_sets,
+    uint32_t n_ways,
+    uint64_t page
+)
+{
+    vtp_model_tag* set = &tlb[(page & (n_sets - 1)) * n_ways];
+
+    for (uint32_t w = 0; w < n_ways; w++)
+    {
+        if (set[w] == page + 1) return true;
+    }
+
+    return false;
+}
+
+
+static void tlbInsert(
+    vtp_model* model,
+    vtp_model_tag* tlb,
+    uint32_t n_sets,
+    uint32_t n_ways,
+    uint64_t page
+)
+{
+    // The hardware picks a random victim, even when the set has
+    // invalid ways (cci_mpf_prim_repl_random).
+    uint32_t w = modelRand(model) & (n_ways - 1);
+    tlb[(page & (n_sets - 1)) * n_ways + w] = page + 1;
+}
+
+
+//
+// Tag and index in the page table walker's cache of the line holding the
+// entry for va at a depth in the table.  Depth 0 is the root.
+//
+static uint64_t ptCacheTag(uint64_t va, uint32_t depth)
+{
+    uint32_t shift = VTP_MODEL_PAGE_4KB_SHIFT +
+                     9 * (VTP_MODEL_PT_DEPTH - 1 - depth);
+    return (va >> shift) / VTP_MODEL_PT_ENTRIES_PER_LINE;
+}
+
+static uint32_t ptCacheIdx(vtp_model* model, uint64_t tag, uint32_t depth)
+{
+    // The depth is the low 2 bits of the index, giving each level its
+    // own region of the cache.
+    return ((hash32((uint32_t)tag) << 2) | depth) &
+           (model->config.pt_cache_entries - 1);
+}
+
+
+//
+// Walk the page table for va, as cci_mpf_svc_vtp_pt_walk.sv does.
+// Returns the number of page table lines read from host memory.
+//
+static uint32_t ptWalk(
+    vtp_model* model,
+    uint64_t va,
+    mpf_vtp_page_size size
+)
+{
+    // Depth of the terminal entry
+    uint32_t terminal;
+    switch (size)
+    {
+      case MPF_VTP_PAGE_1GB:
+        terminal = 1;
+        break;
+      case MPF_VTP_PAGE_2MB:
+        terminal = 2;
+        break;
+      default:
+        terminal = 3;
+    }
+
+    // The walker searches its cache for the deepest line on the path to
+    // the translation and reads the remaining levels from host memory.
+    uint32_t depth = 0;
+    if (model->config.pt_cache_entries)
+    {
+        for (int d = VTP_MODEL_PT_DEPTH - 1; d >= 0; d--)
+        {
+            uint64_t tag = ptCacheTag(va, d);
+            if (model->pt_cache[ptCacheIdx(model, tag, d)] == tag + 1)
+            {
+                model->stats.walk_cache_hits += d + 1;
+                depth = d + 1;
+                break;
+            }
+        }
+    }
+
+    uint32_t n_reads = 0;
+    for (uint32_t d = depth; d <= terminal; d++)
+    {
+        n_reads += 1;
+
+        if (model->config.pt_cache_entries)
+        {
+            uint64_t tag = ptCacheTag(va, d);
+            model->pt_cache[ptCacheIdx(model, tag, d)] = tag + 1;
+        }
+    }
+
+    return n_reads;
+}
+
+
+// ========================================================================
+//
+//   Buffer attribution.
+//
+// ========================================================================
+
+//
+// Find the extent of the allocation holding va using the allocation
+// boundary flags in the page table.
+//
+static bool findBufferExtent(
+    mpf_vtp_pt* pt,
+    const char* va,
+    const char** start,
+    const char** end
+)
+{
+    mpf_vtp_pt_paddr pa;
+    mpf_vtp_page_size size;
+    uint32_t flags;
+
+    if (FPGA_OK != mpfVtpPtTranslateVAtoPA(pt, (void*)va, &pa, &size, &flags))
+    {
+        return false;
+    }
+
+    uint64_t page_bytes = mpfPageSizeEnumToBytes(size);
+    const char* page = (const char*)((uint64_t)va & ~(page_bytes - 1));
+
+    // Walk back to the first page
+    const char* s = page;
+    uint32_t s_flags = flags;
+    while (! (s_flags & MPF_VTP_PT_FLAG_ALLOC_START) &&
+           (FPGA_OK == mpfVtpPtTranslateVAtoPA(pt, (void*)(s - 1), &pa, &size,
+                                               &s_flags)))
+    {
+        s = (const char*)((uint64_t)(s - 1) & ~(mpfPageSizeEnumToBytes(size) - 1));
+    }
+
+    // Walk forward to the last page
+    const char* e = page + page_bytes;
+    uint32_t e_flags = flags;
+    if (0 == (flags & MPF_VTP_PT_FLAG_ALLOC_END))
+    {
+        while (FPGA_OK == mpfVtpPtTranslateVAtoPA(pt, (void*)e, &pa, &size,
+                                                  &e_flags))
+        {
+            e += mpfPageSizeEnumToBytes(size);
+            if (e_flags & MPF_VTP_PT_FLAG_ALLOC_END) break;
+        }
+    }
+
+    *start = s;
+    *end = e;
+    return true;
+}
+
+
+//
+// Buffer holding va or NULL if va isn't mapped.
+//
+static vtp_model_buffer* findBuffer(
+    vtp_model* model,
+    const char* va
+)
+{
+    vtp_model_buffer* b = &model->buffers[model->last_buffer];
+    if (model->n_buffers && (va >= b->start) && (va < b->end)) return b;
+
+    // Binary search for the first buffer ending after va
+    uint32_t lo = 0;
+    uint32_t hi = model->n_buffers;
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if (model->buffers[mid].end <= va)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if ((lo < model->n_buffers) && (va >= model->buffers[lo].start))
+    {
+        model->last_buffer = lo;
+        return &model->buffers[lo];
+    }
+
+    // New buffer.  Insert it at lo to keep the list sorted.
+    const char* start;
+    const char* end;
+    if (! findBufferExtent(model->_mpf_handle->vtp.pt, va, &start, &end))
+    {
+        return NULL;
+    }
+
+    if (model->n_buffers == model->max_buffers)
+    {
+        uint32_t max_buffers = model->max_buffers ? 2 * model->max_buffers : 64;
+        vtp_model_buffer* buffers =
+            realloc(model->buffers, max_buffers * sizeof(vtp_model_buffer));
+        if (NULL == buffers) return NULL;
+
+        model->buffers = buffers;
+        model->max_buffers = max_buffers;
+    }
+
+    memmove(&model->buffers[lo + 1], &model->buffers[lo],
+            (model->n_buffers - lo) * sizeof(vtp_model_buffer));
+    model->n_buffers += 1;
+
+    b = &model->buffers[lo];
+    memset(b, 0, sizeof(vtp_model_buffer));
+    b->start = start;
+    b->end = end;
+
+    model->last_buffer = lo;
+    return b;
+}
+
+
+// ========================================================================
+//
+//   Replay.
+//
+// ========================================================================
+
+static void modelAccess(
+    vtp_model* model,
+    const mpf_vtp_model_access* a
+)
+{
+    uint64_t va = (uint64_t)a->va;
+    uint32_t chan = a->is_write ? 1 : 0;
+    mpf_vtp_model_stats* stats = &model->stats;
+
+    stats->accesses += 1;
+
+    vtp_model_buffer* b = findBuffer(model, a->va);
+    if (b) b->accesses += 1;
+
+    if (l1Lookup(model, chan, va))
+    {
+        stats->l1_hits += 1;
+        return;
+    }
+
+    uint64_t p4kb = va >> VTP_MODEL_PAGE_4KB_SHIFT;
+    uint64_t p2mb = va >> VTP_MODEL_PAGE_2MB_SHIFT;
+
+    if (tlbLookup(model->tlb_4kb, model->config.tlb_4kb_sets,
+                  model->config.tlb_4kb_ways, p4kb))
+    {
+        stats->tlb_4kb_hits += 1;
+        l1Insert(model, chan, va, false);
+        return;
+    }
+
+    if (tlbLookup(model->tlb_2mb, model->config.tlb_2mb_sets,
+                  model->config.tlb_2mb_ways, p2mb))
+    {
+        stats->tlb_2mb_hits += 1;
+        l1Insert(model, chan, va, true);
+        return;
+    }
+
+    // Miss.  Walk the page table.
+    mpf_vtp_pt_paddr pa;
+    mpf_vtp_page_size size;
+    uint32_t flags;
+    if ((FPGA_OK != mpfVtpPtTranslateVAtoPA(model->_mpf_handle->vtp.pt,
+                                            (void*)a->va, &pa, &size, &flags)) ||
+        (flags & MPF_VTP_PT_FLAG_INVALID))
+    {
+        stats->failed_walks += 1;
+        return;
+    }
+
+    uint32_t n_reads = ptWalk(model, va, size);
+    stats->walk_reads += n_reads;
+
+    if (b)
+    {
+        b->walks += 1;
+        b->walk_reads += n_reads;
+    }
+
+    // 1GB pages are held in the 2MB TLB
+    if (MPF_VTP_PAGE_4KB == size)
+    {
+        stats->walks_4kb += 1;
+        tlbInsert(model, model->tlb_4kb, model->config.tlb_4kb_sets,
+                  model->config.tlb_4kb_ways, p4kb);
+        l1Insert(model, chan, va, false);
+    }
+    else
+    {
+        stats->walks_2mb += 1;
+        tlbInsert(model, model->tlb_2mb, model->config.tlb_2mb_sets,
+                  model->config.tlb_2mb_ways, p2mb);
+        l1Insert(model, chan, va, true);
+    }
+}
+
+
+static void freeModel(vtp_model* model)
+{
+    for (int c = 0; c < 2; c++)
+    {
+        free(model->l1_4kb[c]);
+        free(model->l1_2mb[c]);
+    }
+
+    free(model->tlb_4kb);
+    free(model->tlb_2mb);
+    free(model->pt_cache);
+    free(model->buffers);
+    free(model);
+}
+
+
+void __MPF_API__ mpfVtpModelDefaultConfig(
+    mpf_vtp_model_config* config
+)
+{
+    if (NULL == config) return;
+
+    config->l1_4kb_entries = VTP_MODEL_L1_4KB_ENTRIES;
+    config->l1_2mb_entries = VTP_MODEL_L1_2MB_ENTRIES;
+    config->tlb_4kb_sets = VTP_MODEL_TLB_4KB_SETS;
+    config->tlb_4kb_ways = VTP_MODEL_TLB_4KB_WAYS;
+    config->tlb_2mb_sets = VTP_MODEL_TLB_2MB_SETS;
+    config->tlb_2mb_ways = VTP_MODEL_TLB_2MB_WAYS;
+    config->pt_cache_entries = VTP_MODEL_PT_CACHE_ENTRIES;
+    config->seed = 1;
+}
+
+
+fpga_result __MPF_API__ mpfVtpModelCreate(
+    mpf_handle_t mpf_handle,
+    const mpf_vtp_model_config* config,
+    mpf_vtp_model_t* model
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+
+    if (NULL == model) return FPGA_INVALID_PARAM;
+    *model = NULL;
+
+    if (! _mpf_handle->vtp.is_available) return FPGA_NOT_SUPPORTED;
+
+    mpf_vtp_model_config c;
+    if (config)
+    {
+        c = *config;
+    }
+    else
+    {
+        mpfVtpModelDefaultConfig(&c);
+    }
+
+    if ((c.l1_4kb_entries && ! isPow2(c.l1_4kb_entries)) ||
+        (c.l1_2mb_entries && ! isPow2(c.l1_2mb_entries)) ||
+        ! isPow2(c.tlb_4kb_sets) || ! isPow2(c.tlb_4kb_ways) ||
+        ! isPow2(c.tlb_2mb_sets) || ! isPow2(c.tlb_2mb_ways) ||
+        (c.pt_cache_entries &&
+         (! isPow2(c.pt_cache_entries) || (c.pt_cache_entries < VTP_MODEL_PT_DEPTH))))
+    {
+        return FPGA_INVALID_PARAM;
+    }
+
+    vtp_model* m = calloc(1, sizeof(vtp_model));
+    if (NULL == m) return FPGA_NO_MEMORY;
+
+    m->_mpf_handle = _mpf_handle;
+    m->config = c;
+    // xorshift state must be non-zero
+    m->rand_state = c.seed ? c.seed : 1;
+
+    // Tables are allocated with an extra entry since calloc(0) may
+    // return NULL when a cache is disabled.
+    bool ok = true;
+    for (int i = 0; i < 2; i++)
+    {
+        m->l1_4kb[i] = calloc(c.l1_4kb_entries + 1, sizeof(vtp_model_tag));
+        m->l1_2mb[i] = calloc(c.l1_2mb_entries + 1, sizeof(vtp_model_tag));
+        ok = ok && m->l1_4kb[i] && m->l1_2mb[i];
+    }
+
+    m->tlb_4kb = calloc((size_t)c.tlb_4kb_sets * c.tlb_4kb_ways,
+                        sizeof(vtp_model_tag));
+    m->tlb_2mb = calloc((size_t)c.tlb_2mb_sets * c.tlb_2mb_ways,
+                        sizeof(vtp_model_tag));
+    m->pt_cache = calloc(c.pt_cache_entries + 1, sizeof(vtp_model_tag));
+
+    if (! ok || ! m->tlb_4kb || ! m->tlb_2mb || ! m->pt_cache)
+    {
+        freeModel(m);
+        return FPGA_NO_MEMORY;
+    }
+
+    *model = m;
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfVtpModelDestroy(
+    mpf_vtp_model_t model
+)
+{
+    if (NULL == model) return FPGA_INVALID_PARAM;
+
+    freeModel((vtp_model*)model);
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfVtpModelReplay(
+    mpf_vtp_model_t model,
+    const mpf_vtp_model_access* trace,
+    size_t n
+)
+{
+    vtp_model* m = (vtp_model*)model;
+
+    if ((NULL == m) || ((NULL == trace) && n)) return FPGA_INVALID_PARAM;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        modelAccess(m, &trace[i]);
+    }
+
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfVtpModelInvalidate(
+    mpf_vtp_model_t model
+)
+{
+    vtp_model* m = (vtp_model*)model;
+    if (NULL == m) return FPGA_INVALID_PARAM;
+
+    const mpf_vtp_model_config* c = &m->config;
+    for (int i = 0; i < 2; i++)
+    {
+        memset(m->l1_4kb[i], 0, c->l1_4kb_entries * sizeof(vtp_model_tag));
+        memset(m->l1_2mb[i], 0, c->l1_2mb_entries * sizeof(vtp_model_tag));
+    }
+
+    memset(m->tlb_4kb, 0,
+           (size_t)c->tlb_4kb_sets * c->tlb_4kb_ways * sizeof(vtp_model_tag));
+    memset(m->tlb_2mb, 0,
+           (size_t)c->tlb_2mb_sets * c->tlb_2mb_ways * sizeof(vtp_model_tag));
+    memset(m->pt_cache, 0, c->pt_cache_entries * sizeof(vtp_model_tag));
+
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfVtpModelClearStats(
+    mpf_vtp_model_t model
+)
+{
+    vtp_model* m = (vtp_model*)model;
+    if (NULL == m) return FPGA_INVALID_PARAM;
+
+    memset(&m->stats, 0, sizeof(m->stats));
+
+    for (uint32_t i = 0; i < m->n_buffers; i++)
+    {
+        m->buffers[i].accesses = 0;
+        m->buffers[i].walks = 0;
+        m->buffers[i].walk_reads = 0;
+    }
+
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfVtpModelGetStats(
+    mpf_vtp_model_t model,
+    mpf_vtp_model_stats* stats
+)
+{
+    vtp_model* m = (vtp_model*)model;
+    if ((NULL == m) || (NULL == stats)) return FPGA_INVALID_PARAM;
+
+    *stats = m->stats;
+
+    uint64_t l1_misses = stats->accesses - stats->l1_hits;
+    uint64_t tlb_hits = stats->tlb_4kb_hits + stats->tlb_2mb_hits;
+    uint64_t walks = stats->walks_4kb + stats->walks_2mb;
+
+    stats->l1_hit_rate = stats->accesses ?
+        (double)stats->l1_hits / stats->accesses : 0;
+    stats->tlb_hit_rate = l1_misses ?
+        (double)tlb_hits / l1_misses : 0;
+    stats->hit_rate = stats->accesses ?
+        (double)(stats->l1_hits + tlb_hits) / stats->accesses : 0;
+    stats->reads_per_walk = walks ?
+        (double)stats->walk_reads / walks : 0;
+
+    return FPGA_OK;
+}
+
+
+static int cmpBufferWalks(const void* a, const void* b)
+{
+    const mpf_vtp_model_buffer_stats* ba = a;
+    const mpf_vtp_model_buffer_stats* bb = b;
+
+    if (ba->walks != bb->walks) return (ba->walks < bb->walks) ? 1 : -1;
+    if (ba->accesses != bb->accesses) return (ba->accesses < bb->accesses) ? 1 : -1;
+    return (ba->va < bb->va) ? -1 : (ba->va > bb->va);
+}
+
+
+fpga_result __MPF_API__ mpfVtpModelGetTopBuffers(
+    mpf_vtp_model_t model,
+    mpf_vtp_model_buffer_stats* buffers,
+    uint32_t max_buffers,
+    uint32_t* n_buffers
+)
+{
+    vtp_model* m = (vtp_model*)model;
+    if ((NULL == m) || (NULL == n_buffers) || ((NULL == buffers) && max_buffers))
+    {
+        return FPGA_INVALID_PARAM;
+    }
+
+    *n_buffers = 0;
+    if (0 == m->n_buffers) return FPGA_OK;
+
+    mpf_vtp_model_buffer_stats* all =
+        malloc(m->n_buffers * sizeof(mpf_vtp_model_buffer_stats));
+    if (NULL == all) return FPGA_NO_MEMORY;
+
+    for (uint32_t i = 0; i < m->n_buffers; i++)
+    {
+        all[i].va = m->buffers[i].start;
+        all[i].len = m->buffers[i].end - m->buffers[i].start;
+        all[i].accesses = m->buffers[i].accesses;
+        all[i].walks = m->buffers[i].walks;
+        all[i].walk_reads = m->buffers[i].walk_reads;
+    }
+
+    qsort(all, m->n_buffers, sizeof(mpf_vtp_model_buffer_stats), cmpBufferWalks);
+
+    uint32_t n = (m->n_buffers < max_buffers) ? m->n_buffers : max_buffers;
+    memcpy(buffers, all, n * sizeof(mpf_vtp_model_buffer_stats));
+    *n_buffers = n;
+
+    free(all);
+    return FPGA_OK;
+}
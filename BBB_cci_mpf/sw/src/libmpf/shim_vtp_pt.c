@@ -53,18 +53,6 @@ static void nodeReset(
     memset(node, -1, sizeof(mpf_vtp_pt_node));
 }
 
-static bool nodeIsEmpty(
-    mpf_vtp_pt_node* node
-)
-{
-    for (int idx = 0; idx < 512; idx++)
-    {
-        if ((*node)[idx] != -1) return false;
-    }
-
-    return true;
-}
-
 // Does an entry exist at the index?
 static bool nodeEntryExists(
     mpf_vtp_pt_node* node,
@@ -159,7 +147,7 @@ static void nodeInsertChildAddr(
 {
     if (idx < 512)
     {
-        (*node)[idx] = addr;
+        mpfOsAtomicStore64(&(*node)[idx], addr);
     }
 }
 
@@ -173,7 +161,7 @@ static void nodeInsertTranslatedAddr(
 {
     if (idx < 512)
     {
-        (*node)[idx] = addr | MPF_VTP_PT_FLAG_TERMINAL | flags;
+        mpfOsAtomicStore64(&(*node)[idx], addr | MPF_VTP_PT_FLAG_TERMINAL | flags);
     }
 }
 
@@ -184,78 +172,271 @@ static void nodeRemoveTranslatedAddr(
 {
     if (idx < 512)
     {
-        (*node)[idx] = -1;
+        mpfOsAtomicStore64(&(*node)[idx], -1);
     }
 }
 
 
+//
+// Lock-free readers.
+//
+// Walks that don't hold the page table mutex may run concurrently with
+// updates.  Writers fully initialize a node before publishing a pointer
+// to it with a release store, so a reader that loads each entry exactly
+// once with acquire semantics always sees a consistent entry.  The
+// functions above may read an entry more than once and are safe only
+// for writers holding the mutex.
+//
+
+static int64_t nodeLoadEntry(
+    mpf_vtp_pt_node* node,
+    uint64_t idx
+)
+{
+    return mpfOsAtomicLoad64(&(*node)[idx]);
+}
+
+static bool entryExists(
+    int64_t entry
+)
+{
+    return (entry != -1);
+}
+
+static bool entryIsTerminal(
+    int64_t entry
+)
+{
+    return (entry & MPF_VTP_PT_FLAG_TERMINAL) != 0;
+}
+
+static int64_t entryGetTranslatedAddr(
+    int64_t entry
+)
+{
+    return entry & ~ (int64_t)MPF_VTP_PT_FLAG_MASK;
+}
+
+static uint32_t entryGetTranslatedAddrFlags(
+    int64_t entry
+)
+{
+    return (uint32_t)entry & (uint32_t)MPF_VTP_PT_FLAG_MASK;
+}
+
+
 
 // ========================================================================
 //
-// Page table node wsid tracker.
+// Page table node arena.
+//
+// Nodes of the FPGA-visible table are carved from chunks of memory that
+// are each pinned with a single driver call.  Chunks are 2MB when the
+// driver can provide them, holding 512 nodes, and single nodes otherwise.
 //
 // ========================================================================
 
 //
-// Add a new I/O mapped page table node to the tracker.
+// Allocate a shared page with the FPGA.
 //
-static fpga_result trackNodeWsid(
+static fpga_result ptAllocSharedPage(
     mpf_vtp_pt* pt,
-    uint64_t wsid
+    uint64_t length,
+    int fpga_flags,
+    mpf_vtp_pt_vaddr* va_p,
+    mpf_vtp_pt_paddr* pa_p,
+    uint64_t* wsid_p
 )
 {
-    struct v_to_p_wsid* trk = pt->v_to_p_wsid;
+    fpga_result r;
+
+    *va_p = NULL;
+    *wsid_p = 0;
+    r = mpfDevPrepareBuffer(pt->_mpf_handle, length,
+                            (void*)va_p, wsid_p, fpga_flags);
+    if (r != FPGA_OK) return r;
 
-    if ((NULL == trk) || (N_V_TO_P_WSID_ENTRIES == trk->n_entries))
+    // Get the FPGA-side physical address
+    r = mpfDevGetIOAddress(pt->_mpf_handle, *wsid_p, pa_p);
+    if (r != FPGA_OK)
     {
-        // Need a new tracker entry in the linked list
-        trk = malloc(sizeof(struct v_to_p_wsid));
-        if (NULL == trk) return FPGA_NO_MEMORY;
+        mpfDevReleaseBuffer(pt->_mpf_handle, *wsid_p);
+        return r;
+    }
 
-        // Push the new tracker entry on the head of the list
-        trk->next = pt->v_to_p_wsid;
-        trk->n_entries = 0;
-        pt->v_to_p_wsid = trk;
+    if (pt->_mpf_handle->dbg_mode)
+    {
+        MPF_FPGA_MSG("allocate I/O mapped page table chunk VA %p, PA 0x%" PRIx64 ", wsid 0x%" PRIx64 ", %" PRIu64 " bytes",
+                     *va_p, *pa_p, *wsid_p, length);
     }
 
-    // Add wsid to the tracker
-    trk->wsid[trk->n_entries++] = wsid;
+    return r;
+}
+
+
+//
+// Find the chunk holding a physical address.  The index is sorted by PA.
+//
+static const mpf_vtp_pt_chunk* arenaFindChunk(
+    const mpf_vtp_pt_chunk_index* index,
+    mpf_vtp_pt_paddr pa
+)
+{
+    if (NULL == index) return NULL;
+
+    // Find the last chunk starting at or below pa
+    uint64_t lo = 0;
+    uint64_t hi = index->n_chunks;
+    while (hi - lo > 1)
+    {
+        uint64_t mid = (lo + hi) / 2;
+        if (index->chunks[mid].pa <= pa)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    const mpf_vtp_pt_chunk* chunk = &index->chunks[lo];
+    if ((pa < chunk->pa) || (pa - chunk->pa >= chunk->n_bytes)) return NULL;
+
+    return chunk;
+}
+
+
+//
+// Pin a new chunk and publish an index that includes it.
+//
+static fpga_result arenaAddChunk(
+    mpf_vtp_pt* pt
+)
+{
+    fpga_result r;
+    mpf_vtp_pt_chunk chunk;
+
+    if (0 == pt->chunk_bytes)
+    {
+        pt->chunk_bytes = mpfPageSizeEnumToBytes(MPF_VTP_PAGE_2MB);
+    }
+
+    chunk.n_bytes = pt->chunk_bytes;
+    r = ptAllocSharedPage(pt, chunk.n_bytes,
+                          (chunk.n_bytes > sizeof(mpf_vtp_pt_node)) ? FPGA_BUF_QUIET : 0,
+                          &chunk.va, &chunk.pa, &chunk.wsid);
+    if ((FPGA_OK != r) && (chunk.n_bytes > sizeof(mpf_vtp_pt_node)))
+    {
+        // The driver can't provide large chunks.  Allocate nodes one
+        // at a time from now on.
+        pt->chunk_bytes = sizeof(mpf_vtp_pt_node);
+        return arenaAddChunk(pt);
+    }
+    if (FPGA_OK != r) return r;
+
+    // Build a new index with the chunk inserted in PA order
+    const mpf_vtp_pt_chunk_index* old_index = pt->chunk_index;
+    uint64_t n_old = (old_index ? old_index->n_chunks : 0);
+
+    mpf_vtp_pt_chunk_index* index =
+        malloc(sizeof(mpf_vtp_pt_chunk_index) +
+               (n_old + 1) * sizeof(mpf_vtp_pt_chunk));
+    if (NULL == index)
+    {
+        mpfDevReleaseBuffer(pt->_mpf_handle, chunk.wsid);
+        return FPGA_NO_MEMORY;
+    }
+
+    uint64_t n = 0;
+    for (uint64_t i = 0; i < n_old; i++)
+    {
+        if ((n == i) && (old_index->chunks[i].pa > chunk.pa))
+        {
+            index->chunks[n++] = chunk;
+        }
+        index->chunks[n++] = old_index->chunks[i];
+    }
+    if (n == n_old)
+    {
+        index->chunks[n++] = chunk;
+    }
+    index->n_chunks = n;
+    index->prev = pt->chunk_index;
+
+    // Publish the new index.  Lock-free readers may still be using the
+    // old one, so it is kept until the table is destroyed.
+    mpfOsAtomicStore64((int64_t*)&pt->chunk_index, (int64_t)index);
+
+    pt->chunk_next_node = (mpf_vtp_pt_node*)chunk.va;
+    pt->chunk_next_pa = chunk.pa;
+    pt->chunk_n_free = chunk.n_bytes / sizeof(mpf_vtp_pt_node);
 
     return FPGA_OK;
 }
 
 
 //
-// Release all I/O mapped page table nodes
+// Take a node from the arena.  Nodes are returned to the free list
+// when no longer needed, never to the arena.
 //
-static fpga_result releaseTrackedNodes(
+static fpga_result arenaAllocNode(
+    mpf_vtp_pt* pt,
+    mpf_vtp_pt_node** node_p,
+    mpf_vtp_pt_paddr* pa_p
+)
+{
+    if (0 == pt->chunk_n_free)
+    {
+        fpga_result r = arenaAddChunk(pt);
+        if (FPGA_OK != r) return r;
+    }
+
+    *node_p = pt->chunk_next_node;
+    *pa_p = pt->chunk_next_pa;
+
+    pt->chunk_next_node += 1;
+    pt->chunk_next_pa += sizeof(mpf_vtp_pt_node);
+    pt->chunk_n_free -= 1;
+
+    return FPGA_OK;
+}
+
+
+//
+// Release all I/O mapped page table chunks
+//
+static void arenaRelease(
     mpf_vtp_pt* pt
 )
 {
-    struct v_to_p_wsid* trk = pt->v_to_p_wsid;
-    pt->v_to_p_wsid = NULL;
+    mpf_vtp_pt_chunk_index* index = pt->chunk_index;
+    pt->chunk_index = NULL;
 
-    while (NULL != trk)
+    if (NULL != index)
     {
-        for (uint32_t i = 0; i < trk->n_entries; i++)
+        for (uint64_t i = 0; i < index->n_chunks; i++)
         {
             if (pt->_mpf_handle->dbg_mode)
             {
-                MPF_FPGA_MSG("release I/O mapped TLB node wsid 0x%" PRIx64,
-                             trk->wsid[i]);
+                MPF_FPGA_MSG("release I/O mapped page table chunk wsid 0x%" PRIx64,
+                             index->chunks[i].wsid);
             }
 
-            assert(FPGA_OK == fpgaReleaseBuffer(pt->_mpf_handle->handle,
-                                                trk->wsid[i]));
+            assert(FPGA_OK == mpfDevReleaseBuffer(pt->_mpf_handle,
+                                                  index->chunks[i].wsid));
         }
+    }
 
-        // Done with this tracker node.  Release it and move on to the next.
-        struct v_to_p_wsid* trk_next = trk->next;
-        free(trk);
-        trk = trk_next;
+    // Drop the current and all retired indices
+    while (NULL != index)
+    {
+        mpf_vtp_pt_chunk_index* prev = index->prev;
+        free(index);
+        index = prev;
     }
 
-    return FPGA_OK;
+    pt->chunk_n_free = 0;
 }
 
 
@@ -265,14 +446,6 @@ static fpga_result releaseTrackedNodes(
 //
 // ========================================================================
 
-static fpga_result addPAtoVA(
-    mpf_vtp_pt* pt,
-    mpf_vtp_pt_paddr pa,
-    mpf_vtp_pt_vaddr va,
-    uint32_t depth
-);
-
-
 //
 // Compute the node index at specified depth in the tree of a page table
 // for the given address.
@@ -301,59 +474,14 @@ static fpga_result ptTranslatePAtoVA(
     mpf_vtp_pt_vaddr *va
 )
 {
-    mpf_vtp_pt_node* table = pt->p_to_v;
-
-    uint32_t depth = 4;
-    while (depth--)
-    {
-        // Index in the current level
-        uint64_t idx = ptIdxFromAddr((uint64_t)pa, depth);
-
-        if (! nodeEntryExists(table, idx)) return FPGA_NOT_FOUND;
-
-        if (nodeEntryIsTerminal(table, idx))
-        {
-            *va = (mpf_vtp_pt_vaddr)nodeGetTranslatedAddr(table, idx);
-            return FPGA_OK;
-        }
-
-        // Walk down to child
-        table = (mpf_vtp_pt_node*)nodeGetChildAddr(table, idx);
-    }
-
-    return FPGA_NOT_FOUND;
-}
-
-
-//
-// Allocate a shared page with the FPGA.
-//
-static fpga_result ptAllocSharedPage(
-    mpf_vtp_pt* pt,
-    uint64_t length,
-    mpf_vtp_pt_vaddr* va_p,
-    mpf_vtp_pt_paddr* pa_p,
-    uint64_t* wsid_p
-)
-{
-    fpga_result r;
-
-    *va_p = NULL;
-    *wsid_p = 0;
-    r = fpgaPrepareBuffer(pt->_mpf_handle->handle, length,
-                          (void*)va_p, wsid_p, 0);
-    if (r != FPGA_OK) return r;
-
-    // Get the FPGA-side physical address
-    r = fpgaGetIOAddress(pt->_mpf_handle->handle, *wsid_p, pa_p);
+    const mpf_vtp_pt_chunk_index* index =
+        (const mpf_vtp_pt_chunk_index*)mpfOsAtomicLoad64((int64_t*)&pt->chunk_index);
 
-    if (pt->_mpf_handle->dbg_mode)
-    {
-        MPF_FPGA_MSG("allocate I/O mapped TLB node VA %p, PA 0x%" PRIx64 ", wsid 0x%" PRIx64,
-                     *va_p, *pa_p, *wsid_p);
-    }
+    const mpf_vtp_pt_chunk* chunk = arenaFindChunk(index, pa);
+    if (NULL == chunk) return FPGA_NOT_FOUND;
 
-    return r;
+    *va = (mpf_vtp_pt_vaddr)((char*)chunk->va + (pa - chunk->pa));
+    return FPGA_OK;
 }
 
 
@@ -377,21 +505,9 @@ static fpga_result ptAllocTableNode(
     }
     else
     {
-        // Need a new page
-        fpga_result r;
-        uint64_t wsid;
-
-        // Virtual to physical map is shared with the FPGA
-        r = ptAllocSharedPage(pt, sizeof(mpf_vtp_pt_node),
-                              (mpf_vtp_pt_vaddr*)&n, pa_p, &wsid);
-        if (r != FPGA_OK) return r;
-
-        r = trackNodeWsid(pt, wsid);
-        if (FPGA_OK != r) return r;
-
-        // Add new page to physical to virtual translation so the table
-        // can be walked in software
-        r = addPAtoVA(pt, *pa_p, (mpf_vtp_pt_vaddr)n, 4);
+        // Need a new page.  The virtual to physical map is shared with
+        // the FPGA.
+        fpga_result r = arenaAllocNode(pt, &n, pa_p);
         if (r != FPGA_OK) return r;
     }
 
@@ -418,21 +534,22 @@ static fpga_result ptFreeTableNode(
 }
 
 
-static fpga_result addVAtoPA(
+//
+// Walk from the root to the node that will hold a translation at the
+// requested depth, adding nodes to the table as needed.  The corresponding
+// node in the parallel VA to wsid table is also returned.
+//
+static fpga_result ptFindLeafNode(
     mpf_vtp_pt* pt,
     mpf_vtp_pt_vaddr va,
-    mpf_vtp_pt_paddr pa,
-    uint64_t wsid,
     uint32_t depth,
-    uint32_t flags
+    mpf_vtp_pt_node** table_p,
+    mpf_vtp_pt_node** wsid_table_p
 )
 {
     mpf_vtp_pt_node* table = pt->v_to_p;
     mpf_vtp_pt_node* wsid_table = pt->v_to_wsid;
 
-    // Index in the leaf page
-    uint64_t leaf_idx = ptIdxFromAddr((uint64_t)va, 4 - depth);
-
     uint32_t cur_depth = 4;
     while (--depth)
     {
@@ -472,116 +589,138 @@ static fpga_result addVAtoPA(
         wsid_table = (mpf_vtp_pt_node*)nodeGetChildAddr(wsid_table, idx);
     }
 
-    // Now at the leaf.  Add the translation.
-    if (nodeEntryExists(table, leaf_idx))
-    {
-        if ((cur_depth == 2) && ! nodeEntryIsTerminal(table, leaf_idx))
-        {
-            // Entry exists while trying to add a 2MB entry.  Perhaps there is
-            // an old leaf that used to hold 4KB pages.  If the existing
-            // entry has no active pages then get rid of it.
-            mpf_vtp_pt_paddr child_pa = nodeGetChildAddr(table, leaf_idx);
-            mpf_vtp_pt_vaddr child_va;
-            if (FPGA_OK != ptTranslatePAtoVA(pt, child_pa, &child_va)) return FPGA_EXCEPTION;
+    *table_p = table;
+    *wsid_table_p = wsid_table;
+    return FPGA_OK;
+}
 
-            mpf_vtp_pt_node* child_node = (mpf_vtp_pt_node*)child_va;
-            if (! nodeIsEmpty(child_node)) return FPGA_EXCEPTION;
 
-            // The old page that held 4KB translations is now empty and the
-            // pointer will be overwritten with a 2MB page pointer.
-            ptFreeTableNode(pt, child_node, child_pa);
+//
+// Is a subtree free of translations?  Empty interior nodes may remain
+// after pages are removed.
+//
+static bool ptSubtreeIsEmpty(
+    mpf_vtp_pt* pt,
+    mpf_vtp_pt_node* table
+)
+{
+    for (uint64_t idx = 0; idx < 512; idx++)
+    {
+        if (! nodeEntryExists(table, idx)) continue;
+        if (nodeEntryIsTerminal(table, idx)) return false;
 
-            // Free the parallel VA to wsid node
-            free((void*)nodeGetChildAddr(wsid_table, leaf_idx));
-        }
-        else
+        mpf_vtp_pt_vaddr child_va;
+        if (FPGA_OK != ptTranslatePAtoVA(pt, nodeGetChildAddr(table, idx), &child_va))
         {
-            return FPGA_EXCEPTION;
+            return false;
         }
-    }
 
-    nodeInsertTranslatedAddr(table, leaf_idx, pa, flags);
-    nodeInsertChildAddr(wsid_table, leaf_idx, wsid);
-
-    // Memory fence for updates before claiming the table is ready
-    mpfOsMemoryBarrier();
+        if (! ptSubtreeIsEmpty(pt, (mpf_vtp_pt_node*)child_va)) return false;
+    }
 
-    return FPGA_OK;
+    return true;
 }
 
 
-static fpga_result addPAtoVA(
+//
+// Return the nodes of a subtree with no translations to the free list.
+//
+static void ptFreeSubtree(
     mpf_vtp_pt* pt,
-    mpf_vtp_pt_paddr pa,
-    mpf_vtp_pt_vaddr va,
-    uint32_t depth
+    mpf_vtp_pt_node* table,
+    mpf_vtp_pt_paddr table_pa,
+    mpf_vtp_pt_node* wsid_table
 )
 {
-    mpf_vtp_pt_node* table = pt->p_to_v;
-
-    // Index in the leaf page
-    uint64_t leaf_idx = ptIdxFromAddr((uint64_t)pa, 4 - depth);
-
-    uint32_t cur_depth = 4;
-    while (--depth)
+    for (uint64_t idx = 0; idx < 512; idx++)
     {
-        // Drop 4KB page offset
-        uint64_t idx = ptIdxFromAddr((uint64_t)pa, --cur_depth);
+        if (! nodeEntryExists(table, idx)) continue;
 
-        // Need a new page in the table?
-        if (! nodeEntryExists(table, idx))
-        {
-            // Add new page to the host-side-only physical to virtual table
-            mpf_vtp_pt_node* child_node = malloc(sizeof(mpf_vtp_pt_node));
-            if (NULL == child_node) return FPGA_NO_MEMORY;
-            nodeReset(child_node);
-
-            nodeInsertChildAddr(table, idx, (int64_t)child_node);
-        }
-
-        // Are we being asked to add an entry below a larger region that
-        // is already mapped?
-        if (nodeEntryIsTerminal(table, idx)) return FPGA_EXCEPTION;
+        mpf_vtp_pt_paddr child_pa = nodeGetChildAddr(table, idx);
+        mpf_vtp_pt_vaddr child_va;
+        if (FPGA_OK != ptTranslatePAtoVA(pt, child_pa, &child_va)) continue;
 
-        // Continue down the tree
-        table = (mpf_vtp_pt_node*)nodeGetChildAddr(table, idx);
+        ptFreeSubtree(pt, (mpf_vtp_pt_node*)child_va, child_pa,
+                      (mpf_vtp_pt_node*)nodeGetChildAddr(wsid_table, idx));
     }
 
-    // Now at the leaf.  Add the translation.
-    nodeInsertTranslatedAddr(table, leaf_idx, (int64_t)va, 0);
-    return FPGA_OK;
+    ptFreeTableNode(pt, table, table_pa);
+    free(wsid_table);
 }
 
 
 //
-// Release internal PA to VA mapping nodes.
+// Add a translation to a leaf node found by ptFindLeafNode().
 //
-static fpga_result freePAtoVA(
+static fpga_result ptInsertLeafEntry(
     mpf_vtp_pt* pt,
     mpf_vtp_pt_node* table,
-    uint32_t depth
+    mpf_vtp_pt_node* wsid_table,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr pa,
+    uint64_t wsid,
+    uint32_t depth,
+    uint32_t flags
 )
 {
-    for (uint64_t idx = 0; idx < 512; idx++)
+    // Index in the leaf page
+    uint64_t leaf_idx = ptIdxFromAddr((uint64_t)va, 4 - depth);
+
+    if (nodeEntryExists(table, leaf_idx))
     {
-        if (nodeEntryExists(table, idx) && ! nodeEntryIsTerminal(table, idx))
+        if ((depth < 4) && ! nodeEntryIsTerminal(table, leaf_idx))
         {
-            // Recursive walk down the tree
-            assert(depth != 1);
+            // Entry exists while trying to add a large page.  Perhaps there
+            // are old nodes that used to hold smaller pages.  If the existing
+            // subtree has no active pages then get rid of it.
+            mpf_vtp_pt_paddr child_pa = nodeGetChildAddr(table, leaf_idx);
+            mpf_vtp_pt_vaddr child_va;
+            if (FPGA_OK != ptTranslatePAtoVA(pt, child_pa, &child_va)) return FPGA_EXCEPTION;
 
-            mpf_vtp_pt_node* child_table;
-            child_table = (mpf_vtp_pt_node*)nodeGetChildAddr(table, idx);
+            mpf_vtp_pt_node* child_node = (mpf_vtp_pt_node*)child_va;
+            if (! ptSubtreeIsEmpty(pt, child_node)) return FPGA_EXCEPTION;
 
-            freePAtoVA(pt, child_table, depth - 1);
+            // The old nodes are now empty and the pointer will be
+            // overwritten with a large page translation.  The parallel
+            // VA to wsid nodes are freed too.
+            ptFreeSubtree(pt, child_node, child_pa,
+                          (mpf_vtp_pt_node*)nodeGetChildAddr(wsid_table, leaf_idx));
+        }
+        else
+        {
+            return FPGA_EXCEPTION;
         }
     }
 
-    // Done with this node in the table
-    if (pt->_mpf_handle->dbg_mode)
-    {
-        MPF_FPGA_MSG("release PA->VA node %p", table);
-    }
-    free(table);
+    nodeInsertTranslatedAddr(table, leaf_idx, pa, flags);
+    nodeInsertChildAddr(wsid_table, leaf_idx, wsid);
+
+    return FPGA_OK;
+}
+
+
+static fpga_result addVAtoPA(
+    mpf_vtp_pt* pt,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr pa,
+    uint64_t wsid,
+    uint32_t depth,
+    uint32_t flags
+)
+{
+    fpga_result r;
+    mpf_vtp_pt_node* table;
+    mpf_vtp_pt_node* wsid_table;
+
+    r = ptFindLeafNode(pt, va, depth, &table, &wsid_table);
+    if (FPGA_OK != r) return r;
+
+    // Now at the leaf.  Add the translation.
+    r = ptInsertLeafEntry(pt, table, wsid_table, va, pa, wsid, depth, flags);
+    if (FPGA_OK != r) return r;
+
+    // Memory fence for updates before claiming the table is ready
+    mpfOsMemoryBarrier();
 
     return FPGA_OK;
 }
@@ -607,7 +746,14 @@ static void freeAllMappedPages(
         {
             if (nodeEntryIsTerminal(table, idx))
             {
-                // Found an allocated page.  Free it.
+                // Found an allocated page.  Pages pinned along with an
+                // earlier page are released when the first page is freed.
+                if (nodeGetTranslatedAddrFlags(table, idx) & MPF_VTP_PT_FLAG_WSID_SHARED)
+                {
+                    continue;
+                }
+
+                // Free the page.
                 uint64_t wsid = nodeGetValue(wsid_table, idx);
 
                 if (pt->_mpf_handle->dbg_mode)
@@ -615,7 +761,7 @@ static void freeAllMappedPages(
                     MPF_FPGA_MSG("release page wsid 0x%" PRIx64, wsid);
                 }
 
-                fpgaReleaseBuffer(pt->_mpf_handle->handle, wsid);
+                mpfDevReleaseBuffer(pt->_mpf_handle, wsid);
             }
             else
             {
@@ -666,6 +812,9 @@ static void dumpPageTableVAtoPA(
                   case 2:
                     kind = "2MB";
                     break;
+                  case 3:
+                    kind = "1GB";
+                    break;
                   default:
                     kind = "?";
                     break;
@@ -685,13 +834,15 @@ static void dumpPageTableVAtoPA(
                     if (flags & MPF_VTP_PT_FLAG_ALLOC_END) printf(" END");
                     if (flags & MPF_VTP_PT_FLAG_INVALID) printf(" INVALID");
                     if (flags & MPF_VTP_PT_FLAG_PREALLOCATED) printf(" PREALLOC");
+                    if (flags & MPF_VTP_PT_FLAG_WSID_SHARED) printf(" SHARED");
+                    if (flags & MPF_VTP_PT_FLAG_POOLED) printf(" POOLED");
                     printf(" ]");
                 }
                 printf("\n");
 
                 // Validate translation function
                 mpf_vtp_pt_paddr check_pa;
-                assert(FPGA_OK == mpfVtpPtTranslateVAtoPA(pt, (mpf_vtp_pt_vaddr)va, &check_pa, NULL));
+                assert(FPGA_OK == mpfVtpPtTranslateVAtoPA(pt, (mpf_vtp_pt_vaddr)va, &check_pa, NULL, NULL));
                 assert(nodeGetTranslatedAddr(table, idx) == (int64_t) check_pa);
             }
             else
@@ -728,7 +879,6 @@ fpga_result mpfVtpPtInit(
 {
     fpga_result r;
     mpf_vtp_pt* new_pt;
-    uint64_t wsid;
 
     new_pt = malloc(sizeof(mpf_vtp_pt));
     *pt = new_pt;
@@ -738,25 +888,18 @@ fpga_result mpfVtpPtInit(
     new_pt->_mpf_handle = _mpf_handle;
 
     // Virtual to physical map is shared with the FPGA
-    r = ptAllocSharedPage(new_pt, sizeof(mpf_vtp_pt_node),
-                          (mpf_vtp_pt_vaddr*)&(new_pt->v_to_p),
-                          &(new_pt->pt_root_paddr),
-                          &wsid);
+    r = arenaAllocNode(new_pt, &(new_pt->v_to_p), &(new_pt->pt_root_paddr));
     if (FPGA_OK != r) return r;
     nodeReset(new_pt->v_to_p);
 
-    r = trackNodeWsid(new_pt, wsid);
-    if (FPGA_OK != r) return r;
-
     // Virtual to wsid is used only in software
     new_pt->v_to_wsid = malloc(sizeof(mpf_vtp_pt_node));
     if (NULL == new_pt->v_to_wsid) return FPGA_NO_MEMORY;
     nodeReset(new_pt->v_to_wsid);
 
-    // Physical to virtual map is used only in software
-    new_pt->p_to_v = malloc(sizeof(mpf_vtp_pt_node));
-    if (NULL == new_pt->p_to_v) return FPGA_NO_MEMORY;
-    nodeReset(new_pt->p_to_v);
+    // Serialize updates.  Translation doesn't take the lock.
+    r = mpfOsPrepareMutex(&(new_pt->mutex));
+    if (FPGA_OK != r) return r;
 
     return FPGA_OK;
 }
@@ -771,12 +914,13 @@ fpga_result mpfVtpPtTerm(
     // The v_to_wsid table was released by freeAllMappedPages.
     pt->v_to_wsid = NULL;
 
-    // Drop the PA to VA table
-    freePAtoVA(pt, pt->p_to_v, 4);
-    pt->p_to_v = NULL;
-
     // Drop the I/O mapped virtual to physical TLB nodes
-    releaseTrackedNodes(pt);
+    arenaRelease(pt);
+
+    if (pt->mutex)
+    {
+        mpfOsReleaseMutex(pt->mutex);
+    }
 
     // Release the top-level page table descriptor
     free(pt);
@@ -793,6 +937,63 @@ mpf_vtp_pt_paddr mpfVtpPtGetPageTableRootPA(
 }
 
 
+//
+// Page size of a translation found while walking from the root.  Depth
+// counts down from 3 at the root, as in ptIdxFromAddr().
+//
+static mpf_vtp_page_size ptPageSizeAtDepth(
+    uint32_t depth
+)
+{
+    switch (depth)
+    {
+      case 2:
+        return MPF_VTP_PAGE_1GB;
+      case 1:
+        return MPF_VTP_PAGE_2MB;
+      default:
+        return MPF_VTP_PAGE_4KB;
+    }
+}
+
+
+//
+// Check that a mapping is aligned to its page size and return the depth
+// of the translation in the table.
+//
+static fpga_result ptMappingDepth(
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr pa,
+    mpf_vtp_page_size size,
+    uint32_t* depth
+)
+{
+    switch (size)
+    {
+      case MPF_VTP_PAGE_4KB:
+        *depth = 4;
+        break;
+      case MPF_VTP_PAGE_2MB:
+        *depth = 3;
+        break;
+      case MPF_VTP_PAGE_1GB:
+        *depth = 2;
+        break;
+      default:
+        return FPGA_INVALID_PARAM;
+    }
+
+    // Are the addresses reasonable?
+    uint64_t mask = mpfPageSizeEnumToBytes(size) - 1;
+    if ((0 != ((uint64_t)va & mask)) || (0 != (pa & mask)))
+    {
+        return FPGA_INVALID_PARAM;
+    }
+
+    return FPGA_OK;
+}
+
+
 fpga_result mpfVtpPtInsertPageMapping(
     mpf_vtp_pt* pt,
     mpf_vtp_pt_vaddr va,
@@ -802,21 +1003,78 @@ fpga_result mpfVtpPtInsertPageMapping(
     uint32_t flags
 )
 {
-    // Are the addresses reasonable?
-    uint64_t mask = (size == MPF_VTP_PAGE_4KB) ? (1 << 12) - 1 :
-                                                 (1 << 21) - 1;
-    if ((0 != ((uint64_t)va & mask)) || (0 != (pa & mask)))
+    fpga_result r;
+    uint32_t depth;
+
+    r = ptMappingDepth(va, pa, size, &depth);
+    if (FPGA_OK != r) return r;
+
+    mpfOsLockMutex(pt->mutex);
+    r = addVAtoPA(pt, va, pa, wsid, depth, flags);
+    mpfOsUnlockMutex(pt->mutex);
+
+    return r;
+}
+
+
+fpga_result mpfVtpPtInsertPageMappings(
+    mpf_vtp_pt* pt,
+    const mpf_vtp_pt_mapping* mappings,
+    uint32_t n_mappings,
+    uint32_t* n_inserted
+)
+{
+    fpga_result r = FPGA_OK;
+    uint32_t i;
+
+    // The leaf node used by the previous mapping.  Consecutive pages in
+    // the same leaf skip the walk from the root.
+    mpf_vtp_pt_node* table = NULL;
+    mpf_vtp_pt_node* wsid_table = NULL;
+    uint32_t leaf_depth = 0;
+    uint64_t leaf_tag = 0;
+
+    mpfOsLockMutex(pt->mutex);
+
+    for (i = 0; i < n_mappings; i++)
     {
-        return FPGA_INVALID_PARAM;
+        const mpf_vtp_pt_mapping* m = &mappings[i];
+        uint32_t depth;
+
+        r = ptMappingDepth(m->va, m->pa, m->size, &depth);
+        if (FPGA_OK != r) break;
+
+        // Virtual address bits above the region covered by the leaf
+        uint64_t tag = (uint64_t)m->va >> (12 + 9 * (5 - depth));
+        if ((NULL == table) || (depth != leaf_depth) || (tag != leaf_tag))
+        {
+            r = ptFindLeafNode(pt, m->va, depth, &table, &wsid_table);
+            if (FPGA_OK != r) break;
+
+            leaf_depth = depth;
+            leaf_tag = tag;
+        }
+
+        r = ptInsertLeafEntry(pt, table, wsid_table, m->va, m->pa, m->wsid,
+                              depth, m->flags);
+        if (FPGA_OK != r) break;
     }
 
-    uint32_t depth = (size == MPF_VTP_PAGE_4KB) ? 4 : 3;
+    // Memory fence for updates before claiming the table is ready
+    mpfOsMemoryBarrier();
+
+    mpfOsUnlockMutex(pt->mutex);
+
+    if (n_inserted)
+    {
+        *n_inserted = i;
+    }
 
-    return addVAtoPA(pt, va, pa, wsid, depth, flags);
+    return r;
 }
 
 
-fpga_result mpfVtpPtRemovePageMapping(
+static fpga_result ptRemovePageMapping(
     mpf_vtp_pt* pt,
     mpf_vtp_pt_vaddr va,
     mpf_vtp_pt_paddr *pa,
@@ -859,7 +1117,7 @@ fpga_result mpfVtpPtRemovePageMapping(
 
             if (size)
             {
-                *size = (depth == 1 ? MPF_VTP_PAGE_2MB : MPF_VTP_PAGE_4KB);
+                *size = ptPageSizeAtDepth(depth);
             }
 
             if (flags)
@@ -890,13 +1148,35 @@ fpga_result mpfVtpPtRemovePageMapping(
 }
 
 
+fpga_result mpfVtpPtRemovePageMapping(
+    mpf_vtp_pt* pt,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr *pa,
+    mpf_vtp_pt_paddr *pt_pa,
+    uint64_t *wsid,
+    mpf_vtp_page_size *size,
+    uint32_t *flags
+)
+{
+    fpga_result r;
+
+    mpfOsLockMutex(pt->mutex);
+    r = ptRemovePageMapping(pt, va, pa, pt_pa, wsid, size, flags);
+    mpfOsUnlockMutex(pt->mutex);
+
+    return r;
+}
+
+
 fpga_result mpfVtpPtTranslateVAtoPA(
     mpf_vtp_pt* pt,
     mpf_vtp_pt_vaddr va,
     mpf_vtp_pt_paddr *pa,
+    mpf_vtp_page_size *size,
     uint32_t *flags
 )
 {
+    // No lock.  See the description of lock-free readers above.
     mpf_vtp_pt_node* table = pt->v_to_p;
 
     uint32_t depth = 4;
@@ -904,23 +1184,29 @@ fpga_result mpfVtpPtTranslateVAtoPA(
     {
         // Index in the current level
         uint64_t idx = ptIdxFromAddr((uint64_t)va, depth);
+        int64_t entry = nodeLoadEntry(table, idx);
 
-        if (! nodeEntryExists(table, idx)) return FPGA_NOT_FOUND;
+        if (! entryExists(entry)) return FPGA_NOT_FOUND;
 
-        if (nodeEntryIsTerminal(table, idx))
+        if (entryIsTerminal(entry))
         {
-            *pa = (mpf_vtp_pt_paddr)nodeGetTranslatedAddr(table, idx);
+            *pa = (mpf_vtp_pt_paddr)entryGetTranslatedAddr(entry);
+
+            if (size)
+            {
+                *size = ptPageSizeAtDepth(depth);
+            }
 
             if (flags)
             {
-                *flags = nodeGetTranslatedAddrFlags(table, idx);
+                *flags = entryGetTranslatedAddrFlags(entry);
             }
 
             return FPGA_OK;
         }
 
         // Walk down to child
-        mpf_vtp_pt_paddr child_pa = nodeGetChildAddr(table, idx);
+        mpf_vtp_pt_paddr child_pa = entry;
         mpf_vtp_pt_vaddr child_va;
         if (FPGA_OK != ptTranslatePAtoVA(pt, child_pa, &child_va)) return FPGA_NOT_FOUND;
         table = (mpf_vtp_pt_node*)child_va;
@@ -930,13 +1216,111 @@ fpga_result mpfVtpPtTranslateVAtoPA(
 }
 
 
+fpga_result mpfVtpPtTranslateVARange(
+    mpf_vtp_pt* pt,
+    mpf_vtp_pt_vaddr va,
+    size_t len,
+    mpf_vtp_pt_mapping* mappings,
+    uint32_t max_mappings,
+    uint32_t* n_mappings
+)
+{
+    // No lock.  See the description of lock-free readers above.
+    uint64_t addr = (uint64_t)va;
+    uint64_t end = addr + len;
+    uint32_t n = 0;
+
+    while ((addr < end) && (n < max_mappings))
+    {
+        // Walk from the root to the node holding the translation of addr
+        mpf_vtp_pt_node* table = pt->v_to_p;
+        uint32_t depth = 4;
+        int64_t entry = -1;
+        while (depth--)
+        {
+            entry = nodeLoadEntry(table, ptIdxFromAddr(addr, depth));
+            if (! entryExists(entry) || entryIsTerminal(entry)) break;
+
+            mpf_vtp_pt_vaddr child_va;
+            if (FPGA_OK != ptTranslatePAtoVA(pt, entry, &child_va)) break;
+            table = (mpf_vtp_pt_node*)child_va;
+        }
+
+        if (! entryExists(entry) || ! entryIsTerminal(entry)) break;
+
+        // Consume consecutive translations in the same node without
+        // walking from the root again
+        mpf_vtp_page_size size = ptPageSizeAtDepth(depth);
+        uint64_t page_mask = mpfPageSizeEnumToBytes(size) - 1;
+        uint64_t idx = ptIdxFromAddr(addr, depth);
+
+        while (true)
+        {
+            mappings[n].va = (mpf_vtp_pt_vaddr)(addr & ~page_mask);
+            mappings[n].pa = (mpf_vtp_pt_paddr)entryGetTranslatedAddr(entry);
+            mappings[n].wsid = 0;
+            mappings[n].size = size;
+            mappings[n].flags = entryGetTranslatedAddrFlags(entry);
+            n += 1;
+
+            addr = (addr | page_mask) + 1;
+            idx += 1;
+            if ((addr >= end) || (n == max_mappings) || (idx == 512)) break;
+
+            // The next entry may be a pointer to a smaller page node or
+            // missing.  Either way, start again from the root.
+            entry = nodeLoadEntry(table, idx);
+            if (! entryExists(entry) || ! entryIsTerminal(entry)) break;
+        }
+    }
+
+    *n_mappings = n;
+    return FPGA_OK;
+}
+
+
+void mpfVtpPtGetNodeCounts(
+    mpf_vtp_pt* pt,
+    uint64_t* n_pinned,
+    uint64_t* n_used
+)
+{
+    mpfOsLockMutex(pt->mutex);
+
+    uint64_t pinned = 0;
+    const mpf_vtp_pt_chunk_index* index = pt->chunk_index;
+    for (uint64_t i = 0; (NULL != index) && (i < index->n_chunks); i++)
+    {
+        pinned += index->chunks[i].n_bytes / sizeof(mpf_vtp_pt_node);
+    }
+
+    // Unused nodes are at the end of the newest chunk or on the free list
+    uint64_t n_free = pt->chunk_n_free;
+    mpf_vtp_pt_node* n = pt->page_table_free_list;
+    while (NULL != n)
+    {
+        n_free += 1;
+        n = (mpf_vtp_pt_node*)nodeGetChildAddr(n, 0);
+    }
+
+    mpfOsUnlockMutex(pt->mutex);
+
+    *n_pinned = pinned;
+    *n_used = pinned - n_free;
+}
+
+
 void mpfVtpPtDumpPageTable(
     mpf_vtp_pt* pt
 )
 {
+    mpfOsLockMutex(pt->mutex);
+
     printf("  Page table root VA %p -> PA 0x%016" PRIx64 ":\n",
            pt->v_to_p,
            mpfVtpPtGetPageTableRootPA(pt));
 
     dumpPageTableVAtoPA(pt, pt->v_to_p, pt->v_to_wsid, 0, 4);
+
+    mpfOsUnlockMutex(pt->mutex);
 }
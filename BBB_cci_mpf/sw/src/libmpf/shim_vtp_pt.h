@@ -54,12 +54,23 @@ typedef enum
     MPF_VTP_PT_FLAG_INVALID = 8,
     // Buffer was pre-allocated outside MPF.
     MPF_VTP_PT_FLAG_PREALLOCATED = 16,
+    // Page shares its driver buffer (wsid) with the preceding page.  When
+    // a region is pinned with a single driver call only the first page's
+    // wsid is released.
+    MPF_VTP_PT_FLAG_WSID_SHARED = 32,
+    // Buffer was allocated for the VTP buffer pool.  The first page also
+    // holds the pool size class in the MPF_VTP_PT_POOL_CLASS bits.  The
+    // hardware page table walker ignores these bits.
+    MPF_VTP_PT_FLAG_POOLED = 64,
 
     // All flags (mask)
-    MPF_VTP_PT_FLAG_MASK = 31
+    MPF_VTP_PT_FLAG_MASK = 4095
 }
 mpf_vtp_pt_flag;
 
+#define MPF_VTP_PT_POOL_CLASS_SHIFT 7
+#define MPF_VTP_PT_POOL_CLASS_MASK (31 << MPF_VTP_PT_POOL_CLASS_SHIFT)
+
 
 /**
  * The VTP page table is structured like the standard x86 hierarchical table.
@@ -82,20 +93,53 @@ typedef uint64_t mpf_vtp_pt_paddr;
 typedef void* mpf_vtp_pt_vaddr;
 
 
-#define N_V_TO_P_WSID_ENTRIES 510
+/**
+ * A single page translation.  Groups of translations are passed to
+ * mpfVtpPtInsertPageMappings() so that a region can be added to the
+ * table in one pass.
+ */
+typedef struct
+{
+    mpf_vtp_pt_vaddr va;
+    mpf_vtp_pt_paddr pa;
+    uint64_t wsid;
+    mpf_vtp_page_size size;
+    // ORed mpf_vtp_pt_flag values
+    uint32_t flags;
+}
+mpf_vtp_pt_mapping;
+
 
 /**
  * Nodes in the page table's virtual to physical map are in pinned memory,
- * shared with the FPGA.  This data structure tracks the page table
- * node's workspace IDs so the table can be released.
+ * shared with the FPGA.  Nodes are carved from chunks of memory that are
+ * pinned with a single driver call.
+ */
+typedef struct
+{
+    mpf_vtp_pt_vaddr va;
+    mpf_vtp_pt_paddr pa;
+    uint64_t n_bytes;
+    // Driver's handle to the chunk
+    uint64_t wsid;
+}
+mpf_vtp_pt_chunk;
+
+
+/**
+ * Index of page table node chunks, sorted by physical address.  An index
+ * is never modified once published.  Adding a chunk publishes a new index
+ * and retires the old one, which remains valid for lock-free readers
+ * until the page table is destroyed.
  */
-struct v_to_p_wsid
+typedef struct mpf_vtp_pt_chunk_index
 {
-    // Next tracker (linked list)
-    struct v_to_p_wsid* next;
-    uint64_t n_entries;
-    uint64_t wsid[N_V_TO_P_WSID_ENTRIES];
-};
+    // Previous (retired) index
+    struct mpf_vtp_pt_chunk_index* prev;
+    uint64_t n_chunks;
+    mpf_vtp_pt_chunk chunks[];
+}
+mpf_vtp_pt_chunk_index;
 
 
 /**
@@ -112,19 +156,34 @@ typedef struct
     // for translating virtual addresses to wsids.
     mpf_vtp_pt_node* v_to_wsid;
 
-    // The page table is implemented in user space with no access
-    // to kernel page mapping.  In order to walk ptVtoP in software we
-    // need to record a reverse physical to virtual mapping.
-    mpf_vtp_pt_node* p_to_v;
-
     // Physical address of the root of the page table
     mpf_vtp_pt_paddr pt_root_paddr;
 
     // Free list of tree nodes not currently in use
     mpf_vtp_pt_node* page_table_free_list;
 
-    // Track workspace IDs of pinned page table nodes
-    struct v_to_p_wsid* v_to_p_wsid;
+    // The page table is implemented in user space with no access to
+    // kernel page mapping.  In order to walk v_to_p in software the
+    // physical address of a node is converted to a virtual address
+    // using the chunk that holds it.
+    mpf_vtp_pt_chunk_index* chunk_index;
+
+    // Unused nodes at the end of the most recently pinned chunk
+    mpf_vtp_pt_node* chunk_next_node;
+    mpf_vtp_pt_paddr chunk_next_pa;
+    uint64_t chunk_n_free;
+
+    // Size of chunks to request from the driver.  Reduced to a single
+    // node if the driver can't provide larger chunks.
+    uint64_t chunk_bytes;
+
+    // Held while the table is updated.  Translation is lock-free:
+    // entries are published with atomic stores and nodes are never
+    // returned to the system while the table is live.  One lock covers
+    // the whole tree, along with the free list and chunk arena that any
+    // insert may draw from.  Buffers are pinned and unpinned outside
+    // the lock, so it is held only while entries are written.
+    mpf_os_mutex_handle mutex;
 
     // Opaque parent MPF handle.  It is opaque because the internal MPF handle
     // points to the page table, so the dependence would be circular.
@@ -193,6 +252,29 @@ fpga_result mpfVtpPtInsertPageMapping(
 );
 
 
+/**
+ * Insert a group of mappings in the page table.
+ *
+ * Mappings are added in order.  Consecutive mappings that land in the
+ * same page table node share a single walk from the root, so passing
+ * mappings sorted by virtual address is most efficient.
+ *
+ * @param[in]  pt          Page table.
+ * @param[in]  mappings    Array of mappings to add.
+ * @param[in]  n_mappings  Number of entries in mappings.
+ * @param[out] n_inserted  Number of mappings added before an error was
+ *                         encountered.  All mappings were added when the
+ *                         result is FPGA_OK.  (Ignored if NULL.)
+ * @returns                FPGA_OK on success.
+ */
+fpga_result mpfVtpPtInsertPageMappings(
+    mpf_vtp_pt* pt,
+    const mpf_vtp_pt_mapping* mappings,
+    uint32_t n_mappings,
+    uint32_t* n_inserted
+);
+
+
 /**
  * Remove a page from the table.
  *
@@ -223,9 +305,13 @@ fpga_result mpfVtpPtRemovePageMapping(
 /**
  * Translate an address from virtual to physical.
  *
+ * Does not take the page table lock and may be called concurrently
+ * with updates.
+ *
  * @param[in]  pt          Page table.
- * @param[in]  va          Virtual address to remove.
+ * @param[in]  va          Virtual address to translate.
  * @param[out] pa          PA corresponding to VA.
+ * @param[out] size        Physical page size.  (Ignored if NULL.)
  * @param[out] flags       Page flags.  (Ignored if NULL.)
  * @returns                FPGA_OK on success.
  */
@@ -233,10 +319,57 @@ fpga_result mpfVtpPtTranslateVAtoPA(
     mpf_vtp_pt* pt,
     mpf_vtp_pt_vaddr va,
     mpf_vtp_pt_paddr *pa,
+    mpf_vtp_page_size *size,
     uint32_t *flags
 );
 
 
+/**
+ * Translate the pages covering a virtual address range.
+ *
+ * Consecutive pages that share a page table node are translated with a
+ * single walk from the root.  Translation stops at the first address
+ * that isn't in the table or when mappings is full.  The va and pa of
+ * each mapping are the page base addresses.  wsid is not returned.
+ *
+ * Does not take the page table lock and may be called concurrently
+ * with updates.
+ *
+ * @param[in]  pt          Page table.
+ * @param[in]  va          Start of the range.
+ * @param[in]  len         Length of the range in bytes.
+ * @param[out] mappings    Translations, in address order.
+ * @param[in]  max_mappings Size of mappings.
+ * @param[out] n_mappings  Number of translations returned.
+ * @returns                FPGA_OK on success.
+ */
+fpga_result mpfVtpPtTranslateVARange(
+    mpf_vtp_pt* pt,
+    mpf_vtp_pt_vaddr va,
+    size_t len,
+    mpf_vtp_pt_mapping* mappings,
+    uint32_t max_mappings,
+    uint32_t* n_mappings
+);
+
+
+/**
+ * Count nodes of the FPGA-visible page table.
+ *
+ * Nodes are pinned in chunks, so more nodes may be pinned than are
+ * in use.
+ *
+ * @param[in]  pt          Page table.
+ * @param[out] n_pinned    Nodes pinned and shared with the FPGA.
+ * @param[out] n_used      Nodes holding part of the table.
+ */
+void mpfVtpPtGetNodeCounts(
+    mpf_vtp_pt* pt,
+    uint64_t* n_pinned,
+    uint64_t* n_used
+);
+
+
 /**
  * Dump page table for debugging.
  *
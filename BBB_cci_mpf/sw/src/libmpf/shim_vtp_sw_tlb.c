@@ -0,0 +1,236 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include <opae/mpf/mpf.h>
+#include "mpf_internal.h"
+
+//
+// TLB geometry (per thread).  Sets must be powers of 2.
+//
+#define SW_TLB_WAYS 4
+#define SW_TLB_SETS_4KB 32
+#define SW_TLB_SETS_2MB 8
+
+typedef struct
+{
+    // Page-aligned VA with bit 0 set when valid
+    uint64_t tag;
+    mpf_vtp_pt_paddr pa;
+}
+sw_tlb_entry;
+
+typedef struct
+{
+    // Page table and invalidation epoch that the entries belong to
+    const mpf_vtp_pt* pt;
+    uint64_t epoch;
+
+    sw_tlb_entry entries_4kb[SW_TLB_SETS_4KB][SW_TLB_WAYS];
+    sw_tlb_entry entries_2mb[SW_TLB_SETS_2MB][SW_TLB_WAYS];
+
+    // Next way to replace in each set (round robin)
+    uint8_t victim_4kb[SW_TLB_SETS_4KB];
+    uint8_t victim_2mb[SW_TLB_SETS_2MB];
+}
+sw_tlb;
+
+static MPF_OS_THREAD_LOCAL sw_tlb tlb;
+
+// Starts at 1 so that the zero initialized TLB in a new thread is flushed
+// before its first use.
+static uint64_t sw_tlb_epoch = 1;
+
+// Threads that have looked up a translation, numbering them for
+// mpf_vtp_sw_tlb_stats slots.  Zero in a thread that has no number yet.
+static uint64_t sw_tlb_threads;
+static MPF_OS_THREAD_LOCAL uint64_t sw_tlb_thread_num;
+
+
+static void countLookup(
+    mpf_vtp_sw_tlb_stats* stats,
+    bool hit
+)
+{
+    if (sw_tlb_thread_num == 0)
+    {
+        sw_tlb_thread_num = mpfOsAtomicAdd64(&sw_tlb_threads, 1) + 1;
+    }
+
+    uint64_t n = sw_tlb_thread_num;
+    if (n > MPF_VTP_SW_TLB_STAT_SLOTS) n = MPF_VTP_SW_TLB_STAT_SLOTS;
+
+    mpf_vtp_sw_tlb_stat_slot* slot = &stats->slot[n - 1];
+    uint64_t* ctr = (hit ? &slot->hits : &slot->misses);
+
+    if (sw_tlb_thread_num < MPF_VTP_SW_TLB_STAT_SLOTS)
+    {
+        // This thread is the slot's only writer.  No read-modify-write
+        // is needed, just a store that mpfVtpSwTlbGetStats() can read.
+        mpfOsAtomicStore64(ctr, *ctr + 1);
+    }
+    else
+    {
+        mpfOsAtomicAdd64(ctr, 1);
+    }
+}
+
+
+static bool lookupSet(
+    sw_tlb_entry* set,
+    uint64_t tag,
+    mpf_vtp_pt_paddr* pa
+)
+{
+    for (int way = 0; way < SW_TLB_WAYS; way++)
+    {
+        if (set[way].tag == tag)
+        {
+            *pa = set[way].pa;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+static bool lookup(
+    const mpf_vtp_pt* pt,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr* pa
+)
+{
+    uint64_t epoch = mpfOsAtomicLoad64(&sw_tlb_epoch);
+
+    if ((tlb.epoch != epoch) || (tlb.pt != pt))
+    {
+        memset(&tlb, 0, sizeof(tlb));
+        tlb.pt = pt;
+        tlb.epoch = epoch;
+        return false;
+    }
+
+    uint64_t va_2mb = (uint64_t)va >> 21;
+    if (lookupSet(tlb.entries_2mb[va_2mb & (SW_TLB_SETS_2MB - 1)],
+                  (va_2mb << 21) | 1, pa))
+    {
+        return true;
+    }
+
+    uint64_t va_4kb = (uint64_t)va >> 12;
+    return lookupSet(tlb.entries_4kb[va_4kb & (SW_TLB_SETS_4KB - 1)],
+                     (va_4kb << 12) | 1, pa);
+}
+
+
+bool mpfVtpSwTlbLookup(
+    const mpf_vtp_pt* pt,
+    mpf_vtp_sw_tlb_stats* stats,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr* pa
+)
+{
+    bool hit = lookup(pt, va, pa);
+    countLookup(stats, hit);
+    return hit;
+}
+
+
+void mpfVtpSwTlbInsert(
+    const mpf_vtp_pt* pt,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr pa,
+    mpf_vtp_page_size size
+)
+{
+    // The epoch is not checked here.  It was sampled by the lookup that
+    // preceded the walk, so any invalidation since then will flush the
+    // new entry.
+    if (tlb.pt != pt) return;
+
+    sw_tlb_entry* set;
+    uint8_t* victim;
+    uint64_t page_shift;
+
+    // Like the FPGA, a 1GB page is held as a 2MB entry covering the
+    // region containing va.
+    if ((size == MPF_VTP_PAGE_2MB) || (size == MPF_VTP_PAGE_1GB))
+    {
+        page_shift = 21;
+        uint64_t idx = ((uint64_t)va >> page_shift) & (SW_TLB_SETS_2MB - 1);
+        set = tlb.entries_2mb[idx];
+        victim = &tlb.victim_2mb[idx];
+    }
+    else if (size == MPF_VTP_PAGE_4KB)
+    {
+        page_shift = 12;
+        uint64_t idx = ((uint64_t)va >> page_shift) & (SW_TLB_SETS_4KB - 1);
+        set = tlb.entries_4kb[idx];
+        victim = &tlb.victim_4kb[idx];
+    }
+    else
+    {
+        return;
+    }
+
+    sw_tlb_entry* e = &set[*victim];
+    *victim = (*victim + 1) & (SW_TLB_WAYS - 1);
+
+    e->tag = (((uint64_t)va >> page_shift) << page_shift) | 1;
+    e->pa = pa;
+}
+
+
+void mpfVtpSwTlbInvalidate(void)
+{
+    mpfOsAtomicAdd64(&sw_tlb_epoch, 1);
+}
+
+
+void mpfVtpSwTlbGetStats(
+    const mpf_vtp_sw_tlb_stats* stats,
+    uint64_t* hits,
+    uint64_t* misses
+)
+{
+    *hits = 0;
+    *misses = 0;
+
+    for (int i = 0; i < MPF_VTP_SW_TLB_STAT_SLOTS; i++)
+    {
+        *hits += mpfOsAtomicLoad64(&stats->slot[i].hits);
+        *misses += mpfOsAtomicLoad64(&stats->slot[i].misses);
+    }
+}
@@ -0,0 +1,127 @@
+// Copyright(c) 2017, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+/**
+ * \file shim_vtp_sw_tlb.h
+ * \brief Per-thread software cache of VTP virtual to physical translations.
+ */
+
+#ifndef __FPGA_MPF_SHIM_VTP_SW_TLB_H__
+#define __FPGA_MPF_SHIM_VTP_SW_TLB_H__
+
+#include "shim_vtp_pt.h"
+
+/**
+ * Each thread has a private, set associative TLB in front of the page
+ * table walk.  Entries hold both 4KB and 2MB translations.  1GB pages
+ * are held as 2MB entries.
+ *
+ * Threads can't reach each other's TLBs, so invalidation is global:
+ * mpfVtpSwTlbInvalidate() advances an epoch and every thread flushes its
+ * TLB on the next lookup that observes the new epoch.
+ */
+
+
+/**
+ * Hit and miss counters.  Each thread counts in its own slot, so lookups
+ * never write a cache line shared with another thread.  Threads beyond
+ * the first MPF_VTP_SW_TLB_STAT_SLOTS - 1 share the last slot.
+ */
+#define MPF_VTP_SW_TLB_STAT_SLOTS 32
+
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    // Keep slots on separate cache lines whatever the array alignment
+    uint8_t pad[112];
+}
+mpf_vtp_sw_tlb_stat_slot;
+
+typedef struct
+{
+    mpf_vtp_sw_tlb_stat_slot slot[MPF_VTP_SW_TLB_STAT_SLOTS];
+}
+mpf_vtp_sw_tlb_stats;
+
+
+/**
+ * Look up a translation.
+ *
+ * Must be followed by mpfVtpSwTlbInsert() on a miss so that a fill
+ * racing with an invalidation is tagged with the epoch observed here.
+ *
+ * @param[in]  pt          Page table.
+ * @param[in]  stats       Counters updated with the result.
+ * @param[in]  va          Virtual address.
+ * @param[out] pa          Physical address of the page containing va.
+ * @returns                True on a hit.
+ */
+bool mpfVtpSwTlbLookup(
+    const mpf_vtp_pt* pt,
+    mpf_vtp_sw_tlb_stats* stats,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr* pa
+);
+
+
+/**
+ * Add a translation found by walking the page table.
+ *
+ * @param[in]  pt          Page table.
+ * @param[in]  va          Virtual address.
+ * @param[in]  pa          Physical address of the page containing va.
+ * @param[in]  size        Physical page size.
+ */
+void mpfVtpSwTlbInsert(
+    const mpf_vtp_pt* pt,
+    mpf_vtp_pt_vaddr va,
+    mpf_vtp_pt_paddr pa,
+    mpf_vtp_page_size size
+);
+
+
+/**
+ * Invalidate all software TLBs in all threads.
+ */
+void mpfVtpSwTlbInvalidate(void);
+
+
+/**
+ * Sum the hit and miss counters of all threads.
+ *
+ * @param[in]  stats       Counters.
+ * @param[out] hits        Total hits.
+ * @param[out] misses      Total misses.
+ */
+void mpfVtpSwTlbGetStats(
+    const mpf_vtp_sw_tlb_stats* stats,
+    uint64_t* hits,
+    uint64_t* misses
+);
+
+#endif // __FPGA_MPF_SHIM_VTP_SW_TLB_H__
@@ -51,10 +51,14 @@ fpga_result __MPF_API__ mpfWroGetStats(
         return FPGA_NOT_SUPPORTED;
     }
 
-    stats->numConflictCyclesRR = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_WRO, CCI_MPF_WRO_CSR_STAT_RR_CONFLICT, NULL);
-    stats->numConflictCyclesRW = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_WRO, CCI_MPF_WRO_CSR_STAT_RW_CONFLICT, NULL);
-    stats->numConflictCyclesWR = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_WRO, CCI_MPF_WRO_CSR_STAT_WR_CONFLICT, NULL);
-    stats->numConflictCyclesWW = mpfReadCsr(mpf_handle, CCI_MPF_SHIM_WRO, CCI_MPF_WRO_CSR_STAT_WW_CONFLICT, NULL);
+    // The conflict counters are consecutive CSRs, starting with RR
+    uint64_t csrs[4];
+    mpfReadCsrs(mpf_handle, CCI_MPF_SHIM_WRO, CCI_MPF_WRO_CSR_STAT_RR_CONFLICT, 4, csrs);
+
+    stats->numConflictCyclesRR = csrs[0];
+    stats->numConflictCyclesRW = csrs[1];
+    stats->numConflictCyclesWR = csrs[2];
+    stats->numConflictCyclesWW = csrs[3];
 
     return FPGA_OK;
 }
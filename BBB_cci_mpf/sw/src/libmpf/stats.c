@@ -0,0 +1,457 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file stats.c
+ * \brief Sample the statistics of all MPF shims
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opae/mpf/mpf.h>
+#include "mpf_internal.h"
+
+
+fpga_result __MPF_API__ mpfGetAllStats(
+    mpf_handle_t mpf_handle,
+    mpf_all_stats* stats
+)
+{
+    if (NULL == stats) return FPGA_INVALID_PARAM;
+
+    stats->has_vtp = mpfShimPresent(mpf_handle, CCI_MPF_SHIM_VTP);
+    stats->has_vc_map = mpfShimPresent(mpf_handle, CCI_MPF_SHIM_VC_MAP);
+    stats->has_wro = mpfShimPresent(mpf_handle, CCI_MPF_SHIM_WRO);
+    stats->has_pwrite = mpfShimPresent(mpf_handle, CCI_MPF_SHIM_PWRITE);
+
+    uint64_t t_start = mpfOsGetTimeNs();
+
+    // Each GetStats call reads a block of CSRs with mpfReadCsrs() and
+    // fills the shim's statistics with -1 when it isn't present.
+    mpfVtpGetStats(mpf_handle, &stats->vtp);
+    mpfVcMapGetStats(mpf_handle, &stats->vc_map);
+    mpfWroGetStats(mpf_handle, &stats->wro);
+    mpfPwriteGetStats(mpf_handle, &stats->pwrite);
+
+    // Software state, without CSR reads
+    stats->has_vc_map_controller =
+        (FPGA_OK == mpfVcMapControllerGetState(mpf_handle, &stats->vc_map_controller));
+    if (! stats->has_vc_map_controller)
+    {
+        memset(&stats->vc_map_controller, -1, sizeof(stats->vc_map_controller));
+    }
+
+    uint64_t t_end = mpfOsGetTimeNs();
+
+    stats->sample_ns = t_end - t_start;
+    stats->timestamp_ns = t_start + stats->sample_ns / 2;
+
+    return FPGA_OK;
+}
+
+
+// ========================================================================
+//
+//   Statistics sampler.
+//
+// ========================================================================
+
+#define STATS_SAMPLER_DEFAULT_PERIOD_US 100000
+#define STATS_SAMPLER_DEFAULT_HISTORY_LEN 64
+
+// Longest sleep between checks for a stop request
+#define STATS_SAMPLER_MAX_SLEEP_US 10000
+
+//
+// Ring buffer entry.  The single writer is the sampler thread.  Readers
+// don't lock.  Instead, each entry is protected by a sequence lock:
+// lock is odd while the entry is being written and is 2 * (seq + 1) once
+// sample number seq is complete.  A reader copies the sample and then
+// confirms that the lock was unchanged during the copy.
+//
+typedef struct
+{
+    int64_t lock;
+    mpf_stats_sample sample;
+}
+stats_ring_entry;
+
+struct _mpf_stats_sampler
+{
+    _mpf_handle_p _mpf_handle;
+    mpf_stats_sampler_config config;
+
+    mpf_os_thread_handle thread;
+    int64_t stop;
+
+    // Number of completed samples.  Sample seq is stored in
+    // ring[seq % config.history_len].
+    int64_t n_samples;
+    stats_ring_entry* ring;
+
+    // Counters at the start of the current interval.  Used only by
+    // the sampler thread.
+    mpf_all_stats prev;
+    uint64_t prev_extra[MPF_STATS_MAX_EXTRA];
+};
+
+typedef struct _mpf_stats_sampler* _mpf_stats_sampler_p;
+
+
+static double ratePerSec(
+    bool present,
+    uint64_t delta,
+    uint64_t interval_ns
+)
+{
+    if (! present || (0 == interval_ns)) return -1.0;
+    return (double)delta * 1e9 / (double)interval_ns;
+}
+
+
+static double cyclePct(
+    bool present,
+    uint64_t delta_cycles,
+    uint64_t interval_ns,
+    double clock_mhz
+)
+{
+    if (! present || (0 == interval_ns) || (clock_mhz <= 0.0)) return -1.0;
+
+    double cycles = (double)interval_ns * clock_mhz / 1000.0;
+    return 100.0 * (double)delta_cycles / cycles;
+}
+
+
+//
+// Read the counters and compute rates relative to the previous sample.
+// The raw counters become the start of the next interval.
+//
+static void samplerComputeSample(
+    _mpf_stats_sampler_p sampler,
+    mpf_stats_sample* sample
+)
+{
+    const mpf_all_stats* prev = &sampler->prev;
+    const mpf_all_stats* cur = &sample->stats;
+    double mhz = sampler->config.afu_clock_mhz;
+
+    mpfGetAllStats(sampler->_mpf_handle, &sample->stats);
+    memset(sample->extra, 0, sizeof(sample->extra));
+    if (sampler->config.num_extra)
+    {
+        sampler->config.read_extra(sampler->config.read_extra_ctx, sample->extra);
+    }
+
+    uint64_t dt = cur->timestamp_ns - prev->timestamp_ns;
+    sample->interval_ns = dt;
+
+    sample->vtp_tlb_hits_per_sec =
+        ratePerSec(cur->has_vtp,
+                   (cur->vtp.numTLBHits4KB - prev->vtp.numTLBHits4KB) +
+                   (cur->vtp.numTLBHits2MB - prev->vtp.numTLBHits2MB),
+                   dt);
+    sample->vtp_tlb_misses_per_sec =
+        ratePerSec(cur->has_vtp,
+                   (cur->vtp.numTLBMisses4KB - prev->vtp.numTLBMisses4KB) +
+                   (cur->vtp.numTLBMisses2MB - prev->vtp.numTLBMisses2MB),
+                   dt);
+    sample->vtp_failed_translations_per_sec =
+        ratePerSec(cur->has_vtp,
+                   cur->vtp.numFailedTranslations - prev->vtp.numFailedTranslations,
+                   dt);
+    sample->vtp_pt_walk_busy_pct =
+        cyclePct(cur->has_vtp,
+                 cur->vtp.numPTWalkBusyCycles - prev->vtp.numPTWalkBusyCycles,
+                 dt, mhz);
+
+    sample->vc_map_changes_per_sec =
+        ratePerSec(cur->has_vc_map,
+                   cur->vc_map.numMappingChanges - prev->vc_map.numMappingChanges,
+                   dt);
+
+    sample->wro_conflict_rr_pct =
+        cyclePct(cur->has_wro,
+                 cur->wro.numConflictCyclesRR - prev->wro.numConflictCyclesRR,
+                 dt, mhz);
+    sample->wro_conflict_rw_pct =
+        cyclePct(cur->has_wro,
+                 cur->wro.numConflictCyclesRW - prev->wro.numConflictCyclesRW,
+                 dt, mhz);
+    sample->wro_conflict_wr_pct =
+        cyclePct(cur->has_wro,
+                 cur->wro.numConflictCyclesWR - prev->wro.numConflictCyclesWR,
+                 dt, mhz);
+    sample->wro_conflict_ww_pct =
+        cyclePct(cur->has_wro,
+                 cur->wro.numConflictCyclesWW - prev->wro.numConflictCyclesWW,
+                 dt, mhz);
+
+    sample->pwrite_per_sec =
+        ratePerSec(cur->has_pwrite,
+                   cur->pwrite.numPartialWrites - prev->pwrite.numPartialWrites,
+                   dt);
+
+    for (uint32_t i = 0; i < MPF_STATS_MAX_EXTRA; i++)
+    {
+        sample->extra_per_sec[i] =
+            ratePerSec(i < sampler->config.num_extra,
+                       sample->extra[i] - sampler->prev_extra[i],
+                       dt);
+    }
+
+    sampler->prev = sample->stats;
+    memcpy(sampler->prev_extra, sample->extra, sizeof(sample->extra));
+}
+
+
+//
+// Publish a sample in the ring.  Called only by the sampler thread.
+//
+static void samplerPublish(
+    _mpf_stats_sampler_p sampler,
+    const mpf_stats_sample* sample
+)
+{
+    int64_t seq = sampler->n_samples;
+    stats_ring_entry* e = &sampler->ring[seq % sampler->config.history_len];
+
+    mpfOsAtomicStore64(&e->lock, 2 * seq + 1);
+    mpfOsMemoryBarrier();
+
+    e->sample = *sample;
+    e->sample.seq = seq;
+
+    mpfOsAtomicStore64(&e->lock, 2 * (seq + 1));
+    mpfOsAtomicStore64(&sampler->n_samples, seq + 1);
+}
+
+
+//
+// Copy sample number seq from the ring.  Returns false if the entry
+// has been overwritten or is being written.
+//
+static bool samplerRead(
+    _mpf_stats_sampler_p sampler,
+    int64_t seq,
+    mpf_stats_sample* sample
+)
+{
+    stats_ring_entry* e = &sampler->ring[seq % sampler->config.history_len];
+
+    int64_t lock = mpfOsAtomicLoad64(&e->lock);
+    if (lock != 2 * (seq + 1)) return false;
+
+    *sample = e->sample;
+    mpfOsMemoryBarrier();
+
+    return (lock == mpfOsAtomicLoad64(&e->lock));
+}
+
+
+static void samplerThread(void* arg)
+{
+    _mpf_stats_sampler_p sampler = (_mpf_stats_sampler_p)arg;
+    uint64_t period_ns = sampler->config.period_us * 1000;
+    uint64_t deadline = sampler->prev.timestamp_ns + period_ns;
+    mpf_stats_sample sample;
+
+    while (! mpfOsAtomicLoad64(&sampler->stop))
+    {
+        uint64_t now = mpfOsGetTimeNs();
+        if (now < deadline)
+        {
+            uint64_t sleep_us = (deadline - now + 999) / 1000;
+            if (sleep_us > STATS_SAMPLER_MAX_SLEEP_US)
+            {
+                sleep_us = STATS_SAMPLER_MAX_SLEEP_US;
+            }
+
+            mpfOsSleepUs(sleep_us);
+            continue;
+        }
+
+        samplerComputeSample(sampler, &sample);
+        samplerPublish(sampler, &sample);
+
+        // Stay on the original schedule unless the thread fell behind
+        // by a full period.
+        deadline += period_ns;
+        if (deadline < now)
+        {
+            deadline = now + period_ns;
+        }
+    }
+}
+
+
+fpga_result __MPF_API__ mpfStatsSamplerStart(
+    mpf_handle_t mpf_handle,
+    const mpf_stats_sampler_config* config
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    _mpf_stats_sampler_p sampler;
+    fpga_result r;
+
+    if (NULL != _mpf_handle->stats_sampler) return FPGA_BUSY;
+
+    sampler = malloc(sizeof(struct _mpf_stats_sampler));
+    if (NULL == sampler) return FPGA_NO_MEMORY;
+    memset(sampler, 0, sizeof(*sampler));
+
+    sampler->_mpf_handle = _mpf_handle;
+    if (NULL != config)
+    {
+        sampler->config = *config;
+    }
+
+    if ((sampler->config.num_extra > MPF_STATS_MAX_EXTRA) ||
+        (sampler->config.num_extra && (NULL == sampler->config.read_extra)))
+    {
+        free(sampler);
+        return FPGA_INVALID_PARAM;
+    }
+
+    if (0 == sampler->config.period_us)
+    {
+        sampler->config.period_us = STATS_SAMPLER_DEFAULT_PERIOD_US;
+    }
+    if (0 == sampler->config.history_len)
+    {
+        sampler->config.history_len = STATS_SAMPLER_DEFAULT_HISTORY_LEN;
+    }
+
+    sampler->ring = calloc(sampler->config.history_len, sizeof(stats_ring_entry));
+    if (NULL == sampler->ring)
+    {
+        free(sampler);
+        return FPGA_NO_MEMORY;
+    }
+
+    // The first interval starts now
+    mpfGetAllStats(mpf_handle, &sampler->prev);
+    if (sampler->config.num_extra)
+    {
+        sampler->config.read_extra(sampler->config.read_extra_ctx,
+                                   sampler->prev_extra);
+    }
+
+    r = mpfOsCreateThread(samplerThread, sampler, &sampler->thread);
+    if (FPGA_OK != r)
+    {
+        free(sampler->ring);
+        free(sampler);
+        return r;
+    }
+
+    _mpf_handle->stats_sampler = sampler;
+
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfStatsSamplerStop(
+    mpf_handle_t mpf_handle
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    _mpf_stats_sampler_p sampler = _mpf_handle->stats_sampler;
+
+    if (NULL == sampler) return FPGA_NOT_FOUND;
+
+    mpfOsAtomicStore64(&sampler->stop, 1);
+    mpfOsJoinThread(sampler->thread);
+
+    _mpf_handle->stats_sampler = NULL;
+    free(sampler->ring);
+    free(sampler);
+
+    return FPGA_OK;
+}
+
+
+fpga_result __MPF_API__ mpfStatsSamplerGetLatest(
+    mpf_handle_t mpf_handle,
+    mpf_stats_sample* sample
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    _mpf_stats_sampler_p sampler = _mpf_handle->stats_sampler;
+
+    if (NULL == sampler) return FPGA_NOT_FOUND;
+
+    while (true)
+    {
+        int64_t n = mpfOsAtomicLoad64(&sampler->n_samples);
+        if (0 == n) return FPGA_NOT_FOUND;
+
+        // Fails only if the sampler wrapped around the whole ring
+        // during the copy.  Try again with the new latest sample.
+        if (samplerRead(sampler, n - 1, sample)) return FPGA_OK;
+    }
+}
+
+
+uint32_t __MPF_API__ mpfStatsSamplerGetHistory(
+    mpf_handle_t mpf_handle,
+    mpf_stats_sample* samples,
+    uint32_t max_samples
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    _mpf_stats_sampler_p sampler = _mpf_handle->stats_sampler;
+
+    if ((NULL == sampler) || (NULL == samples)) return 0;
+
+    int64_t n = mpfOsAtomicLoad64(&sampler->n_samples);
+    int64_t n_avail = n;
+    if (n_avail > sampler->config.history_len)
+    {
+        n_avail = sampler->config.history_len;
+    }
+    if (n_avail > max_samples)
+    {
+        n_avail = max_samples;
+    }
+
+    // Samples overwritten during the copy are dropped
+    uint32_t n_read = 0;
+    for (int64_t seq = n - n_avail; seq < n; seq++)
+    {
+        if (samplerRead(sampler, seq, &samples[n_read]))
+        {
+            n_read += 1;
+        }
+    }
+
+    return n_read;
+}
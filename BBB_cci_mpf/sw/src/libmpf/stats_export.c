@@ -0,0 +1,629 @@
+//
+// Copyright (c) 2017, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// Neither the name of the Intel Corporation nor the names of its contributors
+// may be used to endorse or promote products derived from this software
+// without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/**
+ * \file stats_export.c
+ * \brief Export MPF statistics in OpenMetrics (Prometheus) text format
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include <opae/mpf/mpf.h>
+#include "mpf_internal.h"
+
+
+// Label values of the shims, indexed by t_cci_mpf_shim_idx
+static const char* const shim_labels[CCI_MPF_SHIM_LAST_IDX] =
+{
+    "vtp", "rsp_order", "vc_map", "latency_qos", "wro", "pwrite"
+};
+
+
+//
+// Text buffer.  Appends past the end of the buffer are dropped but
+// still counted so the required size is known.
+//
+typedef struct
+{
+    char* buf;
+    size_t size;
+    size_t len;
+}
+om_text;
+
+static void omPrintf(
+    om_text* t,
+    const char* format,
+    ...
+)
+{
+    va_list args;
+    size_t avail = (t->len < t->size) ? t->size - t->len : 0;
+
+    va_start(args, format);
+    int n = vsnprintf(avail ? t->buf + t->len : NULL, avail, format, args);
+    va_end(args);
+
+    if (n > 0) t->len += n;
+}
+
+
+// Write the metric family metadata
+static void omFamily(
+    om_text* t,
+    const char* name,
+    const char* type,
+    const char* help
+)
+{
+    omPrintf(t, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+
+//
+// Write one sample.  The afu label is escaped once by the caller.  The
+// shim label and extra labels are constants that need no escaping.
+//
+static void omSample(
+    om_text* t,
+    const char* name,
+    const char* afu,
+    const char* shim,
+    const char* extra_labels,
+    uint64_t value
+)
+{
+    omPrintf(t, "%s{afu=\"%s\",shim=\"%s\"%s%s} %llu\n",
+             name, afu, shim,
+             extra_labels ? "," : "",
+             extra_labels ? extra_labels : "",
+             (unsigned long long)value);
+}
+
+
+// Escape a label value.  Returns NULL if memory is exhausted.
+static char* omEscapeLabel(
+    const char* label
+)
+{
+    if (NULL == label) label = "";
+
+    char* escaped = malloc(2 * strlen(label) + 1);
+    if (NULL == escaped) return NULL;
+
+    char* p = escaped;
+    for (; *label; label++)
+    {
+        switch (*label)
+        {
+          case '\\': *p++ = '\\'; *p++ = '\\'; break;
+          case '"':  *p++ = '\\'; *p++ = '"'; break;
+          case '\n': *p++ = '\\'; *p++ = 'n'; break;
+          default:   *p++ = *label;
+        }
+    }
+    *p = 0;
+
+    return escaped;
+}
+
+
+fpga_result __MPF_API__ mpfStatsFormatOpenMetrics(
+    mpf_handle_t mpf_handle,
+    const char* afu_label,
+    char* buf,
+    size_t buf_size,
+    size_t* len
+)
+{
+    mpf_all_stats s;
+    om_text t = { .buf = buf, .size = buf ? buf_size : 0, .len = 0 };
+
+    // Allocation failure is reported as FPGA_EXCEPTION, since
+    // FPGA_NO_MEMORY means buf is too small and the caller should retry.
+    char* afu = omEscapeLabel(afu_label);
+    if (NULL == afu)
+    {
+        if (NULL != len) *len = 0;
+        return FPGA_EXCEPTION;
+    }
+
+    mpfGetAllStats(mpf_handle, &s);
+
+    omFamily(&t, "mpf_shim_present", "gauge",
+             "MPF shim instantiated in the AFU.");
+    for (int i = 0; i < CCI_MPF_SHIM_LAST_IDX; i++)
+    {
+        omSample(&t, "mpf_shim_present", afu, shim_labels[i], NULL,
+                 mpfShimPresent(mpf_handle, i));
+    }
+
+    if (s.has_vtp)
+    {
+        const char* vtp = shim_labels[CCI_MPF_SHIM_VTP];
+
+        omFamily(&t, "mpf_vtp_tlb_hits", "counter",
+                 "FPGA-side VTP TLB hits.");
+        omSample(&t, "mpf_vtp_tlb_hits_total", afu, vtp, "page_size=\"4KB\"",
+                 s.vtp.numTLBHits4KB);
+        omSample(&t, "mpf_vtp_tlb_hits_total", afu, vtp, "page_size=\"2MB\"",
+                 s.vtp.numTLBHits2MB);
+
+        omFamily(&t, "mpf_vtp_tlb_misses", "counter",
+                 "FPGA-side VTP TLB misses.");
+        omSample(&t, "mpf_vtp_tlb_misses_total", afu, vtp, "page_size=\"4KB\"",
+                 s.vtp.numTLBMisses4KB);
+        omSample(&t, "mpf_vtp_tlb_misses_total", afu, vtp, "page_size=\"2MB\"",
+                 s.vtp.numTLBMisses2MB);
+
+        omFamily(&t, "mpf_vtp_pt_walk_busy_cycles", "counter",
+                 "Cycles with the VTP page table walker active.");
+        omSample(&t, "mpf_vtp_pt_walk_busy_cycles_total", afu, vtp, NULL,
+                 s.vtp.numPTWalkBusyCycles);
+
+        omFamily(&t, "mpf_vtp_failed_translations", "counter",
+                 "Failed VTP virtual to physical translations.");
+        omSample(&t, "mpf_vtp_failed_translations_total", afu, vtp, NULL,
+                 s.vtp.numFailedTranslations);
+
+        omFamily(&t, "mpf_vtp_sw_tlb_hits", "counter",
+                 "Host-side VTP software TLB hits.");
+        omSample(&t, "mpf_vtp_sw_tlb_hits_total", afu, vtp, NULL,
+                 s.vtp.numSwTLBHits);
+
+        omFamily(&t, "mpf_vtp_sw_tlb_misses", "counter",
+                 "Host-side VTP software TLB misses.");
+        omSample(&t, "mpf_vtp_sw_tlb_misses_total", afu, vtp, NULL,
+                 s.vtp.numSwTLBMisses);
+
+        omFamily(&t, "mpf_vtp_lazy_regions_pinned", "counter",
+                 "Regions of lazy VTP buffers pinned on demand.");
+        omSample(&t, "mpf_vtp_lazy_regions_pinned_total", afu, vtp, NULL,
+                 s.vtp.numLazyRegionsPinned);
+    }
+
+    if (s.has_vc_map)
+    {
+        omFamily(&t, "mpf_vc_map_mapping_changes", "counter",
+                 "VC Map channel mapping changes.");
+        omSample(&t, "mpf_vc_map_mapping_changes_total", afu,
+                 shim_labels[CCI_MPF_SHIM_VC_MAP], NULL,
+                 s.vc_map.numMappingChanges);
+    }
+
+    if (s.has_vc_map_controller)
+    {
+        const char* vc_map = shim_labels[CCI_MPF_SHIM_VC_MAP];
+
+        omFamily(&t, "mpf_vc_map_controller_ratio", "gauge",
+                 "Fixed VL0 ratio (64ths) set by the VC Map controller.");
+        omSample(&t, "mpf_vc_map_controller_ratio", afu, vc_map, NULL,
+                 s.vc_map_controller.ratio);
+
+        omFamily(&t, "mpf_vc_map_controller_bandwidth_lines", "gauge",
+                 "Lines per second delivered in the VC Map controller's last period.");
+        omSample(&t, "mpf_vc_map_controller_bandwidth_lines", afu, vc_map, NULL,
+                 (uint64_t)s.vc_map_controller.bw_lines_per_sec);
+
+        omFamily(&t, "mpf_vc_map_controller_probes", "counter",
+                 "VC Map controller ratio probes.");
+        omSample(&t, "mpf_vc_map_controller_probes_total", afu, vc_map,
+                 "result=\"accept\"", s.vc_map_controller.num_accepts);
+        omSample(&t, "mpf_vc_map_controller_probes_total", afu, vc_map,
+                 "result=\"revert\"", s.vc_map_controller.num_reverts);
+
+        omFamily(&t, "mpf_vc_map_controller_traffic_shifts", "counter",
+                 "Bandwidth changes at the VC Map controller's held ratio.");
+        omSample(&t, "mpf_vc_map_controller_traffic_shifts_total", afu, vc_map, NULL,
+                 s.vc_map_controller.num_traffic_shifts);
+    }
+
+    if (s.has_wro)
+    {
+        const char* wro = shim_labels[CCI_MPF_SHIM_WRO];
+
+        omFamily(&t, "mpf_wro_conflict_cycles", "counter",
+                 "Cycles WRO blocked a request due to an address conflict.");
+        omSample(&t, "mpf_wro_conflict_cycles_total", afu, wro, "type=\"rr\"",
+                 s.wro.numConflictCyclesRR);
+        omSample(&t, "mpf_wro_conflict_cycles_total", afu, wro, "type=\"rw\"",
+                 s.wro.numConflictCyclesRW);
+        omSample(&t, "mpf_wro_conflict_cycles_total", afu, wro, "type=\"wr\"",
+                 s.wro.numConflictCyclesWR);
+        omSample(&t, "mpf_wro_conflict_cycles_total", afu, wro, "type=\"ww\"",
+                 s.wro.numConflictCyclesWW);
+    }
+
+    if (s.has_pwrite)
+    {
+        omFamily(&t, "mpf_pwrite_partial_writes", "counter",
+                 "Partial writes.");
+        omSample(&t, "mpf_pwrite_partial_writes_total", afu,
+                 shim_labels[CCI_MPF_SHIM_PWRITE], NULL,
+                 s.pwrite.numPartialWrites);
+    }
+
+    omPrintf(&t, "# EOF\n");
+
+    free(afu);
+
+    if (NULL != len) *len = t.len;
+    return (t.len < t.size) ? FPGA_OK : FPGA_NO_MEMORY;
+}
+
+
+//
+// Format into a newly allocated buffer.  The caller frees the buffer.
+//
+static fpga_result formatAlloc(
+    mpf_handle_t mpf_handle,
+    const char* afu_label,
+    char** text,
+    size_t* len
+)
+{
+    fpga_result r;
+    size_t size = 4096;
+
+    // The length may change between calls if a counter gains digits
+    while (true)
+    {
+        *text = malloc(size);
+        if (NULL == *text) return FPGA_NO_MEMORY;
+
+        *len = 0;
+        r = mpfStatsFormatOpenMetrics(mpf_handle, afu_label, *text, size, len);
+
+        // Retry only when the text didn't fit
+        if ((FPGA_NO_MEMORY != r) || (*len < size)) break;
+
+        free(*text);
+        size = *len + 256;
+    }
+
+    if (FPGA_OK != r)
+    {
+        free(*text);
+        *text = NULL;
+    }
+
+    return r;
+}
+
+
+fpga_result __MPF_API__ mpfStatsWriteOpenMetrics(
+    mpf_handle_t mpf_handle,
+    const char* afu_label,
+    const char* path
+)
+{
+    fpga_result r;
+    char* text;
+    size_t len;
+
+    if (NULL == path) return FPGA_INVALID_PARAM;
+
+    r = formatAlloc(mpf_handle, afu_label, &text, &len);
+    if (FPGA_OK != r) return r;
+
+    char* tmp_path = malloc(strlen(path) + 5);
+    if (NULL == tmp_path)
+    {
+        free(text);
+        return FPGA_NO_MEMORY;
+    }
+    sprintf(tmp_path, "%s.tmp", path);
+
+    r = FPGA_EXCEPTION;
+    FILE* f = fopen(tmp_path, "w");
+    if (NULL != f)
+    {
+        bool ok = (len == fwrite(text, 1, len, f));
+        ok = (0 == fclose(f)) && ok;
+
+#ifdef _WIN32
+        // rename() doesn't replace an existing file on Windows
+        remove(path);
+#endif
+        if (ok && (0 == rename(tmp_path, path)))
+        {
+            r = FPGA_OK;
+        }
+        else
+        {
+            remove(tmp_path);
+        }
+    }
+
+    free(tmp_path);
+    free(text);
+
+    return r;
+}
+
+
+// ========================================================================
+//
+//   HTTP exporter.
+//
+// ========================================================================
+
+#ifndef _WIN32
+
+// Longest wait for a connection before checking for a stop request (ms)
+#define EXPORTER_POLL_MS 100
+
+// Longest wait for a client to send its request (ms)
+#define EXPORTER_RECV_TIMEOUT_MS 1000
+
+struct _mpf_stats_exporter
+{
+    _mpf_handle_p _mpf_handle;
+    char* afu_label;
+    int listen_fd;
+
+    mpf_os_thread_handle thread;
+    int64_t stop;
+};
+
+typedef struct _mpf_stats_exporter* _mpf_stats_exporter_p;
+
+
+static void sendAll(
+    int fd,
+    const char* buf,
+    size_t len
+)
+{
+    while (len)
+    {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) return;
+
+        buf += n;
+        len -= n;
+    }
+}
+
+
+static void sendResponse(
+    int fd,
+    const char* status,
+    const char* content_type,
+    const char* body,
+    size_t body_len
+)
+{
+    char header[256];
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 %s\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Connection: close\r\n"
+                     "\r\n",
+                     status, content_type, body_len);
+
+    sendAll(fd, header, n);
+    sendAll(fd, body, body_len);
+}
+
+
+//
+// Answer one request.  Only the request line matters, so the request is
+// read until the end of the first line.
+//
+static void exporterServe(
+    _mpf_stats_exporter_p exporter,
+    int fd
+)
+{
+    char req[1024];
+    size_t len = 0;
+
+    struct timeval tv = { .tv_sec = 0, .tv_usec = EXPORTER_RECV_TIMEOUT_MS * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (len < sizeof(req) - 1)
+    {
+        ssize_t n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+        if (n <= 0) break;
+        len += n;
+
+        req[len] = 0;
+        if (strchr(req, '\n')) break;
+    }
+    req[len] = 0;
+
+    if ((0 == strncmp(req, "GET /metrics ", 13)) ||
+        (0 == strncmp(req, "GET / ", 6)))
+    {
+        char* text;
+        size_t text_len;
+
+        if (FPGA_OK == formatAlloc(exporter->_mpf_handle, exporter->afu_label,
+                                   &text, &text_len))
+        {
+            sendResponse(fd, "200 OK",
+                         "application/openmetrics-text; version=1.0.0; charset=utf-8",
+                         text, text_len);
+            free(text);
+        }
+        else
+        {
+            const char* msg = "Failed to read MPF statistics\n";
+            sendResponse(fd, "500 Internal Server Error", "text/plain",
+                         msg, strlen(msg));
+        }
+    }
+    else
+    {
+        const char* msg = "Not found\n";
+        sendResponse(fd, "404 Not Found", "text/plain", msg, strlen(msg));
+    }
+}
+
+
+static void exporterThread(void* arg)
+{
+    _mpf_stats_exporter_p exporter = (_mpf_stats_exporter_p)arg;
+    struct pollfd pfd = { .fd = exporter->listen_fd, .events = POLLIN };
+
+    while (! mpfOsAtomicLoad64(&exporter->stop))
+    {
+        if (poll(&pfd, 1, EXPORTER_POLL_MS) <= 0) continue;
+
+        int fd = accept(exporter->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+
+        exporterServe(exporter, fd);
+        close(fd);
+    }
+}
+
+
+fpga_result __MPF_API__ mpfStatsExporterStart(
+    mpf_handle_t mpf_handle,
+    const char* afu_label,
+    uint16_t port,
+    uint16_t* bound_port
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    _mpf_stats_exporter_p exporter;
+    fpga_result r;
+
+    if (NULL != _mpf_handle->stats_exporter) return FPGA_BUSY;
+
+    exporter = malloc(sizeof(struct _mpf_stats_exporter));
+    if (NULL == exporter) return FPGA_NO_MEMORY;
+    memset(exporter, 0, sizeof(*exporter));
+
+    exporter->_mpf_handle = _mpf_handle;
+    exporter->afu_label = strdup(afu_label ? afu_label : "");
+    if (NULL == exporter->afu_label)
+    {
+        free(exporter);
+        return FPGA_NO_MEMORY;
+    }
+
+    // Listen only on the loopback interface
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+
+    r = FPGA_EXCEPTION;
+    exporter->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if ((exporter->listen_fd < 0) ||
+        setsockopt(exporter->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+        bind(exporter->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+        listen(exporter->listen_fd, 16) ||
+        getsockname(exporter->listen_fd, (struct sockaddr*)&addr, &addr_len))
+    {
+        goto fail;
+    }
+
+    r = mpfOsCreateThread(exporterThread, exporter, &exporter->thread);
+    if (FPGA_OK != r) goto fail;
+
+    if (_mpf_handle->dbg_mode)
+    {
+        MPF_FPGA_MSG("OpenMetrics exporter listening on 127.0.0.1:%d",
+                     ntohs(addr.sin_port));
+    }
+
+    if (NULL != bound_port) *bound_port = ntohs(addr.sin_port);
+    _mpf_handle->stats_exporter = exporter;
+
+    return FPGA_OK;
+
+  fail:
+    if (exporter->listen_fd >= 0) close(exporter->listen_fd);
+    free(exporter->afu_label);
+    free(exporter);
+    return r;
+}
+
+
+fpga_result __MPF_API__ mpfStatsExporterStop(
+    mpf_handle_t mpf_handle
+)
+{
+    _mpf_handle_p _mpf_handle = (_mpf_handle_p)mpf_handle;
+    _mpf_stats_exporter_p exporter = _mpf_handle->stats_exporter;
+
+    if (NULL == exporter) return FPGA_NOT_FOUND;
+
+    mpfOsAtomicStore64(&exporter->stop, 1);
+    mpfOsJoinThread(exporter->thread);
+
+    _mpf_handle->stats_exporter = NULL;
+    close(exporter->listen_fd);
+    free(exporter->afu_label);
+    free(exporter);
+
+    return FPGA_OK;
+}
+
+#else // _WIN32
+
+fpga_result __MPF_API__ mpfStatsExporterStart(
+    mpf_handle_t mpf_handle,
+    const char* afu_label,
+    uint16_t port,
+    uint16_t* bound_port
+)
+{
+    return FPGA_NOT_SUPPORTED;
+}
+
+
+fpga_result __MPF_API__ mpfStatsExporterStop(
+    mpf_handle_t mpf_handle
+)
+{
+    return FPGA_NOT_FOUND;
+}
+
+#endif // _WIN32
@@ -57,8 +57,8 @@ install(
 install(FILES ${HDR} DESTINATION include/opae/mpf)
 
 ##
-## Add pthreads to the generated library.  VTP uses a mutex to guarantee
-## that only one allocation happens at a time.
+## Add pthreads to the generated library.  VTP uses a mutex to serialize
+## page table updates.
 ##
 find_package(Threads REQUIRED)
 if(CMAKE_THREAD_LIBS_INIT)
@@ -56,6 +56,11 @@ install(
 
 install(FILES ${HDR} DESTINATION include/vai/mpf)
 
+# vai/mpf/wait.h includes the OPAE version, which has no FPGA API
+# dependence
+install(FILES ${PROJECT_SOURCE_DIR}/include/opae/mpf/wait.h
+        DESTINATION include/opae/mpf)
+
 ##
 ## Add pthreads to the generated library.  VTP uses a mutex to guarantee
 ## that only one allocation happens at a time.
@@ -32,6 +32,19 @@
   #define VCMAP_ENABLE_DEFAULT true
 #endif
 
+//
+// Line counters for the VC Map controller, read from the common CSRs
+//
+static void readVcMapLines(void* ctx, uint64_t* vl0_lines, uint64_t* vh_lines)
+{
+    CCI_TEST* t = (CCI_TEST*)ctx;
+
+    *vl0_lines = t->readCommonCSR(CCI_TEST::CSR_COMMON_VL0_RD_LINES) +
+                 t->readCommonCSR(CCI_TEST::CSR_COMMON_VL0_WR_LINES);
+    *vh_lines = t->readCommonCSR(CCI_TEST::CSR_COMMON_VH0_LINES) +
+                t->readCommonCSR(CCI_TEST::CSR_COMMON_VH1_LINES);
+}
+
 int main(int argc, char *argv[])
 {
     po::options_description desc("Usage");
@@ -42,6 +55,8 @@ int main(int argc, char *argv[])
         ("vcmap-dynamic", po::value<bool>()->default_value(true), "VC MAP: Use dynamic channel mapping (overridden by --vcmap-fixed)")
         ("vcmap-fixed", po::value<int>()->default_value(-1), "VC MAP: Use fixed mapping with VL0 getting <n>/64 of traffic")
         ("vcmap-only-writes", po::value<bool>()->default_value(false), "VC MAP: Apply the chosen mapping mode only to write requests")
+        ("vcmap-controller", po::value<bool>()->default_value(false), "VC MAP: Adjust the fixed VL0 ratio at run time to maximize bandwidth (starts from --vcmap-fixed, if set)")
+        ("vcmap-controller-period", po::value<int>()->default_value(100), "VC MAP: Controller decision period (ms)")
         ("uclk-freq", po::value<int>()->default_value(0), "Frequency of uClk_usr (MHz)")
         ;
 
@@ -71,6 +86,7 @@ int main(int argc, char *argv[])
     bool vcmap_dynamic = vm["vcmap-dynamic"].as<bool>();
     int32_t vcmap_fixed_vl0_ratio = int32_t(vm["vcmap-fixed"].as<int>());
     bool vcmap_only_writes = vm["vcmap-only-writes"].as<bool>();
+    bool vcmap_controller = vm["vcmap-controller"].as<bool>();
     // If a fixed ratio is set ignore "dynamic" and enable VC mapping
     if (vcmap_fixed_vl0_ratio >= 0)
     {
@@ -78,6 +94,12 @@ int main(int argc, char *argv[])
         vcmap_enable = true;
         vcmap_dynamic = false;
     }
+    // The controller replaces dynamic mapping
+    if (vcmap_controller)
+    {
+        vcmap_enable = true;
+        vcmap_dynamic = false;
+    }
 
     if (mpfShimPresent(svc.mpf->c_type(), CCI_MPF_SHIM_VC_MAP))
     {
@@ -102,8 +124,35 @@ int main(int argc, char *argv[])
     }
 
     CCI_TEST* t = allocTest(vm, svc);
+
+    if (vcmap_controller)
+    {
+        mpf_vc_map_controller_config ctrl_config;
+        memset(&ctrl_config, 0, sizeof(ctrl_config));
+        ctrl_config.period_us = 1000 * uint64_t(vm["vcmap-controller-period"].as<int>());
+        ctrl_config.initial_ratio = vcmap_fixed_vl0_ratio;
+        ctrl_config.read_lines = readVcMapLines;
+        ctrl_config.read_lines_ctx = t;
+        ctrl_config.log_decisions = true;
+
+        fpga_result r = mpfVcMapControllerStart(svc.mpf->c_type(), &ctrl_config);
+        if (FPGA_OK != r)
+        {
+            cerr << "Failed to start VC MAP controller: " << fpgaErrStr(r) << endl;
+            exit(1);
+        }
+    }
+
     int result = t->test();
 
+    mpf_vc_map_controller_state ctrl_state;
+    bool has_ctrl_state = vcmap_controller &&
+        (FPGA_OK == mpfVcMapControllerGetState(svc.mpf->c_type(), &ctrl_state));
+    if (vcmap_controller)
+    {
+        mpfVcMapControllerStop(svc.mpf->c_type());
+    }
+
     if (0 == result)
     {
         cout << endl << "# ======= SUCCESS =======" << endl;
@@ -198,7 +247,9 @@ int main(int argc, char *argv[])
              << "#   VTP 4KB hit / miss: " << vtp_stats.numTLBHits4KB << " / "
              << vtp_stats.numTLBMisses4KB << endl
              << "#   VTP 2MB hit / miss: " << vtp_stats.numTLBHits2MB << " / "
-             << vtp_stats.numTLBMisses2MB << endl;
+             << vtp_stats.numTLBMisses2MB << endl
+             << "#   VTP SW hit / miss:  " << vtp_stats.numSwTLBHits << " / "
+             << vtp_stats.numSwTLBMisses << endl;
     }
 
     if (mpfShimPresent(svc.mpf->c_type(), CCI_MPF_SHIM_VC_MAP))
@@ -217,6 +268,15 @@ int main(int argc, char *argv[])
                  << "#   VC MAP map chngs:   " << vcmap_stats.numMappingChanges << endl
                  << "#   VC MAP history:     0x" << hex
                  << history << dec << endl;
+
+            if (has_ctrl_state)
+            {
+                cout << "#   VC MAP ctrl ratio:  " << ctrl_state.ratio << " / 64" << endl
+                     << "#   VC MAP ctrl probes: " << ctrl_state.num_probes
+                     << " (" << ctrl_state.num_accepts << " accepted, "
+                     << ctrl_state.num_reverts << " reverted)" << endl
+                     << "#   VC MAP ctrl shifts: " << ctrl_state.num_traffic_shifts << endl;
+            }
         }
     }
 
@@ -41,5 +41,10 @@
   `define MPF_CONF_ENABLE_VC_MAP 1
 `endif
 
+// Write response Mdata is needed to compute write latency histograms
+`ifndef MPF_CONF_PRESERVE_WRITE_MDATA
+  `define MPF_CONF_PRESERVE_WRITE_MDATA 1
+`endif
+
 // Enable flow control management in cci_test_afu
 `define CCI_TEST_FLOW_CONTROL
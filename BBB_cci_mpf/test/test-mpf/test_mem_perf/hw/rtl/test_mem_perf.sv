@@ -190,6 +190,16 @@ module test_afu
     logic [63:0] rd_req_inflight_total;
     logic [63:0] wr_req_inflight_total;
 
+    // Latency histograms, one counter per log2 bucket of cycles.  Each
+    // fills a DSM line.
+    localparam N_LAT_BUCKETS = 16;
+    typedef t_counter [N_LAT_BUCKETS-1 : 0] t_lat_hist;
+    t_lat_hist rd_lat_hist;
+    t_lat_hist wr_lat_hist;
+
+    // Progress through the DSM lines written at the end of a run
+    logic [1:0] dsm_line_num;
+
     logic [63:0] csr_state;
     always_ff @(posedge clk)
     begin
@@ -376,6 +386,9 @@ module test_afu
     assign can_terminate = ! c0NotEmpty && ! c1NotEmpty &&
                            ! fiu.c0Tx.valid && ! fiu.c1Tx.valid;
 
+    // No responses left in the latency histogram pipeline (assigned below)
+    logic lat_hist_drained;
+
     always_ff @(posedge clk)
     begin
         start_new_run <= csrs.cpu_wr_csrs[0].en;
@@ -412,7 +425,7 @@ module test_afu
           STATE_TERMINATE:
             begin
                 if (! c1TxAlmFull && (wr_beat_num == t_cci_clNum'(0)) &&
-                    can_terminate)
+                    can_terminate && (dsm_line_num == 2'd2))
                 begin
                     state <= STATE_IDLE;
                     $display("Test done.");
@@ -712,26 +725,57 @@ module test_afu
                 end
             end
 
-            // Normal termination: signal done by writing to status memory
-            if ((state == STATE_TERMINATE) && can_terminate)
+            // Normal termination: write the latency histograms to DSM
+            // lines 1 and 2, then signal done by writing line 0.
+            // can_terminate waits for each write's response, so the
+            // histograms are visible before the host sees line 0.
+            // lat_hist_drained holds the first write until the final
+            // responses have been counted.
+            if ((state == STATE_TERMINATE) && can_terminate && lat_hist_drained)
             begin
                 fiu.c1Tx.valid <= 1'b1;
-                fiu.c1Tx.hdr.base.address <= dsm;
                 fiu.c1Tx.hdr.base.sop <= 1'b1;
                 // Use an uncached channel to avoid polluting cache statistics
                 fiu.c1Tx.hdr.base.vc_sel <= eVC_VH1;
                 fiu.c1Tx.hdr.base.cl_len <= eCL_LEN_1;
                 fiu.c1Tx.hdr.pwrite.isPartialWrite <= 1'b0;
-                fiu.c1Tx.data <=
-                    t_cci_clData'({ wr_req_inflight_total,    // 64 bits
-                                    rd_req_inflight_total,    // 64 bits
-                                    32'(wr_req_inflight_max), // 32 bits
-                                    32'(rd_req_inflight_max), // 32 bits
-                                    32'b0,
-                                    cycles_executed });       // 32 bits
+
+                case (dsm_line_num)
+                  2'd0:
+                    begin
+                        fiu.c1Tx.hdr.base.address <= dsm + t_cci_clAddr'(1);
+                        fiu.c1Tx.data <= t_cci_clData'(rd_lat_hist);
+                    end
+                  2'd1:
+                    begin
+                        fiu.c1Tx.hdr.base.address <= dsm + t_cci_clAddr'(2);
+                        fiu.c1Tx.data <= t_cci_clData'(wr_lat_hist);
+                    end
+                  default:
+                    begin
+                        fiu.c1Tx.hdr.base.address <= dsm;
+                        fiu.c1Tx.data <=
+                            t_cci_clData'({ wr_req_inflight_total,    // 64 bits
+                                            rd_req_inflight_total,    // 64 bits
+                                            32'(wr_req_inflight_max), // 32 bits
+                                            32'(rd_req_inflight_max), // 32 bits
+                                            32'b0,
+                                            cycles_executed });       // 32 bits
+                    end
+                endcase
+
+                if (dsm_line_num != 2'd2)
+                begin
+                    dsm_line_num <= dsm_line_num + 2'd1;
+                end
             end
         end
 
+        if (reset || start_new_run)
+        begin
+            dsm_line_num <= 2'd0;
+        end
+
         if (reset)
         begin
             fiu.c1Tx.valid <= 1'b0;
@@ -784,4 +828,153 @@ module test_afu
         end
     end
 
+
+    // ====================================================================
+    //
+    //   Latency histograms
+    //
+    // ====================================================================
+
+    //
+    // The issue cycle of each request is recorded, indexed by Mdata, and
+    // compared to the cycle of each of its responses.  Bucket 0 counts
+    // latencies of 0 and 1 cycles and bucket i counts [2^i, 2^(i+1)).
+    // Timestamps are 16 bits, so latencies are assumed to be under 64K
+    // cycles.
+    //
+    // Twice as many timestamps as lines are kept since MPF may hold
+    // requests in addition to those active in the FIU.
+    //
+    localparam LAT_IDX_BITS = $clog2(MAX_ACTIVE_LINES) + 1;
+    typedef logic [LAT_IDX_BITS-1 : 0] t_lat_idx;
+    typedef logic [15:0] t_lat_cycle;
+    typedef logic [$clog2(N_LAT_BUCKETS)-1 : 0] t_lat_bucket;
+
+    function automatic t_lat_bucket latBucket(t_lat_cycle lat);
+        t_lat_bucket b = t_lat_bucket'(0);
+        for (int i = 1; i < N_LAT_BUCKETS; i = i + 1)
+        begin
+            if (lat >= (t_lat_cycle'(1) << i))
+            begin
+                b = t_lat_bucket'(i);
+            end
+        end
+        return b;
+    endfunction
+
+    t_lat_cycle lat_cycle;
+    always_ff @(posedge clk)
+    begin
+        lat_cycle <= lat_cycle + t_lat_cycle'(1);
+    end
+
+    // Stop counting once the histograms are being written to DSM, since
+    // the DSM writes have responses of their own.
+    logic lat_hist_en;
+    assign lat_hist_en = (dsm_line_num == 2'd0);
+
+    //
+    // Reads
+    //
+    t_lat_cycle rd_issue_cycle[0 : (1 << LAT_IDX_BITS) - 1];
+
+    always_ff @(posedge clk)
+    begin
+        if (do_read)
+        begin
+            rd_issue_cycle[t_lat_idx'(rd_mdata)] <= lat_cycle;
+        end
+    end
+
+    logic rd_lat_rsp_q, rd_lat_rsp_qq, rd_lat_rsp_qqq;
+    t_lat_idx rd_lat_idx_q;
+    t_lat_cycle rd_lat_rsp_cycle_q, rd_lat_rsp_cycle_qq;
+    t_lat_cycle rd_lat_issue_cycle_qq;
+    t_lat_bucket rd_lat_bucket_qqq;
+
+    always_ff @(posedge clk)
+    begin
+        // Response arrives
+        rd_lat_rsp_q <= cci_c0Rx_isReadRsp(fiu.c0Rx);
+        rd_lat_idx_q <= t_lat_idx'(fiu.c0Rx.hdr.mdata);
+        rd_lat_rsp_cycle_q <= lat_cycle;
+
+        // Find the issue cycle
+        rd_lat_rsp_qq <= rd_lat_rsp_q;
+        rd_lat_issue_cycle_qq <= rd_issue_cycle[rd_lat_idx_q];
+        rd_lat_rsp_cycle_qq <= rd_lat_rsp_cycle_q;
+
+        // Bucket
+        rd_lat_rsp_qqq <= rd_lat_rsp_qq;
+        rd_lat_bucket_qqq <= latBucket(rd_lat_rsp_cycle_qq - rd_lat_issue_cycle_qq);
+
+        // Count
+        if (rd_lat_rsp_qqq && lat_hist_en)
+        begin
+            rd_lat_hist[rd_lat_bucket_qqq] <= rd_lat_hist[rd_lat_bucket_qqq] + t_counter'(1);
+        end
+
+        if (reset || start_new_run)
+        begin
+            rd_lat_rsp_q <= 1'b0;
+            rd_lat_rsp_qq <= 1'b0;
+            rd_lat_rsp_qqq <= 1'b0;
+            rd_lat_hist <= t_lat_hist'(0);
+        end
+    end
+
+    //
+    // Writes.  The Mdata of write responses is valid only when MPF is
+    // configured with PRESERVE_WRITE_MDATA.
+    //
+    t_lat_cycle wr_issue_cycle[0 : (1 << LAT_IDX_BITS) - 1];
+
+    always_ff @(posedge clk)
+    begin
+        if (do_write)
+        begin
+            wr_issue_cycle[t_lat_idx'(wr_mdata)] <= lat_cycle;
+        end
+    end
+
+    logic wr_lat_rsp_q, wr_lat_rsp_qq, wr_lat_rsp_qqq;
+    t_lat_idx wr_lat_idx_q;
+    t_lat_cycle wr_lat_rsp_cycle_q, wr_lat_rsp_cycle_qq;
+    t_lat_cycle wr_lat_issue_cycle_qq;
+    t_lat_bucket wr_lat_bucket_qqq;
+
+    always_ff @(posedge clk)
+    begin
+        // Response arrives
+        wr_lat_rsp_q <= cci_c1Rx_isWriteRsp(fiu.c1Rx);
+        wr_lat_idx_q <= t_lat_idx'(fiu.c1Rx.hdr.mdata);
+        wr_lat_rsp_cycle_q <= lat_cycle;
+
+        // Find the issue cycle
+        wr_lat_rsp_qq <= wr_lat_rsp_q;
+        wr_lat_issue_cycle_qq <= wr_issue_cycle[wr_lat_idx_q];
+        wr_lat_rsp_cycle_qq <= wr_lat_rsp_cycle_q;
+
+        // Bucket
+        wr_lat_rsp_qqq <= wr_lat_rsp_qq;
+        wr_lat_bucket_qqq <= latBucket(wr_lat_rsp_cycle_qq - wr_lat_issue_cycle_qq);
+
+        // Count
+        if (wr_lat_rsp_qqq && lat_hist_en)
+        begin
+            wr_lat_hist[wr_lat_bucket_qqq] <= wr_lat_hist[wr_lat_bucket_qqq] + t_counter'(1);
+        end
+
+        if (reset || start_new_run)
+        begin
+            wr_lat_rsp_q <= 1'b0;
+            wr_lat_rsp_qq <= 1'b0;
+            wr_lat_rsp_qqq <= 1'b0;
+            wr_lat_hist <= t_lat_hist'(0);
+        end
+    end
+
+    assign lat_hist_drained = ! (rd_lat_rsp_q || rd_lat_rsp_qq || rd_lat_rsp_qqq ||
+                                 wr_lat_rsp_q || wr_lat_rsp_qq || wr_lat_rsp_qqq);
+
 endmodule // test_afu
@@ -29,11 +29,16 @@
 //
 // This test is used to discover the proper parameters for the latency QoS
 // shim.  Parameters are platform dependent.  We usually pick a configuration
-// that works on MCL=4 R+W, which permits maximum throughput at all sizes.
+// that works on MCL=4, which permits maximum throughput at all sizes.
 //
 // Because the latency QoS shim is inserted near the FIU edge, the presence
 // of a ROB typically doesn't affect the optimal credit limit.
 //
+// The search itself is mpfLatencyQosTune() in libmpf.  Each channel is
+// tuned in turn: reads with a read-only workload and writes with a
+// write-only workload.  The result may be saved as a profile and loaded
+// by mpfConnect() by setting MPF_LATENCY_QOS_PROFILE in the environment.
+//
 
 // ========================================================================
 //
@@ -48,9 +53,13 @@ void testConfigOptions(po::options_description &desc)
     desc.add_options()
         ("c0-qos-enable", po::value<bool>()->default_value(true), "Enable latency QoS for reads")
         ("c1-qos-enable", po::value<bool>()->default_value(true), "Enable latency QoS for writes")
-        ("c0-qos-epoch-len", po::value<int>()->default_value(63), "Latency QoS read epoch length")
-        ("c1-qos-epoch-len", po::value<int>()->default_value(63), "Latency QoS write epoch length")
+        ("c0-qos-epoch-len", po::value<int>()->default_value(63), "Initial latency QoS read epoch length")
+        ("c1-qos-epoch-len", po::value<int>()->default_value(63), "Initial latency QoS write epoch length")
         ("max-active-lines", po::value<int>()->default_value(1023), "Maximum active lines considered per channel")
+        ("mcl", po::value<int>()->default_value(4), "Multi-line size of the tuning workload (1, 2 or 4)")
+        ("vc", po::value<int>()->default_value(0), "Virtual channel of the tuning workload (0 is eVC_VA)")
+        ("bw-tolerance", po::value<double>()->default_value(2.0), "Percent of peak bandwidth that may be given up for lower latency")
+        ("save-profile", po::value<string>(), "Save the tuned configuration to a profile file")
         ;
 }
 
@@ -62,145 +71,171 @@ CCI_TEST* allocTest(const po::variables_map& vm, SVC_WRAPPER& svc)
 
 // ========================================================================
 //
-//  Memory performance test.
+//  Latency QoS parameter search.
 //
 // ========================================================================
 
+typedef struct
+{
+    TEST_MEM_PERF* test;
+    TEST_MEM_PERF::t_test_config config;
+}
+t_measure_ctx;
+
+
+//
+// Measure one candidate configuration.  Bandwidth is lines per second and
+// latency is the mean latency in cycles of the tuned channel's requests.
+//
+fpga_result TEST_MEM_PERF::latencyQosMeasure(
+    void* ctx,
+    uint32_t channel,
+    double* bandwidth,
+    double* latency)
+{
+    t_measure_ctx* m = (t_measure_ctx*)ctx;
+
+    m->config.enable_reads = (channel == 0);
+    m->config.enable_writes = (channel == 1);
+
+    t_test_stats stats;
+    if (m->test->runTestN(&m->config, &stats, 2) != 0) return FPGA_EXCEPTION;
+
+    uint64_t lines = (channel == 0) ? stats.read_lines : stats.write_lines;
+    uint64_t total_latency = (channel == 0) ? stats.read_total_latency :
+                                              stats.write_total_latency;
+    if (lines == 0) return FPGA_EXCEPTION;
+
+    *bandwidth = double(lines) / stats.run_sec;
+    *latency = double(total_latency) / double(lines);
+
+    return FPGA_OK;
+}
+
+
 int TEST_MEM_PERF::test()
 {
     assert(initMem());
 
-    t_test_config config;
-    memset(&config, 0, sizeof(config));
-
-    // What's the AFU frequency (MHz)?
-    uint64_t afu_mhz = getAFUMHz();
+    if (! mpfShimPresent(svc.mpf->c_type(), CCI_MPF_SHIM_LATENCY_QOS))
+    {
+        cerr << "Latency QoS shim is not present" << endl;
+        exit(1);
+    }
 
-    uint64_t c0_qos_enable = uint64_t(vm["c0-qos-enable"].as<bool>());
-    uint64_t c1_qos_enable = uint64_t(vm["c1-qos-enable"].as<bool>());
-    uint64_t c0_qos_epoch_len = uint64_t(vm["c0-qos-epoch-len"].as<int>());
-    uint64_t c1_qos_epoch_len = uint64_t(vm["c1-qos-epoch-len"].as<int>());
-    uint64_t max_active_lines = uint64_t(vm["max-active-lines"].as<int>());
+    int mcl = vm["mcl"].as<int>();
+    if ((mcl != 1) && (mcl != 2) && (mcl != 4))
+    {
+        cerr << "--mcl must be 1, 2 or 4" << endl;
+        exit(1);
+    }
 
-    const static string mode_str[] = { "R ", "W ", "RW" };
+    int vc = vm["vc"].as<int>();
+    if ((vc < 0) || (vc > 3))
+    {
+        cerr << "--vc must be between 0 and 3" << endl;
+        exit(1);
+    }
 
-    cout << "# MCL, VC, RW, " << statsHeader() << endl;
+    double bw_tolerance = vm["bw-tolerance"].as<double>();
+    if ((bw_tolerance < 0) || (bw_tolerance >= 100))
+    {
+        cerr << "--bw-tolerance must be at least 0 and less than 100" << endl;
+        exit(1);
+    }
 
-    t_test_stats stats;
-    uint64_t c0_max_active_lines;
-    uint64_t c1_max_active_lines;
+    t_measure_ctx ctx;
+    ctx.test = this;
 
-    for (config.mcl = 0; config.mcl < 4; config.mcl = (config.mcl << 1) | 1)
+    t_test_config& config = ctx.config;
+    memset(&config, 0, sizeof(config));
+    config.mcl = mcl - 1;
+    config.vc = vc;
+    config.clear_caches = false;
+    config.buf_lines = 32768;
+    config.stride = mcl;
+    config.rdline_s = false;
+    config.wrline_m = false;
+    config.cycles = 128 * 65536;
+
+    mpf_latency_qos_params params;
+    memset(&params, 0, sizeof(params));
+    params.chan[0].enable = vm["c0-qos-enable"].as<bool>();
+    params.chan[1].enable = vm["c1-qos-enable"].as<bool>();
+    params.chan[0].epoch_cycles = vm["c0-qos-epoch-len"].as<int>();
+    params.chan[1].epoch_cycles = vm["c1-qos-epoch-len"].as<int>();
+    params.chan[0].max_active_lines = MPF_LATENCY_QOS_MAX_ACTIVE_LINES;
+    params.chan[1].max_active_lines = MPF_LATENCY_QOS_MAX_ACTIVE_LINES;
+
+    mpf_latency_qos_tune_opts opts;
+    mpfLatencyQosTuneDefaults(&opts);
+    opts.max_active_lines = vm["max-active-lines"].as<int>();
+    opts.bw_tolerance = bw_tolerance / 100.0;
+
+    for (uint32_t c = 0; c < 2; c += 1)
     {
-        config.vc = 3;
-        while (config.vc != 0)
+        if (! params.chan[c].enable) continue;
+
+        fpga_result r = mpfLatencyQosTune(svc.mpf->c_type(), c,
+                                          latencyQosMeasure, &ctx,
+                                          &opts, &params);
+        if (FPGA_OK != r)
         {
-            config.vc -= 1;
-
-            c0_max_active_lines = 512;
-            c1_max_active_lines = 512;
-
-            for (int mode = 0; mode <= 2; mode += 1)
-            {
-                config.clear_caches = false;
-                config.buf_lines = 32768;
-                config.stride = 1 + config.mcl;
-                config.rdline_s = false;
-                config.wrline_m = false;
-
-                config.enable_writes = (mode != 0);
-                config.enable_reads = (mode != 1);
-
-                config.cycles = 128 * 65536;
-
-                int64_t peak_bw = 0.0;
-                int peak_same_cnt = 0;
-
-                if (mode < 2)
-                {
-                    // Read and write passes look for the point at which
-                    // bandwidth peaks.
-                    uint32_t active_incr = 4;
-
-                    for (uint64_t active_lines = 32; active_lines < max_active_lines; active_lines += active_incr)
-                    {
-                        if (mode == 0)
-                        {
-                            c0_max_active_lines = active_lines;
-                        }
-                        else
-                        {
-                            c1_max_active_lines = active_lines;
-                        }
-
-                        uint64_t qos_config = (c0_qos_enable |
-                                               (c1_qos_enable << 1) |
-                                               (c0_max_active_lines << 2) |
-                                               (c1_max_active_lines << 17) |
-                                               (c0_qos_epoch_len << 32) |
-                                               (c1_qos_epoch_len << 48));
-
-                        if (mpfShimPresent(svc.mpf->c_type(), CCI_MPF_SHIM_LATENCY_QOS))
-                        {
-                            mpfLatencyQosSetConfig(svc.mpf->c_type(), qos_config);
-                        }
-
-                        assert(runTestN(&config, &stats, 2) == 0);
-
-                        // Did BW increase by at least 2%?
-                        int64_t bw = stats.read_lines + stats.write_lines;
-                        if ((bw - peak_bw) > (peak_bw / 50))
-                        {
-                            peak_bw = bw;
-                            peak_same_cnt = 0;
-                        }
-                        else
-                        {
-                            peak_same_cnt += 1;
-                        }
-
-                        if (peak_same_cnt == 32)
-                        {
-                            if (mode == 0)
-                            {
-                                c0_max_active_lines = active_lines - 32 * active_incr;
-                            }
-                            else
-                            {
-                                c1_max_active_lines = active_lines - 32 * active_incr;
-                            }
-                            break;
-                        }
-                    }
-                }
-                else
-                {
-                    // R+W mode.  Just report a number
-                    assert(runTestN(&config, &stats, 2) == 0);
-                }
-
-                cout << uint32_t(config.mcl + 1) << " "
-                     << uint32_t(config.vc) << " "
-                     << mode_str[mode] << " "
-                     << c0_max_active_lines << " "
-                     << c1_max_active_lines << " "
-                     << stats
-                     << endl;
-            }
+            cerr << "Latency QoS tuning failed on channel " << c
+                 << ": " << fpgaErrStr(r) << endl;
+            exit(1);
         }
+
+        cout << "# c" << c << " max active lines " << params.chan[c].max_active_lines
+             << ", epoch cycles " << params.chan[c].epoch_cycles << endl;
     }
 
+    // Both channels were enabled while the other was idle.  Report the
+    // final configuration on R+W traffic.
+    assert(mpfLatencyQosSetParams(svc.mpf->c_type(), &params) == FPGA_OK);
+
+    config.enable_reads = true;
+    config.enable_writes = true;
+
+    t_test_stats stats;
+    assert(runTestN(&config, &stats, 2) == 0);
+
+    cout << "# MCL, VC, RW, " << statsHeader() << endl;
+    cout << mcl << " "
+         << uint32_t(config.vc) << " "
+         << "RW "
+         << stats
+         << endl;
+
     cout << endl
          << "Recommended configuration:" << endl;
 
-    if (c0_qos_enable)
+    for (uint32_t c = 0; c < 2; c += 1)
     {
-        cout << "    Read c0 active lines max:  " << c0_max_active_lines << endl;
+        const char* ch_name = (c == 0) ? "Read c0 " : "Write c1";
+
+        cout << "    " << ch_name << " QoS enable:       " << params.chan[c].enable << endl;
+        if (params.chan[c].enable)
+        {
+            cout << "    " << ch_name << " active lines max: " << params.chan[c].max_active_lines << endl
+                 << "    " << ch_name << " epoch cycles:     " << params.chan[c].epoch_cycles << endl;
+        }
     }
 
-    if (c1_qos_enable)
+    cout << "    mpfLatencyQosSetConfig(): 0x" << hex
+         << mpfLatencyQosEncodeConfig(&params) << dec << endl;
+
+    if (vm.count("save-profile"))
     {
-        cout << "    Write c1 active lines max: " << c1_max_active_lines << endl;
+        string path = vm["save-profile"].as<string>();
+        if (FPGA_OK != mpfLatencyQosSaveProfile(svc.mpf->c_type(), path.c_str(), &params))
+        {
+            cerr << "Failed to write profile " << path << endl;
+            exit(1);
+        }
+
+        cout << "    Saved to " << path
+             << " (load with " << MPF_LATENCY_QOS_PROFILE_ENV << "=" << path << ")" << endl;
     }
 
     return 0;
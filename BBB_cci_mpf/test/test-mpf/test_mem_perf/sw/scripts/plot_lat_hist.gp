@@ -0,0 +1,37 @@
+##
+## Plot the latency histogram of one point written by
+## test_mem_perf --latency-hist-file.
+##
+## Variables (set with gnuplot -e):
+##   datafile  Histogram file (default lat_hist.dat)
+##   point     Index of the point in the file (default 0)
+##   ofile     Output name suffix
+##   title     Plot title
+##
+
+if (! exists("title")) title = "SKX"
+if (! exists("datafile")) datafile = "lat_hist.dat"
+if (! exists("point")) point = 0
+if (! exists("ofile")) ofile = ""
+
+set term postscript color enhanced font "Helvetica" 17 butt dashed
+
+set grid ytics
+set key font ",13" top right box
+
+set logscale x 2
+set xrange [1:65536]
+set yrange [0:]
+set xlabel "Latency (cycles)" font ",15" offset 0,0.75
+set xtics font ",11" offset 0,0.5
+set ylabel "Responses" font ",15" offset 2,0
+set ytics font ",11" offset 0.5,0
+
+set style fill transparent solid 0.5 noborder
+
+set output "| ps2pdf - lat_hist_" . ofile . ".pdf"
+set title title . " Latency Histogram" font ",18" offset 1,0
+
+# Buckets are [2^i, 2^(i+1)).  Bucket 0 (0-1 cycles) is drawn from 1.
+plot datafile index point using (($1 > 0 ? $1 : 1) * sqrt(2)):3:($1 > 0 ? $1 : 1):($2 + 1) with boxxy title "Read" lc rgb "#0060ad", \
+     datafile index point using (($1 > 0 ? $1 : 1) * sqrt(2)):4:($1 > 0 ? $1 : 1):($2 + 1) with boxxy title "Write" lc rgb "#dd181f"
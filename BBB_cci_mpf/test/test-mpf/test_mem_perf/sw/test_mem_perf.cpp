@@ -24,7 +24,10 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <fstream>
+
 #include "test_mem_perf.h"
+#include "test_mem_perf_sweep.h"
 
 
 // ========================================================================
@@ -48,6 +51,16 @@ void testConfigOptions(po::options_description &desc)
         ("ts", po::value<int>()->default_value(0), "Test length (seconds)")
         ("enable-warmup", po::value<bool>()->default_value(true), "Warm up VTP's TLB")
         ("test-mode", po::value<bool>()->default_value(false), "Generate simple memory patterns for testing address logic")
+        ("repeat-warmup", po::value<int>()->default_value(0), "Discarded runs before measuring each point")
+        ("repeat-min", po::value<int>()->default_value(1), "Minimum measured runs per point")
+        ("repeat-max", po::value<int>()->default_value(1), "Maximum measured runs per point")
+        ("repeat-ci", po::value<double>()->default_value(0), "Stop repeating once the 95% CI of throughput is within this percent of the mean")
+        ("sweep", po::value<string>()->default_value(""), "Sweep specification (INI file, one group per section)")
+        ("output-format", po::value<string>()->default_value("text"), "Result format (text, csv or json)")
+        ("output-file", po::value<string>()->default_value(""), "Write results to a file instead of stdout")
+        ("latency-hist-file", po::value<string>()->default_value(""), "Also write plot-ready latency histograms to a file")
+        ("checkpoint", po::value<string>()->default_value(""), "Record completed points in a file and skip them when resuming")
+        ("sweep-shard", po::value<string>()->default_value("0/1"), "Run only shard <i>/<n> of the sweep's points")
         ;
 }
 
@@ -94,15 +107,7 @@ int TEST_MEM_PERF::test()
     config.rdline_s = vm["rdline-s"].as<bool>();
     config.wrline_m = vm["wrline-m"].as<bool>();
 
-    config.mcl = uint64_t(vm["mcl"].as<int>());
-    if ((config.mcl > 4) || (config.mcl == 3))
-    {
-        cerr << "Illegal multi-line (mcl) parameter:  " << config.mcl << endl;
-        exit(1);
-    }
-    // Encode mcl as 3 bits.  The low 2 are the Verilog t_ccip_clLen and the
-    // high bit indicates random sizes.
-    config.mcl = (config.mcl - 1) & 7;
+    config.mcl = sweepEncodeMCL(vm["mcl"].as<int>());
 
     if (vm["test-mode"].as<bool>())
     {
@@ -123,117 +128,156 @@ int TEST_MEM_PERF::test()
         return 0;
     }
 
-    uint64_t stride_incr = 1 + config.mcl;
-
-    uint64_t min_stride = uint64_t(vm["min-stride"].as<int>());
-    min_stride = (min_stride + stride_incr - 1) & ~ (stride_incr - 1);
-    uint64_t max_stride = uint64_t(vm["max-stride"].as<int>()) + 1;
-
-    bool vcmap_all = vm["vcmap-all"].as<bool>();
-    bool vcmap_enable = vm["vcmap-enable"].as<bool>();
-    bool vcmap_dynamic = vm["vcmap-dynamic"].as<bool>();
-    int32_t vcmap_fixed_vl0_ratio = int32_t(vm["vcmap-fixed"].as<int>());
-    cout << "# MCL = " << (config.mcl + 1) << endl
-         << "# Cycles per test = " << config.cycles << endl
-         << "# AFU MHz = " << afu_mhz << endl
-         << "# VC = " << vcNumToName(config.vc) << endl
-         << "# VC Map enabled: " << (vcmap_enable ? "true" : "false") << endl;
-    if (vcmap_enable)
+    // Command line settings are the defaults for every sweep group
+    t_sweep_group tmpl;
+    tmpl.name = "";
+    tmpl.mode = SWEEP_MODE_READ;
+    tmpl.min_bytes = 0;
+    tmpl.max_bytes = buffer_bytes;
+    tmpl.min_stride = uint64_t(vm["min-stride"].as<int>());
+    tmpl.max_stride = uint64_t(vm["max-stride"].as<int>());
+    tmpl.vc = config.vc;
+    tmpl.mcl = config.mcl;
+    tmpl.rdline_s = config.rdline_s;
+    tmpl.wrline_m = config.wrline_m;
+
+    const string sweep_path = vm["sweep"].as<string>();
+    std::vector<t_sweep_group> groups =
+        (sweep_path.empty() ? sweepDefaultGroups(tmpl, buffer_bytes) :
+                              sweepLoadGroups(sweep_path, tmpl, buffer_bytes));
+
+    unsigned int shard_idx, n_shards;
+    const string shard = vm["sweep-shard"].as<string>();
+    if ((sscanf(shard.c_str(), "%u/%u", &shard_idx, &n_shards) != 2) ||
+        (n_shards == 0) || (shard_idx >= n_shards))
     {
-        cout << "# VC Map all: " << (vcmap_all ? "true" : "false") << endl
-             << "# VC Map dynamic: " << (vcmap_dynamic ? "true" : "false") << endl;
-        if (! vcmap_dynamic)
-        {
-            cout << "# VC Map fixed VL0 ratio: " << vcmap_fixed_vl0_ratio << " / 64" << endl;
-        }
+        cerr << "Illegal sweep shard (expected <i>/<n>, i < n):  " << shard << endl;
+        exit(1);
     }
 
-    // Read
-    cout << "#" << endl
-         << "# Reads " << (config.rdline_s ? "" : "not ") << "cached" << endl
-         << "# Mem Bytes, Stride, " << statsHeader()
-         << endl;
+    std::vector<t_sweep_point> points = sweepEnumerate(groups, shard_idx, n_shards);
+
+    t_sweep_env env;
+    env.cycles = config.cycles;
+    env.afu_mhz = afu_mhz;
+    env.buffer_bytes = buffer_bytes;
+    env.vcmap_enable = vm["vcmap-enable"].as<bool>();
+    env.vcmap_all = vm["vcmap-all"].as<bool>();
+    env.vcmap_dynamic = vm["vcmap-dynamic"].as<bool>();
+    env.vcmap_fixed_vl0_ratio = int32_t(vm["vcmap-fixed"].as<int>());
+    env.vcmap_only_writes = vm["vcmap-only-writes"].as<bool>();
+
+    if ((vm["repeat-warmup"].as<int>() < 0) ||
+        (vm["repeat-min"].as<int>() < 1) ||
+        (vm["repeat-max"].as<int>() < vm["repeat-min"].as<int>()) ||
+        (vm["repeat-ci"].as<double>() < 0))
+    {
+        cerr << "Illegal repeat parameters (need repeat-min >= 1, repeat-max >= repeat-min)" << endl;
+        exit(1);
+    }
+    env.repeat.warmup_runs = vm["repeat-warmup"].as<int>();
+    env.repeat.min_runs = vm["repeat-min"].as<int>();
+    env.repeat.max_runs = vm["repeat-max"].as<int>();
+    env.repeat.ci_target = vm["repeat-ci"].as<double>() / 100.0;
+
+    SWEEP_CHECKPOINT checkpoint;
+    const string checkpoint_path = vm["checkpoint"].as<string>();
+    if (! checkpoint_path.empty() &&
+        ! checkpoint.open(checkpoint_path,
+                          SWEEP_CHECKPOINT::fingerprint(groups, env, shard_idx, n_shards)))
+    {
+        exit(1);
+    }
 
-    for (uint64_t mem_lines = stride_incr; mem_lines * CL(1) <= buffer_bytes; mem_lines <<= 1)
+    // Resumed runs add to the output of the interrupted run
+    bool append = (checkpoint.numLoaded() != 0);
+    if (append)
     {
-        config.buf_lines = mem_lines;
+        cerr << "Resuming sweep: " << checkpoint.numLoaded() << " of "
+             << points.size() << " points already complete" << endl;
+    }
 
-        // Vary stride
-        uint64_t stride_limit = (mem_lines < max_stride ? mem_lines+1 : max_stride);
-        for (uint64_t stride = min_stride; stride < stride_limit; stride += stride_incr)
+    std::ofstream out_file;
+    const string out_path = vm["output-file"].as<string>();
+    if (! out_path.empty())
+    {
+        out_file.open(out_path.c_str(), append ? std::ios::app : std::ios::trunc);
+        if (! out_file.is_open())
         {
-            t_test_stats stats;
-
-            config.stride = stride;
-            config.enable_writes = false;
-            config.enable_reads = true;
-            assert(runTest(&config, &stats) == 0);
-
-            cout << mem_lines * CL(1) << " "
-                 << stride << " "
-                 << stats
-                 << endl;
+            cerr << "Failed to open output file " << out_path << endl;
+            exit(1);
         }
     }
+    std::ostream& os = (out_path.empty() ? cout : out_file);
 
-    // Write
-    cout << endl
-         << endl
-         << "# Writes " << (config.wrline_m ? "" : "not ") << "cached" << endl
-         << "# Mem Bytes, Stride, " << statsHeader()
-         << endl;
-
-    for (uint64_t mem_lines = stride_incr; mem_lines * CL(1) <= buffer_bytes; mem_lines <<= 1)
+    const string format = vm["output-format"].as<string>();
+    SWEEP_SINK* sink = allocSweepSink(format, os, env);
+    if (sink == NULL)
     {
-        config.buf_lines = mem_lines;
-
-        // Vary stride
-        uint64_t stride_limit = (mem_lines < max_stride ? mem_lines+1 : max_stride);
-        for (uint64_t stride = min_stride; stride < stride_limit; stride += stride_incr)
-        {
-            t_test_stats stats;
+        cerr << "Illegal output format:  " << format << endl;
+        exit(1);
+    }
 
-            config.stride = stride;
-            config.enable_writes = true;
-            config.enable_reads = false;
-            assert(runTest(&config, &stats) == 0);
+    sink->begin(tmpl, append);
 
-            cout << mem_lines * CL(1) << " "
-                 << stride << " "
-                 << stats
-                 << endl;
+    std::ofstream hist_file;
+    SWEEP_SINK* hist_sink = NULL;
+    const string hist_path = vm["latency-hist-file"].as<string>();
+    if (! hist_path.empty())
+    {
+        hist_file.open(hist_path.c_str(), append ? std::ios::app : std::ios::trunc);
+        if (! hist_file.is_open())
+        {
+            cerr << "Failed to open latency histogram file " << hist_path << endl;
+            exit(1);
         }
-    }
 
-    // Throughput (independent read and write)
-    cout << endl
-         << endl
-         << "# Reads " << (config.rdline_s ? "" : "not ") << "cached +"
-         << " Writes " << (config.wrline_m ? "" : "not ") << "cached" << endl
-         << "# Mem Bytes, Stride, " << statsHeader()
-         << endl;
+        hist_sink = allocSweepSink("lathist", hist_file, env);
+        hist_sink->begin(tmpl, append);
+    }
 
-    for (uint64_t mem_lines = stride_incr; mem_lines * CL(1) <= buffer_bytes; mem_lines <<= 1)
+    // Points run one at a time.  The AFU has a single traffic generator,
+    // so larger sweeps are split across AFUs or hosts with --sweep-shard.
+    bool first_group = true;
+    size_t cur_group = groups.size();
+    for (size_t i = 0; i < points.size(); i++)
     {
-        config.buf_lines = mem_lines;
+        const t_sweep_point& p = points[i];
+        if (checkpoint.isDone(p)) continue;
 
-        // Vary stride
-        uint64_t stride_limit = (mem_lines < max_stride ? mem_lines+1 : max_stride);
-        for (uint64_t stride = min_stride; stride < stride_limit; stride += stride_incr)
+        const t_sweep_group& g = groups[p.group];
+        if (p.group != cur_group)
         {
-            t_test_stats stats;
-
-            config.stride = stride;
-            config.enable_writes = true;
-            config.enable_reads = true;
-            assert(runTest(&config, &stats) == 0);
+            sink->beginGroup(g, first_group);
+            first_group = false;
+            cur_group = p.group;
+        }
 
-            cout << mem_lines * CL(1) << " "
-                 << stride << " "
-                 << stats
-                 << endl;
+        t_test_stats stats;
+        t_test_dist dist;
+
+        config.vc = g.vc;
+        config.mcl = g.mcl;
+        config.rdline_s = g.rdline_s;
+        config.wrline_m = g.wrline_m;
+        config.buf_lines = p.mem_lines;
+        config.stride = p.stride;
+        config.enable_writes = (g.mode != SWEEP_MODE_READ);
+        config.enable_reads = (g.mode != SWEEP_MODE_WRITE);
+        assert(runTestStats(&config, &env.repeat, &stats, &dist) == 0);
+
+        sink->result(g, p, stats, dist);
+        if (hist_sink) hist_sink->result(g, p, stats, dist);
+
+        // The result is flushed by the sink before it is checkpointed
+        if (checkpoint.isOpen())
+        {
+            checkpoint.markDone(p);
         }
     }
 
+    delete sink;
+    delete hist_sink;
+
     return 0;
 }
@@ -30,6 +30,7 @@
 #include <math.h>
 #include <iostream>
 #include <boost/format.hpp>
+#include <opae/mpf/wait.h>
 
 #include "cci_test.h"
 
@@ -41,6 +42,14 @@ class TEST_MEM_PERF : public CCI_TEST
         TEST_CSR_BASE = 32
     };
 
+  public:
+    enum
+    {
+        // Log2 buckets in the HW latency histograms.  Bucket 0 holds
+        // latencies of 0 and 1 cycles and bucket i [2^i, 2^(i+1)).
+        N_LAT_BUCKETS = 16
+    };
+
     typedef struct
     {
         uint64_t cycles;
@@ -80,10 +89,140 @@ class TEST_MEM_PERF : public CCI_TEST
         uint64_t read_average_latency;
         uint64_t write_max_inflight_lines;
         uint64_t write_average_latency;
+        // Sum of request latencies (cycles)
+        uint64_t read_total_latency;
+        uint64_t write_total_latency;
+        // Responses per latency bucket
+        uint64_t read_latency_hist[N_LAT_BUCKETS];
+        uint64_t write_latency_hist[N_LAT_BUCKETS];
     }
     t_test_stats;
 
-  public:
+    // Values derived from t_test_stats, as reported
+    typedef struct
+    {
+        double read_gbs;
+        double write_gbs;
+        uint64_t vl0_lines;
+        uint32_t vl0_rd_hits_per_1000;
+        uint32_t vl0_wr_hits_per_1000;
+        double read_almost_full_pct;
+        double write_almost_full_pct;
+        // Latency percentiles (cycles) from the histograms
+        double read_lat_p50;
+        double read_lat_p99;
+        double read_lat_p999;
+        double write_lat_p50;
+        double write_lat_p99;
+        double write_lat_p999;
+    }
+    t_test_stats_summary;
+
+    //
+    // Latency (cycles) below which fraction p of the responses in a
+    // histogram fall, interpolated linearly within the bucket.  Returns
+    // 0 for an empty histogram.
+    //
+    static double latencyPercentile(const uint64_t* hist, double p)
+    {
+        uint64_t total = 0;
+        for (int i = 0; i < N_LAT_BUCKETS; i++) total += hist[i];
+        if (total == 0) return 0;
+
+        double target = p * total;
+        uint64_t below = 0;
+        for (int i = 0; i < N_LAT_BUCKETS; i++)
+        {
+            if (hist[i] && (below + hist[i] >= target))
+            {
+                double lo = (i == 0 ? 0 : double(1 << i));
+                double hi = double(2 << i);
+                return lo + (hi - lo) * (target - below) / hist[i];
+            }
+            below += hist[i];
+        }
+
+        return double(2 << (N_LAT_BUCKETS - 1));
+    }
+
+    // Repetition policy for runTestStats()
+    typedef struct
+    {
+        // Runs discarded before measurement begins
+        uint32_t warmup_runs;
+        uint32_t min_runs;
+        uint32_t max_runs;
+        // Stop once the 95% confidence interval half-width of throughput
+        // is within this fraction of the mean.  0 always runs max_runs.
+        double ci_target;
+    }
+    t_test_repeat;
+
+    // Distribution of one metric over the accepted runs
+    typedef struct
+    {
+        double mean;
+        double median;
+        double p5;
+        double p95;
+        // Half-width of the 95% confidence interval of the mean
+        double ci95;
+    }
+    t_metric_dist;
+
+    typedef struct
+    {
+        uint32_t n_runs;
+        // Runs excluded from n_runs as throughput outliers
+        uint32_t n_rejected;
+        // The CI target was met (always true without a target)
+        bool converged;
+
+        t_metric_dist read_gbs;
+        t_metric_dist write_gbs;
+        t_metric_dist read_latency;
+        t_metric_dist write_latency;
+    }
+    t_test_dist;
+
+    static t_test_stats_summary summarizeStats(const t_test_stats& stats)
+    {
+        t_test_stats_summary s;
+
+        s.read_gbs = (double(stats.read_lines) * CL(1) / 0x40000000) / stats.run_sec;
+        s.write_gbs = (double(stats.write_lines) * CL(1) / 0x40000000) / stats.run_sec;
+        s.vl0_lines = stats.vl0_rd_lines + stats.vl0_wr_lines;
+
+        s.vl0_rd_hits_per_1000 = 0;
+        if (stats.vl0_rd_lines)
+        {
+            s.vl0_rd_hits_per_1000 = round((1000.0 * stats.read_cache_line_hits) / stats.vl0_rd_lines);
+        }
+
+        s.vl0_wr_hits_per_1000 = 0;
+        if (stats.vl0_wr_lines)
+        {
+            s.vl0_wr_hits_per_1000 = round((1000.0 * stats.write_cache_line_hits) / stats.vl0_wr_lines);
+        }
+
+        s.read_almost_full_pct = 100.0 * double(stats.read_almost_full_cycles) / double(stats.actual_cycles);
+        s.write_almost_full_pct = 100.0 * double(stats.write_almost_full_cycles) / double(stats.actual_cycles);
+
+        s.read_lat_p50 = latencyPercentile(stats.read_latency_hist, 0.5);
+        s.read_lat_p99 = latencyPercentile(stats.read_latency_hist, 0.99);
+        s.read_lat_p999 = latencyPercentile(stats.read_latency_hist, 0.999);
+        s.write_lat_p50 = latencyPercentile(stats.write_latency_hist, 0.5);
+        s.write_lat_p99 = latencyPercentile(stats.write_latency_hist, 0.99);
+        s.write_lat_p999 = latencyPercentile(stats.write_latency_hist, 0.999);
+
+        return s;
+    }
+
+    static string statsHeader(void)
+    {
+        return "Read GB/s, Write GB/s, VL0 lines, VH0 lines, VH1 lines, VL0 Rd Hits per 1000, VL0 Wr Hits per 1000, Read Max Inflight Lines, Read Ave Cycle Lat, Write Max Inflight Lines, Write Ave Cycle Lat, Read AlmFull %, Write AlmFull %, Read Lat p50, Read Lat p99, Read Lat p99.9, Write Lat p50, Write Lat p99, Write Lat p99.9";
+    }
+
     TEST_MEM_PERF(const po::variables_map& vm, SVC_WRAPPER& svc) :
         CCI_TEST(vm, svc),
         dsm(NULL),
@@ -91,7 +230,9 @@ class TEST_MEM_PERF : public CCI_TEST
         rd_mem(NULL),
         wr_mem(NULL),
         totalCycles(0)
-    {};
+    {
+        mpfWaitInit(&dsmWait);
+    };
 
     ~TEST_MEM_PERF() {};
 
@@ -104,44 +245,49 @@ class TEST_MEM_PERF : public CCI_TEST
     int runTest(const t_test_config* config, t_test_stats* stats);
     // Invoke runTest n times and return the average
     int runTestN(const t_test_config* config, t_test_stats* stats, int n);
+    // Invoke runTest repeatedly, as directed by repeat.  stats is the
+    // average of the accepted runs, with throughput and latency weighted
+    // by run length and line count.  dist may be NULL.
+    int runTestStats(const t_test_config* config,
+                     const t_test_repeat* repeat,
+                     t_test_stats* stats,
+                     t_test_dist* dist);
+
+    // Measurement callback for mpfLatencyQosTune().  Defined only by
+    // compute_latency_qos_params.
+    static fpga_result latencyQosMeasure(void* ctx,
+                                         uint32_t channel,
+                                         double* bandwidth,
+                                         double* latency);
 
     bool initMem(bool enableWarmup = false, bool cached = false);
 
     // Warm up both VTP and the first 2K lines in VL0 for a region
     void warmUp(void* buf, uint64_t n_bytes, bool cached);
 
-    string statsHeader(void)
-    {
-        return "Read GB/s, Write GB/s, VL0 lines, VH0 lines, VH1 lines, VL0 Rd Hits per 1000, VL0 Wr Hits per 1000, Read Max Inflight Lines, Read Ave Cycle Lat, Write Max Inflight Lines, Write Ave Cycle Lat, Read AlmFull %, Write AlmFull %";
-    }
-
     friend std::ostream& operator<< (std::ostream& os, const t_test_stats& stats)
     {
-        uint32_t vl0_rd_hit_rate = 0;
-        if (stats.vl0_rd_lines)
-        {
-            vl0_rd_hit_rate = round((1000.0 * stats.read_cache_line_hits) / stats.vl0_rd_lines);
-        }
-
-        uint32_t vl0_wr_hit_rate = 0;
-        if (stats.vl0_wr_lines)
-        {
-            vl0_wr_hit_rate = round((1000.0 * stats.write_cache_line_hits) / stats.vl0_wr_lines);
-        }
+        t_test_stats_summary s = summarizeStats(stats);
 
-        os << boost::format("%.1f") % ((double(stats.read_lines) * CL(1) / 0x40000000) / stats.run_sec) << " "
-           << boost::format("%.1f") % ((double(stats.write_lines) * CL(1) / 0x40000000) / stats.run_sec) << " "
-           << stats.vl0_rd_lines + stats.vl0_wr_lines << " "
+        os << boost::format("%.1f") % s.read_gbs << " "
+           << boost::format("%.1f") % s.write_gbs << " "
+           << s.vl0_lines << " "
            << stats.vh0_lines << " "
            << stats.vh1_lines << " "
-           << vl0_rd_hit_rate << " "
-           << vl0_wr_hit_rate << " "
+           << s.vl0_rd_hits_per_1000 << " "
+           << s.vl0_wr_hits_per_1000 << " "
            << stats.read_max_inflight_lines << " "
            << stats.read_average_latency << " "
            << stats.write_max_inflight_lines << " "
            << stats.write_average_latency << " "
-           << boost::format("%.4f") % (100.0 * double(stats.read_almost_full_cycles) / double(stats.actual_cycles)) << " "
-           << boost::format("%.4f") % (100.0 * double(stats.write_almost_full_cycles) / double(stats.actual_cycles)) << " ";
+           << boost::format("%.4f") % s.read_almost_full_pct << " "
+           << boost::format("%.4f") % s.write_almost_full_pct << " "
+           << boost::format("%.0f") % s.read_lat_p50 << " "
+           << boost::format("%.0f") % s.read_lat_p99 << " "
+           << boost::format("%.0f") % s.read_lat_p999 << " "
+           << boost::format("%.0f") % s.write_lat_p50 << " "
+           << boost::format("%.0f") % s.write_lat_p99 << " "
+           << boost::format("%.0f") % s.write_lat_p999 << " ";
         return os;
     }
 
@@ -149,6 +295,8 @@ class TEST_MEM_PERF : public CCI_TEST
 
     fpga::types::shared_buffer::ptr_t dsm_buf_handle;
     volatile uint64_t* dsm;
+    // Adapts polling of dsm to the observed test run times
+    mpf_wait_state dsmWait;
 
     uint64_t buffer_bytes;
     fpga::types::shared_buffer::ptr_t buffer_handle;
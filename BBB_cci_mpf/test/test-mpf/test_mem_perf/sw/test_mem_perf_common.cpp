@@ -34,6 +34,8 @@
 
 #include <unistd.h>
 #include <time.h>
+#include <algorithm>
+#include <vector>
 
 const char* testAFUID()
 {
@@ -142,19 +144,15 @@ TEST_MEM_PERF::runTest(const t_test_config* config, t_test_stats* stats)
                     uint64_t(config->enable_reads));
     writeTestCSR(0, config->cycles);
 
-    // Wait time for something to happen
-    struct timespec ms;
-    // Longer when simulating
-    ms.tv_sec = (hwIsSimulated() ? 2 : 0);
-    ms.tv_nsec = 2500000;
+    // Time between checks for a hung test.  Longer when simulating.
+    uint64_t check_ns = (hwIsSimulated() ? 2000000000 : 0) + 2500000;
 
     uint64_t iter_state_end = 0;
 
     // Wait for test to signal it is complete
-    while (*dsm == 0)
+    while (! mpfWaitUntilTimeout(&dsmWait, dsm, ~uint64_t(0), 0, false,
+                                 check_ns, NULL))
     {
-        nanosleep(&ms, NULL);
-
         // Is the test done but not writing to DSM?  Could be a bug.
         uint8_t state = (readTestCSR(7) >> 8) & 255;
         if (state > 1)
@@ -197,6 +195,17 @@ TEST_MEM_PERF::runTest(const t_test_config* config, t_test_stats* stats)
         return 1;
     }
 
+    stats->read_total_latency = dsm[2];
+    stats->write_total_latency = dsm[3];
+
+    // Latency histograms are in the next two DSM lines, 32 bit counters
+    const volatile uint32_t* rd_hist = reinterpret_cast<const volatile uint32_t*>(dsm + 8);
+    const volatile uint32_t* wr_hist = reinterpret_cast<const volatile uint32_t*>(dsm + 16);
+    for (int i = 0; i < N_LAT_BUCKETS; i++)
+    {
+        stats->read_latency_hist[i] = rd_hist[i];
+        stats->write_latency_hist[i] = wr_hist[i];
+    }
     stats->read_average_latency = (stats->read_lines ? dsm[2] / stats->read_lines : 0);
     stats->write_average_latency = (stats->write_lines ? dsm[3] / stats->write_lines : 0);
 
@@ -208,44 +217,240 @@ TEST_MEM_PERF::runTest(const t_test_config* config, t_test_stats* stats)
 
 int
 TEST_MEM_PERF::runTestN(const t_test_config* config, t_test_stats* stats, int n)
+{
+    t_test_repeat repeat;
+    repeat.warmup_runs = 0;
+    repeat.min_runs = n;
+    repeat.max_runs = n;
+    repeat.ci_target = 0;
+
+    return runTestStats(config, &repeat, stats, NULL);
+}
+
+
+// ========================================================================
+//
+//  Statistics over repeated runs.
+//
+// ========================================================================
+
+// Linear interpolation between closest ranks.  v must be sorted.
+static double percentile(const std::vector<double>& v, double p)
+{
+    if (v.empty()) return 0;
+
+    double rank = p * (v.size() - 1);
+    size_t lo = size_t(rank);
+    if (lo + 1 >= v.size()) return v.back();
+
+    return v[lo] + (rank - lo) * (v[lo + 1] - v[lo]);
+}
+
+// Two-sided 95% critical value of Student's t distribution
+static double tCritical95(size_t df)
+{
+    static const double t[] =
+    {
+        0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+        2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+        2.042
+    };
+
+    if (df < sizeof(t) / sizeof(t[0])) return t[df];
+    if (df < 60) return 2.000;
+    if (df < 120) return 1.980;
+    return 1.960;
+}
+
+static void metricDist(std::vector<double> v, TEST_MEM_PERF::t_metric_dist* d)
+{
+    memset(d, 0, sizeof(*d));
+    if (v.empty()) return;
+
+    std::sort(v.begin(), v.end());
+
+    double sum = 0;
+    for (size_t i = 0; i < v.size(); i++) sum += v[i];
+    d->mean = sum / v.size();
+
+    d->median = percentile(v, 0.5);
+    d->p5 = percentile(v, 0.05);
+    d->p95 = percentile(v, 0.95);
+
+    if (v.size() > 1)
+    {
+        double sq = 0;
+        for (size_t i = 0; i < v.size(); i++) sq += (v[i] - d->mean) * (v[i] - d->mean);
+        double stddev = sqrt(sq / (v.size() - 1));
+        d->ci95 = tCritical95(v.size() - 1) * stddev / sqrt(double(v.size()));
+    }
+}
+
+static double runGBs(const TEST_MEM_PERF::t_test_stats& s)
+{
+    TEST_MEM_PERF::t_test_stats_summary sum = TEST_MEM_PERF::summarizeStats(s);
+    return sum.read_gbs + sum.write_gbs;
+}
+
+//
+// Mark runs whose throughput is more than 3 scaled median absolute
+// deviations from the median.  Too few runs to judge reject nothing.
+//
+static std::vector<bool> findOutliers(const std::vector<TEST_MEM_PERF::t_test_stats>& runs)
+{
+    std::vector<bool> outlier(runs.size(), false);
+    if (runs.size() < 5) return outlier;
+
+    std::vector<double> gbs;
+    for (size_t i = 0; i < runs.size(); i++) gbs.push_back(runGBs(runs[i]));
+
+    std::vector<double> sorted(gbs);
+    std::sort(sorted.begin(), sorted.end());
+    double median = percentile(sorted, 0.5);
+
+    std::vector<double> dev;
+    for (size_t i = 0; i < gbs.size(); i++) dev.push_back(fabs(gbs[i] - median));
+    std::sort(dev.begin(), dev.end());
+    double mad = 1.4826 * percentile(dev, 0.5);
+    if (mad == 0) return outlier;
+
+    for (size_t i = 0; i < gbs.size(); i++)
+    {
+        outlier[i] = (fabs(gbs[i] - median) > 3 * mad);
+    }
+
+    return outlier;
+}
+
+static void computeDist(const std::vector<TEST_MEM_PERF::t_test_stats>& runs,
+                        const std::vector<bool>& outlier,
+                        TEST_MEM_PERF::t_test_dist* dist)
+{
+    std::vector<double> rd_gbs, wr_gbs, rd_lat, wr_lat;
+
+    dist->n_runs = 0;
+    dist->n_rejected = 0;
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        if (outlier[i])
+        {
+            dist->n_rejected += 1;
+            continue;
+        }
+
+        const TEST_MEM_PERF::t_test_stats& s = runs[i];
+        TEST_MEM_PERF::t_test_stats_summary sum = TEST_MEM_PERF::summarizeStats(s);
+
+        dist->n_runs += 1;
+        rd_gbs.push_back(sum.read_gbs);
+        wr_gbs.push_back(sum.write_gbs);
+        if (s.read_lines) rd_lat.push_back(double(s.read_total_latency) / s.read_lines);
+        if (s.write_lines) wr_lat.push_back(double(s.write_total_latency) / s.write_lines);
+    }
+
+    metricDist(rd_gbs, &dist->read_gbs);
+    metricDist(wr_gbs, &dist->write_gbs);
+    metricDist(rd_lat, &dist->read_latency);
+    metricDist(wr_lat, &dist->write_latency);
+}
+
+static bool ciMet(const TEST_MEM_PERF::t_metric_dist& d, double target)
+{
+    return d.ci95 <= target * d.mean;
+}
+
+
+int
+TEST_MEM_PERF::runTestStats(const t_test_config* config,
+                            const t_test_repeat* repeat,
+                            t_test_stats* stats,
+                            t_test_dist* dist)
 {
     int r = 0;
     t_test_stats stats_single;
 
-    memset(stats, 0, sizeof(t_test_stats));
+    for (uint32_t i = 0; i < repeat->warmup_runs; i += 1)
+    {
+        r |= runTest(config, &stats_single);
+    }
 
-    // Sum results from all runs
-    for (int i = 0; i < n; i += 1)
+    uint32_t min_runs = (repeat->min_runs ? repeat->min_runs : 1);
+    uint32_t max_runs = (repeat->max_runs > min_runs ? repeat->max_runs : min_runs);
+
+    std::vector<t_test_stats> runs;
+    std::vector<bool> outlier;
+    t_test_dist d;
+    d.converged = (repeat->ci_target <= 0);
+
+    while (runs.size() < max_runs)
     {
         r |= runTest(config, &stats_single);
+        runs.push_back(stats_single);
 
-        stats->actual_cycles += stats_single.actual_cycles;
-        stats->run_sec += stats_single.run_sec;
-
-        stats->read_lines += stats_single.read_lines;
-        stats->write_lines += stats_single.write_lines;
-        stats->read_cache_line_hits += stats_single.read_cache_line_hits;
-        stats->write_cache_line_hits += stats_single.write_cache_line_hits;
-        stats->vl0_rd_lines += stats_single.vl0_rd_lines;
-        stats->vl0_wr_lines += stats_single.vl0_wr_lines;
-        stats->vh0_lines += stats_single.vh0_lines;
-        stats->vh1_lines += stats_single.vh1_lines;
-        stats->read_almost_full_cycles += stats_single.read_almost_full_cycles;
-        stats->write_almost_full_cycles += stats_single.write_almost_full_cycles;
-
-        if (stats->read_max_inflight_lines < stats_single.read_max_inflight_lines)
+        // Enough samples to stop early?
+        if (! d.converged && (runs.size() >= min_runs) && (runs.size() > 1))
         {
-            stats->read_max_inflight_lines = stats_single.read_max_inflight_lines;
+            outlier = findOutliers(runs);
+            computeDist(runs, outlier, &d);
+            d.converged = (d.n_runs > 1) &&
+                          (! config->enable_reads || ciMet(d.read_gbs, repeat->ci_target)) &&
+                          (! config->enable_writes || ciMet(d.write_gbs, repeat->ci_target));
+            if (d.converged) break;
         }
-        stats->read_average_latency += stats_single.read_average_latency;
-        if (stats->write_max_inflight_lines < stats_single.write_max_inflight_lines)
+    }
+
+    outlier = findOutliers(runs);
+    computeDist(runs, outlier, &d);
+    if (dist) *dist = d;
+
+    // Sum results from the accepted runs.  Throughput and latency derived
+    // from the sums are weighted by cycles and lines, not by run.
+    memset(stats, 0, sizeof(t_test_stats));
+    uint64_t n = 0;
+    for (size_t i = 0; i < runs.size(); i += 1)
+    {
+        if (outlier[i]) continue;
+        n += 1;
+
+        const t_test_stats& s = runs[i];
+        stats->actual_cycles += s.actual_cycles;
+        stats->run_sec += s.run_sec;
+
+        stats->read_lines += s.read_lines;
+        stats->write_lines += s.write_lines;
+        stats->read_cache_line_hits += s.read_cache_line_hits;
+        stats->write_cache_line_hits += s.write_cache_line_hits;
+        stats->vl0_rd_lines += s.vl0_rd_lines;
+        stats->vl0_wr_lines += s.vl0_wr_lines;
+        stats->vh0_lines += s.vh0_lines;
+        stats->vh1_lines += s.vh1_lines;
+        stats->read_almost_full_cycles += s.read_almost_full_cycles;
+        stats->write_almost_full_cycles += s.write_almost_full_cycles;
+
+        if (stats->read_max_inflight_lines < s.read_max_inflight_lines)
         {
-            stats->write_max_inflight_lines = stats_single.write_max_inflight_lines;
+            stats->read_max_inflight_lines = s.read_max_inflight_lines;
+        }
+        if (stats->write_max_inflight_lines < s.write_max_inflight_lines)
+        {
+            stats->write_max_inflight_lines = s.write_max_inflight_lines;
+        }
+        stats->read_total_latency += s.read_total_latency;
+        stats->write_total_latency += s.write_total_latency;
+
+        for (int b = 0; b < N_LAT_BUCKETS; b++)
+        {
+            stats->read_latency_hist[b] += s.read_latency_hist[b];
+            stats->write_latency_hist[b] += s.write_latency_hist[b];
         }
-        stats->write_average_latency += stats_single.write_average_latency;
     }
 
-    // Convert sums to avarages
+    stats->read_average_latency = (stats->read_lines ? stats->read_total_latency / stats->read_lines : 0);
+    stats->write_average_latency = (stats->write_lines ? stats->write_total_latency / stats->write_lines : 0);
+
+    // Convert sums to per-run averages.  Ratios of sums are unchanged.
+    // Histograms remain sums so that sparse tail buckets aren't lost.
     stats->actual_cycles /= n;
     stats->run_sec /= n;
 
@@ -259,9 +464,8 @@ TEST_MEM_PERF::runTestN(const t_test_config* config, t_test_stats* stats, int n)
     stats->vh1_lines /= n;
     stats->read_almost_full_cycles /= n;
     stats->write_almost_full_cycles /= n;
-
-    stats->read_average_latency /= n;
-    stats->write_average_latency /= n;
+    stats->read_total_latency /= n;
+    stats->write_total_latency /= n;
 
     return r;
 }
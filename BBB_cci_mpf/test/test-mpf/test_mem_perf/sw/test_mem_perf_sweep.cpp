@@ -0,0 +1,870 @@
+// Copyright(c) 2007-2016, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+
+#include "test_mem_perf_sweep.h"
+
+
+static const char* vcName(uint32_t vc)
+{
+    static const char* names[] = { "VA", "VL0", "VH0", "VH1" };
+    return names[vc & 3];
+}
+
+static const char* modeName(t_sweep_mode mode)
+{
+    switch (mode)
+    {
+      case SWEEP_MODE_WRITE:
+        return "write";
+      case SWEEP_MODE_RW:
+        return "rw";
+      default:
+        return "read";
+    }
+}
+
+// User-visible MCL from the t_test_config encoding (0 for random sizes)
+static int decodeMCL(uint8_t mcl)
+{
+    return (mcl + 1) & 7;
+}
+
+
+uint8_t sweepEncodeMCL(int mcl)
+{
+    if ((mcl < 0) || (mcl > 4) || (mcl == 3))
+    {
+        cerr << "Illegal multi-line (mcl) parameter:  " << mcl << endl;
+        exit(1);
+    }
+
+    // Encode mcl as 3 bits.  The low 2 are the Verilog t_ccip_clLen and the
+    // high bit indicates random sizes.
+    return (mcl - 1) & 7;
+}
+
+
+std::vector<t_sweep_group> sweepDefaultGroups(const t_sweep_group& tmpl,
+                                              uint64_t buffer_bytes)
+{
+    std::vector<t_sweep_group> groups;
+
+    t_sweep_group g = tmpl;
+    g.min_bytes = 0;
+    g.max_bytes = buffer_bytes;
+
+    g.name = "reads";
+    g.mode = SWEEP_MODE_READ;
+    groups.push_back(g);
+
+    g.name = "writes";
+    g.mode = SWEEP_MODE_WRITE;
+    groups.push_back(g);
+
+    g.name = "rw";
+    g.mode = SWEEP_MODE_RW;
+    groups.push_back(g);
+
+    return groups;
+}
+
+
+// ========================================================================
+//
+//  Sweep specification files.
+//
+// ========================================================================
+
+static void specError(const string& path, const string& section, const string& msg)
+{
+    cerr << path << ": [" << section << "]: " << msg << endl;
+    exit(1);
+}
+
+// Sizes may have a K, M or G (binary) suffix
+static uint64_t parseBytes(const string& path, const string& section,
+                           const string& key, const string& value)
+{
+    char* end;
+    uint64_t v = strtoull(value.c_str(), &end, 0);
+    if (end == value.c_str())
+    {
+        specError(path, section, key + " is not a size: " + value);
+    }
+
+    switch (*end)
+    {
+      case 'K': case 'k': v <<= 10; end += 1; break;
+      case 'M': case 'm': v <<= 20; end += 1; break;
+      case 'G': case 'g': v <<= 30; end += 1; break;
+      default: break;
+    }
+
+    if (*end != '\0')
+    {
+        specError(path, section, key + " is not a size: " + value);
+    }
+
+    return v;
+}
+
+static uint64_t parseUInt(const string& path, const string& section,
+                          const string& key, const string& value)
+{
+    char* end;
+    uint64_t v = strtoull(value.c_str(), &end, 0);
+    if ((end == value.c_str()) || (*end != '\0'))
+    {
+        specError(path, section, key + " is not a number: " + value);
+    }
+
+    return v;
+}
+
+static bool parseBool(const string& path, const string& section,
+                      const string& key, const string& value)
+{
+    if ((value == "1") || (value == "true")) return true;
+    if ((value == "0") || (value == "false")) return false;
+
+    specError(path, section, key + " is not a boolean: " + value);
+    return false;
+}
+
+static uint8_t parseVC(const string& path, const string& section,
+                       const string& key, const string& value)
+{
+    for (uint32_t vc = 0; vc < 4; vc++)
+    {
+        if (value == vcName(vc)) return vc;
+    }
+
+    uint64_t vc = parseUInt(path, section, key, value);
+    if (vc >= 4)
+    {
+        specError(path, section, key + " must be 0-3 or VA/VL0/VH0/VH1: " + value);
+    }
+
+    return vc;
+}
+
+
+std::vector<t_sweep_group> sweepLoadGroups(const string& path,
+                                           const t_sweep_group& tmpl,
+                                           uint64_t buffer_bytes)
+{
+    namespace pt = boost::property_tree;
+
+    pt::ptree spec;
+    try
+    {
+        pt::read_ini(path, spec);
+    }
+    catch (const pt::ini_parser_error& e)
+    {
+        cerr << "Failed to load sweep: " << e.what() << endl;
+        exit(1);
+    }
+
+    std::vector<t_sweep_group> groups;
+
+    for (pt::ptree::const_iterator s = spec.begin(); s != spec.end(); s++)
+    {
+        const string& section = s->first;
+        if (s->second.empty())
+        {
+            cerr << path << ": " << section << ": keys must be inside a [group] section" << endl;
+            exit(1);
+        }
+
+        t_sweep_group g = tmpl;
+        g.name = section;
+        g.mode = SWEEP_MODE_READ;
+        g.min_bytes = 0;
+        g.max_bytes = buffer_bytes;
+
+        for (pt::ptree::const_iterator k = s->second.begin(); k != s->second.end(); k++)
+        {
+            const string& key = k->first;
+            const string value = k->second.data();
+
+            if (key == "mode")
+            {
+                if (value == "read") g.mode = SWEEP_MODE_READ;
+                else if (value == "write") g.mode = SWEEP_MODE_WRITE;
+                else if (value == "rw") g.mode = SWEEP_MODE_RW;
+                else specError(path, section, "mode must be read, write or rw: " + value);
+            }
+            else if (key == "min-bytes")
+            {
+                g.min_bytes = parseBytes(path, section, key, value);
+            }
+            else if (key == "max-bytes")
+            {
+                g.max_bytes = parseBytes(path, section, key, value);
+            }
+            else if (key == "min-stride")
+            {
+                g.min_stride = parseUInt(path, section, key, value);
+            }
+            else if (key == "max-stride")
+            {
+                g.max_stride = parseUInt(path, section, key, value);
+            }
+            else if (key == "vc")
+            {
+                g.vc = parseVC(path, section, key, value);
+            }
+            else if (key == "mcl")
+            {
+                g.mcl = sweepEncodeMCL(int(parseUInt(path, section, key, value)));
+            }
+            else if (key == "rdline-s")
+            {
+                g.rdline_s = parseBool(path, section, key, value);
+            }
+            else if (key == "wrline-m")
+            {
+                g.wrline_m = parseBool(path, section, key, value);
+            }
+            else
+            {
+                specError(path, section, "unknown key: " + key);
+            }
+        }
+
+        if (g.max_bytes > buffer_bytes)
+        {
+            std::ostringstream msg;
+            msg << "max-bytes exceeds the " << buffer_bytes << " byte test buffer";
+            specError(path, section, msg.str());
+        }
+        if (g.min_bytes > g.max_bytes)
+        {
+            specError(path, section, "min-bytes is larger than max-bytes");
+        }
+
+        groups.push_back(g);
+    }
+
+    if (groups.empty())
+    {
+        cerr << path << ": sweep has no groups" << endl;
+        exit(1);
+    }
+
+    return groups;
+}
+
+
+std::vector<t_sweep_point> sweepEnumerate(const std::vector<t_sweep_group>& groups,
+                                          uint32_t shard_idx,
+                                          uint32_t n_shards)
+{
+    std::vector<t_sweep_point> points;
+    uint64_t idx = 0;
+
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        const t_sweep_group& group = groups[g];
+
+        // Multi-line requests must be aligned to their size
+        uint64_t stride_incr = 1 + group.mcl;
+        uint64_t min_stride = (group.min_stride + stride_incr - 1) & ~ (stride_incr - 1);
+        uint64_t max_stride = group.max_stride + 1;
+
+        for (uint64_t mem_lines = stride_incr; mem_lines * CL(1) <= group.max_bytes; mem_lines <<= 1)
+        {
+            if (mem_lines * CL(1) < group.min_bytes) continue;
+
+            // Vary stride
+            uint64_t stride_limit = (mem_lines < max_stride ? mem_lines+1 : max_stride);
+            for (uint64_t stride = min_stride; stride < stride_limit; stride += stride_incr)
+            {
+                if ((idx++ % n_shards) != shard_idx) continue;
+
+                t_sweep_point p;
+                p.group = g;
+                p.mem_lines = mem_lines;
+                p.stride = stride;
+                points.push_back(p);
+            }
+        }
+    }
+
+    return points;
+}
+
+
+// ========================================================================
+//
+//  Result sinks.
+//
+// ========================================================================
+
+//
+// The traditional output, consumed by the gnuplot scripts.  Groups are
+// separated by two blank lines.
+//
+class SWEEP_SINK_TEXT : public SWEEP_SINK
+{
+  public:
+    SWEEP_SINK_TEXT(std::ostream& os, const t_sweep_env& env) :
+        SWEEP_SINK(os, env)
+    {};
+
+    void begin(const t_sweep_group& defaults, bool append)
+    {
+        this->defaults = defaults;
+        if (append) return;
+
+        os << "# MCL = " << (defaults.mcl + 1) << endl
+           << "# Cycles per test = " << env.cycles << endl
+           << "# AFU MHz = " << env.afu_mhz << endl
+           << "# VC = " << vcName(defaults.vc) << endl
+           << "# VC Map enabled: " << (env.vcmap_enable ? "true" : "false") << endl;
+        if (env.vcmap_enable)
+        {
+            os << "# VC Map all: " << (env.vcmap_all ? "true" : "false") << endl
+               << "# VC Map dynamic: " << (env.vcmap_dynamic ? "true" : "false") << endl;
+            if (! env.vcmap_dynamic)
+            {
+                os << "# VC Map fixed VL0 ratio: " << env.vcmap_fixed_vl0_ratio << " / 64" << endl;
+            }
+        }
+    }
+
+    void beginGroup(const t_sweep_group& group, bool first)
+    {
+        os << (first ? "#\n" : "\n\n");
+
+        const char* rd = (group.rdline_s ? "" : "not ");
+        const char* wr = (group.wrline_m ? "" : "not ");
+        switch (group.mode)
+        {
+          case SWEEP_MODE_READ:
+            os << "# Reads " << rd << "cached" << endl;
+            break;
+          case SWEEP_MODE_WRITE:
+            os << "# Writes " << wr << "cached" << endl;
+            break;
+          case SWEEP_MODE_RW:
+            os << "# Reads " << rd << "cached + Writes " << wr << "cached" << endl;
+            break;
+        }
+
+        // Only groups that override the run-wide settings say so
+        if ((group.mcl != defaults.mcl) || (group.vc != defaults.vc))
+        {
+            os << "# MCL = " << (group.mcl + 1) << endl
+               << "# VC = " << vcName(group.vc) << endl;
+        }
+
+        os << "# Mem Bytes, Stride, " << TEST_MEM_PERF::statsHeader() << endl;
+    }
+
+    void result(const t_sweep_group& group,
+                const t_sweep_point& point,
+                const TEST_MEM_PERF::t_test_stats& stats,
+                const TEST_MEM_PERF::t_test_dist& dist)
+    {
+        os << point.mem_lines * CL(1) << " "
+           << point.stride << " "
+           << stats
+           << endl;
+    }
+
+  private:
+    t_sweep_group defaults;
+};
+
+
+//
+// One row per point with the full configuration, suitable for
+// spreadsheets and data frames.
+//
+class SWEEP_SINK_CSV : public SWEEP_SINK
+{
+  public:
+    SWEEP_SINK_CSV(std::ostream& os, const t_sweep_env& env) :
+        SWEEP_SINK(os, env)
+    {};
+
+    void begin(const t_sweep_group& defaults, bool append)
+    {
+        if (append) return;
+
+        os << "group,mode,mem_bytes,stride,mcl,vc,rdline_s,wrline_m,"
+           << "cycles,afu_mhz,vcmap_enable,vcmap_all,vcmap_dynamic,"
+           << "vcmap_fixed_vl0_ratio,vcmap_only_writes,"
+           << "read_gbs,write_gbs,vl0_lines,vh0_lines,vh1_lines,"
+           << "vl0_rd_hits_per_1000,vl0_wr_hits_per_1000,"
+           << "read_max_inflight_lines,read_avg_latency_cycles,"
+           << "write_max_inflight_lines,write_avg_latency_cycles,"
+           << "read_almost_full_pct,write_almost_full_pct,"
+           << "actual_cycles,run_sec,"
+           << "read_lat_p50,read_lat_p99,read_lat_p999,"
+           << "write_lat_p50,write_lat_p99,write_lat_p999,"
+           << "runs,rejected_runs,converged";
+        distHeader("read_gbs");
+        distHeader("write_gbs");
+        distHeader("read_latency_cycles");
+        distHeader("write_latency_cycles");
+        for (int i = 0; i < TEST_MEM_PERF::N_LAT_BUCKETS; i++) os << ",read_lat_hist_" << i;
+        for (int i = 0; i < TEST_MEM_PERF::N_LAT_BUCKETS; i++) os << ",write_lat_hist_" << i;
+        os << endl;
+    }
+
+    void beginGroup(const t_sweep_group& group, bool first) {}
+
+    void result(const t_sweep_group& group,
+                const t_sweep_point& point,
+                const TEST_MEM_PERF::t_test_stats& stats,
+                const TEST_MEM_PERF::t_test_dist& dist)
+    {
+        TEST_MEM_PERF::t_test_stats_summary s = TEST_MEM_PERF::summarizeStats(stats);
+
+        os << quote(group.name) << ","
+           << modeName(group.mode) << ","
+           << point.mem_lines * CL(1) << ","
+           << point.stride << ","
+           << decodeMCL(group.mcl) << ","
+           << vcName(group.vc) << ","
+           << group.rdline_s << ","
+           << group.wrline_m << ","
+           << env.cycles << ","
+           << env.afu_mhz << ","
+           << env.vcmap_enable << ","
+           << env.vcmap_all << ","
+           << env.vcmap_dynamic << ","
+           << env.vcmap_fixed_vl0_ratio << ","
+           << env.vcmap_only_writes << ","
+           << boost::format("%.3f") % s.read_gbs << ","
+           << boost::format("%.3f") % s.write_gbs << ","
+           << s.vl0_lines << ","
+           << stats.vh0_lines << ","
+           << stats.vh1_lines << ","
+           << s.vl0_rd_hits_per_1000 << ","
+           << s.vl0_wr_hits_per_1000 << ","
+           << stats.read_max_inflight_lines << ","
+           << stats.read_average_latency << ","
+           << stats.write_max_inflight_lines << ","
+           << stats.write_average_latency << ","
+           << boost::format("%.4f") % s.read_almost_full_pct << ","
+           << boost::format("%.4f") % s.write_almost_full_pct << ","
+           << stats.actual_cycles << ","
+           << boost::format("%.6f") % stats.run_sec << ","
+           << boost::format("%.1f") % s.read_lat_p50 << ","
+           << boost::format("%.1f") % s.read_lat_p99 << ","
+           << boost::format("%.1f") % s.read_lat_p999 << ","
+           << boost::format("%.1f") % s.write_lat_p50 << ","
+           << boost::format("%.1f") % s.write_lat_p99 << ","
+           << boost::format("%.1f") % s.write_lat_p999 << ","
+           << dist.n_runs << ","
+           << dist.n_rejected << ","
+           << dist.converged;
+        distValues(dist.read_gbs, "%.3f");
+        distValues(dist.write_gbs, "%.3f");
+        distValues(dist.read_latency, "%.1f");
+        distValues(dist.write_latency, "%.1f");
+        for (int i = 0; i < TEST_MEM_PERF::N_LAT_BUCKETS; i++) os << "," << stats.read_latency_hist[i];
+        for (int i = 0; i < TEST_MEM_PERF::N_LAT_BUCKETS; i++) os << "," << stats.write_latency_hist[i];
+        os << endl;
+    }
+
+  private:
+    void distHeader(const char* name)
+    {
+        os << "," << name << "_median"
+           << "," << name << "_p5"
+           << "," << name << "_p95"
+           << "," << name << "_ci95";
+    }
+
+    void distValues(const TEST_MEM_PERF::t_metric_dist& d, const char* fmt)
+    {
+        os << "," << boost::format(fmt) % d.median
+           << "," << boost::format(fmt) % d.p5
+           << "," << boost::format(fmt) % d.p95
+           << "," << boost::format(fmt) % d.ci95;
+    }
+
+    static string quote(const string& str)
+    {
+        if (str.find_first_of(",\"\n") == string::npos) return str;
+
+        string q = "\"";
+        for (size_t i = 0; i < str.size(); i++)
+        {
+            if (str[i] == '"') q += '"';
+            q += str[i];
+        }
+        return q + "\"";
+    }
+};
+
+
+//
+// JSON Lines: one self-describing object per point.
+//
+class SWEEP_SINK_JSON : public SWEEP_SINK
+{
+  public:
+    SWEEP_SINK_JSON(std::ostream& os, const t_sweep_env& env) :
+        SWEEP_SINK(os, env)
+    {};
+
+    void begin(const t_sweep_group& defaults, bool append) {}
+    void beginGroup(const t_sweep_group& group, bool first) {}
+
+    void result(const t_sweep_group& group,
+                const t_sweep_point& point,
+                const TEST_MEM_PERF::t_test_stats& stats,
+                const TEST_MEM_PERF::t_test_dist& dist)
+    {
+        TEST_MEM_PERF::t_test_stats_summary s = TEST_MEM_PERF::summarizeStats(stats);
+
+        os << "{\"group\":" << quote(group.name)
+           << ",\"config\":{"
+           << "\"mode\":\"" << modeName(group.mode) << "\""
+           << ",\"mem_bytes\":" << point.mem_lines * CL(1)
+           << ",\"stride\":" << point.stride
+           << ",\"mcl\":" << decodeMCL(group.mcl)
+           << ",\"vc\":\"" << vcName(group.vc) << "\""
+           << ",\"rdline_s\":" << boolean(group.rdline_s)
+           << ",\"wrline_m\":" << boolean(group.wrline_m)
+           << ",\"cycles\":" << env.cycles
+           << ",\"afu_mhz\":" << env.afu_mhz
+           << ",\"vcmap\":{"
+           << "\"enable\":" << boolean(env.vcmap_enable)
+           << ",\"all\":" << boolean(env.vcmap_all)
+           << ",\"dynamic\":" << boolean(env.vcmap_dynamic)
+           << ",\"fixed_vl0_ratio\":" << env.vcmap_fixed_vl0_ratio
+           << ",\"only_writes\":" << boolean(env.vcmap_only_writes)
+           << "}"
+           << ",\"repeat\":{"
+           << "\"warmup_runs\":" << env.repeat.warmup_runs
+           << ",\"min_runs\":" << env.repeat.min_runs
+           << ",\"max_runs\":" << env.repeat.max_runs
+           << ",\"ci_target\":" << env.repeat.ci_target
+           << "}}"
+           << ",\"stats\":{"
+           << "\"read_gbs\":" << boost::format("%.3f") % s.read_gbs
+           << ",\"write_gbs\":" << boost::format("%.3f") % s.write_gbs
+           << ",\"vl0_lines\":" << s.vl0_lines
+           << ",\"vh0_lines\":" << stats.vh0_lines
+           << ",\"vh1_lines\":" << stats.vh1_lines
+           << ",\"vl0_rd_hits_per_1000\":" << s.vl0_rd_hits_per_1000
+           << ",\"vl0_wr_hits_per_1000\":" << s.vl0_wr_hits_per_1000
+           << ",\"read_max_inflight_lines\":" << stats.read_max_inflight_lines
+           << ",\"read_avg_latency_cycles\":" << stats.read_average_latency
+           << ",\"write_max_inflight_lines\":" << stats.write_max_inflight_lines
+           << ",\"write_avg_latency_cycles\":" << stats.write_average_latency
+           << ",\"read_almost_full_pct\":" << boost::format("%.4f") % s.read_almost_full_pct
+           << ",\"write_almost_full_pct\":" << boost::format("%.4f") % s.write_almost_full_pct
+           << ",\"actual_cycles\":" << stats.actual_cycles
+           << ",\"run_sec\":" << boost::format("%.6f") % stats.run_sec
+           << "}"
+           << ",\"latency\":{"
+           << "\"read\":{"
+           << "\"p50\":" << boost::format("%.1f") % s.read_lat_p50
+           << ",\"p99\":" << boost::format("%.1f") % s.read_lat_p99
+           << ",\"p999\":" << boost::format("%.1f") % s.read_lat_p999
+           << ",\"hist\":" << hist(stats.read_latency_hist)
+           << "},\"write\":{"
+           << "\"p50\":" << boost::format("%.1f") % s.write_lat_p50
+           << ",\"p99\":" << boost::format("%.1f") % s.write_lat_p99
+           << ",\"p999\":" << boost::format("%.1f") % s.write_lat_p999
+           << ",\"hist\":" << hist(stats.write_latency_hist)
+           << "}}"
+           << ",\"dist\":{"
+           << "\"runs\":" << dist.n_runs
+           << ",\"rejected_runs\":" << dist.n_rejected
+           << ",\"converged\":" << boolean(dist.converged);
+        distValues("read_gbs", dist.read_gbs, "%.3f");
+        distValues("write_gbs", dist.write_gbs, "%.3f");
+        distValues("read_latency_cycles", dist.read_latency, "%.1f");
+        distValues("write_latency_cycles", dist.write_latency, "%.1f");
+        os << "}}"
+           << endl;
+    }
+
+  private:
+    void distValues(const char* name, const TEST_MEM_PERF::t_metric_dist& d, const char* fmt)
+    {
+        os << ",\"" << name << "\":{"
+           << "\"median\":" << boost::format(fmt) % d.median
+           << ",\"p5\":" << boost::format(fmt) % d.p5
+           << ",\"p95\":" << boost::format(fmt) % d.p95
+           << ",\"ci95\":" << boost::format(fmt) % d.ci95
+           << "}";
+    }
+
+    static string hist(const uint64_t* h)
+    {
+        std::ostringstream a;
+        a << "[";
+        for (int i = 0; i < TEST_MEM_PERF::N_LAT_BUCKETS; i++)
+        {
+            a << (i ? "," : "") << h[i];
+        }
+        a << "]";
+        return a.str();
+    }
+
+    static const char* boolean(bool b)
+    {
+        return b ? "true" : "false";
+    }
+
+    static string quote(const string& str)
+    {
+        string q = "\"";
+        for (size_t i = 0; i < str.size(); i++)
+        {
+            unsigned char c = str[i];
+            if ((c == '"') || (c == '\\'))
+            {
+                q += '\\';
+                q += c;
+            }
+            else if (c < 0x20)
+            {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                q += buf;
+            }
+            else
+            {
+                q += c;
+            }
+        }
+        return q + "\"";
+    }
+};
+
+
+//
+// Latency histograms, plot-ready.  Each point is a gnuplot data set
+// (select with "index"), one line per log2 bucket.
+//
+class SWEEP_SINK_LAT_HIST : public SWEEP_SINK
+{
+  public:
+    SWEEP_SINK_LAT_HIST(std::ostream& os, const t_sweep_env& env) :
+        SWEEP_SINK(os, env)
+    {};
+
+    void begin(const t_sweep_group& defaults, bool append)
+    {
+        if (append) return;
+
+        os << "# Latency histograms (cycles at " << env.afu_mhz << " MHz)" << endl
+           << "# Cycles per test = " << env.cycles << endl;
+    }
+
+    void beginGroup(const t_sweep_group& group, bool first) {}
+
+    void result(const t_sweep_group& group,
+                const t_sweep_point& point,
+                const TEST_MEM_PERF::t_test_stats& stats,
+                const TEST_MEM_PERF::t_test_dist& dist)
+    {
+        TEST_MEM_PERF::t_test_stats_summary s = TEST_MEM_PERF::summarizeStats(stats);
+
+        os << "# Group " << group.name
+           << ", " << modeName(group.mode)
+           << ", Mem Bytes " << point.mem_lines * CL(1)
+           << ", Stride " << point.stride
+           << ", MCL " << decodeMCL(group.mcl)
+           << ", VC " << vcName(group.vc)
+           << ", Reads " << (group.rdline_s ? "" : "not ") << "cached"
+           << ", Writes " << (group.wrline_m ? "" : "not ") << "cached" << endl
+           << "# Read p50/p99/p99.9 "
+           << boost::format("%.0f/%.0f/%.0f") % s.read_lat_p50 % s.read_lat_p99 % s.read_lat_p999
+           << ", Write p50/p99/p99.9 "
+           << boost::format("%.0f/%.0f/%.0f") % s.write_lat_p50 % s.write_lat_p99 % s.write_lat_p999
+           << endl
+           << "# Bucket Min Cycles, Bucket Max Cycles, Read Responses, Write Responses" << endl;
+
+        for (int i = 0; i < TEST_MEM_PERF::N_LAT_BUCKETS; i++)
+        {
+            os << (i ? (1 << i) : 0) << " "
+               << (2 << i) - 1 << " "
+               << stats.read_latency_hist[i] << " "
+               << stats.write_latency_hist[i]
+               << endl;
+        }
+
+        os << endl
+           << endl;
+    }
+};
+
+
+SWEEP_SINK* allocSweepSink(const string& format,
+                           std::ostream& os,
+                           const t_sweep_env& env)
+{
+    if (format == "text") return new SWEEP_SINK_TEXT(os, env);
+    if (format == "csv") return new SWEEP_SINK_CSV(os, env);
+    if (format == "json") return new SWEEP_SINK_JSON(os, env);
+    if (format == "lathist") return new SWEEP_SINK_LAT_HIST(os, env);
+    return NULL;
+}
+
+
+// ========================================================================
+//
+//  Checkpoints.
+//
+// ========================================================================
+
+uint64_t SWEEP_CHECKPOINT::fingerprint(const std::vector<t_sweep_group>& groups,
+                                       const t_sweep_env& env,
+                                       uint32_t shard_idx,
+                                       uint32_t n_shards)
+{
+    std::ostringstream desc;
+
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        const t_sweep_group& group = groups[g];
+        desc << group.name << " " << group.mode << " "
+             << group.min_bytes << " " << group.max_bytes << " "
+             << group.min_stride << " " << group.max_stride << " "
+             << uint32_t(group.vc) << " " << uint32_t(group.mcl) << " "
+             << group.rdline_s << " " << group.wrline_m << "\n";
+    }
+
+    // Everything that changes the meaning of a result.  The AFU clock
+    // is omitted since it may vary slightly from run to run.
+    desc << env.cycles << " " << env.buffer_bytes << " "
+         << env.vcmap_enable << " " << env.vcmap_all << " "
+         << env.vcmap_dynamic << " " << env.vcmap_fixed_vl0_ratio << " "
+         << env.vcmap_only_writes << " "
+         << env.repeat.warmup_runs << " " << env.repeat.min_runs << " "
+         << env.repeat.max_runs << " " << env.repeat.ci_target << " "
+         << shard_idx << "/" << n_shards;
+
+    // FNV-1a
+    const string s = desc.str();
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        h ^= uint8_t(s[i]);
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+
+bool SWEEP_CHECKPOINT::open(const string& path, uint64_t fp)
+{
+    char fp_str[32];
+    snprintf(fp_str, sizeof(fp_str), "%016llx", (unsigned long long)fp);
+
+    std::ifstream in(path.c_str());
+    string line;
+    bool exists = in.is_open() && std::getline(in, line);
+
+    if (exists)
+    {
+        if (line != string("# sweep ") + fp_str)
+        {
+            cerr << "Checkpoint " << path << " was written by a different sweep" << endl;
+            return false;
+        }
+
+        while (std::getline(in, line))
+        {
+            t_key k;
+            unsigned long long g, mem_lines, stride;
+            if (sscanf(line.c_str(), "%llu %llu %llu", &g, &mem_lines, &stride) != 3)
+            {
+                // Most likely a partial line from an interrupted write
+                continue;
+            }
+
+            k.group = g;
+            k.mem_lines = mem_lines;
+            k.stride = stride;
+            done.insert(k);
+        }
+
+        n_loaded = done.size();
+    }
+    in.close();
+
+    file.open(path.c_str(), exists ? std::ios::app : std::ios::trunc);
+    if (! file.is_open())
+    {
+        cerr << "Failed to open checkpoint " << path << endl;
+        return false;
+    }
+
+    if (! exists)
+    {
+        file << "# sweep " << fp_str << endl;
+    }
+    else
+    {
+        // Terminate a partial line left by an interrupted write
+        file << endl;
+    }
+
+    return file.good();
+}
+
+
+bool SWEEP_CHECKPOINT::isDone(const t_sweep_point& point) const
+{
+    t_key k;
+    k.group = point.group;
+    k.mem_lines = point.mem_lines;
+    k.stride = point.stride;
+
+    return done.find(k) != done.end();
+}
+
+
+void SWEEP_CHECKPOINT::markDone(const t_sweep_point& point)
+{
+    t_key k;
+    k.group = point.group;
+    k.mem_lines = point.mem_lines;
+    k.stride = point.stride;
+    done.insert(k);
+
+    file << point.group << " " << point.mem_lines << " " << point.stride << endl;
+}
@@ -0,0 +1,227 @@
+// Copyright(c) 2007-2016, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __TEST_MEM_PERF_SWEEP_H__
+#define __TEST_MEM_PERF_SWEEP_H__ 1
+
+//
+// Declarative sweeps for test_mem_perf.  A sweep is an ordered list of
+// groups, each a buffer size x stride grid run in one mode (read, write
+// or read+write).  Results are reported through a sink (the traditional
+// gnuplot-friendly text, CSV or JSON Lines) and completed points may be
+// recorded in a checkpoint file so an interrupted sweep can be resumed.
+//
+
+#include <stdint.h>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test_mem_perf.h"
+
+typedef enum
+{
+    SWEEP_MODE_READ,
+    SWEEP_MODE_WRITE,
+    SWEEP_MODE_RW
+}
+t_sweep_mode;
+
+typedef struct
+{
+    string name;
+    t_sweep_mode mode;
+    uint64_t min_bytes;
+    uint64_t max_bytes;
+    uint64_t min_stride;
+    uint64_t max_stride;
+    uint8_t vc;
+    // Encoded as in t_test_config (requested lines - 1, random sizes in bit 2)
+    uint8_t mcl;
+    bool rdline_s;
+    bool wrline_m;
+}
+t_sweep_group;
+
+typedef struct
+{
+    size_t group;
+    uint64_t mem_lines;
+    uint64_t stride;
+}
+t_sweep_point;
+
+// Run-wide state recorded with every result
+typedef struct
+{
+    uint64_t cycles;
+    uint64_t afu_mhz;
+    uint64_t buffer_bytes;
+    bool vcmap_enable;
+    bool vcmap_all;
+    bool vcmap_dynamic;
+    int32_t vcmap_fixed_vl0_ratio;
+    bool vcmap_only_writes;
+    // Each point is measured by TEST_MEM_PERF::runTestStats()
+    TEST_MEM_PERF::t_test_repeat repeat;
+}
+t_sweep_env;
+
+
+//
+// Map a user-visible MCL (1, 2, 4 or 0 for random) to the t_test_config
+// encoding.  Exits on illegal values.
+//
+uint8_t sweepEncodeMCL(int mcl);
+
+//
+// The default sweep: reads, writes and read+write over all buffer sizes,
+// with the template group's channel, hints and stride range.
+//
+std::vector<t_sweep_group> sweepDefaultGroups(const t_sweep_group& tmpl,
+                                              uint64_t buffer_bytes);
+
+//
+// Load a sweep from an INI file.  Each section is a group, run in file
+// order.  Keys not present in a section are taken from tmpl.
+//
+std::vector<t_sweep_group> sweepLoadGroups(const string& path,
+                                           const t_sweep_group& tmpl,
+                                           uint64_t buffer_bytes);
+
+//
+// Expand groups to points in run order.  Only points belonging to shard
+// shard_idx of n_shards are returned.
+//
+std::vector<t_sweep_point> sweepEnumerate(const std::vector<t_sweep_group>& groups,
+                                          uint32_t shard_idx = 0,
+                                          uint32_t n_shards = 1);
+
+
+// ========================================================================
+//
+//  Result sinks.
+//
+// ========================================================================
+
+class SWEEP_SINK
+{
+  public:
+    SWEEP_SINK(std::ostream& os, const t_sweep_env& env) :
+        os(os),
+        env(env)
+    {};
+
+    virtual ~SWEEP_SINK() {};
+
+    // Called once before any results.  append is true when adding to the
+    // output of an earlier, interrupted run.
+    virtual void begin(const t_sweep_group& defaults, bool append) = 0;
+
+    // Called before the first result of each group
+    virtual void beginGroup(const t_sweep_group& group, bool first) = 0;
+
+    virtual void result(const t_sweep_group& group,
+                        const t_sweep_point& point,
+                        const TEST_MEM_PERF::t_test_stats& stats,
+                        const TEST_MEM_PERF::t_test_dist& dist) = 0;
+
+  protected:
+    std::ostream& os;
+    const t_sweep_env env;
+};
+
+// Allocate a sink by name ("text", "csv", "json" or "lathist", the
+// plot-ready latency histograms).  Returns NULL when the format is unknown.
+SWEEP_SINK* allocSweepSink(const string& format,
+                           std::ostream& os,
+                           const t_sweep_env& env);
+
+
+// ========================================================================
+//
+//  Checkpoints.
+//
+// ========================================================================
+
+//
+// A checkpoint is a text file.  The first line holds a fingerprint of the
+// sweep (groups, run length, buffer size and shard) so a checkpoint can't
+// be applied to a different sweep.  Each following line names a completed
+// point.  Lines are flushed as points complete.
+//
+class SWEEP_CHECKPOINT
+{
+  public:
+    SWEEP_CHECKPOINT() :
+        n_loaded(0)
+    {};
+
+    ~SWEEP_CHECKPOINT() {};
+
+    static uint64_t fingerprint(const std::vector<t_sweep_group>& groups,
+                                const t_sweep_env& env,
+                                uint32_t shard_idx,
+                                uint32_t n_shards);
+
+    // Open (or create) path.  Returns false on error or when an existing
+    // file was written for a different sweep.
+    bool open(const string& path, uint64_t fp);
+
+    bool isOpen(void) const { return file.is_open(); }
+
+    // Number of completed points loaded from an earlier run
+    size_t numLoaded(void) const { return n_loaded; }
+
+    bool isDone(const t_sweep_point& point) const;
+    void markDone(const t_sweep_point& point);
+
+  private:
+    typedef struct
+    {
+        size_t group;
+        uint64_t mem_lines;
+        uint64_t stride;
+    }
+    t_key;
+
+    struct keyLess
+    {
+        bool operator() (const t_key& a, const t_key& b) const
+        {
+            if (a.group != b.group) return a.group < b.group;
+            if (a.mem_lines != b.mem_lines) return a.mem_lines < b.mem_lines;
+            return a.stride < b.stride;
+        }
+    };
+
+    std::set<t_key, keyLess> done;
+    std::ofstream file;
+    size_t n_loaded;
+};
+
+#endif // __TEST_MEM_PERF_SWEEP_H__
@@ -0,0 +1,236 @@
+// Copyright(c) 2017, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+
+#include "test_mpf_cxx.h"
+
+// Generated from the AFU JSON file by afu_json_mgr
+#include "afu_json_info.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include <opae/mpf/cxx/mpf_buffer_pool.h>
+#include <opae/mpf/cxx/mpf_completion_engine.h>
+
+using opae::fpga::bbb::mpf::types::mpf_buffer_pool;
+using opae::fpga::bbb::mpf::types::mpf_buffer_lease;
+using opae::fpga::bbb::mpf::types::mpf_buffer_view;
+using opae::fpga::bbb::mpf::types::mpf_completion_engine;
+
+// ========================================================================
+//
+// Each test must provide these functions used by main to find the
+// specific test instance.
+//
+// ========================================================================
+
+const char* testAFUID()
+{
+    return AFU_ACCEL_UUID;
+}
+
+void testConfigOptions(po::options_description &desc)
+{
+    // No test-specific options
+}
+
+CCI_TEST* allocTest(const po::variables_map& vm, SVC_WRAPPER& svc)
+{
+    return new TEST_MPF_CXX(vm, svc);
+}
+
+
+// ========================================================================
+//
+// Checks of the libMPF-cxx helpers.  The AFU isn't used beyond providing
+// VTP.
+//
+// ========================================================================
+
+int TEST_MPF_CXX::test()
+{
+    if (! mpfVtpIsAvailable(svc.mpf->c_type()))
+    {
+        cerr << "VTP is not available in the AFU" << endl;
+        return 1;
+    }
+
+    int errors = 0;
+    errors += testBufferViewIOVA();
+    errors += testCompletionEngine();
+
+    cout << (errors ? "FAIL" : "PASS") << endl;
+    return errors ? 1 : 0;
+}
+
+
+int TEST_MPF_CXX::testBufferViewIOVA()
+{
+    int errors = 0;
+
+    auto pool = mpf_buffer_pool::create(svc.mpf);
+    mpf_buffer_lease lease = pool->acquire(16 * 1024);
+    mpf_buffer_view<uint32_t> all = lease.as<uint32_t>();
+
+    if (all.iova() != lease.iova())
+    {
+        cerr << "buffer_view: iova() of a full view doesn't match the lease" << endl;
+        errors += 1;
+    }
+
+    // The lease starts on a page boundary, so every offset within the
+    // first 4KB is in the same physical page as the start.
+    const size_t offsets[] = { 1, 5, 1023 };
+    for (size_t idx : offsets)
+    {
+        mpf_buffer_view<uint32_t> sub = all.subview(idx, 1);
+        uint64_t expect = lease.iova() + idx * sizeof(uint32_t);
+
+        if (sub.iova() != expect)
+        {
+            cerr << "buffer_view: subview(" << idx << ") iova() is 0x"
+                 << hex << sub.iova() << ", expected 0x" << expect << dec << endl;
+            errors += 1;
+        }
+    }
+
+    cout << "buffer_view iova: " << (errors ? "FAIL" : "PASS") << endl;
+    return errors;
+}
+
+
+//
+// Completion words are written by the host, standing in for an AFU, so
+// the check covers the engine alone.
+//
+int TEST_MPF_CXX::testCompletionEngine()
+{
+    int errors = 0;
+
+    auto pool = mpf_buffer_pool::create(svc.mpf);
+    mpf_buffer_lease lease = pool->acquire(4096);
+    mpf_buffer_view<uint64_t> words = lease.as<uint64_t>();
+    for (auto& w : words) w = 0;
+    volatile uint64_t* dsm = words.data();
+
+    auto engine = mpf_completion_engine::create();
+
+    // Register
+    std::future<uint64_t> f_equal = engine->submit(&dsm[0], 0x5);
+    std::future<uint64_t> f_nonzero =
+        engine->submit(&dsm[1], 0, mpf_completion_engine::match_not_equal);
+    std::future<uint64_t> f_masked =
+        engine->submit(&dsm[2], 0x100, mpf_completion_engine::match_equal, 0xf00);
+
+    std::atomic<uint64_t> cb_value(0);
+    engine->submit(&dsm[3], 0x7,
+                   [&cb_value](uint64_t v) { cb_value = v; });
+
+    if (engine->outstanding() != 4)
+    {
+        cerr << "completion_engine: " << engine->outstanding()
+             << " jobs outstanding after registering 4" << endl;
+        errors += 1;
+    }
+
+    // Complete
+    dsm[0] = 0x4;
+    dsm[2] = 0x1ff;
+    dsm[1] = 0x42;
+    dsm[0] = 0x5;
+    dsm[3] = 0x7;
+
+    const auto timeout = std::chrono::seconds(5);
+    if ((f_equal.wait_for(timeout) != std::future_status::ready) ||
+        (f_equal.get() != 0x5))
+    {
+        cerr << "completion_engine: match_equal job didn't complete" << endl;
+        errors += 1;
+    }
+    if ((f_nonzero.wait_for(timeout) != std::future_status::ready) ||
+        (f_nonzero.get() != 0x42))
+    {
+        cerr << "completion_engine: match_not_equal job didn't complete" << endl;
+        errors += 1;
+    }
+    if ((f_masked.wait_for(timeout) != std::future_status::ready) ||
+        (f_masked.get() != 0x1ff))
+    {
+        cerr << "completion_engine: masked job didn't complete" << endl;
+        errors += 1;
+    }
+
+    // Callback
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while ((engine->outstanding() != 0) &&
+           (std::chrono::steady_clock::now() < deadline))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (cb_value != 0x7)
+    {
+        cerr << "completion_engine: callback wasn't invoked" << endl;
+        errors += 1;
+    }
+    if (engine->outstanding() != 0)
+    {
+        cerr << "completion_engine: " << engine->outstanding()
+             << " jobs outstanding after all completed" << endl;
+        errors += 1;
+    }
+
+    // Shutdown with jobs outstanding.  The future breaks and the callback
+    // isn't invoked.
+    bool cb_invoked = false;
+    std::future<uint64_t> f_abandoned = engine->submit(&dsm[4], 1);
+    engine->submit(&dsm[5], 1, [&cb_invoked](uint64_t) { cb_invoked = true; });
+    engine.reset();
+
+    try
+    {
+        f_abandoned.get();
+        cerr << "completion_engine: abandoned job completed" << endl;
+        errors += 1;
+    }
+    catch (const std::future_error& e)
+    {
+        if (e.code() != std::future_errc::broken_promise)
+        {
+            cerr << "completion_engine: abandoned job failed with "
+                 << e.what() << endl;
+            errors += 1;
+        }
+    }
+    if (cb_invoked)
+    {
+        cerr << "completion_engine: callback of abandoned job was invoked" << endl;
+        errors += 1;
+    }
+
+    cout << "completion_engine: " << (errors ? "FAIL" : "PASS") << endl;
+    return errors;
+}
@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <time.h>
 #include <boost/format.hpp>
+#include <opae/mpf/wait.h>
 #include <boost/algorithm/string.hpp>
 #include <stdlib.h>
 #include <sys/mman.h>
@@ -262,6 +263,10 @@ int TEST_RANDOM::test()
     uint64_t trips = uint64_t(vm["repeat"].as<int>());
     uint64_t iter = 0;
 
+    // Adapts polling of dsm to the observed test run times
+    mpf_wait_state dsm_wait;
+    mpfWaitInit(&dsm_wait);
+
     uint64_t vl0_lines = readCommonCSR(CCI_TEST::CSR_COMMON_VL0_RD_LINES) +
                          readCommonCSR(CCI_TEST::CSR_COMMON_VL0_WR_LINES);
     uint64_t vh0_lines = readCommonCSR(CCI_TEST::CSR_COMMON_VH0_LINES);
@@ -283,19 +288,15 @@ int TEST_RANDOM::test()
                      (enable_writes << 1) |
                      enable_reads);
 
-        // Wait time for something to happen
-        struct timespec ms;
-        // Longer when simulating
-        ms.tv_sec = (hwIsSimulated() ? 2 : 0);
-        ms.tv_nsec = 2500000;
+        // Time between checks for a hung test.  Longer when simulating.
+        uint64_t check_ns = (hwIsSimulated() ? 2000000000 : 0) + 2500000;
 
         uint64_t iter_state_end = 0;
 
         // Wait for test to signal it is complete
-        while (*dsm == 0)
+        while (! mpfWaitUntilTimeout(&dsm_wait, dsm, ~uint64_t(0), 0, false,
+                                     check_ns, NULL))
         {
-            nanosleep(&ms, NULL);
-
             // Is the test done but not writing to DSM?  Could be a bug.
             uint8_t state = (readTestCSR(7) >> 8) & 255;
             if (state > 1)
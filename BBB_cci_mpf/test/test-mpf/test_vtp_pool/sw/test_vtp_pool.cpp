@@ -0,0 +1,161 @@
+// Copyright(c) 2017, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_vtp_pool.h"
+
+// Generated from the AFU JSON file by afu_json_mgr
+#include "afu_json_info.h"
+
+#include <chrono>
+#include <vector>
+#include <boost/format.hpp>
+
+// ========================================================================
+//
+// Each test must provide these functions used by main to find the
+// specific test instance.
+//
+// ========================================================================
+
+const char* testAFUID()
+{
+    return AFU_ACCEL_UUID;
+}
+
+void testConfigOptions(po::options_description &desc)
+{
+    // Add test-specific options
+    desc.add_options()
+        ("min-size-radix", po::value<int>()->default_value(12), "Radix of the smallest buffer size")
+        ("max-size-radix", po::value<int>()->default_value(24), "Radix of the largest buffer size")
+        ("live", po::value<int>()->default_value(4), "Buffers allocated at once in each cycle")
+        ("iter", po::value<int>()->default_value(100), "Cycles per buffer size")
+        ("pool-size-radix", po::value<int>()->default_value(28), "Radix of the buffer pool's idle byte limit")
+        ;
+}
+
+CCI_TEST* allocTest(const po::variables_map& vm, SVC_WRAPPER& svc)
+{
+    return new TEST_VTP_POOL(vm, svc);
+}
+
+
+// ========================================================================
+//
+// VTP buffer pool microbenchmark.  Compares the cost of allocating and
+// releasing buffers with and without the VTP buffer pool.  The AFU isn't
+// used beyond providing VTP.
+//
+// ========================================================================
+
+int TEST_VTP_POOL::test()
+{
+    mpf_handle_t mpf = svc.mpf->c_type();
+
+    if (! mpfVtpIsAvailable(mpf))
+    {
+        cerr << "VTP is not available in the AFU" << endl;
+        return 1;
+    }
+
+    uint32_t min_radix = uint32_t(vm["min-size-radix"].as<int>());
+    uint32_t max_radix = uint32_t(vm["max-size-radix"].as<int>());
+    uint32_t n_live = uint32_t(vm["live"].as<int>());
+    uint64_t iter = uint64_t(vm["iter"].as<int>());
+    uint64_t pool_bytes = uint64_t(1) << vm["pool-size-radix"].as<int>();
+
+    if ((min_radix < 12) || (max_radix > 30) || (min_radix > max_radix))
+    {
+        cerr << "Buffer size radix must be between 12 and 30" << endl;
+        return 1;
+    }
+
+    cout << "# " << n_live << " buffers per cycle, " << iter << " cycles" << endl
+         << "#" << endl
+         << "#   Bytes  Direct (us)  Pooled (us)  Speedup" << endl;
+
+    for (uint32_t radix = min_radix; radix <= max_radix; radix += 1)
+    {
+        size_t n_bytes = size_t(1) << radix;
+
+        // Current path: every cycle goes to the driver
+        mpfVtpSetBufferPoolSize(mpf, 0);
+        double direct_us = runCycles(n_bytes, iter, n_live);
+
+        // Pooled path.  One untimed cycle fills the pool.
+        mpfVtpSetBufferPoolSize(mpf, pool_bytes);
+        runCycles(n_bytes, 1, n_live);
+        double pooled_us = runCycles(n_bytes, iter, n_live);
+
+        cout << boost::format("%9d %12.2f %12.2f %8.1fx")
+                    % n_bytes % direct_us % pooled_us % (direct_us / pooled_us)
+             << endl;
+    }
+
+    // Release idle buffers
+    mpfVtpSetBufferPoolSize(mpf, 0);
+
+    return 0;
+}
+
+
+double TEST_VTP_POOL::runCycles(size_t n_bytes, uint64_t iter, uint32_t n_live)
+{
+    mpf_handle_t mpf = svc.mpf->c_type();
+    std::vector<void*> bufs(n_live);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < iter; i += 1)
+    {
+        for (auto& b : bufs)
+        {
+            if (FPGA_OK != mpfVtpBufferAllocate(mpf, n_bytes, &b))
+            {
+                cerr << "Failed to allocate " << n_bytes << " byte buffer" << endl;
+                exit(1);
+            }
+
+            // Typical use: touch the buffer and look up its IOVA
+            *(volatile char*)b = 0;
+            if (0 == mpfVtpGetIOAddress(mpf, b))
+            {
+                cerr << "Failed to translate buffer VA " << b << endl;
+                exit(1);
+            }
+        }
+
+        for (auto b : bufs)
+        {
+            mpfVtpBufferFree(mpf, b);
+        }
+    }
+
+    std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / double(iter);
+}
@@ -7,6 +7,7 @@
 #include <signal.h>
 
 #include <vai/fpga.h>
+#include <vai/mpf/wait.h>
 #include "csr_addr.h"
 
 struct vai_afu_conn *conn;
@@ -18,6 +19,8 @@ struct status_cl {
     uint32_t n_write;
 };
 
+static mpf_wait_state wait_state = MPF_WAIT_STATE_INIT;
+
 void handler(int sig) {
     printf("disconnecting and exiting...\n");
     vai_afu_disconnect(conn);
@@ -67,9 +70,7 @@ int vai_memcpy_test(void)
 
     printf("start!\n");
 
-    while (0 == stat->completion) {
-        usleep(500000);
-    }
+    mpfWaitUntilNonZero(&wait_state, &stat->completion);
 
     for (i=0; i<128; ++i) {
         if (src[i] != dst[i])
@@ -9,6 +9,7 @@
 #include <cstring>
 
 #include <vai/fpga.h>
+#include <vai/mpf/wait.h>
 #include "csr_addr.h"
 #include "vai_svc_wrapper.h"
 #include "image.h"
@@ -20,6 +21,8 @@ struct status_cl {
     uint32_t n_write;
 };
 
+static mpf_wait_state wait_state = MPF_WAIT_STATE_INIT;
+
 int main()
 {
     std::string file_input("input.png");
@@ -71,10 +74,7 @@ int main()
 
     printf("start!\n");
 
-    while (0 == stat->completion) {
-        usleep(500000);
-        printf("running...\n");
-    }
+    mpfWaitUntilNonZero(&wait_state, &stat->completion);
 
 
     uint64_t *ptr = (uint64_t*)dst;
@@ -10,6 +10,7 @@
 #include <x86intrin.h>
 
 #include <vai/fpga.h>
+#include <vai/mpf/wait.h>
 #include "csr_addr.h"
 #include "vai_svc_wrapper.h"
 #include "image.h"
@@ -21,6 +22,8 @@ struct status_cl {
     uint32_t n_write;
 };
 
+static mpf_wait_state wait_state = MPF_WAIT_STATE_INIT;
+
 int process_image(VAI_SVC_WRAPPER& fpga)
 {
     uint64_t t1, t2, t3, t4, t5;
@@ -80,10 +83,7 @@ int process_image(VAI_SVC_WRAPPER& fpga)
 
     printf("start!\n");
 
-    while (0 == stat->completion) {
-        //usleep(500);
-    //    printf("running...\n");
-    }
+    mpfWaitUntilNonZero(&wait_state, &stat->completion);
 
     t4 = __rdtsc(); // polling
 
@@ -11,6 +11,7 @@
 #include <sys/time.h>
 
 #include <vai/fpga.h>
+#include <vai/mpf/wait.h>
 #include "csr_addr.h"
 #include "vai_svc_wrapper.h"
 #include "image.h"
@@ -22,6 +23,8 @@ struct status_cl {
     uint32_t n_write;
 };
 
+static mpf_wait_state wait_state = MPF_WAIT_STATE_INIT;
+
 int process_image(VAI_SVC_WRAPPER& fpga, Image& image,
         char* src, char* dst, volatile struct status_cl *stat)
 {
@@ -71,10 +74,7 @@ int process_image(VAI_SVC_WRAPPER& fpga, Image& image,
 
     //printf("start!\n");
 
-    while (0 == stat->completion) {
-        //usleep(500);
-    //    printf("running...\n");
-    }
+    mpfWaitUntilNonZero(&wait_state, &stat->completion);
 
     t4 = __rdtsc(); // polling
 
@@ -9,6 +9,7 @@
 #include <sys/time.h>
 
 #include "vai_svc_wrapper.h"
+#include <vai/mpf/wait.h>
 
 #define MMIO_CSR_CONTROL 0
 
@@ -315,6 +316,7 @@ int sssp(VAI_SVC_WRAPPER *fpga, graph_t *g, int root)
     int current_level;
     int i, j, k;
     uint64_t seq_id = 0;
+    static mpf_wait_state wait_state = MPF_WAIT_STATE_INIT;
 
     if (root >= g->num_v) {
         return -EFAULT;
@@ -381,10 +383,7 @@ int sssp(VAI_SVC_WRAPPER *fpga, graph_t *g, int root)
                 continue;
             }
 
-            while (curr->status->valid == 0) {
-                //printf("[%d]: polling... state=%16llx\n", i, fpga->mmioRead64(MMIO_CSR_CONTROL));
-                //usleep(50000);
-            }
+            mpfWaitUntilNonZero(&wait_state, &curr->status->valid);
         }
 
         for (i = 0; i < g->num_intervals; i++) {